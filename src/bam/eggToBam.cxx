@@ -38,6 +38,9 @@
 #include "material.h"
 #include "materialAttrib.h"
 #include "modelRoot.h"
+#include "threadManager.h"
+
+#include <sstream>
 
 /**
  *
@@ -211,6 +214,19 @@ EggToBam() :
      "settings appearing within the egg file will override this.",
      &EggToBam::dispatch_string, nullptr, &_ctex_quality);
 
+  add_option
+    ("j", "count", 0,
+     "Specify the number of worker threads that should be used to load, "
+     "mipmap, compress and write the textures when using -txo, -txopz or "
+     "-ctex.  The default is 1, which converts them one at a time.  The files "
+     "written are the same either way."
+#ifndef HAVE_SQUISH
+     "  Since your Panda does not have libsquish compiled in, textures "
+     "compressed with -ctex are always converted one at a time."
+#endif  // HAVE_SQUISH
+     ,
+     &EggToBam::dispatch_int, nullptr, &_num_threads);
+
   add_option
     ("load-display", "display name", 0,
      "Specifies the particular display module to load to perform the texture "
@@ -230,6 +246,7 @@ EggToBam() :
   _egg_suppress_hidden = 1;
   _tex_txopz = false;
   _ctex_quality = "best";
+  _num_threads = 1;
 }
 
 /**
@@ -383,83 +400,58 @@ run() {
     // Make sure we load the actual texture images when converting them.
     textures_header_only = false;
 
-    Textures::iterator ti;
-    for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
-      Texture *tex = (*ti);
-
+    // The textures are grouped by the txo file they will be written to (or
+    // by the file they were loaded from, if no txo files are being written),
+    // so that they are processed in a consistent order, and so that two
+    // textures are never written to the same txo file at once.  Note that
+    // a.png and a.jpg would both be written to a.txo.
+    typedef pmap<Filename, pvector<Texture *> > TexturesByFile;
+    TexturesByFile by_file;
+    for (Texture *tex : _textures) {
       if (_tex_txo || _tex_txopz) {
-        Filename orig_fullpath = tex->get_fullpath().get_filename_index(0);
-        Filename fullpath = tex->get_fullpath().get_filename_index(0);
-        if (_tex_txopz) {
-          fullpath.set_extension("txo.pz");
-          // We use this clumsy syntax so that the new extension appears to be two
-          // separate extensions, .txo followed by .pz, which is what
-          // Texture::write() expects to find.
-          fullpath = Filename(fullpath.get_fullpath());
-        } else {
-          fullpath.set_extension("txo");
-        }
-
-        // Compare the timestamp of the output filename to the original filename.
-        // If the output filename doesn't exist or is newer than the original
-        // filename, we don't have to actually do anything.
-        if (fullpath.compare_timestamps(orig_fullpath) > 0) {
-          // The output filename is newer than the original, so we don't have to
-          // write a txo.  Just remap the texture to the txo version.
-          tex->set_fullpath(fullpath);
-          tex->set_loaded_from_txo();
-          tex->clear_alpha_filename();
-          tex->clear_alpha_fullpath();
-          Filename filename = tex->get_filename().get_filename_index(0);
-          if (_tex_txopz) {
-            filename.set_extension("txo.pz");
-            filename = Filename(filename.get_fullpath());
-          } else {
-            filename.set_extension("txo");
-          }
-          tex->set_filename(filename);
-          continue;
-        }
+        by_file[get_txo_filename(tex->get_fullpath().get_filename_index(0))].push_back(tex);
+      } else {
+        by_file[tex->get_fullpath()].push_back(tex);
       }
+    }
+    pvector<pvector<Texture *> > groups;
+    groups.reserve(by_file.size());
+    for (TexturesByFile::value_type &entry : by_file) {
+      groups.push_back(std::move(entry.second));
+    }
 
-      // We need to either write a txo version of this texture or embed it
-      // into the bam file.  We need the raw image data.
-
-      // Reload the raw image data of the texture.
-      tex->clear_ram_image();
-      tex->get_ram_image();
-
-      bool want_mipmaps = (_tex_mipmap || tex->uses_mipmaps());
-      if (want_mipmaps) {
-        // Generate mipmap levels.
-        tex->generate_ram_mipmap_images();
+    // Each group's messages are collected separately and reported in order
+    // afterwards, so the output doesn't depend on the number of threads.
+    pvector<std::string> messages(groups.size());
+    auto convert_group = [&](int i) {
+      std::ostringstream out;
+      for (Texture *tex : groups[i]) {
+        convert_texture(tex, out);
       }
+      messages[i] = out.str();
+    };
 
-      if (_tex_ctex) {
-#ifdef HAVE_SQUISH
-        if (!tex->compress_ram_image()) {
-          nout << "  couldn't compress " << tex->get_name() << "\n";
-        }
-        tex->set_compression(Texture::CM_on);
-#else  // HAVE_SQUISH
-        tex->set_keep_ram_image(true);
-        bool has_mipmap_levels = (tex->get_num_ram_mipmap_images() > 1);
-        if (!_engine->extract_texture_data(tex, _gsg)) {
-          nout << "  couldn't compress " << tex->get_name() << "\n";
-        }
-        if (!has_mipmap_levels && !want_mipmaps) {
-          // Make sure we didn't accidentally introduce mipmap levels by
-          // rendezvousing through the graphics card.
-          tex->clear_ram_mipmap_images();
-        }
-        tex->set_keep_ram_image(false);
+    int num_threads = _num_threads;
+#ifndef HAVE_SQUISH
+    if (_tex_ctex) {
+      // Compressing through the graphics card must be done on this thread.
+      num_threads = 1;
+    }
 #endif  // HAVE_SQUISH
-      }
 
-      if (_tex_txo || _tex_txopz) {
-        convert_txo(tex);
+    if (num_threads > 1) {
+      ThreadManager::_num_threads = num_threads;
+      ThreadManager::run_threads_on_individual("ConvertTextures", (int)groups.size(), false,
+                                               convert_group);
+    } else {
+      for (size_t i = 0; i < groups.size(); ++i) {
+        convert_group((int)i);
       }
     }
+
+    for (const std::string &message : messages) {
+      nout << message;
+    }
     textures_header_only = true;
   }
 
@@ -572,48 +564,119 @@ collect_materials(PandaNode *node) {
   }
 }
 
+/**
+ * Reloads the image of the indicated texture and prepares it as requested by
+ * -mipmap and -ctex, then writes it to a txo file if requested by -txo or
+ * -txopz.  If an up-to-date txo file already exists, the texture is simply
+ * remapped to it.  Any messages are written to the indicated stream.
+ *
+ * This may be called for several different textures at once, from different
+ * threads.
+ */
+void EggToBam::
+convert_texture(Texture *tex, std::ostream &out) {
+  if (_tex_txo || _tex_txopz) {
+    Filename orig_fullpath = tex->get_fullpath().get_filename_index(0);
+    Filename fullpath = get_txo_filename(orig_fullpath);
+
+    // Compare the timestamp of the output filename to the original filename.
+    // If the output filename doesn't exist or is newer than the original
+    // filename, we don't have to actually do anything.
+    if (fullpath.compare_timestamps(orig_fullpath) > 0) {
+      // The output filename is newer than the original, so we don't have to
+      // write a txo.  Just remap the texture to the txo version.
+      tex->set_fullpath(fullpath);
+      tex->set_loaded_from_txo();
+      tex->clear_alpha_filename();
+      tex->clear_alpha_fullpath();
+      tex->set_filename(get_txo_filename(tex->get_filename().get_filename_index(0)));
+      return;
+    }
+  }
+
+  // We need to either write a txo version of this texture or embed it
+  // into the bam file.  We need the raw image data.
+
+  // Reload the raw image data of the texture.
+  tex->clear_ram_image();
+  tex->get_ram_image();
+
+  bool want_mipmaps = (_tex_mipmap || tex->uses_mipmaps());
+  if (want_mipmaps) {
+    // Generate mipmap levels.
+    tex->generate_ram_mipmap_images();
+  }
+
+  if (_tex_ctex) {
+#ifdef HAVE_SQUISH
+    if (!tex->compress_ram_image()) {
+      out << "  couldn't compress " << tex->get_name() << "\n";
+    }
+    tex->set_compression(Texture::CM_on);
+#else  // HAVE_SQUISH
+    tex->set_keep_ram_image(true);
+    bool has_mipmap_levels = (tex->get_num_ram_mipmap_images() > 1);
+    if (!_engine->extract_texture_data(tex, _gsg)) {
+      out << "  couldn't compress " << tex->get_name() << "\n";
+    }
+    if (!has_mipmap_levels && !want_mipmaps) {
+      // Make sure we didn't accidentally introduce mipmap levels by
+      // rendezvousing through the graphics card.
+      tex->clear_ram_mipmap_images();
+    }
+    tex->set_keep_ram_image(false);
+#endif  // HAVE_SQUISH
+  }
+
+  if (_tex_txo || _tex_txopz) {
+    convert_txo(tex, out);
+  }
+}
+
 /**
  * If the indicated Texture was not already loaded from a txo file, writes it
  * to a txo file and updates the Texture object to reference the new file.
  */
 void EggToBam::
-convert_txo(Texture *tex) {
+convert_txo(Texture *tex, std::ostream &out) {
   if (!tex->get_loaded_from_txo()) {
-    Filename fullpath = tex->get_fullpath().get_filename_index(0);
-    if (_tex_txopz) {
-      fullpath.set_extension("txo.pz");
-      // We use this clumsy syntax so that the new extension appears to be two
-      // separate extensions, .txo followed by .pz, which is what
-      // Texture::write() expects to find.
-      fullpath = Filename(fullpath.get_fullpath());
-    } else {
-      fullpath.set_extension("txo");
-    }
+    Filename fullpath = get_txo_filename(tex->get_fullpath().get_filename_index(0));
 
     if (tex->write(fullpath)) {
-      nout << "  Wrote " << fullpath;
+      out << "  Wrote " << fullpath;
       if (tex->get_ram_image_compression() != Texture::CM_off) {
-        nout << " (compressed " << tex->get_ram_image_compression() << ")";
+        out << " (compressed " << tex->get_ram_image_compression() << ")";
       }
-      nout << "\n";
+      out << "\n";
       tex->set_loaded_from_txo();
       tex->set_fullpath(fullpath);
       tex->clear_alpha_fullpath();
 
-      Filename filename = tex->get_filename().get_filename_index(0);
-      if (_tex_txopz) {
-        filename.set_extension("txo.pz");
-        filename = Filename(filename.get_fullpath());
-      } else {
-        filename.set_extension("txo");
-      }
-
-      tex->set_filename(filename);
+      tex->set_filename(get_txo_filename(tex->get_filename().get_filename_index(0)));
       tex->clear_alpha_filename();
     }
   }
 }
 
+/**
+ * Returns the name of the txo file, as requested by -txo or -txopz, that the
+ * texture loaded from the indicated file is written to.
+ */
+Filename EggToBam::
+get_txo_filename(const Filename &filename) const {
+  Filename txo_filename = filename;
+  if (_tex_txopz) {
+    txo_filename.set_extension("txo.pz");
+    // We use this clumsy syntax so that the new extension appears to be two
+    // separate extensions, .txo followed by .pz, which is what
+    // Texture::write() expects to find.
+    txo_filename = Filename(txo_filename.get_fullpath());
+  } else {
+    txo_filename.set_extension("txo");
+  }
+  return txo_filename;
+}
+
 /**
  * Creates a GraphicsBuffer for communicating with the graphics card.
  */
@@ -18,6 +18,8 @@
 
 #include "eggToSomething.h"
 #include "pset.h"
+#include "pmap.h"
+#include "pvector.h"
 #include "graphicsPipe.h"
 
 class PandaNode;
@@ -42,7 +44,9 @@ protected:
 private:
   void collect_materials(PandaNode *node);
 
-  void convert_txo(Texture *tex);
+  void convert_texture(Texture *tex, std::ostream &out);
+  void convert_txo(Texture *tex, std::ostream &out);
+  Filename get_txo_filename(const Filename &filename) const;
   bool make_buffer();
 
 private:
@@ -75,6 +79,7 @@ private:
   bool _tex_mipmap;
   std::string _ctex_quality;
   std::string _load_display;
+  int _num_threads;
 
   // The rest of this is required to support -ctex.
   PT(GraphicsPipe) _pipe;
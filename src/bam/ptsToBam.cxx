@@ -15,15 +15,26 @@
 
 #include "config_putil.h"
 #include "geomPoints.h"
+#include "geomVertexData.h"
+#include "geomVertexWriter.h"
 #include "bamFile.h"
 #include "pandaNode.h"
 #include "geomNode.h"
 #include "dcast.h"
 #include "string_utils.h"
 #include "config_egg2pg.h"
+#include "pstrtod.h"
+#include "mutexHolder.h"
+#include "threadManager.h"
+
+#include <algorithm>
 
 using std::string;
 
+// The file is divided into ranges of about this many bytes, which are read
+// and parsed independently.
+static const std::streamoff pts_chunk_size = (std::streamoff)32 << 20;
+
 /**
  *
  */
@@ -53,7 +64,37 @@ PtsToBam() : WithOutputFile(true, false, true)
      "points.",
      &PtsToBam::dispatch_double, nullptr, &_decimate_divisor);
 
+  add_option
+    ("j", "count", 0,
+     "Specify the number of worker threads that should be used to parse the "
+     "pts file.  The file is divided into ranges of lines which are parsed "
+     "in parallel.  The default is 1.",
+     &PtsToBam::dispatch_int, nullptr, &_num_threads);
+
+  add_option
+    ("octree", "max-points", 0,
+     "Divide the points among an octree of GeomNodes, rather than putting "
+     "them all in a single GeomNode, so that the parts of the point cloud "
+     "that are offscreen can be culled.  Each cell of the octree holds at "
+     "most the indicated number of points.  A cell that contains more keeps "
+     "an evenly-spaced sample of that many, and divides the rest among eight "
+     "child cells, down to the depth given by -depth, so that each level of "
+     "the octree is a decimated version of the levels below it.  The cells "
+     "at that depth that still contain too many points are decimated to the "
+     "indicated number of points, which limits the density of the point "
+     "cloud in those places without thinning out the sparser places.",
+     &PtsToBam::dispatch_int, &_got_octree, &_octree_max_points);
+
+  add_option
+    ("depth", "levels", 0,
+     "Specify the maximum depth of the octree generated by -octree.  The "
+     "default is 8.",
+     &PtsToBam::dispatch_int, nullptr, &_octree_max_depth);
+
   _decimate_divisor = 1.0;
+  _num_threads = 1;
+  _octree_max_points = 0;
+  _octree_max_depth = 8;
 }
 
 /**
@@ -62,30 +103,56 @@ PtsToBam() : WithOutputFile(true, false, true)
 void PtsToBam::
 run() {
   pifstream pts;
-  _pts_filename.set_text();
+  _pts_filename.set_binary();
   if (!_pts_filename.open_read(pts)) {
     nout << "Cannot open " << _pts_filename << "\n";
     exit(1);
   }
 
-  _gnode = new GeomNode(_pts_filename.get_basename());
-
   _num_points_expected = 0;
   _num_points_found = 0;
   _num_points_added = 0;
   _decimate_factor = 1.0 / std::max(1.0, _decimate_divisor);
-  _line_number = 0;
-  _point_number = 0;
-  _decimated_point_number = 0.0;
   _num_vdatas = 0;
-  string line;
-  while (std::getline(pts, line)) {
-    process_line(line);
+  _num_cells = 0;
+
+  Chunks chunks;
+  if (!find_chunks(pts, chunks)) {
+    nout << "Error reading " << _pts_filename << "\n";
+    exit(1);
+  }
+  pts.close();
+
+  ThreadManager::_num_threads = _num_threads;
+  ThreadManager::run_threads_on_individual("ParsePoints", (int)chunks.size(), false,
+                                           [&](int i) {
+    read_chunk(chunks[i], i == 0);
+  });
+
+  for (const Chunk &chunk : chunks) {
+    _num_points_found += chunk._num_points_found;
+    _num_points_expected += chunk._num_points_expected;
+  }
+
+  if (_got_octree && _octree_max_points > 0) {
+    _root = new PandaNode(_pts_filename.get_basename());
+    build_root_cell(_root, chunks);
+
+  } else {
+    // The points go straight from the chunks into the GeomVertexDatas, so
+    // that they are never all held twice.
+    PT(GeomNode) gnode = new GeomNode(_pts_filename.get_basename());
+    add_points(gnode, chunks);
+    _root = gnode;
   }
-  close_vertex_data();
 
   nout << "\nFound " << _num_points_found << " points of " << _num_points_expected << " expected.\n";
-  nout << "Generated " << _num_points_added << " points to bam file.\n";
+  nout << "Generated " << _num_points_added << " points in " << _num_vdatas
+       << " GeomVertexDatas";
+  if (_num_cells != 0) {
+    nout << " and " << _num_cells << " octree cells";
+  }
+  nout << " to bam file.\n";
 
   // This should be guaranteed because we pass false to the constructor,
   // above.
@@ -100,7 +167,7 @@ run() {
     exit(1);
   }
 
-  if (!bam_file.write_object(_gnode.p())) {
+  if (!bam_file.write_object(_root.p())) {
     nout << "Error in writing.\n";
     exit(1);
   }
@@ -127,94 +194,438 @@ handle_args(ProgramBase::Args &args) {
 }
 
 /**
- * Reads a single line from the pts file.
+ * Divides the pts file into ranges of about pts_chunk_size bytes, each
+ * beginning at the start of a line.  Returns true on success, false on
+ * failure.
+ */
+bool PtsToBam::
+find_chunks(std::istream &in, Chunks &chunks) {
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg();
+  if (size < 0) {
+    return false;
+  }
+
+  Chunk chunk;
+  chunk._num_points_found = 0;
+  chunk._num_points_expected = 0;
+  chunk._begin = 0;
+  while (chunk._begin < size) {
+    // Find the end of the line that crosses the nominal end of this range.
+    std::streamoff end = chunk._begin + pts_chunk_size;
+    if (end >= size) {
+      end = size;
+    } else {
+      in.clear();
+      in.seekg(end);
+      char buffer[4096];
+      bool found = false;
+      while (!found && end < size) {
+        in.read(buffer, sizeof(buffer));
+        std::streamsize count = in.gcount();
+        if (count <= 0) {
+          return false;
+        }
+        const char *newline = (const char *)memchr(buffer, '\n', (size_t)count);
+        if (newline != nullptr) {
+          end += (newline - buffer) + 1;
+          found = true;
+        } else {
+          end += count;
+        }
+      }
+      end = std::min(end, size);
+    }
+
+    chunk._end = end;
+    chunks.push_back(chunk);
+    chunk._begin = end;
+  }
+
+  return true;
+}
+
+/**
+ * Reads and parses the lines in the indicated range of the pts file.  This
+ * may be called for several chunks at once, from different threads.  Each
+ * chunk is decimated separately.
  */
 void PtsToBam::
-process_line(const string &line) {
-  _line_number++;
+read_chunk(Chunk &chunk, bool first) {
+  // The string is always followed by a null character, which stops
+  // pstrtod() at the end of the last line.
+  string buffer((size_t)(chunk._end - chunk._begin), '\0');
+  {
+    pifstream in;
+    if (!_pts_filename.open_read(in)) {
+      return;
+    }
+    in.seekg(chunk._begin);
+    in.read(&buffer[0], buffer.size());
+    buffer.resize((size_t)std::max((std::streamsize)0, in.gcount()));
+  }
+
+  double decimated_point_number = 0.0;
+  int point_number = 0;
 
-  if (_line_number % 1000000 == 0) {
-    std::cerr << "." << std::flush;
+  const char *p = buffer.data();
+  const char *end = p + buffer.size();
+  while (p < end) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (eol == nullptr) {
+      eol = end;
+    }
+
+    if (first) {
+      // The first line might be just the number of points.
+      first = false;
+      char *num_end;
+      double num_points = pstrtod(p, &num_end);
+      const char *q = num_end;
+      while (q < eol && isspace((unsigned char)*q)) {
+        ++q;
+      }
+      if (num_end != p && q == eol) {
+        chunk._num_points_expected = (size_t)num_points;
+        MutexHolder holder(_progress_lock);
+        nout << "Expecting " << chunk._num_points_expected
+             << " points, will generate "
+             << (size_t)(chunk._num_points_expected * _decimate_factor) << "\n";
+        p = eol + 1;
+        continue;
+      }
+    }
+
+    process_line(chunk, p, eol, decimated_point_number, point_number);
+    p = eol + 1;
   }
 
-  if (line.empty() || !isdigit(line[0])) {
+  MutexHolder holder(_progress_lock);
+  std::cerr << "." << std::flush;
+}
+
+/**
+ * Reads a single line from the pts file, which runs from line up to (but not
+ * including) end.
+ */
+void PtsToBam::
+process_line(Chunk &chunk, const char *line, const char *end,
+             double &decimated_point_number, int &point_number) {
+  if (line == end || !(isdigit((unsigned char)*line) || *line == '-' ||
+                       *line == '+' || *line == '.')) {
     return;
   }
 
-  if (_line_number == 1) {
-    // The first line might be just the number of points.
-    vector_string words;
-    tokenize(trim(line), words, " \t", true);
-    if (words.size() == 1) {
-      string tail;
-      _num_points_expected = string_to_int(words[0], tail);
-      nout << "Expecting " << _num_points_expected << " points, will generate "
-           << (int)(_num_points_expected * _decimate_factor) << "\n";
+  // Here we might have a point.  Only a line with three coordinates counts
+  // as one, and takes a turn in the decimation.
+  double xyz[3];
+  const char *p = line;
+  for (int i = 0; i < 3; ++i) {
+    // Don't let pstrtod() skip over the end of the line.
+    while (p < end && (*p == ' ' || *p == '\t')) {
+      ++p;
+    }
+    if (p >= end || *p == '\r') {
+      return;
+    }
+    char *num_end;
+    xyz[i] = pstrtod(p, &num_end);
+    if (num_end == p) {
       return;
     }
+    p = num_end;
   }
 
-  // Here we might have a point.
-  _num_points_found++;
-  _decimated_point_number += _decimate_factor;
-  int point_number = int(_decimated_point_number);
-  if (point_number > _point_number) {
-    _point_number = point_number;
+  chunk._num_points_found++;
+  decimated_point_number += _decimate_factor;
+  int this_point_number = int(decimated_point_number);
+  if (this_point_number > point_number) {
+    point_number = this_point_number;
+    chunk._points.push_back(LPoint3f((float)xyz[0], (float)xyz[1], (float)xyz[2]));
+  }
+}
 
-    vector_string words;
-    tokenize(trim(line), words, " \t", true);
-    if (words.size() >= 3) {
-      add_point(words);
+/**
+ * Creates the root cell of the octree from the points in the chunks, and adds
+ * it to the parent node.  This does the same thing as build_cell(), but takes
+ * the points from the chunks in the order they appeared in the file, and
+ * frees each chunk as soon as its points have been sorted into the octants,
+ * so that the points are never all held twice.
+ */
+void PtsToBam::
+build_root_cell(PandaNode *parent, Chunks &chunks) {
+  size_t num_points = 0;
+  LPoint3f min_point(0.0f, 0.0f, 0.0f);
+  LPoint3f max_point(0.0f, 0.0f, 0.0f);
+  for (const Chunk &chunk : chunks) {
+    for (const LPoint3f &point : chunk._points) {
+      if (num_points == 0) {
+        min_point = point;
+        max_point = point;
+      } else {
+        min_point = min_point.fmin(point);
+        max_point = max_point.fmax(point);
+      }
+      ++num_points;
+    }
+  }
+  if (num_points == 0) {
+    chunks.clear();
+    return;
+  }
+  ++_num_cells;
+
+  // Make the root cell a cube enclosing all of the points.
+  LVector3f extent = max_point - min_point;
+  float size = std::max(std::max(extent[0], extent[1]), extent[2]);
+  max_point = min_point + LVector3f(size, size, size);
+  LPoint3f center = (min_point + max_point) * 0.5f;
+
+  // The points are visited twice in the same order, first to count the points
+  // that fall in each octant, then to copy them there, so that the octants
+  // can be allocated at their final size.  A cell at the maximum depth keeps
+  // only its sample, like a leaf in build_cell().
+  size_t max_points = (size_t)_octree_max_points;
+  bool divide = (num_points > max_points && _octree_max_depth > 0);
+  Points sample;
+  Points octants[8];
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t counts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    size_t num_sampled = 0;
+    size_t i = 0;
+    for (Chunk &chunk : chunks) {
+      for (const LPoint3f &point : chunk._points) {
+        if (num_points <= max_points ||
+            (num_sampled < max_points &&
+             i == (uint64_t)num_sampled * num_points / max_points)) {
+          if (pass == 1) {
+            sample.push_back(point);
+          }
+          ++num_sampled;
+
+        } else if (divide) {
+          int n = ((point[0] < center[0]) ? 0 : 4) |
+                  ((point[1] < center[1]) ? 0 : 2) |
+                  ((point[2] < center[2]) ? 0 : 1);
+          if (pass == 0) {
+            ++counts[n];
+          } else {
+            octants[n].push_back(point);
+          }
+        }
+        ++i;
+      }
+
+      if (pass == 1) {
+        Points().swap(chunk._points);
+      }
+    }
+
+    if (pass == 0) {
+      sample.reserve(num_sampled);
+      for (int n = 0; n < 8; ++n) {
+        octants[n].reserve(counts[n]);
+      }
+    }
+  }
+  chunks.clear();
+
+  PT(GeomNode) node = new GeomNode("");
+  add_points(node, &sample[0], &sample[0] + sample.size());
+  Points().swap(sample);
+  parent->add_child(node);
+
+  for (int n = 0; n < 8; ++n) {
+    LPoint3f child_min = min_point;
+    LPoint3f child_max = center;
+    if (n & 4) {
+      child_min[0] = center[0];
+      child_max[0] = max_point[0];
+    }
+    if (n & 2) {
+      child_min[1] = center[1];
+      child_max[1] = max_point[1];
+    }
+    if (n & 1) {
+      child_min[2] = center[2];
+      child_max[2] = max_point[2];
+    }
+    Points &octant = octants[n];
+    if (!octant.empty()) {
+      build_cell(node, format_string(n), &octant[0], &octant[0] + octant.size(),
+                 child_min, child_max, 1);
     }
+    Points().swap(octant);
   }
 }
 
 /**
- * Adds a point from the pts file.
+ * Creates the octree cell containing the indicated points, which are
+ * reordered, and adds it to the parent node.  A cell with few enough points,
+ * or at the maximum depth, becomes a leaf GeomNode.  Otherwise, the cell keeps
+ * an evenly-spaced sample of its points in a GeomNode of its own, and divides
+ * the rest among eight child cells.
  */
 void PtsToBam::
-add_point(const vector_string &words) {
-  if (_data == nullptr || _data->get_num_rows() >= egg_max_vertices) {
-    open_vertex_data();
-  }
-
-  string tail;
-  double x, y, z;
-  x = string_to_double(words[0], tail);
-  y = string_to_double(words[1], tail);
-  z = string_to_double(words[2], tail);
-  _vertex.add_data3d(x, y, z);
-  _num_points_added++;
+build_cell(PandaNode *parent, const string &name,
+           LPoint3f *begin, LPoint3f *end,
+           const LPoint3f &min_point, const LPoint3f &max_point, int depth) {
+  size_t num_points = end - begin;
+  if (num_points == 0) {
+    return;
+  }
+  ++_num_cells;
+
+  size_t max_points = (size_t)_octree_max_points;
+  if (num_points <= max_points || depth >= _octree_max_depth) {
+    if (num_points > max_points) {
+      // Keep an evenly-spaced subset of the points.  Since each point kept
+      // comes from at or after the place it is moved to, they can be moved in
+      // place.
+      for (size_t i = 0; i < max_points; ++i) {
+        begin[i] = begin[(uint64_t)i * num_points / max_points];
+      }
+      end = begin + max_points;
+    }
+
+    PT(GeomNode) gnode = new GeomNode(name);
+    add_points(gnode, begin, end);
+    parent->add_child(gnode);
+    return;
+  }
+
+  // Take out an evenly-spaced sample of the points for this level, and close
+  // up the remaining points behind them, keeping them in order.
+  Points sample;
+  sample.reserve(max_points);
+  LPoint3f *rest = begin;
+  for (size_t i = 0; i < num_points; ++i) {
+    if (sample.size() < max_points &&
+        i == (uint64_t)sample.size() * num_points / max_points) {
+      sample.push_back(begin[i]);
+    } else {
+      *rest++ = begin[i];
+    }
+  }
+  end = rest;
+
+  PT(GeomNode) node = new GeomNode(name);
+  add_points(node, &sample[0], &sample[0] + sample.size());
+  Points().swap(sample);
+  parent->add_child(node);
+
+  // Sort the points into octants: first by x, then each half by y, then each
+  // quarter by z.  Octant n then lies between ranges[n] and ranges[n + 1].
+  LPoint3f center = (min_point + max_point) * 0.5f;
+  LPoint3f *ranges[9];
+  ranges[0] = begin;
+  ranges[8] = end;
+  ranges[4] = std::partition(ranges[0], ranges[8],
+    [&](const LPoint3f &point) { return point[0] < center[0]; });
+  for (int i = 0; i < 8; i += 4) {
+    ranges[i + 2] = std::partition(ranges[i], ranges[i + 4],
+      [&](const LPoint3f &point) { return point[1] < center[1]; });
+  }
+  for (int i = 0; i < 8; i += 2) {
+    ranges[i + 1] = std::partition(ranges[i], ranges[i + 2],
+      [&](const LPoint3f &point) { return point[2] < center[2]; });
+  }
+
+  for (int n = 0; n < 8; ++n) {
+    LPoint3f child_min = min_point;
+    LPoint3f child_max = center;
+    if (n & 4) {
+      child_min[0] = center[0];
+      child_max[0] = max_point[0];
+    }
+    if (n & 2) {
+      child_min[1] = center[1];
+      child_max[1] = max_point[1];
+    }
+    if (n & 1) {
+      child_min[2] = center[2];
+      child_max[2] = max_point[2];
+    }
+    build_cell(node, name + format_string(n), ranges[n], ranges[n + 1],
+               child_min, child_max, depth + 1);
+  }
 }
 
 /**
- * Creates a new GeomVertexData.
+ * Adds the indicated points to the GeomNode, in as many GeomVertexDatas as
+ * necessary to stay within egg-max-vertices.
  */
 void PtsToBam::
-open_vertex_data() {
-  if (_data != nullptr) {
-    close_vertex_data();
-  }
+add_points(GeomNode *gnode, const LPoint3f *begin, const LPoint3f *end) {
   CPT(GeomVertexFormat) format = GeomVertexFormat::get_v3();
-  _data = new GeomVertexData("pts", format, GeomEnums::UH_static);
-  _vertex = GeomVertexWriter(_data, "vertex");
+
+  while (begin < end) {
+    int num_vertices = (int)std::min((size_t)(end - begin), (size_t)egg_max_vertices);
+
+    PT(GeomVertexData) data = new GeomVertexData("pts", format, GeomEnums::UH_static);
+    data->reserve_num_rows(num_vertices);
+    {
+      GeomVertexWriter vertex(data, "vertex");
+      for (int i = 0; i < num_vertices; ++i) {
+        vertex.add_data3f(begin[i]);
+      }
+    }
+    begin += num_vertices;
+
+    add_geom(gnode, data, num_vertices);
+  }
 }
 
 /**
- * Closes a previous GeomVertexData and adds it to the scene graph.
+ * Adds all of the points in the chunks to the GeomNode, in the order they
+ * appeared in the file, in as many GeomVertexDatas as necessary to stay within
+ * egg-max-vertices.  The points of each chunk are freed as soon as they have
+ * been copied.
  */
 void PtsToBam::
-close_vertex_data() {
-  if (_data == nullptr) {
-    return;
+add_points(GeomNode *gnode, Chunks &chunks) {
+  CPT(GeomVertexFormat) format = GeomVertexFormat::get_v3();
+
+  size_t num_points = 0;
+  for (const Chunk &chunk : chunks) {
+    num_points += chunk._points.size();
   }
 
-  _num_vdatas++;
-  nout << "\nGenerating " << _num_points_added << " points in " << _num_vdatas << " GeomVertexDatas\n";
+  Chunks::iterator ci = chunks.begin();
+  size_t pi = 0;
+  while (num_points > 0) {
+    int num_vertices = (int)std::min(num_points, (size_t)egg_max_vertices);
+
+    PT(GeomVertexData) data = new GeomVertexData("pts", format, GeomEnums::UH_static);
+    data->reserve_num_rows(num_vertices);
+    {
+      GeomVertexWriter vertex(data, "vertex");
+      for (int i = 0; i < num_vertices; ++i) {
+        while (pi >= (*ci)._points.size()) {
+          Points().swap((*ci)._points);
+          ++ci;
+          pi = 0;
+        }
+        vertex.add_data3f((*ci)._points[pi++]);
+      }
+    }
+    num_points -= num_vertices;
+
+    add_geom(gnode, data, num_vertices);
+  }
+
+  chunks.clear();
+}
 
-  PT(Geom) geom = new Geom(_data);
+/**
+ * Adds a Geom to the GeomNode that draws the first num_vertices vertices of
+ * the indicated GeomVertexData as points, in as many GeomPoints as necessary
+ * to stay within egg-max-indices.
+ */
+void PtsToBam::
+add_geom(GeomNode *gnode, GeomVertexData *data, int num_vertices) {
+  PT(Geom) geom = new Geom(data);
 
-  int num_vertices = _data->get_num_rows();
   int vertices_so_far = 0;
   while (num_vertices > 0) {
     int this_num_vertices = std::min(num_vertices, (int)egg_max_indices);
@@ -222,12 +633,12 @@ close_vertex_data() {
     points->add_consecutive_vertices(vertices_so_far, this_num_vertices);
     geom->add_primitive(points);
     vertices_so_far += this_num_vertices;
+    _num_points_added += this_num_vertices;
     num_vertices -= this_num_vertices;
   }
 
-  _gnode->add_geom(geom);
-
-  _data = nullptr;
+  gnode->add_geom(geom);
+  _num_vdatas++;
 }
 
 int main(int argc, char *argv[]) {
@@ -19,10 +19,12 @@
 #include "programBase.h"
 #include "withOutputFile.h"
 #include "filename.h"
-#include "vector_string.h"
-#include "geomVertexData.h"
-#include "geomVertexWriter.h"
 #include "geomNode.h"
+#include "geomVertexData.h"
+#include "pandaNode.h"
+#include "luse.h"
+#include "pvector.h"
+#include "pmutex.h"
 
 /**
  *
@@ -37,28 +39,52 @@ protected:
   virtual bool handle_args(Args &args);
 
 private:
-  void process_line(const std::string &line);
-  void add_point(const vector_string &words);
+  typedef pvector<LPoint3f> Points;
+
+  // The points read from one range of bytes of the pts file.  The ranges all
+  // begin at the start of a line, so they can be parsed independently.
+  class Chunk {
+  public:
+    std::streamoff _begin;
+    std::streamoff _end;
+    Points _points;
+    size_t _num_points_found;
+    size_t _num_points_expected;
+  };
+  typedef pvector<Chunk> Chunks;
 
-  void open_vertex_data();
-  void close_vertex_data();
+  bool find_chunks(std::istream &in, Chunks &chunks);
+  void read_chunk(Chunk &chunk, bool first);
+  void process_line(Chunk &chunk, const char *line, const char *end,
+                    double &decimated_point_number, int &point_number);
+
+  void build_root_cell(PandaNode *parent, Chunks &chunks);
+  void build_cell(PandaNode *parent, const std::string &name,
+                  LPoint3f *begin, LPoint3f *end,
+                  const LPoint3f &min_point, const LPoint3f &max_point,
+                  int depth);
+  void add_points(GeomNode *gnode, const LPoint3f *begin, const LPoint3f *end);
+  void add_points(GeomNode *gnode, Chunks &chunks);
+  void add_geom(GeomNode *gnode, GeomVertexData *data, int num_vertices);
 
 private:
   Filename _pts_filename;
   double _decimate_divisor;
   double _decimate_factor;
+  int _num_threads;
+  bool _got_octree;
+  int _octree_max_points;
+  int _octree_max_depth;
 
-  int _line_number;
-  int _point_number;
-  int _num_points_expected;
-  int _num_points_found;
-  int _num_points_added;
+  size_t _num_points_expected;
+  size_t _num_points_found;
+  size_t _num_points_added;
   int _num_vdatas;
+  int _num_cells;
+
+  PT(PandaNode) _root;
 
-  double _decimated_point_number;
-  PT(GeomNode) _gnode;
-  PT(GeomVertexData) _data;
-  GeomVertexWriter _vertex;
+  Mutex _progress_lock;
 };
 
 #endif
@@ -427,7 +427,9 @@ run() {
           _palette_size[0], _palette_size[1],
           100.0 / _palettize_scale_factor);
   std::istringstream txa_script(buffer);
-  pal->read_txa_file(txa_script, "default script");
+  if (!pal->read_txa_file(txa_script, "default script")) {
+    exit(1);
+  }
 
   pal->all_params_set();
 
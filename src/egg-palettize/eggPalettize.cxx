@@ -25,7 +25,26 @@
 #include "notifyCategory.h"
 #include "notifySeverity.h"
 
+#ifdef HAVE_NET
+#include "queuedConnectionManager.h"
+#include "queuedConnectionListener.h"
+#include "queuedConnectionReader.h"
+#include "connectionWriter.h"
+#include "netDatagram.h"
+#include "clockObject.h"
+#include "executionEnvironment.h"
+#include "wordWrapStream.h"
+#include "thread.h"
+#endif
+
 #include <stdio.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <direct.h>  // for chdir
+#else
+#include <unistd.h>
+#endif
 
 /**
  *
@@ -91,6 +110,19 @@ EggPalettize() : EggMultiFilter(true) {
      "state for future adjustments.",
      &EggPalettize::dispatch_none, &_nodb);
 
+  add_option
+    ("shard", "", 0,
+     "Record the state in a sharded layout.  The .boo file then holds only "
+     "an index of the egg files and textures, and the images and placements "
+     "of each palette group are kept in a separate file, in a directory "
+     "named after the .boo file with the extension .shards.  Only the "
+     "groups reached by the egg files named on the command line are read, "
+     "and only the files of groups that changed are rewritten.  Options that "
+     "touch every group, such as -all, -opt, -redo, -pi, -s, and -server, "
+     "still read all of them.  Once the state has been sharded, it stays "
+     "sharded.",
+     &EggPalettize::dispatch_none, &_shard);
+
   add_option
     ("tn", "pattern", 0,
      "Specify the name to generate for each palette image.  The string should "
@@ -197,6 +229,64 @@ EggPalettize() : EggMultiFilter(true) {
      "development).",
      &EggPalettize::dispatch_none, &_omitall);
 
+  add_option
+    ("j", "count", 0,
+     "Specify the number of worker threads that should be used to read the "
+     "source textures and generate the palette images in parallel.  The egg "
+     "files are also handled that many at a time, but the egg loader parses "
+     "only one file at a time, so only the work after parsing, such as "
+     "resolving texture filenames, adjusting UV's, and writing the files, "
+     "overlaps.  The default is 1, which does everything one at a time.  "
+     "The files written are the same either way.",
+     &EggPalettize::dispatch_int, nullptr, &_num_threads);
+
+  add_option
+    ("readahead", "megabytes", 0,
+     "Specify the maximum amount of memory, in megabytes, that may be spent "
+     "holding source texture images that have been read in parallel ahead "
+     "of being processed.  This only matters when -j is greater than 1.  "
+     "The default is 256.",
+     &EggPalettize::dispatch_int, nullptr, &_readahead_mb);
+
+#ifdef HAVE_NET
+  add_option
+    ("server", "port", 0,
+     "Run as a resident server on the indicated TCP port of the local "
+     "machine, instead of processing any egg files.  The state file is read "
+     "once, at startup, and kept in memory; each egg-palettize command run "
+     "with -connect on the same port is then carried out by the server, one "
+     "at a time, without reading or writing the state file again.  Each "
+     "such command must name the same .txa file as the server.  The state "
+     "file is written out at most once every -checkpoint seconds, and when "
+     "the server is stopped.  A command that fails is undone and does not "
+     "stop the server.  A few errors still exit the process outright, which "
+     "does stop it; the state as of the last finished command is then "
+     "written out first, if it can be recovered.",
+     &EggPalettize::dispatch_int, &_got_server_port, &_server_port);
+
+  add_option
+    ("connect", "port", 0,
+     "Hand the rest of this command line to an egg-palettize server "
+     "already running with -server on the indicated port of the local "
+     "machine, and report its output, rather than reading the state file "
+     "or any egg files here.  Only the options are checked here; the egg "
+     "files are read by the server.",
+     &EggPalettize::dispatch_int, &_got_connect_port, &_connect_port);
+
+  add_option
+    ("stop", "", 0,
+     "Used with -connect, asks the server to write out its state file and "
+     "exit.",
+     &EggPalettize::dispatch_none, &_stop_server);
+
+  add_option
+    ("checkpoint", "seconds", 0,
+     "Used with -server, specifies the minimum number of seconds between "
+     "writes of the state file while commands are being processed.  The "
+     "default is 60.",
+     &EggPalettize::dispatch_double, nullptr, &_checkpoint_interval);
+#endif  // HAVE_NET
+
   // This isn't even implemented yet.  Presently, we never lock anyway.
   // Dangerous, but hard to implement reliable file locking across NFSSamba
   // and between multiple OS's.
@@ -216,6 +306,18 @@ EggPalettize() : EggMultiFilter(true) {
      &EggPalettize::dispatch_none, &_describe_input_file);
 
   _txa_filename = "textures.txa";
+  _readahead_mb = 256;
+  _got_server_port = false;
+  _server_port = 0;
+  _got_connect_port = false;
+  _connect_port = 0;
+  _stop_server = false;
+  _checkpoint_interval = 60.0;
+  _defer_eggs = false;
+  _got_snapshot = false;
+  _replayable = false;
+  _in_request = false;
+  _dirty = false;
 }
 
 
@@ -226,7 +328,7 @@ EggPalettize() : EggMultiFilter(true) {
  */
 bool EggPalettize::
 handle_args(ProgramBase::Args &args) {
-  if (_describe_input_file) {
+  if (_describe_input_file && !_defer_eggs) {
     describe_input_file();
     exit(1);
   }
@@ -238,6 +340,13 @@ handle_args(ProgramBase::Args &args) {
     return true;
   }
 
+  if (_defer_eggs || _got_connect_port) {
+    // A server reads the egg files later, so that a bad one fails only the
+    // one command; a client leaves them to the server.
+    _egg_args = args;
+    return true;
+  }
+
   // Otherwise, load the named egg files up normally.
   return EggMultiFilter::handle_args(args);
 }
@@ -349,6 +458,14 @@ describe_input_file() {
             "clamped, this will affect the pixels that are painted into "
             "the palette image.\n\n");
 
+  show_text("  resize-point, resize-box, resize-lanczos", 10,
+            "Specifies the filter used to scale the source texture to the "
+            "size it will have on the palette (or in its own image).  The "
+            "default, resize-point, is the fastest, but aliases badly when "
+            "a texture is reduced; resize-box averages together all of the "
+            "pixels that are combined, and resize-lanczos is sharper "
+            "still.\n\n");
+
   show_text("  (image type)", 10,
             "A texture may be converted to a particular image type, for "
             "instance jpg or rgb, by naming the type.  If present, this "
@@ -583,8 +700,77 @@ run() {
     loader_cat->set_severity(NS_warning);
   }
 
+#ifdef HAVE_NET
+  if (_got_connect_port) {
+    exit(run_client());
+  }
+  if (_got_server_port && (_got_txa_script || _nodb)) {
+    nout << "-server cannot be used with -as or -nodb.\n";
+    exit(1);
+  }
+  if (_got_server_port && (!_eggs.empty() || !_remove_egg_list.empty())) {
+    nout << "Egg files cannot be named with -server; name them on "
+         << "the command lines sent with -connect instead.\n";
+    exit(1);
+  }
+#endif  // HAVE_NET
+
   Filename state_filename;
-  BamFile state_file;
+  if (!find_state_filename(state_filename)) {
+    exit(1);
+  }
+
+  if (!read_state(state_filename)) {
+    exit(1);
+  }
+
+  if (_report_pi || _report_statistics) {
+    if (!pal->load_all_groups()) {
+      exit(1);
+    }
+  }
+
+  if (_report_pi) {
+    pal->report_pi();
+    exit(0);
+  }
+
+  if (_report_statistics) {
+    pal->report_statistics();
+    exit(0);
+  }
+
+#ifdef HAVE_NET
+  if (_got_server_port) {
+    run_server(state_filename);
+    return;
+  }
+#endif  // HAVE_NET
+
+  Result result = process(state_filename);
+  if (result == R_aborted) {
+    exit(1);
+  }
+
+  if (!_nodb) {
+    if (!write_state(state_filename)) {
+      exit(1);
+    }
+  }
+
+  if (result != R_ok) {
+    exit(1);
+  }
+}
+
+/**
+ * Locates the .txa file, and fills in the name of the state file that goes
+ * with it, which is left empty if there is none.  Returns true if successful,
+ * or false if the .txa file does not exist.
+ */
+bool EggPalettize::
+find_state_filename(Filename &state_filename) {
+  state_filename = Filename();
 
   if (_got_txa_script) {
     // If we got a command-line script instead of a .txa file, we won't be
@@ -607,7 +793,7 @@ run() {
     if (!_txa_filename.exists()) {
       nout << FilenameUnifier::make_user_filename(_txa_filename)
            << " does not exist; cannot run.\n";
-      exit(1);
+      return false;
     }
 
     FilenameUnifier::set_txa_filename(_txa_filename);
@@ -616,6 +802,16 @@ run() {
     state_filename.set_extension("boo");
   }
 
+  return true;
+}
+
+/**
+ * Creates the global Palettizer object, recovering all of the state saved
+ * from the past session in the state file if there is one.  Returns true if
+ * successful, or false if the state file could not be used.
+ */
+bool EggPalettize::
+read_state(const Filename &state_filename) {
   if (_nodb) {
     // -nodb means don't attempt to read textures.boo; in fact, don't even
     // bother reporting this absence to the user.
@@ -623,97 +819,124 @@ run() {
 
     // And -nodb implies -opt.
     _optimal = true;
+    return true;
+  }
 
-  } else if (!state_filename.exists()) {
+  if (!state_filename.exists()) {
     nout << FilenameUnifier::make_user_filename(state_filename)
          << " does not exist; starting palettization from scratch.\n";
     pal = new Palettizer;
+    pal->_shard_dirname = get_shard_dirname(state_filename);
 
     // By default, the -omitall flag is true from the beginning.
     pal->_omit_everything = true;
+    return true;
+  }
 
-  } else {
-    // Read the Palettizer object from the Bam file written previously.  This
-    // will recover all of the state saved from the past session.
-    nout << "Reading " << FilenameUnifier::make_user_filename(state_filename)
-         << "\n";
-
-    if (!state_file.open_read(state_filename)) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " exists, but cannot be read.  Perhaps you should "
-           << "remove it so a new one can be created.\n";
-      exit(1);
-    }
-
-    TypedWritable *obj = state_file.read_object();
-    if (obj == nullptr || !state_file.resolve()) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " exists, but appears to be corrupt.  Perhaps you "
-           << "should remove it so a new one can be created.\n";
-      exit(1);
-    }
+  // Read the Palettizer object from the Bam file written previously.  This
+  // will recover all of the state saved from the past session.
+  nout << "Reading " << FilenameUnifier::make_user_filename(state_filename)
+       << "\n";
 
-    if (!obj->is_of_type(Palettizer::get_class_type())) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " exists, but does not appear to be "
-           << "an egg-palettize output file.  Perhaps you "
-           << "should remove it so a new one can be created.\n";
-      exit(1);
-    }
+  BamFile state_file;
+  if (!state_file.open_read(state_filename)) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " exists, but cannot be read.  Perhaps you should "
+         << "remove it so a new one can be created.\n";
+    return false;
+  }
 
-    state_file.close();
+  TypedWritable *obj = state_file.read_object();
+  if (obj == nullptr || !state_file.resolve()) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " exists, but appears to be corrupt.  Perhaps you "
+         << "should remove it so a new one can be created.\n";
+    return false;
+  }
 
-    pal = DCAST(Palettizer, obj);
+  if (!obj->is_of_type(Palettizer::get_class_type())) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " exists, but does not appear to be "
+         << "an egg-palettize output file.  Perhaps you "
+         << "should remove it so a new one can be created.\n";
+    return false;
+  }
 
-    if (pal->_read_pi_version > pal->_pi_version) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " was written by a more recent version of egg-palettize "
-           << "than this one.  You will need to update your egg-palettize.\n";
-      exit(1);
-    }
+  state_file.close();
 
-    if (pal->_read_pi_version < pal->_min_pi_version) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " was written by an old version of egg-palettize.\n\n"
-           << "You will need to make undo-pal (or simply remove the file "
-           << FilenameUnifier::make_user_filename(state_filename)
-           << " and try again).\n\n";
-      exit(1);
-    }
+  pal = DCAST(Palettizer, obj);
+  pal->_shard_dirname = get_shard_dirname(state_filename);
 
-    if (!pal->is_valid()) {
-      nout << FilenameUnifier::make_user_filename(state_filename)
-           << " could not be properly read.  You will need to remove it.\n";
-      exit(1);
-    }
+  if (pal->_read_pi_version > pal->_pi_version) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " was written by a more recent version of egg-palettize "
+         << "than this one.  You will need to update your egg-palettize.\n";
+    return false;
   }
 
-  pal->set_noabs(_noabs);
+  if (pal->_read_pi_version < pal->_min_pi_version) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " was written by an old version of egg-palettize.\n\n"
+         << "You will need to make undo-pal (or simply remove the file "
+         << FilenameUnifier::make_user_filename(state_filename)
+         << " and try again).\n\n";
+    return false;
+  }
 
-  if (_report_pi) {
-    pal->report_pi();
-    exit(0);
+  if (!pal->is_valid()) {
+    nout << FilenameUnifier::make_user_filename(state_filename)
+         << " could not be properly read.  You will need to remove it.\n";
+    return false;
   }
 
-  if (_report_statistics) {
-    pal->report_statistics();
-    exit(0);
+  return true;
+}
+
+/**
+ * Returns the directory that holds the shards of the indicated state file,
+ * when the state is sharded.  This is made absolute, since an egg-palettize
+ * server changes to the directory of each client.
+ */
+Filename EggPalettize::
+get_shard_dirname(const Filename &state_filename) {
+  Filename dirname = state_filename;
+  dirname.set_extension("shards");
+  dirname.make_absolute();
+  return dirname;
+}
+
+/**
+ * Applies the parameters on the command line to the global Palettizer, and
+ * processes the named egg files, generating the palette images and writing
+ * out the modified egg files.  This does not write the state file.
+ */
+EggPalettize::Result EggPalettize::
+process(const Filename &state_filename) {
+  pal->set_noabs(_noabs);
+  pal->_num_threads = _num_threads;
+  if (_shard) {
+    pal->_shard_state = true;
   }
+  pal->_prefetch_budget = (size_t)std::max(_readahead_mb, 0) * 1024 * 1024;
 
   bool okflag = true;
 
   if (_got_txa_script) {
     std::istringstream txa_script(_txa_script);
-    pal->read_txa_file(txa_script, "command line");
+    if (!pal->read_txa_file(txa_script, "command line")) {
+      return R_aborted;
+    }
 
   } else {
     _txa_filename.set_text();
     std::ifstream txa_file;
     if (!_txa_filename.open_read(txa_file)) {
       nout << "Unable to open " << _txa_filename << "\n";
-      exit(1);
+      return R_aborted;
+    }
+    if (!pal->read_txa_file(txa_file, _txa_filename)) {
+      return R_aborted;
     }
-    pal->read_txa_file(txa_file, _txa_filename);
   }
 
   if (_got_generated_image_pattern) {
@@ -784,7 +1007,15 @@ run() {
 
   if (!all_eggs_valid) {
     nout << "Errors reading egg file(s).\n";
-    exit(1);
+    return R_aborted;
+  }
+
+  if (_optimal || _all_textures || _redo_all) {
+    // These reconsider every group, so read them all in from a sharded
+    // state.
+    if (!pal->load_all_groups()) {
+      return R_aborted;
+    }
   }
 
   if (_optimal) {
@@ -805,6 +1036,9 @@ run() {
   } else {
     pal->process_command_line_eggs(_redo_all, state_filename);
   }
+  if (pal->_name_conflict || pal->_load_failed) {
+    return R_aborted;
+  }
 
   if (_optimal) {
     // If we're asking for optimal packing, this also implies we want to
@@ -814,6 +1048,9 @@ run() {
 
   if (_redo_eggs) {
     if (!pal->read_stale_eggs(_redo_all)) {
+      if (pal->_name_conflict || pal->_load_failed) {
+        return R_aborted;
+      }
       okflag = false;
     }
   }
@@ -825,6 +1062,9 @@ run() {
       // generate_images() might have made a few more stale egg files
       // (particularly if a texture palette changed filenames).
       if (!pal->read_stale_eggs(false)) {
+        if (pal->_name_conflict || pal->_load_failed) {
+          return R_aborted;
+        }
         okflag = false;
       }
     }
@@ -836,39 +1076,544 @@ run() {
     }
   }
 
-  if (!_nodb) {
-    // Make up a temporary filename to write the state file to, then move the
-    // state file into place.  We do this in case the user interrupts us (or
-    // we core dump) before we're done; that way we won't leave the state file
-    // incompletely written.
-    std::string dirname = state_filename.get_dirname();
-    if (dirname.empty()) {
-      dirname = ".";
+  return okflag ? R_ok : R_failed;
+}
+
+/**
+ * Writes the global Palettizer to the state file.  The file is left alone,
+ * timestamp and all, if it already holds exactly the same state.  If the
+ * state is sharded, the shards of the groups read this session are written
+ * first, and then the index.  Returns true if successful, false otherwise.
+ */
+bool EggPalettize::
+write_state(const Filename &state_filename) {
+  Palettizer::StatePart part = Palettizer::SP_whole;
+  if (pal->_shard_state) {
+    if (!pal->write_shards()) {
+      return false;
     }
-    Filename temp_filename = Filename::temporary(dirname, "pi");
+    part = Palettizer::SP_index;
+  }
 
-    if (!state_file.open_write(temp_filename) ||
-        !state_file.write_object(pal)) {
-      nout << "Unable to write palettization information to "
-           << FilenameUnifier::make_user_filename(temp_filename)
-           << "\n";
-      exit(1);
+  std::string data;
+  if (!Palettizer::encode_state(pal, part, data)) {
+    nout << "Unable to encode palettization information.\n";
+    return false;
+  }
+
+  return Palettizer::write_state_file(state_filename, data);
+}
+
+#ifdef HAVE_NET
+// The server whose state should be written out if something exits the
+// process; see checkpoint_at_exit().
+static EggPalettize *resident_server = nullptr;
+
+/**
+ * Listens for commands from egg-palettize -connect, and carries them out one
+ * at a time against the Palettizer already in memory.  The state file is
+ * written out when there are changes and at least _checkpoint_interval
+ * seconds have passed since it was last written, and again when the server is
+ * stopped.
+ */
+void EggPalettize::
+run_server(const Filename &state_filename) {
+  QueuedConnectionManager manager;
+  QueuedConnectionListener listener(&manager, 0);
+  QueuedConnectionReader reader(&manager, 0);
+  ConnectionWriter writer(&manager, 0);
+  reader.set_tcp_header_size(4);
+  writer.set_tcp_header_size(4);
+
+  // Only accept connections from the local machine, since a command may
+  // write files anywhere the server can.
+  PT(Connection) rendezvous =
+    manager.open_TCP_server_rendezvous("localhost", _server_port, 5);
+  if (rendezvous == nullptr) {
+    nout << "Unable to listen on port " << _server_port << "\n";
+    exit(1);
+  }
+  listener.add_connection(rendezvous);
+
+  // The commands are carried out against the whole Palettizer, so a sharded
+  // state is read in completely up front.
+  if (!pal->load_all_groups()) {
+    exit(1);
+  }
+
+  nout << "Serving " << FilenameUnifier::make_user_filename(_txa_filename)
+       << " on port " << _server_port << "\n";
+
+  // The commands change to the client's directory, so remember our own, and
+  // make the state filename independent of it.
+  _server_cwd = ExecutionEnvironment::get_cwd();
+  _server_state_filename = state_filename;
+  _server_state_filename.make_absolute();
+
+  // The errors that a command can run into within this tree come back as
+  // R_aborted, and the command is undone.  An exit() from elsewhere, for
+  // instance a library that gives up, still ends the process along with the
+  // command; in that case, write out the state as of the last finished
+  // command first, so that those commands are not lost.
+  _dirty = false;
+  _got_snapshot = false;
+  _journal.clear();
+  _in_request = false;
+  resident_server = this;
+  atexit(&checkpoint_at_exit);
+
+  ClockObject *clock = ClockObject::get_global_clock();
+  double last_checkpoint = clock->get_real_time();
+  bool stop = false;
+
+  while (!stop) {
+    listener.poll();
+    if (listener.new_connection_available()) {
+      PT(Connection) rv;
+      NetAddress address;
+      PT(Connection) connection;
+      if (listener.get_new_connection(rv, address, connection)) {
+        reader.add_connection(connection);
+      }
     }
 
-    state_file.close();
-    state_filename.unlink();
-    if (!temp_filename.rename_to(state_filename)) {
-      nout << "Unable to rename temporary file "
-           << FilenameUnifier::make_user_filename(temp_filename) << " to "
-           << FilenameUnifier::make_user_filename(state_filename) << "\n";
-      exit(1);
+    while (manager.reset_connection_available()) {
+      PT(Connection) connection;
+      if (manager.get_reset_connection(connection)) {
+        reader.remove_connection(connection);
+        manager.close_connection(connection);
+      }
+    }
+
+    // The commands are handled strictly in the order they arrive, so two
+    // clients never touch the Palettizer at the same time.
+    reader.poll();
+    while (!stop && reader.data_available()) {
+      NetDatagram datagram;
+      if (!reader.get_data(datagram)) {
+        break;
+      }
+      DatagramIterator scan(datagram);
+      RequestType type = (RequestType)scan.get_uint8();
+
+      int status = 0;
+      std::string output;
+      if (type == RT_stop) {
+        stop = true;
+
+      } else {
+        std::string cwd = scan.get_string();
+        vector_string args;
+        size_t num_args = scan.get_uint16();
+        for (size_t i = 0; i < num_args; ++i) {
+          args.push_back(scan.get_string());
+        }
+
+        Result result;
+        status = handle_request(cwd, args, _server_state_filename, output, result);
+
+        if (result == R_aborted) {
+          // The command stopped partway, and may have changed the Palettizer
+          // already.  Put it back the way it was before the command.
+          if (!roll_back()) {
+            nout << "Unable to recover the state after a failed command.\n";
+            resident_server = nullptr;
+            exit(1);
+          }
+
+        } else if (result != R_unchanged) {
+          _dirty = true;
+          if (_replayable && _journal.size() < max_journal) {
+            JournalEntry entry;
+            entry._cwd = cwd;
+            entry._args = args;
+            _journal.push_back(entry);
+          } else {
+            // Take a new snapshot before the next command that changes the
+            // Palettizer, rather than replay this one.
+            _got_snapshot = false;
+            _journal.clear();
+          }
+        }
+      }
+
+      Datagram reply;
+      reply.add_int32(status);
+      reply.add_string32(output);
+      writer.send(reply, datagram.get_connection());
+    }
+
+    double now = clock->get_real_time();
+    if (_dirty && (stop || now - last_checkpoint >= _checkpoint_interval)) {
+      if (!write_state(state_filename)) {
+        resident_server = nullptr;
+        exit(1);
+      }
+      _dirty = false;
+      last_checkpoint = now;
+    }
+
+    if (!stop) {
+      Thread::sleep(0.01);
     }
   }
 
-  if (!okflag) {
+  resident_server = nullptr;
+  nout << "Stopping server.\n";
+}
+
+/**
+ * Carries out one command line received from a client, run in the indicated
+ * directory, and then returns to the server's own directory.  All of the
+ * output is collected into the output string.  Returns the exit status for
+ * the client, and fills in result with how the command left the Palettizer:
+ * R_unchanged if it was not touched, or R_aborted if it was left partly
+ * changed and must be restored.  _replayable is set according to whether the
+ * command could be run again by roll_back().
+ */
+int EggPalettize::
+handle_request(const std::string &cwd, const vector_string &args,
+               const Filename &state_filename, std::string &output,
+               Result &result) {
+  result = R_unchanged;
+  _replayable = false;
+
+  std::ostringstream strm;
+  std::streambuf *cout_buf = std::cout.rdbuf(strm.rdbuf());
+
+  if (chdir(Filename::from_os_specific(cwd).to_os_specific().c_str()) != 0) {
+    std::cout.rdbuf(cout_buf);
+    output = "Unable to change to directory " + cwd + "\n";
+    return 1;
+  }
+  FilenameUnifier::clear_canonical_cache();
+
+  int status;
+  {
+    // The command line is parsed by a fresh EggPalettize, just as it would
+    // be by a separate process; only the Palettizer is shared.  The new
+    // object installs its own output stream, so we replace it with ours.
+    // The client has already checked the options, and the egg files are
+    // read by check_request(), so a bad egg file fails only this command.
+    EggPalettize request;
+    Notify::ptr()->set_ostream_ptr(&strm, false);
+    request._defer_eggs = true;
+    request._exit_on_bad_egg = false;
+
+    pvector<char *> argv;
+    std::string program_name = _program_name.to_os_specific();
+    argv.push_back((char *)program_name.c_str());
+    for (const std::string &arg : args) {
+      argv.push_back((char *)arg.c_str());
+    }
+    argv.push_back(nullptr);
+    request.parse_command_line((int)args.size() + 1, &argv[0]);
+
+    if (request.check_request(state_filename, status)) {
+      // This command is going to change the Palettizer, so first make sure
+      // we can put it back if the command stops partway.
+      if (!_got_snapshot && !take_snapshot()) {
+        nout << "Unable to record the state before running this command.\n";
+        status = 1;
+
+      } else {
+        _in_request = true;
+        pal->begin_session();
+        result = request.process(state_filename);
+        _in_request = false;
+        status = (result == R_ok) ? 0 : 1;
+
+        // A command that wrote its egg files over its input files would read
+        // different files if it were run again.
+        _replayable = !request._inplace;
+      }
+    }
+  }
+
+  std::cout.rdbuf(cout_buf);
+  Notify::ptr()->set_ostream_ptr(new WordWrapStream(this), true);
+
+  if (chdir(_server_cwd.to_os_specific().c_str()) != 0) {
+    nout << "Unable to return to " << _server_cwd << "\n";
     exit(1);
   }
+  FilenameUnifier::clear_canonical_cache();
+
+  output = strm.str();
+  return status;
+}
+
+/**
+ * Called on the object holding a command line received by a server, this
+ * checks the command, carries it out if it only reports on the state, and
+ * otherwise reads the egg files it names.  Returns true if the command should
+ * go on to be processed against the resident Palettizer, or false if it is
+ * finished, in which case status is filled in with the exit status for the
+ * client.  The Palettizer is not changed either way.
+ */
+bool EggPalettize::
+check_request(const Filename &state_filename, int &status) {
+  status = 1;
+
+  if (_describe_input_file) {
+    describe_input_file();
+    return false;
+  }
+
+  if (_got_txa_script || _nodb) {
+    nout << "-as and -nodb cannot be used with an egg-palettize server.\n";
+    return false;
+  }
+
+  Filename request_state_filename;
+  if (!find_state_filename(request_state_filename)) {
+    return false;
+  }
+  request_state_filename.make_absolute();
+  if (request_state_filename != state_filename) {
+    nout << "This egg-palettize server is maintaining "
+         << FilenameUnifier::make_user_filename(state_filename)
+         << ", not "
+         << FilenameUnifier::make_user_filename(request_state_filename)
+         << ".\n";
+    return false;
+  }
+
+  if (_report_pi) {
+    pal->report_pi();
+    status = 0;
+    return false;
+  }
+
+  if (_report_statistics) {
+    pal->report_statistics();
+    status = 0;
+    return false;
+  }
+
+  if (!_remove_eggs) {
+    // Now read the egg files that were set aside by handle_args().
+    if (!EggMultiFilter::handle_args(_egg_args) ||
+        !EggMultiFilter::post_command_line()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Records the resident Palettizer in _snapshot, so that roll_back() can put
+ * it back.  Returns true if successful, false otherwise.
+ *
+ * Encoding the state costs as much as writing the whole state file, short of
+ * the disk, so this is not done before every command that changes the
+ * Palettizer.  The snapshot is taken before the first such command, and then
+ * again only once max_journal more have been journaled since, or after one
+ * that could not be journaled.
+ */
+bool EggPalettize::
+take_snapshot() {
+  if (!Palettizer::encode_state(pal, Palettizer::SP_whole, _snapshot)) {
+    return false;
+  }
+
+  _got_snapshot = true;
+  _journal.clear();
+  return true;
+}
+
+/**
+ * Decodes a new Palettizer from the last snapshot taken by take_snapshot().
+ * Returns the new Palettizer, or nullptr if it could not be decoded.  The
+ * resident Palettizer is not changed.
+ */
+Palettizer *EggPalettize::
+read_snapshot() const {
+  nassertr(_got_snapshot, nullptr);
+
+  std::istringstream strm(_snapshot);
+  BamFile state_file;
+  if (!state_file.open_read(strm)) {
+    return nullptr;
+  }
+  TypedWritable *obj = state_file.read_object();
+  if (obj == nullptr || !state_file.resolve() ||
+      !obj->is_of_type(Palettizer::get_class_type())) {
+    return nullptr;
+  }
+  state_file.close();
+
+  Palettizer *snapshot = DCAST(Palettizer, obj);
+  snapshot->_shard_dirname = get_shard_dirname(_server_state_filename);
+  return snapshot;
+}
+
+/**
+ * Undoes the command that has just stopped partway: replaces the resident
+ * Palettizer with the last snapshot, deleting the one it replaces, and runs
+ * the journaled commands against it again.  Their output is discarded, and
+ * the files they write are written again.  Returns true if successful, false
+ * otherwise.
+ */
+bool EggPalettize::
+roll_back() {
+  Palettizer *snapshot = read_snapshot();
+  if (snapshot == nullptr) {
+    return false;
+  }
+
+  Palettizer *old_pal = pal;
+  pal = snapshot;
+  old_pal->delete_contents();
+  delete old_pal;
+
+  // The journal is left as it is, so that checkpoint_at_exit() does not
+  // mistake a command being run again for a new one.
+  Journal journal = _journal;
+  for (const JournalEntry &entry : journal) {
+    std::string output;
+    Result result;
+    handle_request(entry._cwd, entry._args, _server_state_filename, output, result);
+    if (result == R_aborted || result == R_unchanged) {
+      nout << "Unable to repeat an earlier command:\n" << output;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Registered with atexit() by run_server().  If the process is exiting with
+ * changes that have not yet been written to the state file, this writes them.
+ * If the exit came from within a command, which may have begun to change the
+ * Palettizer, the state is first put back as of the last snapshot; that is
+ * only possible if no commands have been journaled since, since they cannot
+ * safely be run again at this point.
+ */
+void EggPalettize::
+checkpoint_at_exit() {
+  EggPalettize *server = resident_server;
+  resident_server = nullptr;
+  if (server == nullptr || !server->_dirty) {
+    return;
+  }
+
+  if (server->_in_request) {
+    Palettizer *snapshot = nullptr;
+    if (server->_journal.empty()) {
+      snapshot = server->read_snapshot();
+    }
+    if (snapshot == nullptr) {
+      nout << "Unable to recover the state; the changes since it was last "
+           << "written are lost.\n";
+      return;
+    }
+
+    // The replaced Palettizer may be in any state here, so it is not
+    // deleted; the process is exiting anyway.
+    pal = snapshot;
+  }
+  server->write_state(server->_server_state_filename);
+}
+
+/**
+ * Returns true if the indicated command-line argument is the -connect option,
+ * in any of the forms the option parser accepts: with one or two dashes,
+ * abbreviated, and with or without an attached "=value".  has_value is set
+ * true if the value is attached, or false if it is the next argument.
+ */
+bool EggPalettize::
+is_connect_option(const std::string &arg, bool &has_value) {
+  size_t start = 0;
+  while (start < 2 && start < arg.size() && arg[start] == '-') {
+    ++start;
+  }
+  if (start == 0) {
+    return false;
+  }
+
+  size_t eq = arg.find('=', start);
+  has_value = (eq != std::string::npos);
+  std::string name = arg.substr(start, has_value ? eq - start : std::string::npos);
+
+  // "c" alone is ambiguous with -checkpoint and -cs, so the parser would not
+  // accept it; any longer prefix of "connect" is unique.
+  static const std::string connect = "connect";
+  return name.size() >= 2 && name.size() <= connect.size() &&
+    connect.compare(0, name.size(), name) == 0;
+}
+
+/**
+ * Sends this command line, less the -connect option, to the server, and
+ * waits for the server to finish with it.  Returns the exit status.
+ */
+int EggPalettize::
+run_client() {
+  QueuedConnectionManager manager;
+  QueuedConnectionReader reader(&manager, 0);
+  ConnectionWriter writer(&manager, 0);
+  reader.set_tcp_header_size(4);
+  writer.set_tcp_header_size(4);
+
+  PT(Connection) connection =
+    manager.open_TCP_client_connection("localhost", _connect_port, 5000);
+  if (connection == nullptr) {
+    nout << "Unable to connect to an egg-palettize server on port "
+         << _connect_port << "\n";
+    return 1;
+  }
+  reader.add_connection(connection);
+
+  Datagram datagram;
+  if (_stop_server) {
+    datagram.add_uint8(RT_stop);
+
+  } else {
+    datagram.add_uint8(RT_run);
+    datagram.add_string(ExecutionEnvironment::get_cwd().to_os_specific());
+
+    vector_string args;
+    for (size_t i = 0; i < _program_args.size(); ++i) {
+      bool has_value;
+      if (is_connect_option(_program_args[i], has_value)) {
+        if (!has_value) {
+          // The value is the next argument.
+          ++i;
+        }
+      } else {
+        args.push_back(_program_args[i]);
+      }
+    }
+    datagram.add_uint16(args.size());
+    for (const std::string &arg : args) {
+      datagram.add_string(arg);
+    }
+  }
+  writer.send(datagram, connection);
+
+  while (true) {
+    reader.poll();
+    if (reader.data_available()) {
+      NetDatagram reply;
+      if (reader.get_data(reply)) {
+        DatagramIterator scan(reply);
+        int status = scan.get_int32();
+        std::cout << scan.get_string32() << std::flush;
+        manager.close_connection(connection);
+        return status;
+      }
+    }
+
+    if (manager.reset_connection_available()) {
+      nout << "Lost connection to the egg-palettize server.\n";
+      return 1;
+    }
+    Thread::sleep(0.01);
+  }
 }
+#endif  // HAVE_NET
 
 int
 main(int argc, char *argv[]) {
@@ -17,6 +17,9 @@
 #include "pandatoolbase.h"
 
 #include "eggMultiFilter.h"
+#include "vector_string.h"
+
+class Palettizer;
 
 /**
  * This is the program wrapper for egg-palettize, but it mainly serves to read
@@ -32,6 +35,41 @@ public:
 
   void run();
 
+private:
+  enum Result {
+    R_ok,       // Finished successfully.
+    R_failed,   // Finished, but with errors; the state should still be saved.
+    R_aborted,  // Stopped early; the state should not be saved.
+    R_unchanged, // Finished without touching the state, e.g. a report.
+  };
+
+  bool find_state_filename(Filename &state_filename);
+  bool read_state(const Filename &state_filename);
+  static Filename get_shard_dirname(const Filename &state_filename);
+  Result process(const Filename &state_filename);
+  bool write_state(const Filename &state_filename);
+
+#ifdef HAVE_NET
+  enum RequestType {
+    RT_run,
+    RT_stop,
+  };
+
+  void run_server(const Filename &state_filename);
+  int handle_request(const std::string &cwd, const vector_string &args,
+                     const Filename &state_filename, std::string &output,
+                     Result &result);
+  bool check_request(const Filename &state_filename, int &status);
+  bool take_snapshot();
+  Palettizer *read_snapshot() const;
+  bool roll_back();
+  static void checkpoint_at_exit();
+  static bool is_connect_option(const std::string &arg, bool &has_value);
+  int run_client();
+#endif
+
+public:
+
   // The following parameter values specifically relate to textures and
   // palettes.  These values are copied to the Palettizer.
   bool _got_txa_filename;
@@ -39,6 +77,7 @@ public:
   bool _got_txa_script;
   std::string _txa_script;
   bool _nodb;
+  bool _shard;
   std::string _generated_image_pattern;
   bool _got_generated_image_pattern;
   std::string _map_dirname;
@@ -62,6 +101,44 @@ private:
   bool _omitall;
   bool _redo_all;
   bool _redo_eggs;
+  int _readahead_mb;
+
+  // These control running as a resident server, which keeps the state in
+  // memory between runs, or passing the command line to one.
+  bool _got_server_port;
+  int _server_port;
+  bool _got_connect_port;
+  int _connect_port;
+  bool _stop_server;
+  double _checkpoint_interval;
+
+  // Set on a command line received by a server.  The egg files are then not
+  // read while the command line is parsed, but later by check_request().
+  // A client never reads them at all.
+  bool _defer_eggs;
+  Args _egg_args;
+
+  // The server's encoding of the Palettizer as it stood some commands ago,
+  // and the commands that have changed it since, in order.  A command that
+  // stops partway is undone by restoring the snapshot and running the
+  // journaled commands again.  The snapshot is retaken only once the journal
+  // is full, or after a command that cannot be run again.
+  class JournalEntry {
+  public:
+    std::string _cwd;
+    vector_string _args;
+  };
+  typedef pvector<JournalEntry> Journal;
+  enum { max_journal = 16 };
+
+  std::string _snapshot;
+  bool _got_snapshot;
+  Journal _journal;
+  bool _replayable;
+  bool _in_request;
+  bool _dirty;
+  Filename _server_state_filename;
+  Filename _server_cwd;
 
   bool _describe_input_file;
   bool _remove_eggs;
@@ -17,6 +17,7 @@
 #include "eggComment.h"
 #include "filename.h"
 #include "dSearchPath.h"
+#include "threadManager.h"
 
 /**
  *
@@ -36,6 +37,8 @@ EggMultiBase() {
      "detect errors when populating or building a standalone model tree, "
      "which should be self-contained and include only relative pathnames.",
      &EggMultiBase::dispatch_none, &_noabs);
+
+  _num_threads = 1;
 }
 
 /**
@@ -185,3 +188,57 @@ read_egg(const Filename &filename) {
 
   return data;
 }
+
+/**
+ * Reads each of the indicated egg files via read_egg() and appends them, in
+ * order, to _eggs.  Returns true if all of the files were read successfully,
+ * or false if any of them could not be read (in which case _eggs is left
+ * unchanged).
+ *
+ * If _num_threads is greater than 1, read_egg() is called on that many
+ * threads.  EggData::read() parses under the global egg lock, though, so the
+ * files are still parsed one at a time; only the rest of read_egg(), such as
+ * converting the paths, overlaps.
+ */
+bool EggMultiBase::
+read_eggs(const pvector<Filename> &filenames) {
+  if (filenames.empty()) {
+    return true;
+  }
+
+  Eggs eggs(filenames.size());
+
+  // The first file is always read on this thread, since it establishes the
+  // coordinate system for the rest if none was specified on the command
+  // line.  After that, read_egg() no longer modifies this object.
+  eggs[0] = read_egg(filenames[0]);
+  if (eggs[0] == nullptr) {
+    return false;
+  }
+
+  if (_num_threads > 1 && filenames.size() > 2) {
+    ThreadManager::_num_threads = _num_threads;
+    ThreadManager::run_threads_on_individual("ReadEggs", (int)filenames.size() - 1, false,
+                                             [&](int i) {
+      eggs[i + 1] = read_egg(filenames[i + 1]);
+    });
+
+  } else {
+    for (size_t i = 1; i < filenames.size(); ++i) {
+      eggs[i] = read_egg(filenames[i]);
+      if (eggs[i] == nullptr) {
+        return false;
+      }
+    }
+  }
+
+  Eggs::const_iterator ei;
+  for (ei = eggs.begin(); ei != eggs.end(); ++ei) {
+    if ((*ei) == nullptr) {
+      return false;
+    }
+  }
+
+  _eggs.insert(_eggs.end(), eggs.begin(), eggs.end());
+  return true;
+}
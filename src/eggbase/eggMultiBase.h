@@ -20,6 +20,7 @@
 #include "coordinateSystem.h"
 #include "eggData.h"
 #include "pointerTo.h"
+#include "pvector.h"
 
 class Filename;
 
@@ -38,12 +39,17 @@ public:
 
 protected:
   virtual PT(EggData) read_egg(const Filename &filename);
+  bool read_eggs(const pvector<Filename> &filenames);
 
 protected:
   typedef pvector< PT(EggData) > Eggs;
   Eggs _eggs;
 
   bool _force_complete;
+
+  // The number of threads read_eggs() may use.  A derived class that sets
+  // this greater than 1 must make sure its read_egg() is thread-safe.
+  int _num_threads;
 };
 
 #endif
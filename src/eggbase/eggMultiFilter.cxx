@@ -62,6 +62,8 @@ EggMultiFilter(bool allow_empty) : _allow_empty(allow_empty) {
   // option that will prevent the program from generating output.  This
   // removes some checks for an output specification in handle_args.
   _read_only = false;
+
+  _exit_on_bad_egg = true;
 }
 
 
@@ -132,17 +134,21 @@ handle_args(ProgramBase::Args &args) {
     }
   }
 
+  pvector<Filename> filenames;
   Args::const_iterator ai;
   for (ai = args.begin(); ai != args.end(); ++ai) {
-    PT(EggData) data = read_egg(Filename::from_os_specific(*ai));
-    if (data == nullptr) {
-      // Rather than returning false, we simply exit here, so the ProgramBase
-      // won't try to tell the user how to run the program just because we got
-      // a bad egg file.
-      exit(1);
+    filenames.push_back(Filename::from_os_specific(*ai));
+  }
+
+  if (!read_eggs(filenames)) {
+    if (!_exit_on_bad_egg) {
+      return false;
     }
 
-    _eggs.push_back(data);
+    // Rather than returning false, we simply exit here, so the ProgramBase
+    // won't try to tell the user how to run the program just because we got
+    // a bad egg file.
+    exit(1);
   }
 
   return true;
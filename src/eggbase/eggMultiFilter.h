@@ -46,6 +46,10 @@ protected:
   bool _got_input_filename;
 
   bool _read_only;
+
+  // If this is false, handle_args() returns false when an egg file cannot be
+  // read, instead of exiting.
+  bool _exit_on_bad_egg;
 };
 
 #endif
@@ -14,9 +14,8 @@
 #include "objToEggConverter.h"
 #include "config_objegg.h"
 #include "eggData.h"
-#include "string_utils.h"
-#include "streamReader.h"
 #include "virtualFileSystem.h"
+#include "pstrtod.h"
 #include "eggPolygon.h"
 #include "nodePath.h"
 #include "geomTriangles.h"
@@ -27,6 +26,9 @@
 #include "triangulator3.h"
 #include "config_egg2pg.h"
 
+#include <ctype.h>
+#include <limits.h>
+
 using std::string;
 
 /**
@@ -144,17 +146,25 @@ convert_to_node(const LoaderOptions &options, const Filename &filename) {
 }
 
 /**
- * Reads the file and converts it to egg structures.
+ * Reads the entire contents of the obj file into memory, ready to be parsed
+ * by read_words(), and resets the tables read from the file.  Returns true on
+ * success, false on failure.
  */
 bool ObjToEggConverter::
-process(const Filename &filename) {
+read_file(const Filename &filename) {
+  // Reading the whole file at once, and parsing it in place, is much faster
+  // than reading and allocating it a line at a time.
   VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
-  std::istream *strm = vfs->open_read_file(filename, true);
-  if (strm == nullptr) {
+  _buffer.clear();
+  if (!vfs->read_file(filename, _buffer, true)) {
     objegg_cat.error()
       << "Couldn't read " << filename << "\n";
     return false;
   }
+  _cursor = _buffer.data();
+  _buffer_end = _cursor + _buffer.size();
+  _next_line_number = 1;
+  _line_number = 0;
 
   _v_table.clear();
   _vn_table.clear();
@@ -165,49 +175,230 @@ process(const Filename &filename) {
   _v4_given = false;
   _vt3_given = false;
   _f_given = false;
+  return true;
+}
 
-  _vpool = new EggVertexPool("vpool");
-  _egg_data->add_child(_vpool);
-  _root_group = new EggGroup("root");
-  _egg_data->add_child(_root_group);
-  _current_group = _root_group;
+/**
+ * Splits the next nonblank line of the file into words, and sets
+ * _line_number to the line it begins on.  A line ending in a backslash is
+ * continued on the following line.  Returns false when there are no more
+ * lines.
+ */
+bool ObjToEggConverter::
+read_words(Words &words) {
+  words.clear();
+
+  const char *p = _cursor;
+  const char *end = _buffer_end;
+  while (p < end) {
+    char ch = *p;
+    if (ch == '\n') {
+      ++p;
+      ++_next_line_number;
+      if (!words.empty()) {
+        break;
+      }
 
-  StreamReader sr(strm, true);
-  string line = sr.readline();
-  _line_number = 1;
-  while (!line.empty()) {
-    line = trim(line);
-    if (line.empty()) {
-      line = sr.readline();
-      continue;
+    } else if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v') {
+      ++p;
+
+    } else {
+      const char *begin = p;
+      while (p < end && !isspace((unsigned char)*p)) {
+        ++p;
+      }
+
+      if (p[-1] == '\\') {
+        // If it ends on a backslash, it's a continuation character, as long
+        // as nothing else follows on the line.
+        const char *q = p;
+        while (q < end && (*q == ' ' || *q == '\t' || *q == '\r')) {
+          ++q;
+        }
+        if (q == end || *q == '\n') {
+          if (q < end) {
+            ++q;
+            ++_next_line_number;
+          }
+          if (begin != p - 1) {
+            if (words.empty()) {
+              _line_number = _next_line_number;
+            }
+            words.push_back(Word(begin, p - 1));
+          }
+          p = q;
+          continue;
+        }
+      }
+
+      if (words.empty()) {
+        _line_number = _next_line_number;
+      }
+      words.push_back(Word(begin, p));
     }
+  }
 
-    while (line[line.length() - 1] == '\\') {
-      // If it ends on a backslash, it's a continuation character.
-      string line2 = sr.readline();
-      ++_line_number;
-      if (line2.empty()) {
+  _cursor = p;
+  return !words.empty();
+}
+
+/**
+ * Parses the indicated word as a floating-point number, without copying it.
+ * Returns true on success, false if it is not a valid number.
+ */
+bool ObjToEggConverter::
+parse_double(const Word &word, double &result) {
+  // These powers of ten can all be represented exactly.
+  static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  // Almost all of the numbers in an obj file are short decimals, which we can
+  // convert exactly with one multiplication or division, as long as the
+  // digits fit in the 53-bit mantissa of a double.  Anything else is handed
+  // off to pstrtod().
+  const char *p = word._begin;
+  const char *end = word._end;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int num_digits = 0;
+  int exponent = 0;
+  bool any_digits = false;
+  bool fast = true;
+
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    any_digits = true;
+    if (num_digits >= 19) {
+      fast = false;
+      break;
+    }
+    mantissa = mantissa * 10 + (*p - '0');
+    if (mantissa != 0) {
+      ++num_digits;
+    }
+  }
+  if (fast && p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+      any_digits = true;
+      if (num_digits >= 19) {
+        fast = false;
         break;
       }
-      line = line.substr(0, line.length() - 1) + trim(line2);
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) {
+        ++num_digits;
+      }
+      --exponent;
     }
-
-    if (line.substr(0, 15) == "#_ref_plane_res") {
-      process_ref_plane_res(line);
-      line = sr.readline();
-      continue;
+  }
+  if (fast && any_digits && p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool exp_negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      exp_negative = (*p == '-');
+      ++p;
+    }
+    int exp_value = 0;
+    const char *exp_begin = p;
+    for (; p < end && *p >= '0' && *p <= '9' && exp_value < 1000; ++p) {
+      exp_value = exp_value * 10 + (*p - '0');
     }
+    if (p == exp_begin) {
+      fast = false;
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
 
-    if (line[0] == '#') {
-      line = sr.readline();
-      continue;
+  if (fast && any_digits && p == end &&
+      mantissa < ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+    double value = (double)mantissa;
+    if (exponent < 0) {
+      value /= powers_of_ten[-exponent];
+    } else {
+      value *= powers_of_ten[exponent];
     }
+    result = negative ? -value : value;
+    return true;
+  }
+
+  // The word is followed in the buffer by whitespace, or by the terminating
+  // null character, either of which stops pstrtod().
+  char *endptr;
+  result = pstrtod(word._begin, &endptr);
+  return endptr == word._end && endptr != word._begin;
+}
+
+/**
+ * Parses the indicated range of characters as a decimal integer.  Returns
+ * true on success, false if it is not a valid integer.
+ */
+bool ObjToEggConverter::
+parse_int(const char *begin, const char *end, int &result) {
+  const char *p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == end) {
+    return false;
+  }
 
-    if (!process_line(line)) {
+  int64_t value = 0;
+  for (; p < end; ++p) {
+    if (*p < '0' || *p > '9') {
       return false;
     }
-    line = sr.readline();
-    ++_line_number;
+    value = value * 10 + (*p - '0');
+    if (value > INT_MAX) {
+      return false;
+    }
+  }
+
+  result = (int)(negative ? -value : value);
+  return true;
+}
+
+/**
+ * Reads the file and converts it to egg structures.
+ */
+bool ObjToEggConverter::
+process(const Filename &filename) {
+  if (!read_file(filename)) {
+    return false;
+  }
+
+  _egg_vertex_refs.clear();
+  _egg_heads.clear();
+
+  _vpool = new EggVertexPool("vpool");
+  _egg_data->add_child(_vpool);
+  _root_group = new EggGroup("root");
+  _egg_data->add_child(_root_group);
+  _current_group = _root_group;
+
+  Words words;
+  bool okflag = true;
+  while (okflag && read_words(words)) {
+    if (words[0].has_prefix("#_ref_plane_res")) {
+      process_ref_plane_res(words);
+
+    } else if (*words[0]._begin != '#') {
+      okflag = process_line(words);
+    }
+  }
+
+  _buffer.clear();
+  _egg_vertex_refs.clear();
+  _egg_heads.clear();
+  if (!okflag) {
+    return false;
   }
 
   if (!_f_given) {
@@ -221,12 +412,10 @@ process(const Filename &filename) {
  *
  */
 bool ObjToEggConverter::
-process_line(const string &line) {
-  vector_string words;
-  tokenize(line, words, " \t", true);
+process_line(const Words &words) {
   nassertr(!words.empty(), false);
 
-  string tag = words[0];
+  const Word &tag = words[0];
   if (tag == "v") {
     return process_v(words);
   } else if (tag == "vt") {
@@ -242,10 +431,10 @@ process_line(const string &line) {
   } else if (tag == "g") {
     return process_g(words);
   } else {
-    bool inserted = _ignored_tags.insert(tag).second;
+    bool inserted = _ignored_tags.insert(tag.str()).second;
     if (inserted) {
       objegg_cat.info()
-        << "Ignoring tag " << tag << "\n";
+        << "Ignoring tag " << tag.str() << "\n";
     }
   }
 
@@ -256,13 +445,11 @@ process_line(const string &line) {
  *
  */
 bool ObjToEggConverter::
-process_ref_plane_res(const string &line) {
+process_ref_plane_res(const Words &words) {
   // the #_ref_plane_res line is a DRZ extension that defines the pixel
   // resolution of the projector device.  It's needed to properly scale the
   // xvt lines.
 
-  vector_string words;
-  tokenize(line, words, " \t", true);
   nassertr(!words.empty(), false);
 
   if (words.size() != 3) {
@@ -272,8 +459,8 @@ process_ref_plane_res(const string &line) {
   }
 
   bool okflag = true;
-  okflag &= string_to_double(words[1], _ref_plane_res[0]);
-  okflag &= string_to_double(words[2], _ref_plane_res[1]);
+  okflag &= parse_double(words[1], _ref_plane_res[0]);
+  okflag &= parse_double(words[2], _ref_plane_res[1]);
 
   if (!okflag) {
     objegg_cat.error()
@@ -288,7 +475,7 @@ process_ref_plane_res(const string &line) {
  *
  */
 bool ObjToEggConverter::
-process_v(vector_string &words) {
+process_v(const Words &words) {
   if (words.size() != 4 && words.size() != 5 &&
       words.size() != 7 && words.size() != 8) {
     objegg_cat.error()
@@ -298,11 +485,11 @@ process_v(vector_string &words) {
 
   bool okflag = true;
   LPoint4d pos;
-  okflag &= string_to_double(words[1], pos[0]);
-  okflag &= string_to_double(words[2], pos[1]);
-  okflag &= string_to_double(words[3], pos[2]);
+  okflag &= parse_double(words[1], pos[0]);
+  okflag &= parse_double(words[2], pos[1]);
+  okflag &= parse_double(words[3], pos[2]);
   if (words.size() == 5 || words.size() == 8) {
-    okflag &= string_to_double(words[4], pos[3]);
+    okflag &= parse_double(words[4], pos[3]);
     _v4_given = true;
   } else {
     pos[3] = 1.0;
@@ -320,9 +507,9 @@ process_v(vector_string &words) {
   if (words.size() == 7 && words.size() == 8) {
     size_t si = words.size();
     LVecBase3d rgb;
-    okflag &= string_to_double(words[si - 3], rgb[0]);
-    okflag &= string_to_double(words[si - 2], rgb[1]);
-    okflag &= string_to_double(words[si - 1], rgb[2]);
+    okflag &= parse_double(words[si - 3], rgb[0]);
+    okflag &= parse_double(words[si - 2], rgb[1]);
+    okflag &= parse_double(words[si - 1], rgb[2]);
 
     if (!okflag) {
       objegg_cat.error()
@@ -342,7 +529,7 @@ process_v(vector_string &words) {
  *
  */
 bool ObjToEggConverter::
-process_vt(vector_string &words) {
+process_vt(const Words &words) {
   if (words.size() != 3 && words.size() != 4) {
     objegg_cat.error()
       << "Wrong number of tokens at line " << _line_number << "\n";
@@ -351,10 +538,10 @@ process_vt(vector_string &words) {
 
   bool okflag = true;
   LTexCoord3d uvw;
-  okflag &= string_to_double(words[1], uvw[0]);
-  okflag &= string_to_double(words[2], uvw[1]);
+  okflag &= parse_double(words[1], uvw[0]);
+  okflag &= parse_double(words[2], uvw[1]);
   if (words.size() == 4) {
-    okflag &= string_to_double(words[3], uvw[2]);
+    okflag &= parse_double(words[3], uvw[2]);
     _vt3_given = true;
   } else {
     uvw[2] = 0.0;
@@ -377,7 +564,7 @@ process_vt(vector_string &words) {
  * camera.  We map it to the nominal texture coordinates here.
  */
 bool ObjToEggConverter::
-process_xvt(vector_string &words) {
+process_xvt(const Words &words) {
   if (words.size() < 3) {
     objegg_cat.error()
       << "Wrong number of tokens at line " << _line_number << "\n";
@@ -386,8 +573,8 @@ process_xvt(vector_string &words) {
 
   bool okflag = true;
   LTexCoordd uv;
-  okflag &= string_to_double(words[1], uv[0]);
-  okflag &= string_to_double(words[2], uv[1]);
+  okflag &= parse_double(words[1], uv[0]);
+  okflag &= parse_double(words[2], uv[1]);
 
   if (!okflag) {
     objegg_cat.error()
@@ -407,7 +594,7 @@ process_xvt(vector_string &words) {
  * "xvc" is another extended column invented by DRZ.  We quietly ignore it.
  */
 bool ObjToEggConverter::
-process_xvc(vector_string &words) {
+process_xvc(const Words &words) {
   return true;
 }
 
@@ -415,7 +602,7 @@ process_xvc(vector_string &words) {
  *
  */
 bool ObjToEggConverter::
-process_vn(vector_string &words) {
+process_vn(const Words &words) {
   if (words.size() != 4) {
     objegg_cat.error()
       << "Wrong number of tokens at line " << _line_number << "\n";
@@ -424,9 +611,9 @@ process_vn(vector_string &words) {
 
   bool okflag = true;
   LVector3d normal;
-  okflag &= string_to_double(words[1], normal[0]);
-  okflag &= string_to_double(words[2], normal[1]);
-  okflag &= string_to_double(words[3], normal[2]);
+  okflag &= parse_double(words[1], normal[0]);
+  okflag &= parse_double(words[2], normal[1]);
+  okflag &= parse_double(words[3], normal[2]);
 
   if (!okflag) {
     objegg_cat.error()
@@ -444,7 +631,7 @@ process_vn(vector_string &words) {
  * Defines a face in the obj file.
  */
 bool ObjToEggConverter::
-process_f(vector_string &words) {
+process_f(const Words &words) {
   _f_given = true;
 
   PT(EggPolygon) poly = new EggPolygon;
@@ -464,7 +651,7 @@ process_f(vector_string &words) {
  * Defines a group in the obj file.
  */
 bool ObjToEggConverter::
-process_g(vector_string &words) {
+process_g(const Words &words) {
   EggGroup *group = _root_group;
 
   // We assume the group names define a hierarchy of more-specific to less-
@@ -475,9 +662,10 @@ process_g(vector_string &words) {
   size_t i = words.size();
   while (i > 1) {
     --i;
-    EggNode *child = group->find_child(words[i]);
+    string name = words[i].str();
+    EggNode *child = group->find_child(name);
     if (child == nullptr || !child->is_of_type(EggGroup::get_class_type())) {
-      child = new EggGroup(words[i]);
+      child = new EggGroup(name);
       group->add_child(child);
     }
     group = DCAST(EggGroup, child);
@@ -492,9 +680,21 @@ process_g(vector_string &words) {
  * reference.
  */
 EggVertex *ObjToEggConverter::
-get_face_vertex(const string &reference) {
+get_face_vertex(const Word &reference) {
   VertexEntry entry(this, reference);
 
+  // The same face reference always produces the same vertex, so check
+  // whether we have made this one already before synthesizing it again.
+  if (entry._vi >= (int)_egg_heads.size()) {
+    _egg_heads.resize(entry._vi + 1, -1);
+  }
+  for (int ri = _egg_heads[entry._vi]; ri >= 0; ri = _egg_vertex_refs[ri]._next) {
+    const EggVertexRef &ref = _egg_vertex_refs[ri];
+    if (ref._vti == entry._vti && ref._vni == entry._vni) {
+      return ref._vertex;
+    }
+  }
+
   // Synthesize a vertex.
   EggVertex synth;
 
@@ -532,7 +732,17 @@ get_face_vertex(const string &reference) {
     synth.set_normal(_vn_table[entry._vni - 1]);
   }
 
-  return _vpool->create_unique_vertex(synth);
+  EggVertex *vertex = _vpool->create_unique_vertex(synth);
+
+  EggVertexRef ref;
+  ref._vti = entry._vti;
+  ref._vni = entry._vni;
+  ref._next = _egg_heads[entry._vi];
+  ref._vertex = vertex;
+  _egg_heads[entry._vi] = (int)_egg_vertex_refs.size();
+  _egg_vertex_refs.push_back(ref);
+
+  return vertex;
 }
 
 /**
@@ -553,50 +763,26 @@ generate_egg_points() {
  */
 bool ObjToEggConverter::
 process_node(const Filename &filename) {
-  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
-  std::istream *strm = vfs->open_read_file(filename, true);
-  if (strm == nullptr) {
-    objegg_cat.error()
-      << "Couldn't read " << filename << "\n";
+  if (!read_file(filename)) {
     return false;
   }
 
-  _v_table.clear();
-  _vn_table.clear();
-  _rgb_table.clear();
-  _vt_table.clear();
-  _xvt_table.clear();
-  _ref_plane_res.set(1.0, 1.0);
-  _v4_given = false;
-  _vt3_given = false;
-  _f_given = false;
-
-  StreamReader sr(strm, true);
-  string line = sr.readline();
-  _line_number = 1;
-  while (!line.empty()) {
-    line = trim(line);
-    if (line.empty()) {
-      line = sr.readline();
-      continue;
-    }
+  _first_entry.clear();
 
-    if (line.substr(0, 15) == "#_ref_plane_res") {
-      process_ref_plane_res(line);
-      line = sr.readline();
-      continue;
-    }
+  Words words;
+  bool okflag = true;
+  while (okflag && read_words(words)) {
+    if (words[0].has_prefix("#_ref_plane_res")) {
+      process_ref_plane_res(words);
 
-    if (line[0] == '#') {
-      line = sr.readline();
-      continue;
+    } else if (*words[0]._begin != '#') {
+      okflag = process_line_node(words);
     }
+  }
 
-    if (!process_line_node(line)) {
-      return false;
-    }
-    line = sr.readline();
-    ++_line_number;
+  _buffer.clear();
+  if (!okflag) {
+    return false;
   }
 
   if (!_f_given) {
@@ -610,12 +796,10 @@ process_node(const Filename &filename) {
  *
  */
 bool ObjToEggConverter::
-process_line_node(const string &line) {
-  vector_string words;
-  tokenize(line, words, " \t", true);
+process_line_node(const Words &words) {
   nassertr(!words.empty(), false);
 
-  string tag = words[0];
+  const Word &tag = words[0];
   if (tag == "v") {
     return process_v(words);
   } else if (tag == "vt") {
@@ -631,10 +815,10 @@ process_line_node(const string &line) {
   } else if (tag == "g") {
     return process_g_node(words);
   } else {
-    bool inserted = _ignored_tags.insert(tag).second;
+    bool inserted = _ignored_tags.insert(tag.str()).second;
     if (inserted) {
       objegg_cat.info()
-        << "Ignoring tag " << tag << "\n";
+        << "Ignoring tag " << tag.str() << "\n";
     }
   }
 
@@ -645,14 +829,14 @@ process_line_node(const string &line) {
  * Defines a face in the obj file.
  */
 bool ObjToEggConverter::
-process_f_node(vector_string &words) {
+process_f_node(const Words &words) {
   _f_given = true;
 
   bool all_vn = true;
   //int non_vn_index = -1;
 
-  pvector<VertexEntry> verts;
-  verts.reserve(words.size() - 1);
+  VertexEntries &verts = _face_entries;
+  verts.clear();
   for (size_t i = 1; i < words.size(); ++i) {
     VertexEntry entry(this, words[i]);
     verts.push_back(entry);
@@ -733,7 +917,7 @@ process_f_node(vector_string &words) {
  * Defines a group in the obj file.
  */
 bool ObjToEggConverter::
-process_g_node(vector_string &words) {
+process_g_node(const Words &words) {
   _current_vertex_data->close_geom(this);
   delete _current_vertex_data;
   _current_vertex_data = nullptr;
@@ -749,7 +933,7 @@ process_g_node(vector_string &words) {
   string name;
   while (i > 2) {
     --i;
-    name = words[i];
+    name = words[i].str();
     NodePath child = np.find(name);
     if (!child) {
       child = np.attach_new_node(name);
@@ -759,7 +943,7 @@ process_g_node(vector_string &words) {
 
   if (i > 1) {
     --i;
-    name = words[i];
+    name = words[i].str();
   }
 
   _current_vertex_data = new VertexData(np.node(), name);
@@ -819,25 +1003,25 @@ add_synth_normal(const LVecBase3d &normal) {
  * reference.
  */
 ObjToEggConverter::VertexEntry::
-VertexEntry(const ObjToEggConverter *converter, const string &obj_vertex) {
+VertexEntry(const ObjToEggConverter *converter, const Word &obj_vertex) {
   _vi = 0;
   _vti = 0;
   _vni = 0;
   _synth_vni = 0;
 
-  vector_string words;
-  tokenize(obj_vertex, words, "/", false);
-  nassertv(!words.empty());
+  const char *p = obj_vertex._begin;
+  const char *end = obj_vertex._end;
+  for (int i = 0; i < 3 && p <= end; ++i) {
+    const char *slash = (const char *)memchr(p, '/', end - p);
+    if (slash == nullptr) {
+      slash = end;
+    }
 
-  for (size_t i = 0; i < words.size(); ++i) {
     int index;
-    if (trim(words[i]).empty()) {
+    if (!parse_int(p, slash, index)) {
       index = 0;
-    } else {
-      if (!string_to_int(words[i], index)) {
-        index = 0;
-      }
     }
+    p = slash + 1;
 
     switch (i) {
     case 0:
@@ -896,71 +1080,82 @@ VertexData(PandaNode *parent, const string &name) :
  * returns an equivalent vertex already present.
  */
 int ObjToEggConverter::VertexData::
-add_vertex(const ObjToEggConverter *converter, const VertexEntry &entry) {
-  std::pair<UniqueVertexEntries::iterator, bool> result;
-  UniqueVertexEntries::iterator ni;
-  int index;
+add_vertex(ObjToEggConverter *converter, const VertexEntry &entry) {
+  pvector<int> &first_entry = converter->_first_entry;
+  if (entry._vi >= (int)first_entry.size()) {
+    first_entry.resize(entry._vi + 1, -1);
+  }
+
+  // Look through the vertices we have already stored with the same position,
+  // for one that matches except possibly for the normal.  There are rarely
+  // more than a handful of these.
+  int exact = -1;
+  int no_normal = -1;
+  int first_match = -1;
+  for (int ei = first_entry[entry._vi]; ei >= 0; ei = _next_entry[ei]) {
+    const VertexEntry &other = _entries[ei];
+    if (!other.matches_except_normal(entry)) {
+      continue;
+    }
+    if (other == entry) {
+      exact = ei;
+    }
+    if (other._vni == 0 && other._synth_vni == 0) {
+      no_normal = ei;
+    }
+    if (first_match < 0 || other < _entries[first_match]) {
+      first_match = ei;
+    }
+  }
+
+  if (exact >= 0) {
+    return exact;
+  }
 
   if (entry._vni != 0 || entry._synth_vni != 0) {
     // If we are storing a vertex with a normal, see if we have already stored
     // a vertex without a normal first.
-    VertexEntry no_normal(entry);
-    no_normal._vni = 0;
-    no_normal._synth_vni = 0;
-    ni = _unique_entries.find(no_normal);
-    if (ni != _unique_entries.end()) {
+    if (no_normal >= 0) {
       // We did have such a vertex!  In this case, repurpose this vertex,
       // resetting it to contain this normal.
-      index = (*ni).second;
-      _unique_entries.erase(ni);
-      result = _unique_entries.insert(UniqueVertexEntries::value_type(entry, index));
-      nassertr(result.second, index);
-      nassertr(_entries[index] == no_normal, index);
-      _entries[index]._vni = entry._vni;
-      _entries[index]._synth_vni = entry._synth_vni;
-      return index;
+      _entries[no_normal]._vni = entry._vni;
+      _entries[no_normal]._synth_vni = entry._synth_vni;
+      return no_normal;
     }
-  } else if (entry._vni == 0 && entry._synth_vni == 0) {
+  } else {
     // If we are storing a vertex *without* any normal, see if we have already
     // stored a vertex with a normal first.
-    ni = _unique_entries.lower_bound(entry);
-    if (ni != _unique_entries.end() && (*ni).first.matches_except_normal(entry)) {
+    if (first_match >= 0) {
       // We had such a vertex, so use it.
-      index = (*ni).second;
-      return index;
+      return first_match;
     }
   }
 
-  // We didn't already have a vertex we could repurpose, so try to add exactly
-  // the desired vertex.
-  result = _unique_entries.insert(UniqueVertexEntries::value_type(entry, _entries.size()));
-  ni = result.first;
-  index = (*ni).second;
+  // We didn't already have a vertex we could repurpose, so add exactly the
+  // desired vertex.
+  int index = (int)_entries.size();
+  _entries.push_back(entry);
+  _next_entry.push_back(first_entry[entry._vi]);
+  first_entry[entry._vi] = index;
 
-  if (result.second) {
-    // If the vertex was added to the table, it's a unique vertex, and now we
-    // have to add it to the vertex data too.
-    _entries.push_back(entry);
-
-    if (converter->_v4_given) {
-      _v4_given = true;
-    }
-    if (converter->_vt3_given) {
-      _vt3_given = true;
-    }
-    if (entry._vti != 0) {
-      _vt_given = true;
-    } else if (entry._vi - 1 < (int)converter->_xvt_table.size()) {
-      // We have an xvt texture coordinate.
-      _vt_given = true;
-    }
-    if (entry._vi - 1 < (int)converter->_rgb_table.size()) {
-      // We have a per-vertex color too.
-      _rgb_given = true;
-    }
-    if (entry._vni != 0) {
-      _vn_given = true;
-    }
+  if (converter->_v4_given) {
+    _v4_given = true;
+  }
+  if (converter->_vt3_given) {
+    _vt3_given = true;
+  }
+  if (entry._vti != 0) {
+    _vt_given = true;
+  } else if (entry._vi - 1 < (int)converter->_xvt_table.size()) {
+    // We have an xvt texture coordinate.
+    _vt_given = true;
+  }
+  if (entry._vi - 1 < (int)converter->_rgb_table.size()) {
+    // We have a per-vertex color too.
+    _rgb_given = true;
+  }
+  if (entry._vni != 0) {
+    _vn_given = true;
   }
 
   return index;
@@ -972,7 +1167,7 @@ add_vertex(const ObjToEggConverter *converter, const VertexEntry &entry) {
  * assigned to the last vertex.
  */
 void ObjToEggConverter::VertexData::
-add_triangle(const ObjToEggConverter *converter, const VertexEntry &v0,
+add_triangle(ObjToEggConverter *converter, const VertexEntry &v0,
              const VertexEntry &v1, const VertexEntry &v2,
              int synth_vni) {
   int v0i, v1i, v2i;
@@ -997,7 +1192,7 @@ add_triangle(const ObjToEggConverter *converter, const VertexEntry &v0,
  * for new geoms.
  */
 void ObjToEggConverter::VertexData::
-close_geom(const ObjToEggConverter *converter) {
+close_geom(ObjToEggConverter *converter) {
   if (_prim->get_num_vertices() != 0) {
     // Create a new format that includes only the columns we actually used.
     PT(GeomVertexArrayFormat) aformat = new GeomVertexArrayFormat;
@@ -1100,7 +1295,13 @@ close_geom(const ObjToEggConverter *converter) {
     _geom_node->add_geom(geom, state);
   }
 
+  // Reset only the parts of the index that we used.
+  pvector<int> &first_entry = converter->_first_entry;
+  for (const VertexEntry &entry : _entries) {
+    first_entry[entry._vi] = -1;
+  }
+
   _prim = new GeomTriangles(GeomEnums::UH_static);
   _entries.clear();
-  _unique_entries.clear();
+  _next_entry.clear();
 }
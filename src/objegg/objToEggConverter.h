@@ -47,30 +47,57 @@ public:
   virtual PT(PandaNode) convert_to_node(const LoaderOptions &options, const Filename &filename);
 
 protected:
+  // A whitespace-delimited word of the obj file.  It refers directly to the
+  // file contents in _buffer, rather than being copied out into a string.
+  class Word {
+  public:
+    INLINE Word(const char *begin, const char *end);
+
+    INLINE size_t length() const;
+    INLINE std::string str() const;
+    INLINE bool operator == (const char *str) const;
+    INLINE bool has_prefix(const char *prefix) const;
+
+    const char *_begin;
+    const char *_end;
+  };
+  typedef pvector<Word> Words;
+
+  bool read_file(const Filename &filename);
+  bool read_words(Words &words);
+  static bool parse_double(const Word &word, double &result);
+  static bool parse_int(const char *begin, const char *end, int &result);
+
   bool process(const Filename &filename);
-  bool process_line(const std::string &line);
-  bool process_ref_plane_res(const std::string &line);
-
-  bool process_v(vector_string &words);
-  bool process_vt(vector_string &words);
-  bool process_xvt(vector_string &words);
-  bool process_xvc(vector_string &words);
-  bool process_vn(vector_string &words);
-  bool process_f(vector_string &words);
-  bool process_g(vector_string &words);
-
-  EggVertex *get_face_vertex(const std::string &face_reference);
+  bool process_line(const Words &words);
+  bool process_ref_plane_res(const Words &words);
+
+  bool process_v(const Words &words);
+  bool process_vt(const Words &words);
+  bool process_xvt(const Words &words);
+  bool process_xvc(const Words &words);
+  bool process_vn(const Words &words);
+  bool process_f(const Words &words);
+  bool process_g(const Words &words);
+
+  EggVertex *get_face_vertex(const Word &face_reference);
   void generate_egg_points();
 
   bool process_node(const Filename &filename);
-  bool process_line_node(const std::string &line);
+  bool process_line_node(const Words &words);
 
-  bool process_f_node(vector_string &words);
-  bool process_g_node(vector_string &words);
+  bool process_f_node(const Words &words);
+  bool process_g_node(const Words &words);
 
   void generate_points();
   int add_synth_normal(const LVecBase3d &normal);
 
+  // The entire contents of the obj file, which is parsed in place.
+  std::string _buffer;
+  const char *_cursor;
+  const char *_buffer_end;
+  int _next_line_number;
+
   // Read from the obj file.
   int _line_number;
   typedef epvector<LVecBase4d> Vec4Table;
@@ -95,13 +122,26 @@ protected:
   PT(EggGroup) _root_group;
   EggGroup *_current_group;
 
+  // The vertices already created for each combination of indices in a face
+  // reference.  These are chained together by the position index: _egg_heads
+  // holds the first one for each position index, or -1.
+  class EggVertexRef {
+  public:
+    int _vti, _vni;
+    int _next;
+    EggVertex *_vertex;
+  };
+  typedef pvector<EggVertexRef> EggVertexRefs;
+  EggVertexRefs _egg_vertex_refs;
+  pvector<int> _egg_heads;
+
   // Structures filled when creating a PandaNode directly.
   PT(PandaNode) _root_node;
 
   class VertexEntry {
   public:
     VertexEntry();
-    VertexEntry(const ObjToEggConverter *converter, const std::string &obj_vertex);
+    VertexEntry(const ObjToEggConverter *converter, const Word &obj_vertex);
 
     INLINE bool operator < (const VertexEntry &other) const;
     INLINE bool operator == (const VertexEntry &other) const;
@@ -114,18 +154,23 @@ protected:
     // The 1-based index number to the synthesized normal, if needed.
     int _synth_vni;
   };
-  typedef pmap<VertexEntry, int> UniqueVertexEntries;
   typedef pvector<VertexEntry> VertexEntries;
+  VertexEntries _face_entries;
+
+  // The first entry of the current VertexData with each position index, or
+  // -1.  The rest are chained through VertexData::_next_entry.  Only the
+  // entries that are in use are reset when the VertexData is closed.
+  pvector<int> _first_entry;
 
   class VertexData {
   public:
     VertexData(PandaNode *parent, const std::string &name);
 
-    int add_vertex(const ObjToEggConverter *converter, const VertexEntry &entry);
-    void add_triangle(const ObjToEggConverter *converter, const VertexEntry &v0,
+    int add_vertex(ObjToEggConverter *converter, const VertexEntry &entry);
+    void add_triangle(ObjToEggConverter *converter, const VertexEntry &v0,
                       const VertexEntry &v1, const VertexEntry &v2,
                       int synth_vni);
-    void close_geom(const ObjToEggConverter *converter);
+    void close_geom(ObjToEggConverter *converter);
 
     PT(PandaNode) _parent;
     std::string _name;
@@ -133,7 +178,7 @@ protected:
 
     PT(GeomPrimitive) _prim;
     VertexEntries _entries;
-    UniqueVertexEntries _unique_entries;
+    pvector<int> _next_entry;
 
     bool _v4_given, _vt3_given;
     bool _vt_given, _rgb_given, _vn_given;
@@ -19,21 +19,40 @@
      filenameUnifier.h imageFile.h omitReason.h \
      pal_string_utils.h paletteGroup.h \
      paletteGroups.h paletteImage.h \
-     palettePage.h palettizer.h sourceTextureImage.h \
+     paletteOccupancy.h palettePage.h palettizer.h sourceTextureImage.h \
      textureImage.h textureMemoryCounter.h texturePlacement.h \
      texturePosition.h textureProperties.h \
-     textureReference.h textureRequest.h \
+     textureReference.h textureRequest.h textureResampler.h \
      txaFile.h txaLine.h
 
   #define COMPOSITE_SOURCES \
      config_palettizer.cxx destTextureImage.cxx eggFile.cxx \
      filenameUnifier.cxx imageFile.cxx \
      omitReason.cxx pal_string_utils.cxx paletteGroup.cxx \
-     paletteGroups.cxx paletteImage.cxx palettePage.cxx \
+     paletteGroups.cxx paletteImage.cxx paletteOccupancy.cxx \
+     palettePage.cxx \
      palettizer.cxx sourceTextureImage.cxx textureImage.cxx \
      textureMemoryCounter.cxx texturePlacement.cxx \
      texturePosition.cxx textureProperties.cxx \
-     textureReference.cxx textureRequest.cxx txaFile.cxx \
+     textureReference.cxx textureRequest.cxx textureResampler.cxx \
+     txaFile.cxx \
      txaLine.cxx
 
 #end ss_lib_target
+
+#begin test_bin_target
+  #define TARGET test_palette_pack
+  #define LOCAL_LIBS \
+    palettizer pandatoolbase
+
+  #define OTHER_LIBS \
+    egg:c pandaegg:m \
+    pipeline:c event:c pstatclient:c panda:m \
+     pnmimage:c mathutil:c linmath:c putil:c express:c \
+    interrogatedb prc  \
+    dtoolutil:c dtoolbase:c dtool:m
+
+  #define SOURCES \
+    test_palette_pack.cxx
+
+#end test_bin_target
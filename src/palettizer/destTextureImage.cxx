@@ -30,6 +30,8 @@ TypeHandle DestTextureImage::_type_handle;
  */
 DestTextureImage::
 DestTextureImage() {
+  _source_hash = 0;
+  _resize_filter = TextureResampler::F_unspecified;
 }
 
 /**
@@ -37,6 +39,8 @@ DestTextureImage() {
  */
 DestTextureImage::
 DestTextureImage(TexturePlacement *placement) {
+  _source_hash = 0;
+  _resize_filter = TextureResampler::F_unspecified;
   TextureImage *texture = placement->get_texture();
   _properties = texture->get_properties();
   _size_known = texture->is_size_known();
@@ -61,11 +65,16 @@ DestTextureImage(TexturePlacement *placement) {
  */
 void DestTextureImage::
 copy(TextureImage *texture) {
+  SourceTextureImage *source = texture->get_preferred_source();
+  _source_hash = (source != nullptr) ? source->get_content_hash() : 0;
+  _resize_filter = texture->get_txa_resize_filter();
+
   const PNMImage &source_image = texture->read_source_image();
   if (source_image.is_valid()) {
     PNMImage dest_image(_x_size, _y_size, texture->get_num_channels(),
                         source_image.get_maxval());
-    dest_image.quick_filter_from(source_image);
+    TextureResampler::resample(dest_image, source_image, texture->get_txa_resize_filter(),
+                               texture->get_properties()._srgb);
     write(dest_image);
 
   } else {
@@ -91,16 +100,23 @@ void DestTextureImage::
 copy_if_stale(const DestTextureImage *other, TextureImage *texture) {
   if (other->get_x_size() != get_x_size() ||
       other->get_y_size() != get_y_size() ||
-      other->get_num_channels() != get_num_channels()) {
+      other->get_num_channels() != get_num_channels() ||
+      other->_resize_filter != texture->get_txa_resize_filter()) {
     copy(texture);
 
   } else {
-    // Also check the timestamps.
+    // Also check the timestamps, and if the source appears to be newer, its
+    // contents.
     SourceTextureImage *source = texture->get_preferred_source();
 
     if (source != nullptr &&
-        source->get_filename().compare_timestamps(get_filename()) > 0) {
+        source->get_filename().compare_timestamps(get_filename()) > 0 &&
+        (other->_source_hash == 0 ||
+         source->get_content_hash() != other->_source_hash)) {
       copy(texture);
+    } else {
+      _source_hash = other->_source_hash;
+      _resize_filter = other->_resize_filter;
     }
   }
 }
@@ -133,6 +149,13 @@ register_with_read_factory() {
 void DestTextureImage::
 write_datagram(BamWriter *writer, Datagram &datagram) {
   ImageFile::write_datagram(writer, datagram);
+
+  if (Palettizer::_pi_version >= 23) {
+    datagram.add_uint64(_source_hash);
+  }
+  if (Palettizer::_pi_version >= 24) {
+    datagram.add_uint8((int)_resize_filter);
+  }
 }
 
 /**
@@ -158,4 +181,11 @@ make_DestTextureImage(const FactoryParams &params) {
 void DestTextureImage::
 fillin(DatagramIterator &scan, BamReader *manager) {
   ImageFile::fillin(scan, manager);
+
+  if (Palettizer::_read_pi_version >= 23) {
+    _source_hash = scan.get_uint64();
+  }
+  if (Palettizer::_read_pi_version >= 24) {
+    _resize_filter = (TextureResampler::Filter)scan.get_uint8();
+  }
 }
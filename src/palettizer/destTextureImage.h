@@ -17,6 +17,7 @@
 #include "pandatoolbase.h"
 
 #include "imageFile.h"
+#include "textureResampler.h"
 
 class TexturePlacement;
 class TextureImage;
@@ -38,6 +39,11 @@ public:
 private:
   static int to_power_2(int value);
 
+  // The hash of the source image contents, and the filter used to scale
+  // them, as of the last copy.
+  uint64_t _source_hash;
+  TextureResampler::Filter _resize_filter;
+
 
   // The TypedWritable interface follows.
 public:
@@ -97,10 +97,22 @@ get_source_filename() const {
  * Scans the egg file for texture references and updates the _textures list
  * appropriately.  This assumes the egg file was supplied on the command line
  * and thus the _data member is available.
+ *
+ * Returns true if successful, or false if a texture name conflict was found
+ * or the shard of a sharded state could not be read, in which case the
+ * _textures list is left unchanged.
  */
-void EggFile::
+bool EggFile::
 scan_textures() {
-  nassertv(_data != nullptr);
+  nassertr(_data != nullptr, false);
+
+  // The references we already have may be replaced, which needs their
+  // placements in memory.
+  PaletteGroups placement_groups;
+  get_placement_groups(placement_groups);
+  if (!pal->load_groups(placement_groups)) {
+    return false;
+  }
 
   // Extract the set of textures referenced by this egg file.
   EggTextureCollection tc;
@@ -111,14 +123,33 @@ scan_textures() {
 
   // Now build up a list of new TextureReference objects that represent the
   // textures actually used and their uv range, etc.
-  Textures new_textures;
+  TextureReference::References refs;
+  refs.reserve(tc.size());
 
   EggTextureCollection::iterator eti;
   for (eti = tc.begin(); eti != tc.end(); ++eti) {
     EggTexture *egg_tex = (*eti);
 
     TextureReference *ref = new TextureReference;
-    ref->from_egg(this, _data, egg_tex);
+    refs.push_back(ref);
+    if (!ref->from_egg(this, _data, egg_tex)) {
+      TextureReference::References::iterator ri;
+      for (ri = refs.begin(); ri != refs.end(); ++ri) {
+        delete (*ri);
+      }
+      return false;
+    }
+  }
+
+  // Measure the UV range of all of the textures in one pass over the
+  // geometry.
+  TextureReference::get_uv_ranges(_data, refs);
+
+  Textures new_textures;
+
+  TextureReference::References::iterator ri;
+  for (ri = refs.begin(); ri != refs.end(); ++ri) {
+    TextureReference *ref = (*ri);
 
     if (!ref->has_uvs()) {
       // This texture isn't *really* referenced.  (Usually this happens if the
@@ -198,6 +229,7 @@ scan_textures() {
   }
 
   _textures.swap(combined_textures);
+  return true;
 }
 
 /**
@@ -369,6 +401,34 @@ apply_properties_to_source() {
   }
 }
 
+/**
+ * Fills up the indicated set with the groups of the TexturePlacements used by
+ * this egg file, whether or not they have been read from a sharded state.
+ */
+void EggFile::
+get_placement_groups(PaletteGroups &result) const {
+  Textures::const_iterator ti;
+  for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
+    PaletteGroup *group = (*ti)->get_placement_group();
+    if (group != nullptr) {
+      result.insert(group);
+    }
+  }
+}
+
+/**
+ * Looks up the TexturePlacements of the egg file's texture references whose
+ * groups have just been read from a sharded state.  This is called by
+ * Palettizer::load_groups().
+ */
+void EggFile::
+resolve_placements() {
+  Textures::iterator ti;
+  for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
+    (*ti)->resolve_placement();
+  }
+}
+
 /**
  * Once all the textures have been assigned to groups (but before they may
  * actually be placed), chooses a suitable TexturePlacement for each texture
@@ -383,11 +443,13 @@ choose_placements() {
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
     TextureReference *reference = (*ti);
     TextureImage *texture = reference->get_texture();
+    PaletteGroup *current_group = reference->get_placement_group();
 
-    if (reference->get_placement() != nullptr &&
-        texture->get_groups().count(reference->get_placement()->get_group()) != 0) {
+    if (current_group != nullptr &&
+        texture->get_groups().count(current_group) != 0) {
       // The egg file is already using a TexturePlacement that is suitable.
-      // Don't bother changing it.
+      // Don't bother changing it.  It may still be in a shard that has not
+      // been read this session.
 
     } else {
       // We need to select a new TexturePlacement.
@@ -409,6 +471,9 @@ choose_placements() {
         // It doesn't really matter which group in the set we choose, so we
         // arbitrarily choose the first one.
         PaletteGroup *group = (*groups.begin());
+        if (!pal->load_groups(texture->get_groups())) {
+          return;
+        }
 
         // Now get the TexturePlacement object that corresponds to the
         // placement of this texture into this group.
@@ -447,11 +512,19 @@ void EggFile::
 update_egg() {
   nassertv(_data != nullptr);
 
+  TextureReference::References refs;
+
   Textures::iterator ti;
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
     TextureReference *reference = (*ti);
-    reference->update_egg();
+    if (reference->update_egg()) {
+      refs.push_back(reference);
+    }
   }
+
+  // Now adjust the UV's of all the palettized textures in one pass over the
+  // geometry.
+  TextureReference::update_uv_ranges(_data, refs);
 }
 
 /**
@@ -460,24 +533,33 @@ update_egg() {
  */
 void EggFile::
 remove_egg() {
+  PaletteGroups placement_groups;
+  get_placement_groups(placement_groups);
+  if (!pal->load_groups(placement_groups)) {
+    return;
+  }
+
   Textures::iterator ti;
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
     TextureReference *reference = (*ti);
     TexturePlacement *placement = reference->get_placement();
-    placement->remove_egg(reference);
+    if (placement != nullptr) {
+      placement->remove_egg(reference);
+    }
   }
 }
 
 /**
  * Reads in the egg file from its _source_filename.  It is only valid to call
  * this if it has not already been read in, e.g.  from the command line.
- * Returns true if successful, false if there is an error.
+ * Returns true if successful, false if there is an error.  Problems with the
+ * egg file are reported to the indicated stream.
  *
  * This may also be called after a previous call to release_egg_data(), in
  * order to re-read the same egg file.
  */
 bool EggFile::
-read_egg(bool noabs) {
+read_egg(bool noabs, std::ostream &out) {
   nassertr(_data == nullptr, false);
   nassertr(!_source_filename.empty(), false);
 
@@ -485,7 +567,7 @@ read_egg(bool noabs) {
     FilenameUnifier::make_user_filename(_source_filename);
 
   if (!_source_filename.exists()) {
-    nout << user_source_filename << " does not exist.\n";
+    out << user_source_filename << " does not exist.\n";
     return false;
   }
 
@@ -496,8 +578,8 @@ read_egg(bool noabs) {
   }
 
   if (noabs && data->original_had_absolute_pathnames()) {
-    nout << _source_filename.get_basename()
-         << " references textures using absolute pathnames!\n";
+    out << _source_filename.get_basename()
+        << " references textures using absolute pathnames!\n";
     return false;
   }
 
@@ -540,7 +622,7 @@ read_egg(bool noabs) {
 
   if (!_textures.empty()) {
     // If we already have textures, assume we're re-reading the file.
-    rescan_textures();
+    rescan_textures(out);
   }
 
   return true;
@@ -562,17 +644,44 @@ release_egg_data() {
 }
 
 /**
- * Writes out the egg file to its _dest_filename.  Returns true if successful,
- * false if there is an error.
+ * Resets the values that are not stored in the state file to the way they
+ * would be if the EggFile had just been read from it, in preparation for
+ * another session in the same process.
+ */
+void EggFile::
+reset_session() {
+  release_egg_data();
+  _first_txa_match = false;
+  _complete_groups.clear();
+  _had_data = false;
+}
+
+/**
+ * Deletes the TextureReferences of this egg file.  This is the first step in
+ * deleting a whole Palettizer; see Palettizer::delete_contents().
+ */
+void EggFile::
+delete_contents() {
+  Textures::iterator ti;
+  for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
+    delete (*ti);
+  }
+  _textures.clear();
+}
+
+/**
+ * Writes out the egg file to its _dest_filename, reporting the filename to
+ * the indicated stream.  Returns true if successful, false if there is an
+ * error.
  */
 bool EggFile::
-write_egg() {
+write_egg(std::ostream &out) {
   nassertr(_data != nullptr, false);
   nassertr(!_dest_filename.empty(), false);
 
   _dest_filename.make_dir();
-  nout << "Writing " << FilenameUnifier::make_user_filename(_dest_filename)
-       << "\n";
+  out << "Writing " << FilenameUnifier::make_user_filename(_dest_filename)
+      << "\n";
   if (!_data->write_egg(_dest_filename)) {
     // Some error while writing.  Most unusual.
     _is_stale = true;
@@ -650,10 +759,12 @@ remove_backstage(EggGroupNode *node) {
 
 /**
  * After reloading the egg file for the second time in a given session,
- * rematches the texture pointers with the TextureReference objects.
+ * rematches the texture pointers with the TextureReference objects.  Any
+ * texture that was not there the first time is reported to the indicated
+ * stream.
  */
 void EggFile::
-rescan_textures() {
+rescan_textures(std::ostream &out) {
   nassertv(_data != nullptr);
 
   // Extract the set of textures referenced by this egg file.
@@ -679,9 +790,9 @@ rescan_textures() {
     ByTRefName::const_iterator tni = by_tref_name.find(egg_tex->get_name());
     if (tni == by_tref_name.end()) {
       // We didn't find this TRef name last time around!
-      nout << _source_filename.get_basename()
-           << " modified during session--TRef " << egg_tex->get_name()
-           << " is new!\n";
+      out << _source_filename.get_basename()
+          << " modified during session--TRef " << egg_tex->get_name()
+          << " is new!\n";
 
     } else {
       TextureReference *ref = (*tni).second;
@@ -44,8 +44,10 @@ public:
 
   const Filename &get_source_filename() const;
 
-  void scan_textures();
+  bool scan_textures();
   void get_textures(pset<TextureImage *> &result) const;
+  void get_placement_groups(PaletteGroups &result) const;
+  void resolve_placements();
 
   void pre_txa_file();
   void match_txa_groups(const PaletteGroups &groups);
@@ -69,16 +71,18 @@ public:
 
   void update_egg();
   void remove_egg();
-  bool read_egg(bool noabs);
+  bool read_egg(bool noabs, std::ostream &out);
   void release_egg_data();
-  bool write_egg();
+  void reset_session();
+  void delete_contents();
+  bool write_egg(std::ostream &out);
 
   void write_description(std::ostream &out, int indent_level = 0) const;
   void write_texture_refs(std::ostream &out, int indent_level = 0) const;
 
 private:
   void remove_backstage(EggGroupNode *node);
-  void rescan_textures();
+  void rescan_textures(std::ostream &out);
 
 private:
   PT(EggData) _data;
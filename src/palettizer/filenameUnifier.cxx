@@ -14,12 +14,14 @@
 #include "filenameUnifier.h"
 
 #include "executionEnvironment.h"
+#include "mutexHolder.h"
 
 Filename FilenameUnifier::_txa_filename;
 Filename FilenameUnifier::_txa_dir;
 Filename FilenameUnifier::_rel_dirname;
 
 FilenameUnifier::CanonicalFilenames FilenameUnifier::_canonical_filenames;
+Mutex FilenameUnifier::_canonical_lock;
 
 /**
  * Notes the filename the .txa file was found in.  This may have come from the
@@ -125,6 +127,7 @@ make_canonical(Filename &filename) {
 
   Filename orig_dirname = filename.get_dirname();
 
+  MutexHolder holder(_canonical_lock);
   CanonicalFilenames::iterator fi;
   fi = _canonical_filenames.find(orig_dirname);
   if (fi != _canonical_filenames.end()) {
@@ -141,3 +144,14 @@ make_canonical(Filename &filename) {
 
   _canonical_filenames.insert(CanonicalFilenames::value_type(orig_dirname, new_dirname));
 }
+
+/**
+ * Empties the cache used by make_canonical().  The cache may hold relative
+ * directory names, so this must be called whenever the current directory
+ * changes.
+ */
+void FilenameUnifier::
+clear_canonical_cache() {
+  MutexHolder holder(_canonical_lock);
+  _canonical_filenames.clear();
+}
@@ -19,6 +19,7 @@
 #include "filename.h"
 
 #include "pmap.h"
+#include "pmutex.h"
 
 /**
  * This static class does the job of converting filenames from relative to
@@ -37,6 +38,7 @@ public:
   static Filename make_egg_filename(Filename filename);
   static Filename make_user_filename(Filename filename);
   static void make_canonical(Filename &filename);
+  static void clear_canonical_cache();
 
 private:
 
@@ -46,6 +48,10 @@ private:
 
   typedef pmap<std::string, std::string> CanonicalFilenames;
   static CanonicalFilenames _canonical_filenames;
+
+  // Protects _canonical_filenames, since palette images may be generated
+  // (and reported to the user) from several threads at once.
+  static Mutex _canonical_lock;
 };
 
 #endif
@@ -9,6 +9,7 @@
 #include "paletteGroup.cxx"
 #include "paletteGroups.cxx"
 #include "paletteImage.cxx"
+#include "paletteOccupancy.cxx"
 #include "palettePage.cxx"
 #include "palettizer.cxx"
 #include "sourceTextureImage.cxx"
@@ -19,6 +20,7 @@
 #include "textureProperties.cxx"
 #include "textureReference.cxx"
 #include "textureRequest.cxx"
+#include "textureResampler.cxx"
 #include "txaFile.cxx"
 #include "txaLine.cxx"
 
@@ -44,6 +44,7 @@ PaletteGroup() {
   _margin_override = 0;
   _group_x_size = -1;
   _group_y_size = -1;
+  _loaded = true;
 }
 
 /**
@@ -360,6 +361,80 @@ get_egg_count() const {
   return _egg_count;
 }
 
+/**
+ * Resets the egg count, and the per-session state of each page, in
+ * preparation for another session in the same process.
+ */
+void PaletteGroup::
+reset_session() {
+  _egg_count = 0;
+
+  Pages::iterator pai;
+  for (pai = _pages.begin(); pai != _pages.end(); ++pai) {
+    (*pai).second->reset_session();
+  }
+}
+
+/**
+ * Deletes the pages of this group, and their images.  The placements must
+ * already be gone; see Palettizer::delete_contents().
+ */
+void PaletteGroup::
+delete_contents() {
+  Pages::iterator pai;
+  for (pai = _pages.begin(); pai != _pages.end(); ++pai) {
+    (*pai).second->delete_contents();
+    delete (*pai).second;
+  }
+  _pages.clear();
+}
+
+/**
+ * Returns true if the placements and pages of this group are in memory, or
+ * false if the group was read from the index of a sharded state and its shard
+ * has not been read yet.  See Palettizer::load_groups().
+ */
+bool PaletteGroup::
+is_loaded() const {
+  return _loaded;
+}
+
+/**
+ * Moves the placements and pages read from this group's shard, which were
+ * read into the indicated temporary group, into this group, and looks up the
+ * textures they name.  Returns true if successful, or false if the shard does
+ * not match the index.
+ */
+bool PaletteGroup::
+take_shard(PaletteGroup *shard) {
+  nassertr(!_loaded, false);
+  if (shard->get_name() != get_name()) {
+    return false;
+  }
+
+  Placements::const_iterator pli;
+  for (pli = shard->_placements.begin(); pli != shard->_placements.end(); ++pli) {
+    TexturePlacement *placement = (*pli);
+    if (!placement->resolve_names(this)) {
+      return false;
+    }
+    _placements.insert(placement);
+  }
+  shard->_placements.clear();
+
+  Pages::const_iterator pai;
+  for (pai = shard->_pages.begin(); pai != shard->_pages.end(); ++pai) {
+    PalettePage *page = (*pai).second;
+    page->_group = this;
+    _pages.insert(*pai);
+  }
+  shard->_pages.clear();
+
+  _loaded = true;
+  setup_shadow_images();
+  return true;
+}
+
 /**
  * Returns the page associated with the indicated properties.  If no page
  * object has yet been created, creates one.
@@ -594,6 +669,20 @@ update_images(bool redo_all) {
   }
 }
 
+/**
+ * Calls PaletteImage::prepare_update() on each PaletteImage in this group,
+ * and appends the ones that need to be regenerated to the indicated list.
+ * This is the first half of update_images().
+ */
+void PaletteGroup::
+prepare_images(bool redo_all, pvector<PaletteImage *> &images) {
+  Pages::iterator pai;
+  for (pai = _pages.begin(); pai != _pages.end(); ++pai) {
+    PalettePage *page = (*pai).second;
+    page->prepare_images(redo_all, images);
+  }
+}
+
 /**
  * Registers the current object as something that can be read from a Bam file.
  */
@@ -610,31 +699,54 @@ register_with_read_factory() {
 void PaletteGroup::
 write_datagram(BamWriter *writer, Datagram &datagram) {
   TypedWritable::write_datagram(writer, datagram);
-  datagram.add_string(get_name());
-  datagram.add_string(_dirname);
-  _dependent.write_datagram(writer, datagram);
 
-  datagram.add_int32(_dependency_level);
-  datagram.add_int32(_dependency_order);
-  datagram.add_int32(_dirname_order);
+  // The index of a sharded state holds everything about the group but its
+  // placements and pages, and the group's shard holds just those.
+  Palettizer::StatePart part = Palettizer::_write_state_part;
+  if (part == Palettizer::SP_shard) {
+    datagram.add_int32(Palettizer::_pi_version);
+  }
 
-  datagram.add_uint32(_placements.size());
-  Placements::const_iterator pli;
-  for (pli = _placements.begin(); pli != _placements.end(); ++pli) {
-    writer->write_pointer(datagram, (*pli));
+  datagram.add_string(get_name());
+  if (part != Palettizer::SP_shard) {
+    datagram.add_string(_dirname);
+    _dependent.write_datagram(writer, datagram);
+
+    datagram.add_int32(_dependency_level);
+    datagram.add_int32(_dependency_order);
+    datagram.add_int32(_dirname_order);
   }
 
-  datagram.add_uint32(_pages.size());
-  Pages::const_iterator pai;
-  for (pai = _pages.begin(); pai != _pages.end(); ++pai) {
-    writer->write_pointer(datagram, (*pai).second);
+  if (part != Palettizer::SP_index) {
+    nassertv(_loaded);
+
+    // The placements are written in order by texture name, rather than by
+    // pointer, so that the same state always produces the same file.
+    pvector<TexturePlacement *> placement_vector(_placements.begin(), _placements.end());
+    sort(placement_vector.begin(), placement_vector.end(),
+         IndirectCompareNames<TexturePlacement>());
+
+    datagram.add_uint32(placement_vector.size());
+    pvector<TexturePlacement *>::const_iterator pvi;
+    for (pvi = placement_vector.begin(); pvi != placement_vector.end(); ++pvi) {
+      writer->write_pointer(datagram, (*pvi));
+    }
+
+    datagram.add_uint32(_pages.size());
+    Pages::const_iterator pai;
+    for (pai = _pages.begin(); pai != _pages.end(); ++pai) {
+      writer->write_pointer(datagram, (*pai).second);
+    }
   }
-  datagram.add_bool(_has_margin_override);
-  datagram.add_int16(_margin_override);
 
-  if (Palettizer::_pi_version >= 22) {
-    datagram.add_int32(_group_x_size);
-    datagram.add_int32(_group_y_size);
+  if (part != Palettizer::SP_shard) {
+    datagram.add_bool(_has_margin_override);
+    datagram.add_int16(_margin_override);
+
+    if (Palettizer::_pi_version >= 22) {
+      datagram.add_int32(_group_x_size);
+      datagram.add_int32(_group_y_size);
+    }
   }
 }
 
@@ -648,7 +760,9 @@ int PaletteGroup::
 complete_pointers(TypedWritable **p_list, BamReader *manager) {
   int pi = TypedWritable::complete_pointers(p_list, manager);
 
-  pi += _dependent.complete_pointers(p_list + pi, manager);
+  if (Palettizer::_read_state_part != Palettizer::SP_shard) {
+    pi += _dependent.complete_pointers(p_list + pi, manager);
+  }
 
   int i;
   for (i = 0; i < _num_placements; i++) {
@@ -716,28 +830,45 @@ make_PaletteGroup(const FactoryParams &params) {
 void PaletteGroup::
 fillin(DatagramIterator &scan, BamReader *manager) {
   TypedWritable::fillin(scan, manager);
-  set_name(scan.get_string());
-  _dirname = scan.get_string();
-  _dependent.fillin(scan, manager);
 
-  _dependency_level = scan.get_int32();
-  _dependency_order = scan.get_int32();
-  _dirname_order = scan.get_int32();
+  Palettizer::StatePart part = Palettizer::_read_state_part;
+  if (part == Palettizer::SP_shard) {
+    // A shard is not rewritten along with the index if it has not changed,
+    // so it records its own version.
+    Palettizer::_read_pi_version = scan.get_int32();
+  }
 
-  _num_placements = scan.get_uint32();
-  manager->read_pointers(scan, _num_placements);
+  set_name(scan.get_string());
+  if (part != Palettizer::SP_shard) {
+    _dirname = scan.get_string();
+    _dependent.fillin(scan, manager);
 
-  _num_pages = scan.get_uint32();
-  manager->read_pointers(scan, _num_pages);
+    _dependency_level = scan.get_int32();
+    _dependency_order = scan.get_int32();
+    _dirname_order = scan.get_int32();
+  }
 
-  if (Palettizer::_read_pi_version >= 19) {
-    _has_margin_override = scan.get_bool();
-    _margin_override = scan.get_int16();
+  _num_placements = 0;
+  _num_pages = 0;
+  if (part != Palettizer::SP_index) {
+    _num_placements = scan.get_uint32();
+    manager->read_pointers(scan, _num_placements);
+
+    _num_pages = scan.get_uint32();
+    manager->read_pointers(scan, _num_pages);
   }
+  _loaded = (part != Palettizer::SP_index);
+
+  if (part != Palettizer::SP_shard) {
+    if (Palettizer::_read_pi_version >= 19) {
+      _has_margin_override = scan.get_bool();
+      _margin_override = scan.get_int16();
+    }
 
-  if (Palettizer::_read_pi_version >= 22) {
-    _group_x_size = scan.get_int32();
-    _group_y_size = scan.get_int32();
+    if (Palettizer::_read_pi_version >= 22) {
+      _group_x_size = scan.get_int32();
+      _group_y_size = scan.get_int32();
+    }
   }
 }
 
@@ -30,6 +30,7 @@ class EggFile;
 class TexturePlacement;
 class PalettePage;
 class TextureImage;
+class PaletteImage;
 class TxaFile;
 
 /**
@@ -74,6 +75,11 @@ public:
 
   void increment_egg_count();
   int get_egg_count() const;
+  void reset_session();
+  void delete_contents();
+
+  bool is_loaded() const;
+  bool take_shard(PaletteGroup *shard);
 
   PalettePage *get_page(const TextureProperties &properties);
 
@@ -89,6 +95,7 @@ public:
   void reset_images();
   void setup_shadow_images();
   void update_images(bool redo_all);
+  void prepare_images(bool redo_all, pvector<PaletteImage *> &images);
 
   void add_texture_swap_info(const std::string sourceTextureName, const vector_string &swapTextures);
   bool is_none_texture_swap() const;
@@ -116,6 +123,9 @@ private:
   // the global palette size.
   int _group_x_size, _group_y_size;
 
+  // False while the placements and pages are in a shard not yet read.
+  bool _loaded;
+
   // The TypedWritable interface follows.
 public:
   static void register_with_read_factory();
@@ -292,9 +292,15 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   TypedWritable::write_datagram(writer, datagram);
   datagram.add_uint32(_groups.size());
 
-  Groups::const_iterator gi;
-  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
-    writer->write_pointer(datagram, *gi);
+  // The set is ordered by pointer, so we write the groups in order by name
+  // instead, so that the same state always produces the same file.
+  pvector<PaletteGroup *> group_vector(_groups.begin(), _groups.end());
+  sort(group_vector.begin(), group_vector.end(),
+       IndirectCompareNames<PaletteGroup>());
+
+  pvector<PaletteGroup *>::const_iterator gvi;
+  for (gvi = group_vector.begin(); gvi != group_vector.end(); ++gvi) {
+    writer->write_pointer(datagram, *gvi);
   }
 }
 
@@ -273,10 +273,16 @@ place(TexturePlacement *placement) {
   nassertr(placement->is_size_known(), true);
   nassertr(!placement->is_placed(), true);
 
+  if (!_occupancy.is_size(_x_size, _y_size)) {
+    rebuild_occupancy();
+  }
+
   int x, y;
-  if (find_hole(x, y, placement->get_x_size(), placement->get_y_size())) {
+  if (_occupancy.find_hole(x, y, placement->get_x_size(), placement->get_y_size())) {
     placement->place_at(this, x, y);
     _placements.push_back(placement);
+    _occupancy.add(x, y, placement->get_placed_x_size(),
+                   placement->get_placed_y_size());
 
     // [gjeon] create swappedImages
     TexturePlacement::TextureSwaps::iterator tsi;
@@ -305,6 +311,9 @@ unplace(TexturePlacement *placement) {
   pi = find(_placements.begin(), _placements.end(), placement);
   while (pi != _placements.end()) {
     _placements.erase(pi);
+    _occupancy.remove(placement->get_placed_x(), placement->get_placed_y(),
+                      placement->get_placed_x_size(),
+                      placement->get_placed_y_size());
     pi = find(_placements.begin(), _placements.end(), placement);
   }
   _cleared_regions.push_back(ClearedRegion(placement));
@@ -356,6 +365,10 @@ check_solitary() {
 
 /**
  * Attempts to resize the palette image to as small as it can go.
+ *
+ * Candidate sizes are tried by packing the textures into a scratch
+ * PaletteOccupancy, without disturbing the actual placements; only once the
+ * smallest size that works has been found are the textures repacked.
  */
 void PaletteImage::
 optimal_resize() {
@@ -363,36 +376,106 @@ optimal_resize() {
     return;
   }
 
-  bool resized_any = false;
+  nassertv(_x_size > 0 && _y_size > 0);
+
+  // The textures will be repacked from biggest to smallest, as an aid to
+  // optimal packing; resize_image() will do the same.
+  Placements sorted = _placements;
+  sort(sorted.begin(), sorted.end(), SortPlacementBySize());
+
+  // No size smaller than the total area of the textures, or narrower or
+  // shorter than the biggest texture, can possibly work.
+  PackBounds bounds;
+  bounds._area = 0;
+  bounds._x_size = 0;
+  bounds._y_size = 0;
+  Placements::const_iterator pi;
+  for (pi = sorted.begin(); pi != sorted.end(); ++pi) {
+    TexturePlacement *placement = (*pi);
+    bounds._area += (int64_t)placement->get_x_size() * (int64_t)placement->get_y_size();
+    bounds._x_size = std::max(bounds._x_size, placement->get_x_size());
+    bounds._y_size = std::max(bounds._y_size, placement->get_y_size());
+  }
+
+  // First, cut the image in half in each dimension, one at a time, for as
+  // long as everything still fits.
+  int x_size = _x_size;
+  int y_size = _y_size;
   bool success;
   do {
     success = false;
-    nassertv(_x_size > 0 && _y_size > 0);
-
-    // Try to cut it in half in both dimensions, one at a time.
-    if (resize_image(_x_size, _y_size / 2)) {
+    if (fits_at_size(x_size, y_size / 2, sorted, bounds)) {
+      y_size /= 2;
       success = true;
-      resized_any = true;
     }
-    if (resize_image(_x_size / 2, _y_size)) {
+    if (fits_at_size(x_size / 2, y_size, sorted, bounds)) {
+      x_size /= 2;
       success = true;
-      resized_any = true;
     }
-
   } while (success);
 
-  if (resized_any) {
-    nout << "Resizing "
-         << FilenameUnifier::make_user_filename(get_filename()) << " to "
-         << _x_size << " " << _y_size << "\n";
+  // Halving one dimension at a time can get stuck at a shape that is not
+  // the smallest; so also consider every other combination of halvings that
+  // would be smaller still.
+  int64_t best_area = (int64_t)x_size * (int64_t)y_size;
+  for (int xs = _x_size; xs >= bounds._x_size && xs > 0; xs /= 2) {
+    for (int ys = _y_size; ys >= bounds._y_size && ys > 0; ys /= 2) {
+      int64_t area = (int64_t)xs * (int64_t)ys;
+      if (area < best_area && fits_at_size(xs, ys, sorted, bounds)) {
+        x_size = xs;
+        y_size = ys;
+        best_area = area;
+      }
+    }
+  }
 
-    // [gjeon] resize swapped images, also
-    SwappedImages::iterator si;
-    for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
-      PaletteImage *swappedImage = (*si);
-      swappedImage->resize_swapped_image(_x_size, _y_size);
+  if (x_size == _x_size && y_size == _y_size) {
+    // It's already as small as it will go; leave it alone.
+    return;
+  }
+
+  bool resized = resize_image(x_size, y_size);
+  nassertv(resized);
+
+  nout << "Resizing "
+       << FilenameUnifier::make_user_filename(get_filename()) << " to "
+       << _x_size << " " << _y_size << "\n";
+
+  // [gjeon] resize swapped images, also
+  SwappedImages::iterator si;
+  for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
+    PaletteImage *swappedImage = (*si);
+    swappedImage->resize_swapped_image(_x_size, _y_size);
+  }
+}
+
+/**
+ * A support function for optimal_resize(), this returns true if the indicated
+ * textures, in the order given, would all fit on an image of the indicated
+ * size, as resize_image() would pack them.  Nothing is actually moved.
+ */
+bool PaletteImage::
+fits_at_size(int x_size, int y_size, const Placements &sorted,
+             const PackBounds &bounds) const {
+  if (x_size < bounds._x_size || y_size < bounds._y_size ||
+      (int64_t)x_size * (int64_t)y_size < bounds._area) {
+    return false;
+  }
+
+  PaletteOccupancy scratch;
+  scratch.reset(x_size, y_size);
+
+  Placements::const_iterator pi;
+  for (pi = sorted.begin(); pi != sorted.end(); ++pi) {
+    TexturePlacement *placement = (*pi);
+    int x, y;
+    if (!scratch.find_hole(x, y, placement->get_x_size(), placement->get_y_size())) {
+      return false;
     }
+    scratch.add(x, y, placement->get_x_size(), placement->get_y_size());
   }
+
+  return true;
 }
 
 /**
@@ -411,6 +494,10 @@ resize_image(int x_size, int y_size) {
   Placements saved;
   saved.swap(_placements);
 
+  // The occupancy index still marks the rectangles of the saved textures,
+  // which unplace() won't clear now that they are no longer in _placements.
+  rebuild_occupancy();
+
   // Also save our current size.
   int saved_x_size = _x_size;
   int saved_y_size = _y_size;
@@ -443,6 +530,7 @@ resize_image(int x_size, int y_size) {
 
     Placements remove;
     remove.swap(_placements);
+    rebuild_occupancy();
     for (pi = remove.begin(); pi != remove.end(); ++pi) {
       (*pi)->force_replace();
     }
@@ -503,6 +591,35 @@ reset_image() {
   remove_image();
 }
 
+/**
+ * Releases the image, and discards the swapped images, which are rebuilt as
+ * textures are placed; this leaves the PaletteImage as it would be if it had
+ * just been read from the state file.  This is in preparation for another
+ * session in the same process.
+ */
+void PaletteImage::
+reset_session() {
+  release_image();
+
+  SwappedImages::iterator si;
+  for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
+    delete (*si);
+  }
+  _swappedImages.clear();
+}
+
+/**
+ * Deletes the swapped images of this image, without removing their files.
+ */
+void PaletteImage::
+delete_contents() {
+  SwappedImages::iterator si;
+  for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
+    delete (*si);
+  }
+  _swappedImages.clear();
+}
+
 /**
  * Ensures the _shadow_image has the correct filename and image types, based
  * on what was supplied on the command line and in the .txa file.
@@ -526,11 +643,27 @@ setup_shadow_image() {
  */
 void PaletteImage::
 update_image(bool redo_all) {
+  if (prepare_update(redo_all)) {
+    generate_image();
+  }
+}
+
+/**
+ * The first half of update_image(), this determines whether the palette has
+ * changed since it was last written out, and updates the filenames of the
+ * image and its swapped images accordingly.  Returns true if generate_image()
+ * must now be called to write out a new image.
+ *
+ * This may delete files and mark egg files stale, so it must be called from
+ * the main thread, in the same order that update_image() would be.
+ */
+bool PaletteImage::
+prepare_update(bool redo_all) {
   if (is_empty() && pal->_aggressively_clean_mapdir) {
     // If the palette image is 'empty', ensure that it doesn't exist.  No need
     // to clutter up the map directory.
     remove_image();
-    return;
+    return false;
   }
 
   if (redo_all) {
@@ -558,6 +691,7 @@ update_image(bool redo_all) {
 
     } else {
       TextureImage *texture = placement->get_texture();
+      bool newer = false;
 
       // Only check the timestamps on textures that are named (indirectly) on
       // the command line.
@@ -566,10 +700,8 @@ update_image(bool redo_all) {
 
         if (source != nullptr &&
             source->get_filename().compare_timestamps(get_filename()) > 0) {
-          // The source image is newer than the palette image; we need to
-          // regenerate.
-          placement->mark_unfilled();
-          needs_update = true;
+          // The source image is newer than the palette image.
+          newer = true;
         }
       }
 
@@ -583,22 +715,62 @@ update_image(bool redo_all) {
 
           if (sourceSwapTexture != nullptr &&
               sourceSwapTexture->get_filename().compare_timestamps(get_filename()) > 0) {
-            // The source image is newer than the palette image; we need to
-            // regenerate.
-            placement->mark_unfilled();
-            needs_update = true;
+            // The source image is newer than the palette image.
+            newer = true;
           }
         }
       }
 
+      // A newer timestamp doesn't mean much if the file contents are the
+      // same as they were when we last filled the texture, as when the
+      // source tree was freshly checked out.
+      if (newer && !placement->is_fill_unchanged()) {
+        // We need to regenerate.
+        placement->mark_unfilled();
+        needs_update = true;
+      }
     }
   }
 
   if (!needs_update) {
     // No sweat; nothing has changed.
-    return;
+    return false;
+  }
+
+  // Remember what we are about to fill each texture with, so that we can
+  // tell next time whether it has really changed.
+  for (pi = _placements.begin(); pi != _placements.end(); ++pi) {
+    if (!(*pi)->is_filled()) {
+      (*pi)->record_fill_hash();
+    }
+  }
+
+  // [gjeon] If any textures are to be refilled, check the filenames of the
+  // swapped images too.
+  for (pi = _placements.begin(); pi != _placements.end(); ++pi) {
+    if (!(*pi)->is_filled()) {
+      SwappedImages::iterator si;
+      for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
+        PaletteImage *swappedImage = (*si);
+        swappedImage->update_filename();
+      }
+      break;
+    }
   }
 
+  return true;
+}
+
+/**
+ * The second half of update_image(), this fills in the palette image (and its
+ * swapped images) with whatever has changed, and writes them out.  It should
+ * only be called after prepare_update() has returned true.
+ *
+ * This touches nothing but this image, its swapped images, and the
+ * placements on it, so different PaletteImages may be generated in parallel.
+ */
+void PaletteImage::
+generate_image() {
   get_image();
   // [gjeon] get swapped images, too
   get_swapped_images();
@@ -619,6 +791,7 @@ update_image(bool redo_all) {
   _cleared_regions.clear();
 
   // Now add the recent additions to the image.
+  Placements::iterator pi;
   for (pi = _placements.begin(); pi != _placements.end(); ++pi) {
     TexturePlacement *placement = (*pi);
     if (!placement->is_filled()) {
@@ -627,9 +800,7 @@ update_image(bool redo_all) {
       // [gjeon] fill swapped images
       SwappedImages::iterator si;
       for (si = _swappedImages.begin(); si != _swappedImages.end(); ++si) {
-        PaletteImage *swappedImage = (*si);
-        swappedImage->update_filename();
-        placement->fill_swapped_image(swappedImage->_image, si - _swappedImages.begin());
+        placement->fill_swapped_image((*si)->_image, si - _swappedImages.begin());
       }
     }
   }
@@ -777,59 +948,23 @@ setup_filename() {
 }
 
 /**
- * Searches for a hole of at least x_size by y_size pixels somewhere within
- * the PaletteImage.  If a suitable hole is found, sets x and y to the top
- * left corner and returns true; otherwise, returns false.
+ * Resets the occupancy index to the current size of the image and fills it in
+ * with the rectangles of all of the textures placed so far, in the order in
+ * which they were placed.
  */
-bool PaletteImage::
-find_hole(int &x, int &y, int x_size, int y_size) const {
-  y = 0;
-  while (y + y_size <= _y_size) {
-    int next_y = _y_size;
-    // Scan along the row at 'y'.
-    x = 0;
-    while (x + x_size <= _x_size) {
-      // Consider the spot at x, y.
-      TexturePlacement *overlap = find_overlap(x, y, x_size, y_size);
-
-      if (overlap == nullptr) {
-        // Hooray!
-        return true;
-      }
-
-      int next_x = overlap->get_placed_x() + overlap->get_placed_x_size();
-      next_y = std::min(next_y, overlap->get_placed_y() + overlap->get_placed_y_size());
-      nassertr(next_x > x, false);
-      x = next_x;
-    }
-
-    nassertr(next_y > y, false);
-    y = next_y;
-  }
-
-  // Nope, wouldn't fit anywhere.
-  return false;
-}
+void PaletteImage::
+rebuild_occupancy() {
+  _occupancy.reset(_x_size, _y_size);
 
-/**
- * If the rectangle whose top left corner is x, y and whose size is x_size,
- * y_size describes an empty hole that does not overlap any placed images,
- * returns NULL; otherwise, returns the first placed texture that the image
- * does overlap.  It is assumed the rectangle lies completely within the
- * boundaries of the image itself.
- */
-TexturePlacement *PaletteImage::
-find_overlap(int x, int y, int x_size, int y_size) const {
   Placements::const_iterator pi;
   for (pi = _placements.begin(); pi != _placements.end(); ++pi) {
     TexturePlacement *placement = (*pi);
-    if (placement->is_placed() &&
-        placement->intersects(x, y, x_size, y_size)) {
-      return placement;
+    if (placement->is_placed()) {
+      _occupancy.add(placement->get_placed_x(), placement->get_placed_y(),
+                     placement->get_placed_x_size(),
+                     placement->get_placed_y_size());
     }
   }
-
-  return nullptr;
 }
 
 /**
@@ -871,10 +1006,12 @@ get_image() {
   _new_image = false;
   _got_image = true;
 
-  // Now fill up the image.
+  // Now fill up the image.  Every placement is being filled anew, so each one
+  // records its fill hash, not just the ones prepare_update() found unfilled.
   Placements::iterator pi;
   for (pi = _placements.begin(); pi != _placements.end(); ++pi) {
     TexturePlacement *placement = (*pi);
+    placement->record_fill_hash();
     placement->fill_image(_image);
   }
 }
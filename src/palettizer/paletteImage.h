@@ -17,6 +17,7 @@
 #include "pandatoolbase.h"
 
 #include "imageFile.h"
+#include "paletteOccupancy.h"
 
 #include "pnmImage.h"
 
@@ -53,15 +54,30 @@ public:
 
   void write_placements(std::ostream &out, int indent_level = 0) const;
   void reset_image();
+  void reset_session();
+  void delete_contents();
   void setup_shadow_image();
   void update_image(bool redo_all);
+  bool prepare_update(bool redo_all);
+  void generate_image();
 
   bool update_filename();
 
 private:
+  typedef pvector<TexturePlacement *> Placements;
+
+  // Limits, derived from a set of textures, on the smallest image that could
+  // possibly hold them all.
+  class PackBounds {
+  public:
+    int64_t _area;
+    int _x_size, _y_size;
+  };
+
+  bool fits_at_size(int x_size, int y_size, const Placements &sorted,
+                    const PackBounds &bounds) const;
   bool setup_filename();
-  bool find_hole(int &x, int &y, int x_size, int y_size) const;
-  TexturePlacement *find_overlap(int x, int y, int x_size, int y_size) const;
+  void rebuild_occupancy();
   void get_image();
   void release_image();
   void remove_image();
@@ -89,11 +105,14 @@ private:
   typedef pvector<ClearedRegion> ClearedRegions;
   ClearedRegions _cleared_regions;
 
-  typedef pvector<TexturePlacement *> Placements;
   Placements _placements;
 
   Placements *_masterPlacements;
 
+  // This indexes the rectangles occupied by _placements, for finding holes.
+  // It is rebuilt on demand, e.g.  after reading from a bam file or resizing.
+  PaletteOccupancy _occupancy;
+
   PalettePage *_page;
   int _index;
   std::string _basename;
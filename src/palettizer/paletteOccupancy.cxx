@@ -0,0 +1,227 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file paletteOccupancy.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "paletteOccupancy.h"
+
+#include <algorithm>
+
+/**
+ *
+ */
+PaletteOccupancy::
+PaletteOccupancy() {
+  _x_size = 0;
+  _y_size = 0;
+  _x_cells = 0;
+  _y_cells = 0;
+  _next_seq = 0;
+  _resume_valid = false;
+}
+
+/**
+ * Empties the index and sets it up to cover an image of the indicated size.
+ */
+void PaletteOccupancy::
+reset(int x_size, int y_size) {
+  _x_size = x_size;
+  _y_size = y_size;
+  _x_cells = std::max((x_size + cell_size - 1) / cell_size, 1);
+  _y_cells = std::max((y_size + cell_size - 1) / cell_size, 1);
+  _next_seq = 0;
+  _resume_valid = false;
+
+  _cells.clear();
+  _cells.resize(_x_cells * _y_cells);
+}
+
+/**
+ * Returns true if the index has been set up to cover an image of the
+ * indicated size, false if it needs to be reset() and refilled first.
+ */
+bool PaletteOccupancy::
+is_size(int x_size, int y_size) const {
+  return !_cells.empty() && _x_size == x_size && _y_size == y_size;
+}
+
+/**
+ * Records the indicated rectangle as occupied.  Rectangles added later are
+ * considered to follow all of the rectangles added before them.
+ */
+void PaletteOccupancy::
+add(int x, int y, int x_size, int y_size) {
+  nassertv(!_cells.empty());
+
+  Rect rect;
+  rect._seq = _next_seq++;
+  rect._x = x;
+  rect._y = y;
+  rect._x_size = x_size;
+  rect._y_size = y_size;
+
+  int cx0 = std::max(x / cell_size, 0);
+  int cy0 = std::max(y / cell_size, 0);
+  int cx1 = std::min((x + x_size - 1) / cell_size, _x_cells - 1);
+  int cy1 = std::min((y + y_size - 1) / cell_size, _y_cells - 1);
+
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      _cells[cy * _x_cells + cx].push_back(rect);
+    }
+  }
+}
+
+/**
+ * Removes a rectangle previously recorded by add().  Since no two placed
+ * rectangles may overlap, the rectangle's position and size are enough to
+ * identify it.
+ */
+void PaletteOccupancy::
+remove(int x, int y, int x_size, int y_size) {
+  if (_cells.empty()) {
+    return;
+  }
+
+  // Opening up a hole invalidates anything we learned in a previous search.
+  _resume_valid = false;
+
+  int cx0 = std::max(x / cell_size, 0);
+  int cy0 = std::max(y / cell_size, 0);
+  int cx1 = std::min((x + x_size - 1) / cell_size, _x_cells - 1);
+  int cy1 = std::min((y + y_size - 1) / cell_size, _y_cells - 1);
+
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      Cell &cell = _cells[cy * _x_cells + cx];
+      Cell::iterator ri;
+      for (ri = cell.begin(); ri != cell.end(); ++ri) {
+        if ((*ri)._x == x && (*ri)._y == y &&
+            (*ri)._x_size == x_size && (*ri)._y_size == y_size) {
+          cell.erase(ri);
+          break;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Searches for a hole of at least x_size by y_size pixels somewhere within
+ * the image.  If a suitable hole is found, sets x and y to the top left
+ * corner and returns true; otherwise, returns false.
+ *
+ * This visits candidate positions in the same order, and skips past the same
+ * overlapping rectangles, as PaletteImage has always done, so the result is
+ * the same; it merely avoids repeating work it has already done.
+ */
+bool PaletteOccupancy::
+find_hole(int &x, int &y, int x_size, int y_size) const {
+  y = 0;
+  x = 0;
+  int next_y = _y_size;
+
+  if (_resume_valid &&
+      _resume_x_size == x_size && _resume_y_size == y_size) {
+    if (!_resume_found) {
+      // It didn't fit last time, and there's no more room now.
+      return false;
+    }
+    // Pick up where the last search for this size succeeded.
+    x = _resume_x;
+    y = _resume_y;
+    next_y = _resume_next_y;
+  }
+
+  _resume_valid = true;
+  _resume_found = false;
+  _resume_x_size = x_size;
+  _resume_y_size = y_size;
+
+  while (y + y_size <= _y_size) {
+    // Scan along the row at 'y'.
+    while (x + x_size <= _x_size) {
+      // Consider the spot at x, y.
+      const Rect *overlap = find_overlap(x, y, x_size, y_size);
+
+      if (overlap == nullptr) {
+        // Hooray!
+        _resume_found = true;
+        _resume_x = x;
+        _resume_y = y;
+        _resume_next_y = next_y;
+        return true;
+      }
+
+      int next_x = overlap->_x + overlap->_x_size;
+      next_y = std::min(next_y, overlap->_y + overlap->_y_size);
+      nassertr(next_x > x, false);
+      x = next_x;
+    }
+
+    nassertr(next_y > y, false);
+    y = next_y;
+    x = 0;
+    next_y = _y_size;
+  }
+
+  // Nope, wouldn't fit anywhere.
+  return false;
+}
+
+/**
+ * If the rectangle whose top left corner is x, y and whose size is x_size,
+ * y_size does not overlap any occupied rectangle, returns NULL; otherwise,
+ * returns the earliest-added rectangle that it does overlap.
+ */
+const PaletteOccupancy::Rect *PaletteOccupancy::
+find_overlap(int x, int y, int x_size, int y_size) const {
+  if (_cells.empty()) {
+    return nullptr;
+  }
+
+  int cx0 = std::max(x / cell_size, 0);
+  int cy0 = std::max(y / cell_size, 0);
+  int cx1 = std::min((x + x_size - 1) / cell_size, _x_cells - 1);
+  int cy1 = std::min((y + y_size - 1) / cell_size, _y_cells - 1);
+
+  const Rect *best = nullptr;
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      const Cell &cell = _cells[cy * _x_cells + cx];
+      Cell::const_iterator ri;
+      for (ri = cell.begin(); ri != cell.end(); ++ri) {
+        const Rect &rect = (*ri);
+        if (best != nullptr && rect._seq >= best->_seq) {
+          // The cell is sorted by _seq, so nothing further along in it can
+          // beat what we already have.
+          break;
+        }
+        if (rect.intersects(x, y, x_size, y_size)) {
+          best = &rect;
+          break;
+        }
+      }
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Returns true if this rectangle overlaps the rectangle whose top left corner
+ * is x, y and whose size is x_size, y_size.
+ */
+bool PaletteOccupancy::Rect::
+intersects(int x, int y, int x_size, int y_size) const {
+  return !(x >= _x + _x_size || x + x_size <= _x ||
+           y >= _y + _y_size || y + y_size <= _y);
+}
@@ -0,0 +1,80 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file paletteOccupancy.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef PALETTEOCCUPANCY_H
+#define PALETTEOCCUPANCY_H
+
+#include "pandatoolbase.h"
+
+#include "pvector.h"
+
+/**
+ * This is a spatial index of the rectangles that have been placed on a
+ * PaletteImage.  The image is divided into a coarse grid of cells, and each
+ * cell lists the rectangles that touch it, so that searching for a hole need
+ * only consider the rectangles near each candidate position rather than every
+ * texture on the palette.
+ *
+ * Each rectangle is stamped with the order in which it was added, and
+ * find_overlap() always reports the earliest-added rectangle that overlaps,
+ * so find_hole() arrives at exactly the same position that a linear walk
+ * through the placement list would have found.
+ */
+class PaletteOccupancy {
+public:
+  PaletteOccupancy();
+
+  void reset(int x_size, int y_size);
+  bool is_size(int x_size, int y_size) const;
+
+  void add(int x, int y, int x_size, int y_size);
+  void remove(int x, int y, int x_size, int y_size);
+
+  bool find_hole(int &x, int &y, int x_size, int y_size) const;
+
+private:
+  class Rect {
+  public:
+    bool intersects(int x, int y, int x_size, int y_size) const;
+
+    unsigned int _seq;
+    int _x, _y;
+    int _x_size, _y_size;
+  };
+
+  const Rect *find_overlap(int x, int y, int x_size, int y_size) const;
+
+  // Each cell lists its rectangles in increasing order of _seq.
+  typedef pvector<Rect> Cell;
+  typedef pvector<Cell> Cells;
+  Cells _cells;
+
+  int _x_size, _y_size;
+  int _x_cells, _y_cells;
+  unsigned int _next_seq;
+
+  // These record where the last call to find_hole() left off.  As long as
+  // rectangles are only added, the earliest overlap at each position it
+  // already passed over is unchanged, so a search for another hole of the
+  // same size may resume from there instead of starting over at the top.
+  mutable bool _resume_valid;
+  mutable bool _resume_found;
+  mutable int _resume_x_size, _resume_y_size;
+  mutable int _resume_x, _resume_y;
+  mutable int _resume_next_y;
+
+  // The size in pixels of each (square) cell of the grid.
+  static const int cell_size = 32;
+};
+
+#endif
@@ -182,6 +182,33 @@ reset_images() {
   _images.clear();
 }
 
+/**
+ * Forgets the textures assigned this session, and releases the images, in
+ * preparation for another session in the same process.
+ */
+void PalettePage::
+reset_session() {
+  _assigned.clear();
+
+  Images::iterator ii;
+  for (ii = _images.begin(); ii != _images.end(); ++ii) {
+    (*ii)->reset_session();
+  }
+}
+
+/**
+ * Deletes the images of this page, without removing their files.
+ */
+void PalettePage::
+delete_contents() {
+  Images::iterator ii;
+  for (ii = _images.begin(); ii != _images.end(); ++ii) {
+    (*ii)->delete_contents();
+    delete (*ii);
+  }
+  _images.clear();
+}
+
 /**
  * Ensures that each PaletteImage's _shadow_image has the correct filename and
  * image types, based on what was supplied on the command line and in the .txa
@@ -208,6 +235,22 @@ update_images(bool redo_all) {
   }
 }
 
+/**
+ * Calls PaletteImage::prepare_update() on each PaletteImage on this page, and
+ * appends the ones that need to be regenerated to the indicated list.  This
+ * is the first half of update_images().
+ */
+void PalettePage::
+prepare_images(bool redo_all, pvector<PaletteImage *> &images) {
+  Images::iterator ii;
+  for (ii = _images.begin(); ii != _images.end(); ++ii) {
+    PaletteImage *image = (*ii);
+    if (image->prepare_update(redo_all)) {
+      images.push_back(image);
+    }
+  }
+}
+
 /**
  * Registers the current object as something that can be read from a Bam file.
  */
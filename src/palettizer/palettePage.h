@@ -48,8 +48,11 @@ public:
   void write_image_info(std::ostream &out, int indent_level = 0) const;
   void optimal_resize();
   void reset_images();
+  void reset_session();
+  void delete_contents();
   void setup_shadow_images();
   void update_images(bool redo_all);
+  void prepare_images(bool redo_all, pvector<PaletteImage *> &images);
 
 private:
   PaletteGroup *_group;
@@ -94,6 +97,8 @@ public:
 
 private:
   static TypeHandle _type_handle;
+
+  friend class PaletteGroup;
 };
 
 #endif
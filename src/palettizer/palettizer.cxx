@@ -18,6 +18,10 @@
 #include "paletteGroup.h"
 #include "filenameUnifier.h"
 #include "textureMemoryCounter.h"
+#include "paletteImage.h"
+#include "paletteGroups.h"
+#include "sourceTextureImage.h"
+#include "texturePlacement.h"
 
 #include "pnmImage.h"
 #include "pnmFileTypeRegistry.h"
@@ -27,7 +31,13 @@
 #include "datagramIterator.h"
 #include "bamReader.h"
 #include "bamWriter.h"
+#include "bamFile.h"
+#include "virtualFileSystem.h"
 #include "indent.h"
+#include "threadManager.h"
+
+#include <algorithm>
+#include <sstream>
 
 using std::cout;
 using std::string;
@@ -39,7 +49,7 @@ Palettizer *pal = nullptr;
 // update egg-palettize to write out additional information to its pi file,
 // without having it increment the bam version number for all bam and boo
 // files anywhere in the world.
-int Palettizer::_pi_version = 22;
+int Palettizer::_pi_version = 25;
 /*
  * Updated to version 8 on 32003 to remove extensions from texture key names.
  * Updated to version 9 on 41303 to add a few properties in various places.
@@ -56,6 +66,9 @@ int Palettizer::_pi_version = 22;
  * Updated to version 20 on 72709 to add TexturePlacement::_swapTextures.
  * Updated to version 21 on 110120 to add sRGB support.
  * Updated to version 22 on 121521 to support per-group sizes.
+ * Updated to version 23 on 101726 to add content hashes of the source images.
+ * Updated to version 24 on 101726 to add TextureImage::_txa_resize_filter.
+ * Updated to version 25 on 101726 to add the sharded state layout.
  */
 
 int Palettizer::_min_pi_version = 8;
@@ -63,6 +76,9 @@ int Palettizer::_min_pi_version = 8;
 
 int Palettizer::_read_pi_version = 0;
 
+Palettizer::StatePart Palettizer::_write_state_part = Palettizer::SP_whole;
+Palettizer::StatePart Palettizer::_read_state_part = Palettizer::SP_whole;
+
 TypeHandle Palettizer::_type_handle;
 
 std::ostream &operator << (std::ostream &out, Palettizer::RemapUV remap) {
@@ -110,6 +126,10 @@ Palettizer::
 Palettizer() {
   _is_valid = true;
   _noabs = false;
+  _num_threads = 1;
+  _prefetch_budget = 256 * 1024 * 1024;
+  _name_conflict = false;
+  _load_failed = false;
 
   _generated_image_pattern = "%g_palette_%p_%i";
   _map_dirname = "%g";
@@ -134,6 +154,7 @@ Palettizer() {
   _round_fuzz = 0.01;
   _remap_uv = RU_poly;
   _remap_char_uv = RU_poly;
+  _shard_state = false;
 
   get_palette_group("null");
 }
@@ -349,9 +370,10 @@ report_statistics() const {
 
 /**
  * Reads in the .txa file and keeps it ready for matching textures and egg
- * files.
+ * files.  Returns true if successful, or false if there was an error in the
+ * file.
  */
-void Palettizer::
+bool Palettizer::
 read_txa_file(std::istream &txa_file, const string &txa_filename) {
   // Clear out the group dependencies, in preparation for reading them again
   // from the .txa file.
@@ -366,14 +388,17 @@ read_txa_file(std::istream &txa_file, const string &txa_filename) {
   _shadow_color_type = nullptr;
   _shadow_alpha_type = nullptr;
 
+  // Start from an empty TxaFile, since this may be called once per session
+  // on a resident Palettizer.
+  _txa_file = TxaFile();
   if (!_txa_file.read(txa_file, txa_filename)) {
-    exit(1);
+    return false;
   }
 
   if (_color_type == nullptr) {
     nout << "No valid output image file type available; cannot run.\n"
          << "Use :imagetype command in .txa file.\n";
-    exit(1);
+    return false;
   }
 
   // Compute the correct dependency level and order for each group.  This will
@@ -398,6 +423,8 @@ read_txa_file(std::istream &txa_file, const string &txa_filename) {
       }
     }
   } while (any_changed);
+
+  return true;
 }
 
 /**
@@ -414,6 +441,72 @@ all_params_set() {
   }
 }
 
+/**
+ * Resets everything that is specific to one session, leaving the Palettizer
+ * as it would be if it had just been read from the state file.  This must be
+ * called before each session after the first when the same Palettizer is
+ * kept resident in one process, as by egg-palettize -server.
+ */
+void Palettizer::
+begin_session() {
+  _command_line_eggs.clear();
+  _command_line_textures.clear();
+  _name_conflict = false;
+  _load_failed = false;
+
+  EggFiles::iterator efi;
+  for (efi = _egg_files.begin(); efi != _egg_files.end(); ++efi) {
+    (*efi).second->reset_session();
+  }
+
+  Groups::iterator gi;
+  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+    (*gi).second->reset_session();
+  }
+
+  Textures::iterator ti;
+  for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
+    (*ti).second->reset_session();
+  }
+}
+
+/**
+ * Deletes all of the egg files, textures and groups of this Palettizer, and
+ * everything they own, so that the Palettizer itself may then be deleted.
+ * This does not touch any files on disk.
+ *
+ * The objects refer to one another, and some of them detach themselves from
+ * the others as they are deleted, so the order matters: the egg files'
+ * TextureReferences go first, then the textures with their placements, and
+ * the groups with their pages and images last.
+ */
+void Palettizer::
+delete_contents() {
+  _command_line_eggs.clear();
+  _command_line_textures.clear();
+
+  EggFiles::iterator efi;
+  for (efi = _egg_files.begin(); efi != _egg_files.end(); ++efi) {
+    (*efi).second->delete_contents();
+    delete (*efi).second;
+  }
+  _egg_files.clear();
+
+  Textures::iterator ti;
+  for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
+    (*ti).second->delete_contents();
+    delete (*ti).second;
+  }
+  _textures.clear();
+
+  Groups::iterator gi;
+  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+    (*gi).second->delete_contents();
+    delete (*gi).second;
+  }
+  _groups.clear();
+}
+
 /**
  * Processes all the textures named in the _command_line_eggs, placing them on
  * the appropriate palettes or whatever needs to be done with them.
@@ -432,7 +525,11 @@ process_command_line_eggs(bool force_texture_read, const Filename &state_filenam
        ++ei) {
     EggFile *egg_file = (*ei);
 
-    egg_file->scan_textures();
+    if (!egg_file->scan_textures()) {
+      // A texture name conflict or an unreadable shard; _name_conflict or
+      // _load_failed is now set.
+      return;
+    }
     egg_file->get_textures(_command_line_textures);
 
     egg_file->pre_txa_file();
@@ -440,6 +537,20 @@ process_command_line_eggs(bool force_texture_read, const Filename &state_filenam
     egg_file->post_txa_file();
   }
 
+  // If the state is sharded, the groups these textures are placed in must be
+  // read before the textures are matched against the .txa file, which may
+  // change their placements.
+  PaletteGroups texture_groups;
+  CommandLineTextures::const_iterator cti;
+  for (cti = _command_line_textures.begin();
+       cti != _command_line_textures.end();
+       ++cti) {
+    texture_groups.make_union(texture_groups, (*cti)->get_groups());
+  }
+  if (!load_groups(texture_groups)) {
+    return;
+  }
+
   // Now that all of our egg files are read in, build in all the cross links
   // and back pointers and stuff.
   EggFiles::const_iterator efi;
@@ -449,27 +560,50 @@ process_command_line_eggs(bool force_texture_read, const Filename &state_filenam
 
   // Now match each of the textures mentioned in those egg files against a
   // line in the .txa file.
-  CommandLineTextures::iterator ti;
-  for (ti = _command_line_textures.begin();
-       ti != _command_line_textures.end();
-       ++ti) {
-    TextureImage *texture = *ti;
-
-    if (force_texture_read || texture->is_newer_than(state_filename)) {
-      // If we're forcing a redo, or the texture image has changed, re-read
-      // the complete image.
-      texture->read_source_image();
-    } else {
-      // Otherwise, just the header is sufficient.
-      texture->read_header();
+  TextureList textures(_command_line_textures.begin(),
+                       _command_line_textures.end());
+  pvector<size_t> image_bytes;
+  if (_num_threads > 1) {
+    prefetch_headers(textures, force_texture_read, state_filename, image_bytes);
+  }
+
+  size_t i = 0;
+  while (i < textures.size()) {
+    size_t end = textures.size();
+    if (_num_threads > 1) {
+      // Decode as many of the upcoming source images in parallel as our
+      // memory budget allows.  The loop below then finds them already read.
+      end = prefetch_images(textures, image_bytes, i);
     }
 
-    texture->mark_texture_named();
-    texture->pre_txa_file();
-    _txa_file.match_texture(texture);
-    texture->post_txa_file();
+    for (; i < end; ++i) {
+      TextureImage *texture = textures[i];
+
+      if (force_texture_read || texture->is_newer_than(state_filename)) {
+        // If we're forcing a redo, or the texture image has changed, re-read
+        // the complete image.
+        texture->read_source_image();
+      } else {
+        // Otherwise, just the header is sufficient.
+        texture->read_header();
+      }
+
+      texture->mark_texture_named();
+      texture->pre_txa_file();
+      _txa_file.match_texture(texture);
+      texture->post_txa_file();
+
+      if (_num_threads > 1) {
+        // Let go of the image, as process_all() does, so that no more than
+        // the readahead budget is held at once.  It is read again when the
+        // texture is copied onto its palette.
+        texture->release_source_image();
+      }
+    }
   }
 
+  CommandLineTextures::iterator ti;
+
   // And now, assign each of the current set of textures to an appropriate
   // group or groups.
   for (ti = _command_line_textures.begin();
@@ -478,6 +612,9 @@ process_command_line_eggs(bool force_texture_read, const Filename &state_filenam
     TextureImage *texture = *ti;
     texture->assign_groups();
   }
+  if (_load_failed) {
+    return;
+  }
 
   // And then the egg files need to sign up for a particular TexturePlacement,
   // so we can determine some more properties about how the textures are
@@ -530,7 +667,11 @@ process_all(bool force_texture_read, const Filename &state_filename) {
        ++ei) {
     EggFile *egg_file = (*ei);
 
-    egg_file->scan_textures();
+    if (!egg_file->scan_textures()) {
+      // A texture name conflict or an unreadable shard; _name_conflict or
+      // _load_failed is now set.
+      return;
+    }
     egg_file->get_textures(_command_line_textures);
   }
 
@@ -555,19 +696,40 @@ process_all(bool force_texture_read, const Filename &state_filename) {
 
   // Now match each of the textures in the world against a line in the .txa
   // file.
+  TextureList textures;
+  textures.reserve(_textures.size());
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
-    TextureImage *texture = (*ti).second;
-    if (force_texture_read || texture->is_newer_than(state_filename)) {
-      texture->read_source_image();
+    textures.push_back((*ti).second);
+  }
+  pvector<size_t> image_bytes;
+  if (_num_threads > 1) {
+    prefetch_headers(textures, force_texture_read, state_filename, image_bytes);
+  }
+
+  size_t i = 0;
+  while (i < textures.size()) {
+    size_t end = textures.size();
+    if (_num_threads > 1) {
+      // Decode as many of the upcoming source images in parallel as our
+      // memory budget allows.  The loop below then finds them already read,
+      // and releases each one again as soon as it is done with it.
+      end = prefetch_images(textures, image_bytes, i);
     }
 
-    texture->mark_texture_named();
-    texture->pre_txa_file();
-    _txa_file.match_texture(texture);
-    texture->post_txa_file();
+    for (; i < end; ++i) {
+      TextureImage *texture = textures[i];
+      if (force_texture_read || texture->is_newer_than(state_filename)) {
+        texture->read_source_image();
+      }
 
-    // We need to do this to avoid bloating memory.
-    texture->release_source_image();
+      texture->mark_texture_named();
+      texture->pre_txa_file();
+      _txa_file.match_texture(texture);
+      texture->post_txa_file();
+
+      // We need to do this to avoid bloating memory.
+      texture->release_source_image();
+    }
   }
 
   // And now, assign each texture to an appropriate group or groups.
@@ -601,6 +763,118 @@ process_all(bool force_texture_read, const Filename &state_filename) {
   }
 }
 
+/**
+ * A support function for process_all() and process_command_line_eggs(), this
+ * determines, using _num_threads threads, which of the indicated textures
+ * will need their complete source image read: those that are newer than the
+ * state file, or all of them if force_texture_read is true.  The rest are
+ * left alone, since their sizes are already known from the state file.
+ *
+ * On return, image_bytes is filled in with the approximate number of bytes
+ * each texture's source image will occupy once it is read, or 0 if it will
+ * not be read.
+ */
+void Palettizer::
+prefetch_headers(const TextureList &textures, bool force_texture_read,
+                 const Filename &state_filename,
+                 pvector<size_t> &image_bytes) {
+  image_bytes.assign(textures.size(), 0);
+  if (textures.empty()) {
+    return;
+  }
+
+  ThreadManager::_num_threads = _num_threads;
+  ThreadManager::run_threads_on_individual("ReadTextureHeaders", (int)textures.size(), false,
+                                           [&](int i) {
+    // Each texture has its own set of source images, so examining different
+    // textures at the same time is safe.
+    TextureImage *texture = textures[i];
+    if (force_texture_read || texture->is_newer_than(state_filename)) {
+      SourceTextureImage *source = texture->get_preferred_source();
+      if (source != nullptr && source->get_size()) {
+        image_bytes[i] = (size_t)source->get_x_size() * (size_t)source->get_y_size() *
+          (sizeof(xel) + sizeof(xelval));
+      }
+    }
+  });
+}
+
+/**
+ * A support function for process_all() and process_command_line_eggs(), this
+ * reads, using _num_threads threads, the complete source images of the
+ * textures beginning at index begin that were flagged by prefetch_headers(),
+ * stopping before the total would exceed _prefetch_budget.  At least one
+ * texture is always included.
+ *
+ * Returns the index just past the last texture considered; the caller should
+ * process the textures up to that point before calling this again.
+ */
+size_t Palettizer::
+prefetch_images(const TextureList &textures,
+                const pvector<size_t> &image_bytes, size_t begin) {
+  size_t end = begin;
+  size_t total_bytes = 0;
+  while (end < textures.size() &&
+         (end == begin || total_bytes + image_bytes[end] <= _prefetch_budget)) {
+    total_bytes += image_bytes[end];
+    ++end;
+  }
+
+  TextureList to_read;
+  for (size_t i = begin; i < end; ++i) {
+    if (image_bytes[i] != 0) {
+      to_read.push_back(textures[i]);
+    }
+  }
+
+  if (!to_read.empty()) {
+    ThreadManager::_num_threads = _num_threads;
+    ThreadManager::run_threads_on_individual("ReadTextureImages", (int)to_read.size(), false,
+                                             [&to_read](int i) {
+      to_read[i]->read_source_image();
+    });
+  }
+
+  return end;
+}
+
+/**
+ * A support function for read_stale_eggs(), this reads in each of the
+ * indicated egg files, using _num_threads threads.  On return, read_ok is
+ * filled in with nonzero for each file that was read successfully.  The
+ * messages about each file are reported in the order of egg_files.
+ */
+void Palettizer::
+read_egg_files(const EggFileList &egg_files, pvector<int> &read_ok) {
+  read_ok.assign(egg_files.size(), false);
+
+  // Each egg file is read into its own egg data, so reading different egg
+  // files at the same time is safe.  The parsing itself, including that of
+  // any externals, is serialized by the egg loader's global lock; what
+  // overlaps is the rest of EggFile::read_egg(), mainly resolving the
+  // texture filenames.
+  pvector<std::string> messages(egg_files.size());
+  auto read_one = [&](int i) {
+    std::ostringstream out;
+    read_ok[i] = egg_files[i]->read_egg(_noabs, out);
+    messages[i] = out.str();
+  };
+
+  if (_num_threads > 1 && egg_files.size() > 1) {
+    ThreadManager::_num_threads = _num_threads;
+    ThreadManager::run_threads_on_individual("ReadEggs", (int)egg_files.size(), false,
+                                             read_one);
+    for (size_t i = 0; i < egg_files.size(); ++i) {
+      nout << messages[i];
+    }
+  } else {
+    for (size_t i = 0; i < egg_files.size(); ++i) {
+      read_one((int)i);
+      nout << messages[i];
+    }
+  }
+}
+
 /**
  * Attempts to resize each PalettteImage down to its smallest possible size.
  */
@@ -630,19 +904,47 @@ reset_images() {
  * Actually generates the appropriate palette and unplaced texture images into
  * the map directories.  If redo_all is true, this forces a regeneration of
  * each image file.
+ *
+ * If _num_threads is greater than 1, the palette images are filled and
+ * written in parallel.
  */
 void Palettizer::
 generate_images(bool redo_all) {
   Groups::iterator gi;
-  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
-    PaletteGroup *group = (*gi).second;
-    group->update_images(redo_all);
+  if (_num_threads > 1) {
+    // First decide which palette images need to be regenerated.  This may
+    // rename image files and mark egg files stale, so we do it on the main
+    // thread, in the same order as the serial path.
+    pvector<PaletteImage *> images;
+    for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+      PaletteGroup *group = (*gi).second;
+      group->prepare_images(redo_all, images);
+    }
+
+    // Each palette image is independent of the others, so they can all be
+    // filled in and written out at the same time.
+    if (!images.empty()) {
+      ThreadManager::_num_threads = _num_threads;
+      ThreadManager::run_threads_on_individual("GeneratePalettes", (int)images.size(), false,
+                                               [&images](int i) { images[i]->generate_image(); });
+    }
+
+  } else {
+    for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+      PaletteGroup *group = (*gi).second;
+      group->update_images(redo_all);
+    }
   }
 
   Textures::iterator ti;
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
     TextureImage *texture = (*ti).second;
-    texture->copy_unplaced(redo_all);
+
+    // A texture whose placements are still in unread shards has not changed
+    // this session, and neither have its copies.
+    if (texture->is_resident()) {
+      texture->copy_unplaced(redo_all);
+    }
   }
 }
 
@@ -652,12 +954,17 @@ generate_images(bool redo_all) {
  * write_eggs() is called.  If redo_all is true, this even reads egg files
  * that were not flagged as stale.
  *
+ * If _num_threads is greater than 1, the egg files are read that many at a
+ * time, as described in read_egg_files(); each is scanned and released again
+ * before the next batch is read.
+ *
  * Returns true if successful, or false if there was some error.
  */
 bool Palettizer::
 read_stale_eggs(bool redo_all) {
   bool okflag = true;
 
+  pvector<EggFiles::iterator> stale_eggs;
   pvector<EggFiles::iterator> invalid_eggs;
 
   EggFiles::iterator ei;
@@ -665,11 +972,34 @@ read_stale_eggs(bool redo_all) {
     EggFile *egg_file = (*ei).second;
     if (!egg_file->had_data() &&
         (egg_file->is_stale() || redo_all)) {
-      if (!egg_file->read_egg(_noabs)) {
-        invalid_eggs.push_back(ei);
+      stale_eggs.push_back(ei);
+    }
+  }
+
+  size_t batch_size = (size_t)std::max(_num_threads, 1);
+  for (size_t begin = 0; begin < stale_eggs.size(); begin += batch_size) {
+    size_t end = std::min(begin + batch_size, stale_eggs.size());
+
+    EggFileList batch;
+    for (size_t i = begin; i < end; ++i) {
+      batch.push_back((*stale_eggs[i]).second);
+    }
+    pvector<int> read_ok;
+    read_egg_files(batch, read_ok);
+
+    // Scanning the textures modifies the palettizer's own tables, so that
+    // part is done on this thread, in order.
+    for (size_t i = begin; i < end; ++i) {
+      EggFile *egg_file = (*stale_eggs[i]).second;
+      if (!read_ok[i - begin]) {
+        invalid_eggs.push_back(stale_eggs[i]);
+
+      } else if (!egg_file->scan_textures()) {
+        // A texture name conflict or an unreadable shard; _name_conflict or
+        // _load_failed is now set.
+        return false;
 
       } else {
-        egg_file->scan_textures();
         egg_file->choose_placements();
         egg_file->release_egg_data();
       }
@@ -711,31 +1041,73 @@ read_stale_eggs(bool redo_all) {
 /**
  * Adjusts the egg files to reference the newly generated textures, and writes
  * them out.  Returns true if successful, or false if there was some error.
+ *
+ * If _num_threads is greater than 1, the egg files are handled that many at a
+ * time.  Re-reading an egg file is serialized by the egg loader like any
+ * other parse, but adjusting and writing the files overlap.  Each one is
+ * released as soon as it has been written, and the messages are reported in
+ * the same order either way.
  */
 bool Palettizer::
 write_eggs() {
-  bool okflag = true;
+  EggFileList egg_files;
 
   EggFiles::iterator ei;
   for (ei = _egg_files.begin(); ei != _egg_files.end(); ++ei) {
     EggFile *egg_file = (*ei).second;
     if (egg_file->had_data()) {
-      if (!egg_file->has_data()) {
-        // Re-read the egg file.
-        bool read_ok = egg_file->read_egg(_noabs);
-        if (!read_ok) {
-          nout << "Error!  Unable to re-read egg file.\n";
-          okflag = false;
-        }
+      egg_files.push_back(egg_file);
+    }
+  }
+
+  if (egg_files.empty()) {
+    return true;
+  }
+
+  // Each egg file has its own egg data and texture references, and only
+  // reads the placements that have already been decided, so the egg files
+  // may be written independently of each other.
+  pvector<std::string> messages(egg_files.size());
+  pvector<int> write_ok(egg_files.size(), true);
+  auto write_one = [&](int i) {
+    EggFile *egg_file = egg_files[i];
+    std::ostringstream out;
+    if (!egg_file->has_data()) {
+      // Re-read the egg file.
+      bool read_ok = egg_file->read_egg(_noabs, out);
+      if (!read_ok) {
+        out << "Error!  Unable to re-read egg file.\n";
+        write_ok[i] = false;
       }
+    }
 
-      if (egg_file->has_data()) {
-        egg_file->update_egg();
-        if (!egg_file->write_egg()) {
-          okflag = false;
-        }
-        egg_file->release_egg_data();
+    if (egg_file->has_data()) {
+      egg_file->update_egg();
+      if (!egg_file->write_egg(out)) {
+        write_ok[i] = false;
       }
+      egg_file->release_egg_data();
+    }
+    messages[i] = out.str();
+  };
+
+  if (_num_threads > 1 && egg_files.size() > 1) {
+    ThreadManager::_num_threads = _num_threads;
+    ThreadManager::run_threads_on_individual("WriteEggs", (int)egg_files.size(), false,
+                                             write_one);
+  } else {
+    for (size_t i = 0; i < egg_files.size(); ++i) {
+      write_one((int)i);
+      nout << messages[i];
+      messages[i].clear();
+    }
+  }
+
+  bool okflag = true;
+  for (size_t i = 0; i < egg_files.size(); ++i) {
+    nout << messages[i];
+    if (!write_ok[i]) {
+      okflag = false;
     }
   }
 
@@ -861,6 +1233,267 @@ get_texture(const string &name) {
   return image;
 }
 
+/**
+ * Returns the TextureImage with the given name.  If there is no TextureImage
+ * with the indicated name, returns NULL.
+ */
+TextureImage *Palettizer::
+test_texture(const string &name) const {
+  Textures::const_iterator ti = _textures.find(name);
+  if (ti != _textures.end()) {
+    return (*ti).second;
+  }
+
+  ti = _textures.find(downcase(name));
+  if (ti != _textures.end()) {
+    return (*ti).second;
+  }
+
+  return nullptr;
+}
+
+/**
+ * Makes sure each of the indicated groups is in memory.  When the state is
+ * sharded, the index is read without the contents of the groups; this reads
+ * the shard of each of these groups that has not been read yet, and hooks up
+ * the egg file references to the placements it holds.
+ *
+ * Any other group that a texture of these groups is placed in is read as
+ * well, so that each texture has either all of its placements in memory or
+ * none of them.  A texture with none of them in memory is not touched this
+ * session.
+ *
+ * Returns true if successful, or false if a shard could not be read, in which
+ * case _load_failed is set and the session must stop.
+ */
+bool Palettizer::
+load_groups(const PaletteGroups &groups) {
+  if (_load_failed) {
+    return false;
+  }
+
+  PaletteGroups to_load;
+  PaletteGroups::const_iterator gi;
+  for (gi = groups.begin(); gi != groups.end(); ++gi) {
+    if (!(*gi)->is_loaded()) {
+      to_load.insert(*gi);
+    }
+  }
+  if (to_load.empty()) {
+    return true;
+  }
+
+  while (!to_load.empty()) {
+    PaletteGroups next;
+    for (gi = to_load.begin(); gi != to_load.end(); ++gi) {
+      PaletteGroup *group = (*gi);
+      if (group->is_loaded()) {
+        continue;
+      }
+      if (!read_shard(group)) {
+        _load_failed = true;
+        return false;
+      }
+
+      pvector<TexturePlacement *> placements;
+      group->get_placements(placements);
+      pvector<TexturePlacement *>::const_iterator pi;
+      for (pi = placements.begin(); pi != placements.end(); ++pi) {
+        const PaletteGroups &texture_groups = (*pi)->get_texture()->get_groups();
+        PaletteGroups::const_iterator tgi;
+        for (tgi = texture_groups.begin(); tgi != texture_groups.end(); ++tgi) {
+          if (!(*tgi)->is_loaded()) {
+            next.insert(*tgi);
+          }
+        }
+      }
+    }
+    to_load = next;
+  }
+
+  // Now that the placements are in memory, the egg file references that were
+  // read from the index can find them.
+  EggFiles::const_iterator ei;
+  for (ei = _egg_files.begin(); ei != _egg_files.end(); ++ei) {
+    (*ei).second->resolve_placements();
+  }
+
+  return true;
+}
+
+/**
+ * Makes sure every group is in memory, for an operation that touches all of
+ * them.  See load_groups().  Returns true if successful, false otherwise.
+ */
+bool Palettizer::
+load_all_groups() {
+  PaletteGroups groups;
+  Groups::const_iterator gi;
+  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+    groups.insert((*gi).second);
+  }
+  return load_groups(groups);
+}
+
+/**
+ * Writes out the shard of each group that is in memory, for a sharded state.
+ * The shards of the groups that were not read this session cannot have
+ * changed, and are left alone, as is any shard that still holds exactly the
+ * same contents.  Returns true if successful, false otherwise.
+ */
+bool Palettizer::
+write_shards() {
+  bool okflag = true;
+
+  Groups::const_iterator gi;
+  for (gi = _groups.begin(); gi != _groups.end(); ++gi) {
+    PaletteGroup *group = (*gi).second;
+    if (!group->is_loaded()) {
+      continue;
+    }
+
+    Filename filename = get_shard_filename(group);
+    filename.make_dir();
+
+    string data;
+    if (!encode_state(group, SP_shard, data)) {
+      nout << "Unable to encode palettization information for group "
+           << group->get_name() << ".\n";
+      okflag = false;
+
+    } else if (!write_state_file(filename, data)) {
+      okflag = false;
+    }
+  }
+
+  return okflag;
+}
+
+/**
+ * Returns the name of the file that holds the contents of the indicated group
+ * when the state is sharded.
+ */
+Filename Palettizer::
+get_shard_filename(const PaletteGroup *group) const {
+  Filename filename(_shard_dirname, group->get_name() + ".boo");
+  filename.set_binary();
+  return filename;
+}
+
+/**
+ * Encodes the indicated object as the indicated part of the state, and stores
+ * the result in data.  The object is the Palettizer itself, or the group in
+ * question for SP_shard.  Returns true if successful, false otherwise.
+ */
+bool Palettizer::
+encode_state(TypedWritable *object, StatePart part, string &data) {
+  StatePart orig_part = _write_state_part;
+  _write_state_part = part;
+
+  std::ostringstream strm;
+  bool okflag;
+  {
+    BamFile state_file;
+    okflag = state_file.open_write(strm) && state_file.write_object(object);
+    state_file.close();
+  }
+
+  _write_state_part = orig_part;
+  data = strm.str();
+  return okflag;
+}
+
+/**
+ * Writes the indicated data, as encoded by encode_state(), to the indicated
+ * file.  The file is left alone, timestamp and all, if it already holds
+ * exactly the same data.  Returns true if successful, false otherwise.
+ */
+bool Palettizer::
+write_state_file(const Filename &filename, const string &data) {
+  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+  string old_data;
+  if (vfs->read_file(filename, old_data, true) && old_data == data) {
+    return true;
+  }
+
+  // Make up a temporary filename to write the file to, then move it into
+  // place.  We do this in case the user interrupts us (or we core dump)
+  // before we're done; that way we won't leave the file incompletely
+  // written.
+  string dirname = filename.get_dirname();
+  if (dirname.empty()) {
+    dirname = ".";
+  }
+  Filename temp_filename = Filename::temporary(dirname, "pi");
+  temp_filename.set_binary();
+
+  if (!vfs->write_file(temp_filename, data, false)) {
+    nout << "Unable to write palettization information to "
+         << FilenameUnifier::make_user_filename(temp_filename)
+         << "\n";
+    return false;
+  }
+
+  filename.unlink();
+  if (!temp_filename.rename_to(filename)) {
+    nout << "Unable to rename temporary file "
+         << FilenameUnifier::make_user_filename(temp_filename) << " to "
+         << FilenameUnifier::make_user_filename(filename) << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Reads the shard of the indicated group, and moves its contents into the
+ * group.  Returns true if successful, false otherwise.
+ */
+bool Palettizer::
+read_shard(PaletteGroup *group) {
+  Filename filename = get_shard_filename(group);
+
+  BamFile shard_file;
+  if (!shard_file.open_read(filename)) {
+    nout << FilenameUnifier::make_user_filename(filename)
+         << " cannot be read.  You will need to remove the state file and "
+         << FilenameUnifier::make_user_filename(_shard_dirname)
+         << " and palettize again from scratch.\n";
+    return false;
+  }
+
+  // Each shard records the version that wrote it, which is not necessarily
+  // the version of the index.
+  int index_pi_version = _read_pi_version;
+  StatePart orig_part = _read_state_part;
+  _read_state_part = SP_shard;
+
+  TypedWritable *obj = shard_file.read_object();
+  bool okflag = (obj != nullptr && shard_file.resolve() &&
+                 obj->is_of_type(PaletteGroup::get_class_type()));
+  shard_file.close();
+
+  int shard_pi_version = _read_pi_version;
+  _read_pi_version = index_pi_version;
+  _read_state_part = orig_part;
+
+  if (okflag) {
+    PaletteGroup *shard = DCAST(PaletteGroup, obj);
+    okflag = (shard_pi_version <= _pi_version &&
+              shard_pi_version >= _min_pi_version &&
+              group->take_shard(shard));
+    delete shard;
+  }
+
+  if (!okflag) {
+    nout << FilenameUnifier::make_user_filename(filename)
+         << " could not be properly read.  You will need to remove the state "
+         << "file and " << FilenameUnifier::make_user_filename(_shard_dirname)
+         << " and palettize again from scratch.\n";
+  }
+  return okflag;
+}
+
 /**
  * A silly function to return "yes" or "no" based on a bool flag for nicely
  * formatted output.
@@ -974,6 +1607,9 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   for (ti = _textures.begin(); ti != _textures.end(); ++ti) {
     writer->write_pointer(datagram, (*ti).second);
   }
+
+  datagram.add_bool(_shard_state);
+  datagram.add_uint8((int)_write_state_part);
 }
 
 /**
@@ -1173,4 +1809,13 @@ fillin(DatagramIterator &scan, BamReader *manager) {
 
   _num_textures = scan.get_int32();
   manager->read_pointers(scan, _num_textures);
+
+  // The rest of the objects in the file are read according to the part of
+  // the state this is.
+  if (_read_pi_version >= 25) {
+    _shard_state = scan.get_bool();
+    _read_state_part = (StatePart)scan.get_uint8();
+  } else {
+    _read_state_part = SP_whole;
+  }
 }
@@ -29,6 +29,7 @@ class EggFile;
 class PaletteGroup;
 class TextureImage;
 class TexturePlacement;
+class PaletteGroups;
 class FactoryParams;
 
 /**
@@ -47,8 +48,10 @@ public:
   void report_pi() const;
   void report_statistics() const;
 
-  void read_txa_file(std::istream &txa_file, const std::string &txa_filename);
+  bool read_txa_file(std::istream &txa_file, const std::string &txa_filename);
   void all_params_set();
+  void begin_session();
+  void delete_contents();
   void process_command_line_eggs(bool force_texture_read, const Filename &state_filename);
   void process_all(bool force_texture_read, const Filename &state_filename);
   void optimal_resize();
@@ -66,15 +69,41 @@ public:
   PaletteGroup *test_palette_group(const std::string &name) const;
   PaletteGroup *get_default_group();
   TextureImage *get_texture(const std::string &name);
+  TextureImage *test_texture(const std::string &name) const;
+
+  bool load_groups(const PaletteGroups &groups);
+  bool load_all_groups();
+  bool write_shards();
+  Filename get_shard_filename(const PaletteGroup *group) const;
+
+  // The parts into which the state may be divided.  SP_whole is the entire
+  // state in one file.  A sharded state is an SP_index file, holding
+  // everything but the contents of the groups, and one SP_shard file for
+  // each group.
+  enum StatePart {
+    SP_whole,
+    SP_index,
+    SP_shard
+  };
+
+  static bool encode_state(TypedWritable *object, StatePart part,
+                           std::string &data);
+  static bool write_state_file(const Filename &filename,
+                               const std::string &data);
 
 private:
   static const char *yesno(bool flag);
+  bool read_shard(PaletteGroup *group);
 
 public:
   static int _pi_version;
   static int _min_pi_version;
   static int _read_pi_version;
 
+  // The part of the state being written or read at the moment.
+  static StatePart _write_state_part;
+  static StatePart _read_state_part;
+
   enum RemapUV {
     RU_never,
     RU_group,
@@ -92,6 +121,18 @@ public:
   std::string _default_groupname;
   std::string _default_groupdir;
   bool _noabs;
+  int _num_threads;
+  size_t _prefetch_budget;
+
+  // Set when an egg file names a texture that conflicts with an existing
+  // one.  The session must then stop without saving the state.
+  bool _name_conflict;
+
+  // The directory that holds the group shards of a sharded state, and a flag
+  // set if one of them could not be read.  In that case, too, the session
+  // must stop without saving the state.
+  Filename _shard_dirname;
+  bool _load_failed;
 
   // The following parameter values specifically relate to textures and
   // palettes.  These values are stored in the textures.boo file for future
@@ -118,12 +159,23 @@ public:
   PNMFileType *_shadow_alpha_type;
   EggRenderMode::AlphaMode _cutout_mode;
   double _cutout_ratio;
+  bool _shard_state;
 
 private:
   typedef pvector<TexturePlacement *> Placements;
   void compute_statistics(std::ostream &out, int indent_level,
                           const Placements &placements) const;
 
+  typedef pvector<TextureImage *> TextureList;
+  void prefetch_headers(const TextureList &textures, bool force_texture_read,
+                        const Filename &state_filename,
+                        pvector<size_t> &image_bytes);
+  size_t prefetch_images(const TextureList &textures,
+                         const pvector<size_t> &image_bytes, size_t begin);
+
+  typedef pvector<EggFile *> EggFileList;
+  void read_egg_files(const EggFileList &egg_files, pvector<int> &read_ok);
+
   typedef pmap<std::string, EggFile *> EggFiles;
   EggFiles _egg_files;
 
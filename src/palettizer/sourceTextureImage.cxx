@@ -14,8 +14,10 @@
 #include "sourceTextureImage.h"
 #include "textureImage.h"
 #include "filenameUnifier.h"
+#include "palettizer.h"
 
 #include "pnmImageHeader.h"
+#include "virtualFileSystem.h"
 #include "datagram.h"
 #include "datagramIterator.h"
 #include "bamReader.h"
@@ -33,6 +35,9 @@ SourceTextureImage() {
   _egg_count = 0;
   _read_header = false;
   _successfully_read_header = false;
+  _recorded_hash = 0;
+  _content_hash = 0;
+  _hashed_content = false;
 }
 
 /**
@@ -49,6 +54,9 @@ SourceTextureImage(TextureImage *texture, const Filename &filename,
   _egg_count = 0;
   _read_header = false;
   _successfully_read_header = false;
+  _recorded_hash = 0;
+  _content_hash = 0;
+  _hashed_content = false;
 }
 
 /**
@@ -143,6 +151,93 @@ set_header(const PNMImageHeader &header) {
 }
 
 
+/**
+ * Returns a hash of the bytes of the image file (and of the alpha file, if
+ * any), computed the first time it is requested this session.  Returns 0 if
+ * the files cannot be read.
+ */
+uint64_t SourceTextureImage::
+get_content_hash() {
+  if (!_hashed_content) {
+    _hashed_content = true;
+    _content_hash = 0;
+
+    FnvHash hash;
+    if (hash_file(hash, _filename)) {
+      if (!_alpha_filename.empty()) {
+        if (!hash_file(hash, _alpha_filename)) {
+          return _content_hash;
+        }
+        hash.add_word((uint64_t)(_alpha_file_channel + 1));
+      }
+      // Reserve 0 to mean "unknown".
+      _content_hash = hash.get_nonzero_hash();
+    }
+  }
+  return _content_hash;
+}
+
+/**
+ * Returns true if the image files are known to hold exactly the same bytes
+ * that they did the last time record_content_hash() was called, possibly in
+ * a previous session, even if their timestamps say otherwise.
+ */
+bool SourceTextureImage::
+is_content_unchanged() {
+  return _recorded_hash != 0 && get_content_hash() == _recorded_hash;
+}
+
+/**
+ * Notes the current contents of the image files, for the benefit of future
+ * calls to is_content_unchanged().  This should be called whenever the image
+ * is read in full.
+ */
+void SourceTextureImage::
+record_content_hash() {
+  _recorded_hash = get_content_hash();
+}
+
+/**
+ * Forgets the egg count and anything learned about the image files this
+ * session, since they may change before the next session in the same
+ * process.
+ */
+void SourceTextureImage::
+reset_session() {
+  _egg_count = 0;
+  _read_header = false;
+  _successfully_read_header = false;
+  _content_hash = 0;
+  _hashed_content = false;
+}
+
+/**
+ * Folds the contents of the indicated file into the running hash.
+ * Returns true if the file was read successfully, false otherwise.
+ */
+bool SourceTextureImage::
+hash_file(FnvHash &hash, const Filename &filename) {
+  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+  std::istream *in = vfs->open_read_file(filename, true);
+  if (in == nullptr) {
+    return false;
+  }
+
+  static const size_t buffer_size = 16384;
+  unsigned char buffer[buffer_size];
+  in->read((char *)buffer, buffer_size);
+  size_t count = in->gcount();
+  while (count != 0) {
+    hash.add_data(buffer, count);
+    in->read((char *)buffer, buffer_size);
+    count = in->gcount();
+  }
+
+  bool okflag = !in->bad();
+  vfs->close_read_file(in);
+  return okflag;
+}
+
 /**
  * Registers the current object as something that can be read from a Bam file.
  */
@@ -166,6 +261,10 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   // We don't store _read_header or _successfully_read_header in the Bam file;
   // these are transitory and we need to reread the image header for each
   // session (in case the image files change between sessions).
+
+  if (Palettizer::_pi_version >= 23) {
+    datagram.add_uint64(_recorded_hash);
+  }
 }
 
 /**
@@ -206,4 +305,8 @@ void SourceTextureImage::
 fillin(DatagramIterator &scan, BamReader *manager) {
   ImageFile::fillin(scan, manager);
   manager->read_pointer(scan); // _texture
+
+  if (Palettizer::_read_pi_version >= 23) {
+    _recorded_hash = scan.get_uint64();
+  }
 }
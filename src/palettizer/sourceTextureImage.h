@@ -17,6 +17,7 @@
 #include "pandatoolbase.h"
 
 #include "imageFile.h"
+#include "fnvHash.h"
 
 class TextureImage;
 class PNMImageHeader;
@@ -42,12 +43,25 @@ public:
   bool read_header();
   void set_header(const PNMImageHeader &header);
 
+  uint64_t get_content_hash();
+  bool is_content_unchanged();
+  void record_content_hash();
+  void reset_session();
+
 private:
+  static bool hash_file(FnvHash &hash, const Filename &filename);
+
   TextureImage *_texture;
   int _egg_count;
   bool _read_header;
   bool _successfully_read_header;
 
+  // The hash of the image files as of the last time the image was read, and
+  // their hash this session.
+  uint64_t _recorded_hash;
+  uint64_t _content_hash;
+  bool _hashed_content;
+
   // The TypedWritable interface follows.
 public:
   static void register_with_read_factory();
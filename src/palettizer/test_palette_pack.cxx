@@ -0,0 +1,167 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file test_palette_pack.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "paletteOccupancy.h"
+
+#include "pvector.h"
+#include "trueClock.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+/**
+ * A trivial stand-in for a TexturePlacement: just a rectangle.
+ */
+class TestRect {
+public:
+  int _x, _y;
+  int _x_size, _y_size;
+  bool _placed;
+};
+
+typedef pvector<TestRect> TestRects;
+
+/**
+ * Sorts rectangles from biggest to smallest, the same way that
+ * SortPlacementBySize orders textures before packing them.
+ */
+static bool
+sort_by_size(const TestRect &a, const TestRect &b) {
+  if (a._y_size != b._y_size) {
+    return a._y_size > b._y_size;
+  }
+  return a._x_size > b._x_size;
+}
+
+/**
+ * The reference hole finder: this is the algorithm PaletteImage used before
+ * it had an occupancy index, walking the entire list for each candidate.
+ */
+static bool
+linear_find_hole(const TestRects &placed, int pal_x_size, int pal_y_size,
+                 int &x, int &y, int x_size, int y_size) {
+  y = 0;
+  while (y + y_size <= pal_y_size) {
+    int next_y = pal_y_size;
+    x = 0;
+    while (x + x_size <= pal_x_size) {
+      const TestRect *overlap = nullptr;
+      TestRects::const_iterator ri;
+      for (ri = placed.begin(); ri != placed.end() && overlap == nullptr; ++ri) {
+        const TestRect &r = (*ri);
+        if (!(x >= r._x + r._x_size || x + x_size <= r._x ||
+              y >= r._y + r._y_size || y + y_size <= r._y)) {
+          overlap = &r;
+        }
+      }
+      if (overlap == nullptr) {
+        return true;
+      }
+      next_y = std::min(next_y, overlap->_y + overlap->_y_size);
+      x = overlap->_x + overlap->_x_size;
+    }
+    y = next_y;
+  }
+  return false;
+}
+
+int
+main(int argc, char *argv[]) {
+  int num_textures = 10000;
+  int pal_x_size = 4096;
+  int pal_y_size = 4096;
+  bool compare = true;
+
+  if (argc > 1) {
+    num_textures = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    pal_x_size = pal_y_size = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    // Pass a third parameter of 0 to skip the (slow) linear reference.
+    compare = (atoi(argv[3]) != 0);
+  }
+
+  // Generate a reproducible set of small UI/icon-sized textures.
+  TestRects rects;
+  rects.reserve(num_textures);
+  unsigned int seed = 12345;
+  for (int i = 0; i < num_textures; ++i) {
+    TestRect r;
+    seed = seed * 1103515245 + 12345;
+    r._x_size = 4 << ((seed >> 16) % 4);
+    seed = seed * 1103515245 + 12345;
+    r._y_size = 4 << ((seed >> 16) % 4);
+    r._x = r._y = 0;
+    r._placed = false;
+    rects.push_back(r);
+  }
+  std::stable_sort(rects.begin(), rects.end(), sort_by_size);
+
+  TrueClock *clock = TrueClock::get_global_ptr();
+
+  // Pack with the occupancy index.
+  TestRects indexed = rects;
+  double start = clock->get_short_time();
+  PaletteOccupancy occupancy;
+  occupancy.reset(pal_x_size, pal_y_size);
+  int num_placed = 0;
+  TestRects::iterator ri;
+  for (ri = indexed.begin(); ri != indexed.end(); ++ri) {
+    TestRect &r = (*ri);
+    if (occupancy.find_hole(r._x, r._y, r._x_size, r._y_size)) {
+      occupancy.add(r._x, r._y, r._x_size, r._y_size);
+      r._placed = true;
+      ++num_placed;
+    }
+  }
+  double indexed_time = clock->get_short_time() - start;
+
+  nout << "Placed " << num_placed << " of " << num_textures
+       << " textures on a " << pal_x_size << " x " << pal_y_size
+       << " palette in " << indexed_time * 1000.0 << " ms\n";
+
+  if (!compare) {
+    return 0;
+  }
+
+  // Pack again with the linear reference, and make sure we arrive at the
+  // same layout.
+  TestRects linear = rects;
+  TestRects placed;
+  start = clock->get_short_time();
+  for (ri = linear.begin(); ri != linear.end(); ++ri) {
+    TestRect &r = (*ri);
+    if (linear_find_hole(placed, pal_x_size, pal_y_size,
+                         r._x, r._y, r._x_size, r._y_size)) {
+      r._placed = true;
+      placed.push_back(r);
+    }
+  }
+  double linear_time = clock->get_short_time() - start;
+
+  nout << "Linear reference took " << linear_time * 1000.0 << " ms\n";
+
+  for (size_t i = 0; i < rects.size(); ++i) {
+    if (indexed[i]._placed != linear[i]._placed ||
+        (indexed[i]._placed &&
+         (indexed[i]._x != linear[i]._x || indexed[i]._y != linear[i]._y))) {
+      nout << "Layout mismatch at texture " << i << "\n";
+      return 1;
+    }
+  }
+
+  nout << "Layouts match.\n";
+  return 0;
+}
@@ -52,6 +52,7 @@ TextureImage() {
   _alpha_mode = EggRenderMode::AM_unspecified;
   _txa_wrap_u = EggTexture::WM_unspecified;
   _txa_wrap_v = EggTexture::WM_unspecified;
+  _txa_resize_filter = TextureResampler::F_unspecified;
   _texture_named = false;
   _got_txa_file = false;
 }
@@ -211,6 +212,28 @@ get_placement(PaletteGroup *group) const {
   return (*pi).second;
 }
 
+/**
+ * Returns true if the placements of the texture in all of its groups are in
+ * memory, or false if some of its groups are in a shard of a sharded state
+ * that has not been read this session.  See Palettizer::load_groups().
+ */
+bool TextureImage::
+is_resident() const {
+  return _placement.size() == _actual_assigned_groups.size();
+}
+
+/**
+ * Records a placement of this texture just read from the shard of a sharded
+ * state.  This is called by TexturePlacement::resolve_names().
+ */
+void TextureImage::
+load_placement(TexturePlacement *placement) {
+  PaletteGroup *group = placement->get_group();
+  nassertv(_actual_assigned_groups.count(group) != 0);
+  bool inserted = _placement.insert(Placement::value_type(group, placement)).second;
+  nassertv(inserted);
+}
+
 /**
  * Removes the texture from any PaletteImages it is assigned to, but does not
  * remove it from the groups.  It will be re-placed within each group when
@@ -323,6 +346,18 @@ post_txa_file() {
     }
   }
 
+  if (_txa_resize_filter != _request._resize_filter) {
+    _txa_resize_filter = _request._resize_filter;
+
+    // The palettes will need to be refilled with the texture scaled the new
+    // way.  (The unplaced copies take care of themselves.)
+    Placement::iterator pi;
+    for (pi = _placement.begin(); pi != _placement.end(); ++pi) {
+      TexturePlacement *placement = (*pi).second;
+      placement->mark_unfilled();
+    }
+  }
+
   if (_properties.has_num_channels() && !_request._keep_format) {
     int num_channels = _properties.get_num_channels();
     // Examine the image to determine if we can downgrade the number of
@@ -465,7 +500,7 @@ get_margin() const {
  */
 bool TextureImage::
 is_surprise() const {
-  if (_placement.empty()) {
+  if (!is_used()) {
     // A texture that is not actually placed anywhere is not considered a
     // surprise.
     return false;
@@ -480,7 +515,9 @@ is_surprise() const {
  */
 bool TextureImage::
 is_used() const {
-  return !_placement.empty();
+  // The placements in a group that has not been read from a sharded state
+  // are not in memory, but the group is still in _actual_assigned_groups.
+  return !_placement.empty() || !_actual_assigned_groups.empty();
 }
 
 /**
@@ -511,6 +548,15 @@ get_txa_wrap_v() const {
   return _txa_wrap_v;
 }
 
+/**
+ * Returns the filter specified in the txa file for scaling the texture to its
+ * palettized size, or F_unspecified.
+ */
+TextureResampler::Filter TextureImage::
+get_txa_resize_filter() const {
+  return _txa_resize_filter;
+}
+
 
 /**
  * Returns the SourceTextureImage corresponding to the given filename(s).  If
@@ -626,6 +672,21 @@ get_preferred_source() {
   return _preferred_source;
 }
 
+/**
+ * Returns the DestTextureImage that is copied to the indicated filename, or
+ * NULL if there is none.
+ */
+DestTextureImage *TextureImage::
+find_dest(const Filename &filename) const {
+  Dests::const_iterator di;
+  di = _dests.find(filename);
+  if (di == _dests.end()) {
+    return nullptr;
+  }
+
+  return (*di).second;
+}
+
 /**
  * Calls clear_basic_properties() on each source texture image used by this
  * texture, to reset the properties in preparation for re-applying them from
@@ -712,7 +773,9 @@ read_source_image() {
   if (!_read_source_image) {
     SourceTextureImage *source = get_preferred_source();
     if (source != nullptr) {
-      source->read(_source_image);
+      if (source->read(_source_image)) {
+        source->record_content_hash();
+      }
     }
     _read_source_image = true;
     _allow_release_source_image = true;
@@ -735,6 +798,56 @@ release_source_image() {
   }
 }
 
+/**
+ * Resets everything that is redetermined each session from the egg files and
+ * the .txa file, and releases the source image, in preparation for another
+ * session in the same process.
+ */
+void TextureImage::
+reset_session() {
+  _request = TextureRequest();
+  _preferred_source = nullptr;
+  _explicitly_assigned_groups.clear();
+  _egg_files.clear();
+
+  _source_image.clear();
+  _read_source_image = false;
+  _allow_release_source_image = true;
+  _texture_named = false;
+  _got_txa_file = false;
+
+  Sources::iterator si;
+  for (si = _sources.begin(); si != _sources.end(); ++si) {
+    (*si).second->reset_session();
+  }
+}
+
+/**
+ * Deletes the placements, sources and dests of this texture.  The
+ * TextureReferences must already be gone; see Palettizer::delete_contents().
+ */
+void TextureImage::
+delete_contents() {
+  Placement::iterator pi;
+  for (pi = _placement.begin(); pi != _placement.end(); ++pi) {
+    delete (*pi).second;
+  }
+  _placement.clear();
+
+  Sources::iterator si;
+  for (si = _sources.begin(); si != _sources.end(); ++si) {
+    delete (*si).second;
+  }
+  _sources.clear();
+  _preferred_source = nullptr;
+
+  Dests::iterator di;
+  for (di = _dests.begin(); di != _dests.end(); ++di) {
+    delete (*di).second;
+  }
+  _dests.clear();
+}
+
 /**
  * Accepts the indicated source image as if it had been read from disk.  This
  * image is copied into the structure, and will be returned by future calls to
@@ -748,6 +861,17 @@ set_source_image(const PNMImage &image) {
   _ever_read_image = true;
 }
 
+/**
+ * Returns the lock that must be held while the source image is read, used,
+ * and released, whenever other threads might be doing the same thing with
+ * this texture (for instance, because it has been placed on several palette
+ * images that are being generated in parallel).
+ */
+Mutex &TextureImage::
+get_source_lock() {
+  return _source_lock;
+}
+
 /**
  * Causes the header part of the image to be reread, usually to confirm that
  * its image properties (size, number of channels, etc.) haven't changed.
@@ -765,6 +889,9 @@ read_header() {
 /**
  * Returns true if the source image is newer than the indicated file, false
  * otherwise.  If the image has already been read, this always returns false.
+ *
+ * A source image whose timestamp is newer, but whose contents are the same as
+ * they were when it was last read, is not considered newer.
  */
 bool TextureImage::
 is_newer_than(const Filename &reference_filename) {
@@ -772,7 +899,8 @@ is_newer_than(const Filename &reference_filename) {
     SourceTextureImage *source = get_preferred_source();
     if (source != nullptr) {
       const Filename &source_filename = source->get_filename();
-      return source_filename.compare_timestamps(reference_filename) >= 0;
+      return source_filename.compare_timestamps(reference_filename) >= 0 &&
+        !source->is_content_unchanged();
     }
   }
 
@@ -967,6 +1095,10 @@ compute_egg_count(PaletteGroup *group,
  */
 void TextureImage::
 assign_to_groups(const PaletteGroups &groups) {
+  if (!pal->load_groups(groups)) {
+    return;
+  }
+
   PaletteGroups::const_iterator gi;
   Placement::const_iterator pi;
 
@@ -1264,6 +1396,7 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   datagram.add_bool(_is_cutout);
   datagram.add_uint8((int)_txa_wrap_u);
   datagram.add_uint8((int)_txa_wrap_v);
+  datagram.add_uint8((int)_txa_resize_filter);
 
   // We don't write out _explicitly_assigned_groups; this is re-read from the
   // .txa file each time.
@@ -1272,11 +1405,25 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
 
   // We don't write out _egg_files; this is redetermined each session.
 
-  datagram.add_uint32(_placement.size());
-  Placement::const_iterator pi;
-  for (pi = _placement.begin(); pi != _placement.end(); ++pi) {
-    writer->write_pointer(datagram, (*pi).first);
-    writer->write_pointer(datagram, (*pi).second);
+  // The placements are keyed by group pointer; write them in order by group
+  // name instead, so that the same state always produces the same file.  The
+  // index of a sharded state leaves them to the shard of each group.
+  pvector<PaletteGroup *> group_vector;
+  if (Palettizer::_write_state_part != Palettizer::SP_index) {
+    group_vector.reserve(_placement.size());
+    Placement::const_iterator pi;
+    for (pi = _placement.begin(); pi != _placement.end(); ++pi) {
+      group_vector.push_back((*pi).first);
+    }
+  }
+  sort(group_vector.begin(), group_vector.end(),
+       IndirectCompareNames<PaletteGroup>());
+
+  datagram.add_uint32(group_vector.size());
+  pvector<PaletteGroup *>::const_iterator gvi;
+  for (gvi = group_vector.begin(); gvi != group_vector.end(); ++gvi) {
+    writer->write_pointer(datagram, (*gvi));
+    writer->write_pointer(datagram, (*_placement.find(*gvi)).second);
   }
 
   datagram.add_uint32(_sources.size());
@@ -1383,6 +1530,9 @@ fillin(DatagramIterator &scan, BamReader *manager) {
     _txa_wrap_u = (EggTexture::WrapMode)scan.get_uint8();
     _txa_wrap_v = (EggTexture::WrapMode)scan.get_uint8();
   }
+  if (pal->_read_pi_version >= 24) {
+    _txa_resize_filter = (TextureResampler::Filter)scan.get_uint8();
+  }
 
   _actual_assigned_groups.fillin(scan, manager);
 
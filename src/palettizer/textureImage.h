@@ -23,6 +23,7 @@
 #include "namable.h"
 #include "filename.h"
 #include "pnmImage.h"
+#include "pmutex.h"
 #include "eggRenderMode.h"
 
 #include "pmap.h"
@@ -52,6 +53,8 @@ public:
 
   const PaletteGroups &get_groups() const;
   TexturePlacement *get_placement(PaletteGroup *group) const;
+  bool is_resident() const;
+  void load_placement(TexturePlacement *placement);
   void force_replace();
   void mark_eggs_stale();
 
@@ -72,19 +75,24 @@ public:
 
   EggTexture::WrapMode get_txa_wrap_u() const;
   EggTexture::WrapMode get_txa_wrap_v() const;
+  TextureResampler::Filter get_txa_resize_filter() const;
 
   SourceTextureImage *get_source(const Filename &filename,
                                  const Filename &alpha_filename,
                                  int alpha_file_channel);
 
   SourceTextureImage *get_preferred_source();
+  DestTextureImage *find_dest(const Filename &filename) const;
   void clear_source_basic_properties();
 
   void copy_unplaced(bool redo_all);
 
   const PNMImage &read_source_image();
   void release_source_image();
+  void reset_session();
+  void delete_contents();
   void set_source_image(const PNMImage &image);
+  Mutex &get_source_lock();
   void read_header();
   bool is_newer_than(const Filename &reference_filename);
 
@@ -134,6 +142,7 @@ private:
   bool _is_cutout;
   EggRenderMode::AlphaMode _alpha_mode;
   EggTexture::WrapMode _txa_wrap_u, _txa_wrap_v;
+  TextureResampler::Filter _txa_resize_filter;
 
   PaletteGroups _explicitly_assigned_groups;
   PaletteGroups _actual_assigned_groups;
@@ -149,6 +158,7 @@ private:
   bool _read_source_image;
   bool _allow_release_source_image;
   PNMImage _source_image;
+  Mutex _source_lock;
   bool _texture_named;
   bool _got_txa_file;
 
@@ -19,6 +19,10 @@
 #include "palettizer.h"
 #include "eggFile.h"
 #include "destTextureImage.h"
+#include "sourceTextureImage.h"
+#include "filenameUnifier.h"
+#include "textureResampler.h"
+#include "fnvHash.h"
 
 #include "indent.h"
 #include "datagram.h"
@@ -26,12 +30,34 @@
 #include "bamReader.h"
 #include "bamWriter.h"
 #include "pnmImage.h"
+#include "mutexHolder.h"
+
+#include <algorithm>
+#include <string.h>
 
 using std::max;
 using std::min;
 
 TypeHandle TexturePlacement::_type_handle;
 
+// This STL function object is used in write_datagram(), below.
+class SortReferencesByName {
+public:
+  bool operator ()(const TextureReference *a, const TextureReference *b) const {
+    const EggFile *a_egg = a->get_egg_file();
+    const EggFile *b_egg = b->get_egg_file();
+    if (a_egg != b_egg) {
+      if (a_egg == nullptr || b_egg == nullptr) {
+        return a_egg == nullptr;
+      }
+      if (a_egg->get_name() != b_egg->get_name()) {
+        return a_egg->get_name() < b_egg->get_name();
+      }
+    }
+    return a->get_tref_name() < b->get_tref_name();
+  }
+};
+
 /**
  * The default constructor is only for the convenience of the Bam reader.
  */
@@ -44,6 +70,7 @@ TexturePlacement() {
   _has_uvs = false;
   _size_known = false;
   _is_filled = true;
+  _fill_hash = 0;
   _omit_reason = OR_none;
 }
 
@@ -68,6 +95,7 @@ TexturePlacement(TextureImage *texture, PaletteGroup *group) :
   _has_uvs = false;
   _size_known = false;
   _is_filled = false;
+  _fill_hash = 0;
 }
 
 /**
@@ -165,6 +193,56 @@ mark_eggs_stale() {
   }
 }
 
+/**
+ * Called on a placement just read from the shard of a sharded state, which
+ * names the texture, dest and swap textures instead of pointing to them,
+ * since they are in the index.  This looks them up, and records the
+ * placement with its texture.  Returns true if successful, or false if the
+ * texture is not in the index.
+ */
+bool TexturePlacement::
+resolve_names(PaletteGroup *group) {
+  _group = group;
+  _texture = pal->test_texture(_load_texture_name);
+  if (_texture == nullptr) {
+    nout << "Texture " << _load_texture_name << " in group "
+         << group->get_name() << " is not in the index.\n";
+    return false;
+  }
+
+  if (!_load_dest_filename.empty()) {
+    _dest = _texture->find_dest(_load_dest_filename);
+  }
+
+  vector_string::const_iterator si;
+  for (si = _load_swap_names.begin(); si != _load_swap_names.end(); ++si) {
+    TextureImage *swap_texture = pal->test_texture(*si);
+    if (swap_texture == nullptr) {
+      nout << "Texture " << (*si) << " in group " << group->get_name()
+           << " is not in the index.\n";
+      return false;
+    }
+    _textureSwaps.push_back(swap_texture);
+  }
+
+  _load_texture_name.clear();
+  _load_dest_filename = Filename();
+  _load_swap_names.clear();
+
+  _texture->load_placement(this);
+  return true;
+}
+
+/**
+ * Records that the indicated egg file reference, read from the index of a
+ * sharded state, uses this placement.  Unlike add_egg(), this does not mark
+ * the egg file stale, since nothing has changed.
+ */
+void TexturePlacement::
+load_reference(TextureReference *reference) {
+  _references.insert(reference);
+}
+
 /**
  * Sets the DestTextureImage that corresponds to this texture as it was copied
  * to the install directory.
@@ -686,6 +764,28 @@ mark_unfilled() {
   _is_filled = false;
 }
 
+/**
+ * Returns true if the texture was filled from source images with exactly the
+ * same contents, at exactly the same place, as they have now, according to
+ * the hash saved by the last call to record_fill_hash().  In this case there
+ * is no need to fill it again even if the source images appear to be newer
+ * than the palette image.
+ */
+bool TexturePlacement::
+is_fill_unchanged() {
+  return _fill_hash != 0 && compute_fill_hash() == _fill_hash;
+}
+
+/**
+ * Saves a hash of the texture's source images and its placement on the
+ * palette, for future calls to is_fill_unchanged().  This should be called
+ * when the texture is about to be filled.
+ */
+void TexturePlacement::
+record_fill_hash() {
+  _fill_hash = compute_fill_hash();
+}
+
 /**
  * Fills in the rectangle of the palette image represented by the texture
  * placement with the image pixels.
@@ -722,96 +822,25 @@ fill_image(PNMImage &image) {
   nassertv(x_size >= 0 && y_size >= 0);
 
   // Now we get a PNMImage that represents the source texture at that size.
-  const PNMImage &source_full = _texture->read_source_image();
-  if (!source_full.is_valid()) {
-    flag_error_image(image);
-    return;
-  }
-
-  PNMImage source(x_size, y_size, source_full.get_num_channels(),
-                  source_full.get_maxval());
-  source.quick_filter_from(source_full);
-
-  bool alpha = image.has_alpha();
-  bool source_alpha = source.has_alpha();
-
-  // Now copy the pixels.  We do this by walking through the rectangular
-  // region on the palette image that we have reserved for this texture; for
-  // each pixel in this region, we determine its appropriate color based on
-  // its relation to the actual texture image location (determined above), and
-  // on whether the texture wraps or clamps.
-  for (int y = _placed._y; y < _placed._y + _placed._y_size; y++) {
-    int sy = y - top;
-
-    switch (_placed._wrap_v) {
-    case EggTexture::WM_clamp:
-      // Clamp at [0, y_size).
-      sy = max(min(sy, y_size - 1), 0);
-      break;
-
-    case EggTexture::WM_mirror:
-      sy = (sy < 0) ? (y_size * 2) - 1 - ((-sy - 1) % (y_size * 2)) : sy % (y_size * 2);
-      sy = (sy < y_size) ? sy : 2 * y_size - sy - 1;
-      break;
-
-    case EggTexture::WM_mirror_once:
-      sy = (sy < y_size) ? sy : 2 * y_size - sy - 1;
-      // Fall through
-
-    case EggTexture::WM_border_color:
-      if (sy < 0 || sy >= y_size) {
-        continue;
-      }
-      break;
-
-    default:
-      // Wrap: sign-independent modulo.
-      sy = (sy < 0) ? y_size - 1 - ((-sy - 1) % y_size) : sy % y_size;
-      break;
+  // We hold the texture's lock only while we need the full-size source image,
+  // since the same texture may be on another palette being filled right now.
+  PNMImage source;
+  {
+    MutexHolder holder(_texture->get_source_lock());
+    const PNMImage &source_full = _texture->read_source_image();
+    if (!source_full.is_valid()) {
+      flag_error_image(image);
+      return;
     }
 
-    for (int x = _placed._x; x < _placed._x + _placed._x_size; x++) {
-      int sx = x - left;
-
-      switch (_placed._wrap_u) {
-      case EggTexture::WM_clamp:
-        // Clamp at [0, x_size).
-        sx = max(min(sx, x_size - 1), 0);
-        break;
-
-      case EggTexture::WM_mirror:
-        sx = (sx < 0) ? (x_size * 2) - 1 - ((-sx - 1) % (x_size * 2)) : sx % (x_size * 2);
-        sx = (sx < x_size) ? sx : 2 * x_size - sx - 1;
-        break;
-
-      case EggTexture::WM_mirror_once:
-        sx = (sx >= 0) ? sx : ~sx;
-        // Fall through
-
-      case EggTexture::WM_border_color:
-        if (sx < 0 || sx >= x_size) {
-          continue;
-        }
-        break;
-
-      default:
-        // Wrap: sign-independent modulo.
-        sx = (sx < 0) ? x_size - 1 - ((-sx - 1) % x_size) : sx % x_size;
-        break;
-      }
-
-      image.set_xel(x, y, source.get_xel(sx, sy));
-      if (alpha) {
-        if (source_alpha) {
-          image.set_alpha(x, y, source.get_alpha(sx, sy));
-        } else {
-          image.set_alpha(x, y, 1.0);
-        }
-      }
-    }
+    source.clear(x_size, y_size, source_full.get_num_channels(),
+                 source_full.get_maxval());
+    TextureResampler::resample(source, source_full, _texture->get_txa_resize_filter(),
+                               _texture->get_properties()._srgb);
+    _texture->release_source_image();
   }
 
-  _texture->release_source_image();
+  copy_pixels(image, source, top, left, _placed._wrap_u, _placed._wrap_v);
 }
 
 
@@ -854,60 +883,29 @@ fill_swapped_image(PNMImage &image, int index) {
   TextureSwaps::iterator tsi;
   tsi = _textureSwaps.begin() + index;
   TextureImage *swapTexture = (*tsi);
-  const PNMImage &source_full = swapTexture->read_source_image();
-  if (!source_full.is_valid()) {
-    flag_error_image(image);
-    return;
-  }
-
-  PNMImage source(x_size, y_size, source_full.get_num_channels(),
-                  source_full.get_maxval());
-  source.quick_filter_from(source_full);
-
-  bool alpha = image.has_alpha();
-  bool source_alpha = source.has_alpha();
-
-  // Now copy the pixels.  We do this by walking through the rectangular
-  // region on the palette image that we have reserved for this texture; for
-  // each pixel in this region, we determine its appropriate color based on
-  // its relation to the actual texture image location (determined above), and
-  // on whether the texture wraps or clamps.
-  for (int y = _placed._y; y < _placed._y + _placed._y_size; y++) {
-    int sy = y - top;
-
-    if (_placed._wrap_v == EggTexture::WM_clamp) {
-      // Clamp at [0, y_size).
-      sy = max(min(sy, y_size - 1), 0);
-
-    } else {
-      // Wrap: sign-independent modulo.
-      sy = (sy < 0) ? y_size - 1 - ((-sy - 1) % y_size) : sy % y_size;
+  PNMImage source;
+  {
+    MutexHolder holder(swapTexture->get_source_lock());
+    const PNMImage &source_full = swapTexture->read_source_image();
+    if (!source_full.is_valid()) {
+      flag_error_image(image);
+      return;
     }
 
-    for (int x = _placed._x; x < _placed._x + _placed._x_size; x++) {
-      int sx = x - left;
-
-      if (_placed._wrap_u == EggTexture::WM_clamp) {
-        // Clamp at [0, x_size).
-        sx = max(min(sx, x_size - 1), 0);
-
-      } else {
-        // Wrap: sign-independent modulo.
-        sx = (sx < 0) ? x_size - 1 - ((-sx - 1) % x_size) : sx % x_size;
-      }
-
-      image.set_xel(x, y, source.get_xel(sx, sy));
-      if (alpha) {
-        if (source_alpha) {
-          image.set_alpha(x, y, source.get_alpha(sx, sy));
-        } else {
-          image.set_alpha(x, y, 1.0);
-        }
-      }
-    }
+    source.clear(x_size, y_size, source_full.get_num_channels(),
+                 source_full.get_maxval());
+    TextureResampler::resample(source, source_full, swapTexture->get_txa_resize_filter(),
+                               swapTexture->get_properties()._srgb);
+    swapTexture->release_source_image();
   }
 
-  swapTexture->release_source_image();
+  // The swapped images have only ever honored clamp; everything else
+  // repeats.
+  EggTexture::WrapMode wrap_u =
+    (_placed._wrap_u == EggTexture::WM_clamp) ? EggTexture::WM_clamp : EggTexture::WM_repeat;
+  EggTexture::WrapMode wrap_v =
+    (_placed._wrap_v == EggTexture::WM_clamp) ? EggTexture::WM_clamp : EggTexture::WM_repeat;
+  copy_pixels(image, source, top, left, wrap_u, wrap_v);
 }
 
 /**
@@ -931,6 +929,235 @@ flag_error_image(PNMImage &image) {
   }
 }
 
+/**
+ * A support function for fill_image() and fill_swapped_image(), this copies
+ * the source image, already scaled to its final size, into the rectangle of
+ * the palette image reserved for this texture.  The source image's upper-left
+ * corner lands at pixel (left, top) of the palette; the pixels of the
+ * rectangle outside of that are filled in according to the wrap modes.
+ *
+ * The mapping from palette pixels to source pixels is computed just once for
+ * each axis, and runs of consecutive source pixels are copied a row span at a
+ * time.
+ */
+void TexturePlacement::
+copy_pixels(PNMImage &image, const PNMImage &source, int top, int left,
+            EggTexture::WrapMode wrap_u, EggTexture::WrapMode wrap_v) {
+  int x_size = source.get_x_size();
+  int y_size = source.get_y_size();
+  if (x_size == 0 || y_size == 0 || _placed._x_size <= 0 || _placed._y_size <= 0) {
+    return;
+  }
+
+  // Image rows run opposite to the v axis, so mirroring once about v = 0
+  // reflects about the bottom edge of the source image.
+  pvector<int> row_map, col_map;
+  compute_wrap_map(row_map, _placed._y - top, _placed._y_size, y_size,
+                   wrap_v, true);
+  compute_wrap_map(col_map, _placed._x - left, _placed._x_size, x_size,
+                   wrap_u, false);
+
+  // Break the columns up into spans that each read consecutive source
+  // pixels.  Columns that are skipped (-1) don't belong to any span.
+  pvector<CopySpan> spans;
+  int i = 0;
+  while (i < _placed._x_size) {
+    if (col_map[i] < 0) {
+      ++i;
+      continue;
+    }
+    CopySpan span;
+    span._x = _placed._x + i;
+    span._sx = col_map[i];
+    span._count = 1;
+    ++i;
+    while (i < _placed._x_size && col_map[i] == span._sx + span._count) {
+      ++span._count;
+      ++i;
+    }
+    spans.push_back(span);
+  }
+
+  bool alpha = image.has_alpha();
+  bool source_alpha = source.has_alpha();
+
+  if (image.get_maxval() == source.get_maxval() &&
+      image.get_color_space() == source.get_color_space()) {
+    // The pixel values mean the same thing in both images, so we can copy
+    // them directly.
+    int pal_x_size = image.get_x_size();
+    xel *dest_array = image.get_array();
+    const xel *source_array = source.get_array();
+    xelval *dest_alpha = alpha ? image.get_alpha_array() : nullptr;
+    const xelval *src_alpha = source_alpha ? source.get_alpha_array() : nullptr;
+    xelval opaque = image.get_maxval();
+
+    for (int j = 0; j < _placed._y_size; ++j) {
+      int sy = row_map[j];
+      if (sy < 0) {
+        continue;
+      }
+      size_t dest_row = (size_t)(_placed._y + j) * pal_x_size;
+      size_t source_row = (size_t)sy * x_size;
+
+      pvector<CopySpan>::const_iterator si;
+      for (si = spans.begin(); si != spans.end(); ++si) {
+        const CopySpan &span = (*si);
+        memcpy(dest_array + dest_row + span._x, source_array + source_row + span._sx,
+               span._count * sizeof(xel));
+        if (dest_alpha != nullptr) {
+          if (src_alpha != nullptr) {
+            memcpy(dest_alpha + dest_row + span._x, src_alpha + source_row + span._sx,
+                   span._count * sizeof(xelval));
+          } else {
+            std::fill(dest_alpha + dest_row + span._x,
+                      dest_alpha + dest_row + span._x + span._count, opaque);
+          }
+        }
+      }
+    }
+
+  } else {
+    // The images differ in their encoding, so each pixel has to be converted
+    // on its way across.
+    for (int j = 0; j < _placed._y_size; ++j) {
+      int sy = row_map[j];
+      if (sy < 0) {
+        continue;
+      }
+      int y = _placed._y + j;
+
+      pvector<CopySpan>::const_iterator si;
+      for (si = spans.begin(); si != spans.end(); ++si) {
+        const CopySpan &span = (*si);
+        for (int k = 0; k < span._count; ++k) {
+          int x = span._x + k;
+          int sx = span._sx + k;
+          image.set_xel(x, y, source.get_xel(sx, sy));
+          if (alpha) {
+            if (source_alpha) {
+              image.set_alpha(x, y, source.get_alpha(sx, sy));
+            } else {
+              image.set_alpha(x, y, 1.0);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * A support function for copy_pixels(), this fills map with the source pixel
+ * index to use for each of count consecutive palette pixels along one axis,
+ * the first of which is start pixels past the edge of the source image, of
+ * size pixels.  Pixels that are to be left alone receive -1.
+ *
+ * If inverted is true, the axis runs opposite to the texture coordinate it
+ * represents, which affects the side on which WM_mirror_once reflects.
+ */
+void TexturePlacement::
+compute_wrap_map(pvector<int> &map, int start, int count, int size,
+                 EggTexture::WrapMode wrap_mode, bool inverted) {
+  map.resize(count);
+  for (int i = 0; i < count; ++i) {
+    int s = start + i;
+
+    switch (wrap_mode) {
+    case EggTexture::WM_clamp:
+      // Clamp at [0, size).
+      s = max(min(s, size - 1), 0);
+      break;
+
+    case EggTexture::WM_mirror:
+      s = (s < 0) ? (size * 2) - 1 - ((-s - 1) % (size * 2)) : s % (size * 2);
+      s = (s < size) ? s : 2 * size - s - 1;
+      break;
+
+    case EggTexture::WM_mirror_once:
+      if (inverted) {
+        s = (s < size) ? s : 2 * size - s - 1;
+      } else {
+        s = (s >= 0) ? s : ~s;
+      }
+      // Fall through
+
+    case EggTexture::WM_border_color:
+      if (s < 0 || s >= size) {
+        s = -1;
+      }
+      break;
+
+    default:
+      // Wrap: sign-independent modulo.
+      s = (s < 0) ? size - 1 - ((-s - 1) % size) : s % size;
+      break;
+    }
+
+    map[i] = s;
+  }
+}
+
+/**
+ * A support function for is_fill_unchanged() and record_fill_hash(), this
+ * computes a hash of the contents of the source images that will be copied
+ * into the palette, along with the rectangle they are copied into and the
+ * properties of the texture and of the palette.  Returns 0 if any of the
+ * source images cannot be hashed.
+ */
+uint64_t TexturePlacement::
+compute_fill_hash() {
+  FnvHash hash;
+
+  uint64_t content_hash = get_source_content_hash(_texture);
+  if (content_hash == 0) {
+    return 0;
+  }
+  hash.add_word(content_hash);
+
+  TextureSwaps::const_iterator tsi;
+  for (tsi = _textureSwaps.begin(); tsi != _textureSwaps.end(); ++tsi) {
+    content_hash = get_source_content_hash(*tsi);
+    if (content_hash == 0) {
+      return 0;
+    }
+    hash.add_word(content_hash);
+  }
+
+  hash.add_word((uint64_t)_placed._x);
+  hash.add_word((uint64_t)_placed._y);
+  hash.add_word((uint64_t)_placed._x_size);
+  hash.add_word((uint64_t)_placed._y_size);
+  hash.add_word((uint64_t)_placed._margin);
+  hash.add_word((uint64_t)_placed._wrap_u);
+  hash.add_word((uint64_t)_placed._wrap_v);
+  hash.add_word((uint64_t)_texture->get_txa_resize_filter());
+  get_properties().add_hash(hash);
+  if (_image != nullptr) {
+    hash.add_word((uint64_t)_image->get_x_size());
+    hash.add_word((uint64_t)_image->get_y_size());
+    _image->get_properties().add_hash(hash);
+  }
+
+  return hash.get_nonzero_hash();
+}
+
+/**
+ * A support function for compute_fill_hash(), this returns the content hash
+ * of the indicated texture's preferred source image, or 0 if it has none.  The
+ * texture's lock is held while the hash is computed, since the same texture may
+ * be on another palette that is being generated at the same time.
+ */
+uint64_t TexturePlacement::
+get_source_content_hash(TextureImage *texture) {
+  MutexHolder holder(texture->get_source_lock());
+  SourceTextureImage *source = texture->get_preferred_source();
+  if (source == nullptr) {
+    return 0;
+  }
+  return source->get_content_hash();
+}
+
 /**
  * A support function for determine_size(), this computes the appropriate size
  * of the texture in pixels based on the UV coverage (as well as on the size
@@ -997,10 +1224,29 @@ register_with_read_factory() {
 void TexturePlacement::
 write_datagram(BamWriter *writer, Datagram &datagram) {
   TypedWritable::write_datagram(writer, datagram);
-  writer->write_pointer(datagram, _texture);
+
+  // In the shard of a sharded state, the objects that are kept in the index
+  // are written by name.  The references are not written at all; they are
+  // found again from the egg files in the index.
+  bool shard = (Palettizer::_write_state_part == Palettizer::SP_shard);
+  nassertv(Palettizer::_write_state_part != Palettizer::SP_index);
+
+  if (shard) {
+    datagram.add_string(_texture->get_name());
+  } else {
+    writer->write_pointer(datagram, _texture);
+  }
   writer->write_pointer(datagram, _group);
   writer->write_pointer(datagram, _image);
-  writer->write_pointer(datagram, _dest);
+  if (shard) {
+    if (_dest != nullptr) {
+      datagram.add_string(FilenameUnifier::make_bam_filename(_dest->get_filename()));
+    } else {
+      datagram.add_string(std::string());
+    }
+  } else {
+    writer->write_pointer(datagram, _dest);
+  }
 
   datagram.add_bool(_has_uvs);
   datagram.add_bool(_size_known);
@@ -1010,18 +1256,33 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   _placed.write_datagram(writer, datagram);
   datagram.add_int32((int)_omit_reason);
 
-  datagram.add_int32(_references.size());
-  References::const_iterator ri;
-  for (ri = _references.begin(); ri != _references.end(); ++ri) {
-    writer->write_pointer(datagram, (*ri));
+  if (!shard) {
+    // The references are ordered by pointer; write them in order by egg file
+    // and texture name instead, so that the same state always produces the
+    // same file.
+    pvector<TextureReference *> reference_vector(_references.begin(), _references.end());
+    sort(reference_vector.begin(), reference_vector.end(), SortReferencesByName());
+
+    datagram.add_int32(reference_vector.size());
+    pvector<TextureReference *>::const_iterator rvi;
+    for (rvi = reference_vector.begin(); rvi != reference_vector.end(); ++rvi) {
+      writer->write_pointer(datagram, (*rvi));
+    }
   }
 
   datagram.add_int32(_textureSwaps.size());
   TextureSwaps::const_iterator tsi;
   for (tsi = _textureSwaps.begin(); tsi != _textureSwaps.end(); ++tsi) {
-    writer->write_pointer(datagram, (*tsi));
+    if (shard) {
+      datagram.add_string((*tsi)->get_name());
+    } else {
+      writer->write_pointer(datagram, (*tsi));
+    }
   }
 
+  if (Palettizer::_pi_version >= 23) {
+    datagram.add_uint64(_fill_hash);
+  }
 }
 
 /**
@@ -1033,11 +1294,14 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
 int TexturePlacement::
 complete_pointers(TypedWritable **p_list, BamReader *manager) {
   int index = TypedWritable::complete_pointers(p_list, manager);
+  bool shard = (Palettizer::_read_state_part == Palettizer::SP_shard);
 
-  if (p_list[index] != nullptr) {
-    DCAST_INTO_R(_texture, p_list[index], index);
+  if (!shard) {
+    if (p_list[index] != nullptr) {
+      DCAST_INTO_R(_texture, p_list[index], index);
+    }
+    index++;
   }
-  index++;
 
   if (p_list[index] != nullptr) {
     DCAST_INTO_R(_group, p_list[index], index);
@@ -1049,10 +1313,12 @@ complete_pointers(TypedWritable **p_list, BamReader *manager) {
   }
   index++;
 
-  if (p_list[index] != nullptr) {
-    DCAST_INTO_R(_dest, p_list[index], index);
+  if (!shard) {
+    if (p_list[index] != nullptr) {
+      DCAST_INTO_R(_dest, p_list[index], index);
+    }
+    index++;
   }
-  index++;
 
   int i;
   for (i = 0; i < _num_references; i++) {
@@ -1095,11 +1361,23 @@ make_TexturePlacement(const FactoryParams &params) {
 void TexturePlacement::
 fillin(DatagramIterator &scan, BamReader *manager) {
   TypedWritable::fillin(scan, manager);
+  bool shard = (Palettizer::_read_state_part == Palettizer::SP_shard);
 
-  manager->read_pointer(scan);  // _texture
+  if (shard) {
+    _load_texture_name = scan.get_string();
+  } else {
+    manager->read_pointer(scan);  // _texture
+  }
   manager->read_pointer(scan);  // _group
   manager->read_pointer(scan);  // _image
-  manager->read_pointer(scan);  // _dest
+  if (shard) {
+    std::string dest_filename = scan.get_string();
+    if (!dest_filename.empty()) {
+      _load_dest_filename = FilenameUnifier::get_bam_filename(dest_filename);
+    }
+  } else {
+    manager->read_pointer(scan);  // _dest
+  }
 
   _has_uvs = scan.get_bool();
   _size_known = scan.get_bool();
@@ -1109,15 +1387,29 @@ fillin(DatagramIterator &scan, BamReader *manager) {
   _placed.fillin(scan, manager);
   _omit_reason = (OmitReason)scan.get_int32();
 
-  _num_references = scan.get_int32();
-  manager->read_pointers(scan, _num_references);
+  _num_references = 0;
+  if (!shard) {
+    _num_references = scan.get_int32();
+    manager->read_pointers(scan, _num_references);
+  }
 
   if (Palettizer::_read_pi_version >= 20) {
     _num_textureSwaps = scan.get_int32();
   } else {
     _num_textureSwaps = 0;
   }
-  manager->read_pointers(scan, _num_textureSwaps);
+  if (shard) {
+    for (int i = 0; i < _num_textureSwaps; i++) {
+      _load_swap_names.push_back(scan.get_string());
+    }
+    _num_textureSwaps = 0;
+  } else {
+    manager->read_pointers(scan, _num_textureSwaps);
+  }
+
+  if (Palettizer::_read_pi_version >= 23) {
+    _fill_hash = scan.get_uint64();
+  }
 }
 
 
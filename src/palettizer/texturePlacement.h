@@ -23,6 +23,7 @@
 #include "luse.h"
 
 #include "pset.h"
+#include "vector_string.h"
 
 class TextureImage;
 class DestTextureImage;
@@ -55,6 +56,9 @@ public:
   void remove_egg(TextureReference *reference);
   void mark_eggs_stale();
 
+  bool resolve_names(PaletteGroup *group);
+  void load_reference(TextureReference *reference);
+
   void set_dest(DestTextureImage *dest);
   DestTextureImage *get_dest() const;
 
@@ -86,6 +90,8 @@ public:
 
   bool is_filled() const;
   void mark_unfilled();
+  bool is_fill_unchanged();
+  void record_fill_hash();
   void fill_image(PNMImage &image);
   void fill_swapped_image(PNMImage &image, int index);
   void flag_error_image(PNMImage &image);
@@ -95,6 +101,21 @@ public:
 
 private:
   void compute_size_from_uvs(const LTexCoordd &min_uv, const LTexCoordd &max_uv);
+  uint64_t compute_fill_hash();
+  static uint64_t get_source_content_hash(TextureImage *texture);
+  void copy_pixels(PNMImage &image, const PNMImage &source, int top, int left,
+                   EggTexture::WrapMode wrap_u, EggTexture::WrapMode wrap_v);
+  static void compute_wrap_map(pvector<int> &map, int start, int count, int size,
+                               EggTexture::WrapMode wrap_mode, bool inverted);
+
+  // A run of palette pixels within one row that take their values from
+  // consecutive source pixels.
+  class CopySpan {
+  public:
+    int _x;
+    int _sx;
+    int _count;
+  };
 
   TextureImage *_texture;
   PaletteGroup *_group;
@@ -106,6 +127,7 @@ private:
   TexturePosition _position;
 
   bool _is_filled;
+  uint64_t _fill_hash;
   TexturePosition _placed;
   OmitReason _omit_reason;
 
@@ -129,6 +151,12 @@ private:
   int _num_references;
   int _num_textureSwaps;
 
+  // The names by which a shard of a sharded state refers to the objects in
+  // the index.  See resolve_names().
+  std::string _load_texture_name;
+  Filename _load_dest_filename;
+  vector_string _load_swap_names;
+
 public:
   static TypeHandle get_class_type() {
     return _type_handle;
@@ -550,6 +550,28 @@ egg_properties_match(const TextureProperties &other) const {
           _anisotropic_degree == other._anisotropic_degree);
 }
 
+/**
+ * Folds all of the properties into the indicated hash.  The image file types
+ * are hashed by name, so the result may be compared across sessions.
+ */
+void TextureProperties::
+add_hash(FnvHash &hash) const {
+  hash.add_word((uint64_t)_got_num_channels);
+  hash.add_word((uint64_t)_num_channels);
+  hash.add_word((uint64_t)_effective_num_channels);
+  hash.add_word((uint64_t)_format);
+  hash.add_word((uint64_t)_force_format);
+  hash.add_word((uint64_t)_generic_format);
+  hash.add_word((uint64_t)_keep_format);
+  hash.add_word((uint64_t)_minfilter);
+  hash.add_word((uint64_t)_magfilter);
+  hash.add_word((uint64_t)_quality_level);
+  hash.add_word((uint64_t)_anisotropic_degree);
+  hash.add_word((uint64_t)_srgb);
+  hash.add_string((_color_type != nullptr) ? _color_type->get_name() : string());
+  hash.add_string((_alpha_type != nullptr) ? _alpha_type->get_name() : string());
+}
+
 /**
  *
  */
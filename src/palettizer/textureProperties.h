@@ -16,6 +16,7 @@
 
 #include "pandatoolbase.h"
 
+#include "fnvHash.h"
 #include "eggTexture.h"
 #include "typedWritable.h"
 
@@ -48,6 +49,7 @@ public:
 
   void update_egg_tex(EggTexture *egg_tex) const;
   bool egg_properties_match(const TextureProperties &other) const;
+  void add_hash(FnvHash &hash) const;
 
   bool operator < (const TextureProperties &other) const;
   bool operator == (const TextureProperties &other) const;
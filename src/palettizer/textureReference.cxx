@@ -14,6 +14,7 @@
 #include "textureReference.h"
 #include "textureImage.h"
 #include "paletteImage.h"
+#include "paletteGroup.h"
 #include "sourceTextureImage.h"
 #include "destTextureImage.h"
 #include "texturePlacement.h"
@@ -34,6 +35,7 @@
 #include "string_utils.h"
 
 #include <math.h>
+#include <algorithm>
 
 using std::max;
 using std::min;
@@ -52,6 +54,7 @@ TextureReference() {
   _inv_tex_mat = LMatrix3d::ident_mat();
   _source_texture = nullptr;
   _placement = nullptr;
+  _pending_group = nullptr;
   _uses_alpha = false;
   _any_uvs = false;
   _min_uv.set(0.0, 0.0);
@@ -70,8 +73,13 @@ TextureReference::
 
 /**
  * Sets up the TextureReference using information extracted from an egg file.
+ * The UV range is not filled in until get_uv_ranges() is called.
+ *
+ * Returns true if successful, or false if the texture's name conflicts with
+ * that of an existing texture, in which case the Palettizer's _name_conflict
+ * flag is also set.
  */
-void TextureReference::
+bool TextureReference::
 from_egg(EggFile *egg_file, EggData *data, EggTexture *egg_tex) {
   _egg_file = egg_file;
   _egg_tex = egg_tex;
@@ -111,7 +119,8 @@ from_egg(EggFile *egg_file, EggData *data, EggTexture *egg_tex) {
     // Make this a hard error; refuse to do anything else until the user fixes
     // it.  Case conflicts can be very bad, especially if CVS is involved on a
     // Windows machine.
-    exit(1);
+    pal->_name_conflict = true;
+    return false;
   }
   _source_texture = texture->get_source(filename, alpha_filename,
                                         alpha_file_channel);
@@ -132,10 +141,9 @@ from_egg(EggFile *egg_file, EggData *data, EggTexture *egg_tex) {
     _uses_alpha = true;
   }
 
-  get_uv_range(_egg_data, pal->_remap_uv);
-
   _wrap_u = _egg_tex->determine_wrap_u();
   _wrap_v = _egg_tex->determine_wrap_v();
+  return true;
 }
 
 /**
@@ -306,6 +314,7 @@ is_equivalent(const TextureReference &other) const {
  */
 void TextureReference::
 set_placement(TexturePlacement *placement) {
+  _pending_group = nullptr;
   if (_placement != placement) {
     if (_placement != nullptr) {
       // Remove our reference from the old placement object.
@@ -337,6 +346,34 @@ get_placement() const {
   return _placement;
 }
 
+/**
+ * Returns the group of the TexturePlacement for this egg file, or NULL if
+ * there is none.  This is known even while the placement itself is in the
+ * shard of a sharded state that has not been read.
+ */
+PaletteGroup *TextureReference::
+get_placement_group() const {
+  if (_placement != nullptr) {
+    return _placement->get_group();
+  }
+  return _pending_group;
+}
+
+/**
+ * Looks up the TexturePlacement for this egg file, once the group it is in
+ * has been read from the shard of a sharded state.  This is called by
+ * Palettizer::load_groups().
+ */
+void TextureReference::
+resolve_placement() {
+  if (_pending_group != nullptr && _pending_group->is_loaded()) {
+    _placement = get_texture()->get_placement(_pending_group);
+    _pending_group = nullptr;
+    nassertv(_placement != nullptr);
+    _placement->load_reference(this);
+  }
+}
+
 /**
  * Marks the egg file that shares this reference as stale.
  */
@@ -350,19 +387,23 @@ mark_egg_stale() {
 /**
  * Updates the egg file with all the relevant information to reference the
  * texture in its new home, wherever that might be.
+ *
+ * The return value is true if the UV's on the geometry must also be
+ * translated to fit the palette; the caller should pass this reference to
+ * update_uv_ranges() along with the others from the same egg file.
  */
-void TextureReference::
+bool TextureReference::
 update_egg() {
   if (_egg_tex == nullptr) {
     // Not much we can do if we don't have an actual egg file to reference.
-    return;
+    return false;
   }
 
   if (_placement == nullptr) {
     // Nor if we don't have an actual placement yet.  This is possible if the
     // egg was assigned to the "null" group, and the texture hasn't been re-
     // assigned yet.
-    return;
+    return false;
   }
 
   TextureImage *texture = get_texture();
@@ -403,23 +444,23 @@ update_egg() {
     Filename orig_filename = _egg_tex->get_filename();
     texture->update_egg_tex(_egg_tex);
     _egg_tex->set_filename(orig_filename.get_basename());
-    return;
+    return false;
   }
   if (_placement->get_omit_reason() != OR_none) {
     // The texture exists but is not on a palette.  This is the easy case; we
     // simply have to update the texture reference to the new texture
     // location.
     DestTextureImage *dest = _placement->get_dest();
-    nassertv(dest != nullptr);
+    nassertr(dest != nullptr, false);
     dest->update_egg_tex(_egg_tex);
-    return;
+    return false;
   }
 
   // The texture *does* appear on a palette.  This means we need to not only
   // update the texture reference, but also adjust the UV's.  In most cases,
   // we can do this by simply applying a texture matrix to the reference.
   PaletteImage *image = _placement->get_image();
-  nassertv(image != nullptr);
+  nassertr(image != nullptr, false);
 
   image->update_egg_tex(_egg_tex);
 
@@ -437,11 +478,10 @@ update_egg() {
   // any.
   _egg_tex->set_transform2d(_tex_mat * new_tex_mat);
 
-  // Finally, go back and actually adjust the UV's to match what we claimed
-  // they could be.
-  if (_egg_tex->get_tex_gen() == EggTexture::TG_unspecified) {
-    update_uv_range(_egg_data, pal->_remap_uv);
-  }
+  // Finally, the UV's must be adjusted to match what we claimed they could
+  // be.  That is left to the caller, which does it for all of the egg file's
+  // references at once.
+  return (_egg_tex->get_tex_gen() == EggTexture::TG_unspecified);
 }
 
 /**
@@ -519,24 +559,77 @@ write(std::ostream &out, int indent_level) const {
 
 /**
  * Checks the geometry in the egg file to see what range of UV's are requested
- * for this particular texture reference.
+ * for each of the indicated texture references, all of which must have been
+ * initialized via from_egg() with the same egg data.  The hierarchy is walked
+ * just once, no matter how many references there are.
  *
  * If pal->_remap_uv is not RU_never, this will also attempt to remap the UV's
  * found so that the midpoint lies in the unit square (0,0) - (1,1), in the
  * hopes of maximizing overlap of UV coordinates between different polygons.
  * However, the hypothetical translations are not actually applied to the egg
  * file at this point (because we might decide not to place the texture in a
- * palette); they will actually be applied when update_uv_range(), below, is
+ * palette); they will actually be applied when update_uv_ranges(), below, is
  * called later.
+ */
+void TextureReference::
+get_uv_ranges(EggGroupNode *group, const References &refs) {
+  if (refs.empty()) {
+    return;
+  }
+  UVScan scan(refs);
+  get_uv_range(scan, group, pal->_remap_uv);
+}
+
+/**
+ * Actually applies the UV translates that were assumed in the previous call
+ * to get_uv_ranges(), for each of the indicated texture references.  The
+ * references are processed in the order given.
+ */
+void TextureReference::
+update_uv_ranges(EggGroupNode *group, const References &refs) {
+  if (refs.empty()) {
+    return;
+  }
+  UVScan scan(refs);
+  update_uv_range(scan, group, pal->_remap_uv);
+}
+
+/**
  *
- * The return value is true if the search should continue, or false if it
- * should abort prematurely.
  */
-bool TextureReference::
-get_uv_range(EggGroupNode *group, Palettizer::RemapUV remap) {
+TextureReference::UVScan::
+UVScan(const References &refs) :
+  _refs(refs),
+  _group_ranges(refs.size()),
+  _group_prims(refs.size()),
+  _done(refs.size(), false)
+{
+  for (size_t i = 0; i < refs.size(); ++i) {
+    _index[refs[i]->_egg_tex] = (int)i;
+  }
+}
+
+/**
+ * Returns the index within _refs of the reference to the indicated texture,
+ * or -1 if the texture is not one we are scanning for.
+ */
+int TextureReference::UVScan::
+find(EggTexture *egg_tex) const {
+  Index::const_iterator ii = _index.find(egg_tex);
+  if (ii == _index.end()) {
+    return -1;
+  }
+  return (*ii).second;
+}
+
+/**
+ * The recursive implementation of get_uv_ranges().
+ */
+void TextureReference::
+get_uv_range(UVScan &scan, EggGroupNode *group, Palettizer::RemapUV remap) {
   if (group->is_of_type(EggGroup::get_class_type())) {
     EggGroup *egg_group;
-    DCAST_INTO_R(egg_group, group, false);
+    DCAST_INTO_V(egg_group, group);
 
     if (egg_group->get_dart_type() != EggGroup::DT_none) {
       // If it's a character, we might change the kind of remapping we do.
@@ -544,87 +637,106 @@ get_uv_range(EggGroupNode *group, Palettizer::RemapUV remap) {
     }
   }
 
-  bool group_any_uvs = false;
-  LTexCoordd group_min_uv, group_max_uv;
-
   EggGroupNode::iterator ci;
   for (ci = group->begin(); ci != group->end(); ci++) {
     EggNode *child = (*ci);
     if (child->is_of_type(EggNurbsSurface::get_class_type())) {
       EggNurbsSurface *nurbs = DCAST(EggNurbsSurface, child);
-      if (nurbs->has_texture(_egg_tex)) {
-        // Here's a NURBS surface that references the texture.  Unlike other
-        // kinds of geometries, NURBS don't store UV's; they're implicit in
-        // the surface.  NURBS UV's will always run in the range (0, 0) - (1,
-        // 1).  However, we do need to apply the texture matrix.
-
-        // We also don't count the NURBS surfaces in with the group's UV's,
-        // because we can't adjust the UV's on a NURBS, so counting them up
-        // would be misleading (the reason we count up the group UV's is so we
-        // can consider adjusting them later).  Instead, we just accumulate
-        // the NURBS UV's directly into our total.
-        collect_nominal_uv_range();
+      int num_textures = nurbs->get_num_textures();
+      for (int ti = 0; ti < num_textures; ++ti) {
+        int i = scan.find(nurbs->get_texture(ti));
+        if (i >= 0 && !scan._done[i]) {
+          // Here's a NURBS surface that references the texture.  Unlike
+          // other kinds of geometries, NURBS don't store UV's; they're
+          // implicit in the surface.  NURBS UV's will always run in the range
+          // (0, 0) - (1, 1).  However, we do need to apply the texture
+          // matrix.
+
+          // We also don't count the NURBS surfaces in with the group's UV's,
+          // because we can't adjust the UV's on a NURBS, so counting them up
+          // would be misleading (the reason we count up the group UV's is so
+          // we can consider adjusting them later).  Instead, we just
+          // accumulate the NURBS UV's directly into our total.
+          scan._refs[i]->collect_nominal_uv_range();
+        }
       }
 
     } else if (child->is_of_type(EggPrimitive::get_class_type())) {
       EggPrimitive *geom = DCAST(EggPrimitive, child);
-      if (geom->has_texture(_egg_tex)) {
+      int num_textures = geom->get_num_textures();
+      for (int ti = 0; ti < num_textures; ++ti) {
+        int i = scan.find(geom->get_texture(ti));
+        if (i < 0 || scan._done[i]) {
+          continue;
+        }
+
         // Here's a piece of geometry that references this texture.  Walk
         // through its vertices and get its UV's.
-
-        if (_egg_tex->get_tex_gen() != EggTexture::TG_unspecified) {
+        TextureReference *ref = scan._refs[i];
+        if (ref->_egg_tex->get_tex_gen() != EggTexture::TG_unspecified) {
           // If the texture has a TexGen mode, we don't check the UV range on
           // the model, since that doesn't matter.  Instead, we assume the
           // texture is used in the range (0, 0) - (1, 1), which will be true
           // for a sphere map, although the effective range is a little less
           // clear for the TG_world_position and similar modes.
-          collect_nominal_uv_range();
+          ref->collect_nominal_uv_range();
 
-          // In fact, now we can return, having found at least one model that
-          // references the texture; there's no need to search further.
-          return false;
+          // In fact, having found at least one model that references the
+          // texture, there's no need to look at this texture any further.
+          scan._done[i] = true;
 
         } else {
           LTexCoordd geom_min_uv, geom_max_uv;
 
-          if (get_geom_uvs(geom, geom_min_uv, geom_max_uv)) {
+          if (ref->get_geom_uvs(geom, geom_min_uv, geom_max_uv)) {
             if (remap == Palettizer::RU_poly) {
               LVector2d trans = translate_uv(geom_min_uv, geom_max_uv);
               geom_min_uv += trans;
               geom_max_uv += trans;
             }
-            collect_uv(group_any_uvs, group_min_uv, group_max_uv,
+            UVScan::GroupRange &range = scan._group_ranges[i];
+            if (!range._any_uvs) {
+              scan._touched.push_back(i);
+            }
+            collect_uv(range._any_uvs, range._min_uv, range._max_uv,
                        geom_min_uv, geom_max_uv);
           }
         }
       }
-
-    } else if (child->is_of_type(EggGroupNode::get_class_type())) {
-      EggGroupNode *cg = DCAST(EggGroupNode, child);
-      if (!get_uv_range(cg, remap)) {
-        return false;
-      }
     }
   }
 
-  if (group_any_uvs) {
+  // Now fold this group's UV's into the total for each texture it used,
+  // before we go on to reuse the per-group ranges for the child groups.
+  pvector<int>::const_iterator ii;
+  for (ii = scan._touched.begin(); ii != scan._touched.end(); ++ii) {
+    UVScan::GroupRange &range = scan._group_ranges[*ii];
     if (remap == Palettizer::RU_group) {
-      LVector2d trans = translate_uv(group_min_uv, group_max_uv);
-      group_min_uv += trans;
-      group_max_uv += trans;
+      LVector2d trans = translate_uv(range._min_uv, range._max_uv);
+      range._min_uv += trans;
+      range._max_uv += trans;
     }
-    collect_uv(_any_uvs, _min_uv, _max_uv, group_min_uv, group_max_uv);
+    TextureReference *ref = scan._refs[*ii];
+    collect_uv(ref->_any_uvs, ref->_min_uv, ref->_max_uv,
+               range._min_uv, range._max_uv);
+    range._any_uvs = false;
   }
+  scan._touched.clear();
 
-  return true;
+  for (ci = group->begin(); ci != group->end(); ci++) {
+    EggNode *child = (*ci);
+    if (child->is_of_type(EggGroupNode::get_class_type())) {
+      EggGroupNode *cg = DCAST(EggGroupNode, child);
+      get_uv_range(scan, cg, remap);
+    }
+  }
 }
 
 /**
- * Actually applies the UV translates that were assumed in the previous call
- * to get_uv_range().
+ * The recursive implementation of update_uv_ranges().
  */
 void TextureReference::
-update_uv_range(EggGroupNode *group, Palettizer::RemapUV remap) {
+update_uv_range(UVScan &scan, EggGroupNode *group, Palettizer::RemapUV remap) {
   if (group->is_of_type(EggGroup::get_class_type())) {
     EggGroup *egg_group;
     DCAST_INTO_V(egg_group, group);
@@ -635,56 +747,84 @@ update_uv_range(EggGroupNode *group, Palettizer::RemapUV remap) {
     }
   }
 
-  bool group_any_uvs = false;
-  LTexCoordd group_min_uv, group_max_uv;
-
   EggGroupNode::iterator ci;
-  for (ci = group->begin(); ci != group->end(); ci++) {
-    EggNode *child = (*ci);
-    if (child->is_of_type(EggNurbsSurface::get_class_type())) {
-      // We do nothing at this point for a Nurbs.  Nothing we can do about
-      // these things.
-
-    } else if (child->is_of_type(EggPrimitive::get_class_type())) {
-      if (remap != Palettizer::RU_never) {
+  if (remap != Palettizer::RU_never) {
+    // First, sort the primitives in this group by the textures they
+    // reference.  We do nothing at this point for a Nurbs; nothing we can do
+    // about these things.
+    for (ci = group->begin(); ci != group->end(); ci++) {
+      EggNode *child = (*ci);
+      if (child->is_of_type(EggPrimitive::get_class_type()) &&
+          !child->is_of_type(EggNurbsSurface::get_class_type())) {
         EggPrimitive *geom = DCAST(EggPrimitive, child);
-        if (geom->has_texture(_egg_tex)) {
-          LTexCoordd geom_min_uv, geom_max_uv;
-
-          if (get_geom_uvs(geom, geom_min_uv, geom_max_uv)) {
-            if (remap == Palettizer::RU_poly) {
-              LVector2d trans = translate_uv(geom_min_uv, geom_max_uv);
-              trans = trans * _inv_tex_mat;
-              if (!trans.almost_equal(LVector2d::zero())) {
-                translate_geom_uvs(geom, trans);
-              }
-            } else {
-              collect_uv(group_any_uvs, group_min_uv, group_max_uv,
-                         geom_min_uv, geom_max_uv);
+        int num_textures = geom->get_num_textures();
+        for (int ti = 0; ti < num_textures; ++ti) {
+          int i = scan.find(geom->get_texture(ti));
+          if (i >= 0) {
+            pvector<EggPrimitive *> &prims = scan._group_prims[i];
+            if (prims.empty()) {
+              scan._touched.push_back(i);
+            }
+            if (prims.empty() || prims.back() != geom) {
+              prims.push_back(geom);
             }
           }
         }
       }
-
-    } else if (child->is_of_type(EggGroupNode::get_class_type())) {
-      EggGroupNode *cg = DCAST(EggGroupNode, child);
-      update_uv_range(cg, remap);
     }
-  }
 
-  if (group_any_uvs && remap == Palettizer::RU_group) {
-    LVector2d trans = translate_uv(group_min_uv, group_max_uv);
-    trans = trans * _inv_tex_mat;
-    if (!trans.almost_equal(LVector2d::zero())) {
-      for (ci = group->begin(); ci != group->end(); ci++) {
-        EggNode *child = (*ci);
-        if (child->is_of_type(EggPrimitive::get_class_type())) {
-          EggPrimitive *geom = DCAST(EggPrimitive, child);
-          if (geom->has_texture(_egg_tex)) {
-            translate_geom_uvs(geom, trans);
+    // Then translate each texture's primitives in turn, in the order the
+    // references were given, so that primitives sharing a UV name are
+    // adjusted in a consistent order.
+    sort(scan._touched.begin(), scan._touched.end());
+
+    pvector<int>::const_iterator ii;
+    for (ii = scan._touched.begin(); ii != scan._touched.end(); ++ii) {
+      TextureReference *ref = scan._refs[*ii];
+      pvector<EggPrimitive *> &prims = scan._group_prims[*ii];
+
+      bool group_any_uvs = false;
+      LTexCoordd group_min_uv, group_max_uv;
+
+      pvector<EggPrimitive *>::const_iterator pi;
+      for (pi = prims.begin(); pi != prims.end(); ++pi) {
+        EggPrimitive *geom = (*pi);
+        LTexCoordd geom_min_uv, geom_max_uv;
+
+        if (ref->get_geom_uvs(geom, geom_min_uv, geom_max_uv)) {
+          if (remap == Palettizer::RU_poly) {
+            LVector2d trans = translate_uv(geom_min_uv, geom_max_uv);
+            trans = trans * ref->_inv_tex_mat;
+            if (!trans.almost_equal(LVector2d::zero())) {
+              ref->translate_geom_uvs(geom, trans);
+            }
+          } else {
+            collect_uv(group_any_uvs, group_min_uv, group_max_uv,
+                       geom_min_uv, geom_max_uv);
+          }
+        }
+      }
+
+      if (group_any_uvs && remap == Palettizer::RU_group) {
+        LVector2d trans = translate_uv(group_min_uv, group_max_uv);
+        trans = trans * ref->_inv_tex_mat;
+        if (!trans.almost_equal(LVector2d::zero())) {
+          for (pi = prims.begin(); pi != prims.end(); ++pi) {
+            ref->translate_geom_uvs(*pi, trans);
           }
         }
       }
+
+      prims.clear();
+    }
+    scan._touched.clear();
+  }
+
+  for (ci = group->begin(); ci != group->end(); ci++) {
+    EggNode *child = (*ci);
+    if (child->is_of_type(EggGroupNode::get_class_type())) {
+      EggGroupNode *cg = DCAST(EggGroupNode, child);
+      update_uv_range(scan, cg, remap);
     }
   }
 }
@@ -811,7 +951,14 @@ write_datagram(BamWriter *writer, Datagram &datagram) {
   _inv_tex_mat.write_datagram(datagram);
 
   writer->write_pointer(datagram, _source_texture);
-  writer->write_pointer(datagram, _placement);
+  if (Palettizer::_write_state_part == Palettizer::SP_index) {
+    // The placement is in the shard of its group; the index records only the
+    // group, and resolve_placement() finds the placement again.
+    writer->write_pointer(datagram, get_placement_group());
+  } else {
+    nassertv(_pending_group == nullptr);
+    writer->write_pointer(datagram, _placement);
+  }
 
   datagram.add_bool(_uses_alpha);
   datagram.add_bool(_any_uvs);
@@ -845,7 +992,11 @@ complete_pointers(TypedWritable **p_list, BamReader *manager) {
   pi++;
 
   if (p_list[pi] != nullptr) {
-    DCAST_INTO_R(_placement, p_list[pi], pi);
+    if (Palettizer::_read_state_part == Palettizer::SP_index) {
+      DCAST_INTO_R(_pending_group, p_list[pi], pi);
+    } else {
+      DCAST_INTO_R(_placement, p_list[pi], pi);
+    }
   }
   pi++;
 
@@ -887,7 +1038,7 @@ fillin(DatagramIterator &scan, BamReader *manager) {
   _inv_tex_mat.read_datagram(scan);
 
   manager->read_pointer(scan);  // _source_texture
-  manager->read_pointer(scan);  // _placement
+  manager->read_pointer(scan);  // _placement or _pending_group
 
   _uses_alpha = scan.get_bool();
   _any_uvs = scan.get_bool();
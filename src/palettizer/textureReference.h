@@ -21,6 +21,8 @@
 
 #include "luse.h"
 #include "typedWritable.h"
+#include "pvector.h"
+#include "pmap.h"
 
 class TextureImage;
 class SourceTextureImage;
@@ -31,6 +33,7 @@ class EggTexture;
 class EggGroupNode;
 class EggPrimitive;
 class TexturePlacement;
+class PaletteGroup;
 
 /**
  * This is the particular reference of a texture filename by an egg file.  It
@@ -42,7 +45,7 @@ public:
   TextureReference();
   ~TextureReference();
 
-  void from_egg(EggFile *egg_file, EggData *data, EggTexture *egg_tex);
+  bool from_egg(EggFile *egg_file, EggData *data, EggTexture *egg_tex);
   void from_egg_quick(const TextureReference &other);
   void release_egg_data();
   void rebind_egg_data(EggData *data, EggTexture *egg_tex);
@@ -66,18 +69,55 @@ public:
   void set_placement(TexturePlacement *placement);
   void clear_placement();
   TexturePlacement *get_placement() const;
+  PaletteGroup *get_placement_group() const;
+  void resolve_placement();
 
   void mark_egg_stale();
-  void update_egg();
+  bool update_egg();
   void apply_properties_to_source();
 
   void output(std::ostream &out) const;
   void write(std::ostream &out, int indent_level = 0) const;
 
 
+  typedef pvector<TextureReference *> References;
+  static void get_uv_ranges(EggGroupNode *group, const References &refs);
+  static void update_uv_ranges(EggGroupNode *group, const References &refs);
+
 private:
-  bool get_uv_range(EggGroupNode *group, Palettizer::RemapUV remap);
-  void update_uv_range(EggGroupNode *group, Palettizer::RemapUV remap);
+  // This holds the state of one walk through the egg hierarchy on behalf of
+  // several TextureReferences at once.  Each primitive is bucketed by the
+  // textures it references, so the walk costs the same however many
+  // textures there are.
+  class UVScan {
+  public:
+    UVScan(const References &refs);
+    int find(EggTexture *egg_tex) const;
+
+    class GroupRange {
+    public:
+      GroupRange() : _any_uvs(false) {}
+      bool _any_uvs;
+      LTexCoordd _min_uv, _max_uv;
+    };
+
+    const References &_refs;
+    typedef pmap<EggTexture *, int> Index;
+    Index _index;
+
+    // These are indexed by the position of the reference in _refs.
+    pvector<GroupRange> _group_ranges;
+    pvector<pvector<EggPrimitive *> > _group_prims;
+    pvector<bool> _done;
+
+    // The references that have been seen within the current group.
+    pvector<int> _touched;
+  };
+
+  static void get_uv_range(UVScan &scan, EggGroupNode *group,
+                           Palettizer::RemapUV remap);
+  static void update_uv_range(UVScan &scan, EggGroupNode *group,
+                              Palettizer::RemapUV remap);
 
   bool get_geom_uvs(EggPrimitive *geom,
                     LTexCoordd &geom_min_uv, LTexCoordd &geom_max_uv);
@@ -98,6 +138,10 @@ private:
   SourceTextureImage *_source_texture;
   TexturePlacement *_placement;
 
+  // The group of the placement, while that group is in the shard of a
+  // sharded state that has not been read this session.
+  PaletteGroup *_pending_group;
+
   bool _uses_alpha;
 
   bool _any_uvs;
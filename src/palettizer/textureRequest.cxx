@@ -35,6 +35,7 @@ TextureRequest() {
   _alpha_mode = EggRenderMode::AM_unspecified;
   _wrap_u = EggTexture::WM_unspecified;
   _wrap_v = EggTexture::WM_unspecified;
+  _resize_filter = TextureResampler::F_unspecified;
   _omit = false;
   _margin = 0;
   _coverage_threshold = 0.0;
@@ -20,6 +20,7 @@
 
 #include "eggTexture.h"
 #include "eggRenderMode.h"
+#include "textureResampler.h"
 
 /**
  * These are the things that a user might explicitly request to adjust on a
@@ -47,6 +48,7 @@ public:
   int _anisotropic_degree;
   EggRenderMode::AlphaMode _alpha_mode;
   EggTexture::WrapMode _wrap_u, _wrap_v;
+  TextureResampler::Filter _resize_filter;
   bool _omit;
   int _margin;
   double _coverage_threshold;
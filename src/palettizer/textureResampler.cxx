@@ -0,0 +1,372 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file textureResampler.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "textureResampler.h"
+
+#include "pnmImage.h"
+#include "string_utils.h"
+#include "mathNumbers.h"
+
+#include <algorithm>
+#include <math.h>
+
+using std::max;
+using std::min;
+
+// The number of lobes on either side of the center of the Lanczos filter.
+static const int lanczos_lobes = 3;
+
+/**
+ * Returns the value of the Lanczos kernel at x.
+ */
+static float
+lanczos_kernel(float x) {
+  if (x == 0.0f) {
+    return 1.0f;
+  }
+  if (x <= -lanczos_lobes || x >= lanczos_lobes) {
+    return 0.0f;
+  }
+  float px = (float)MathNumbers::pi * x;
+  return lanczos_lobes * sinf(px) * sinf(px / lanczos_lobes) / (px * px);
+}
+
+/**
+ * Converts the indicated sRGB-encoded value in the range [0, 1] to linear.
+ */
+static float
+decode_srgb(float value) {
+  if (value <= 0.04045f) {
+    return value * (1.0f / 12.92f);
+  }
+  return powf((value + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+/**
+ * Converts the indicated linear value in the range [0, 1] to sRGB.
+ */
+static float
+encode_srgb(float value) {
+  if (value <= 0.0031308f) {
+    return value * 12.92f;
+  }
+  return 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Scales the indicated filtered value, in the range [0, 1], to the nearest
+ * integer pixel value within the range [0, maxval].
+ */
+static xelval
+to_xelval(float value, xelval maxval) {
+  if (value <= 0.0f) {
+    return 0;
+  }
+  int result = (int)(value * maxval + 0.5f);
+  return (xelval)min(result, (int)maxval);
+}
+
+/**
+ * Fills dest, which must already have been set to the desired size, with the
+ * source image scaled to fit, using the indicated filter.
+ *
+ * The filters average the pixels in linear light: if srgb is true, or the
+ * source image says it is sRGB-encoded, the color values are decoded from
+ * sRGB first and encoded again afterwards.  If both images have alpha, the
+ * colors are also weighted by alpha while they are averaged, so that the
+ * colors of transparent pixels do not bleed into their neighbors.
+ */
+void TextureResampler::
+resample(PNMImage &dest, const PNMImage &source, Filter filter, bool srgb) {
+  int dest_x_size = dest.get_x_size();
+  int dest_y_size = dest.get_y_size();
+  int source_x_size = source.get_x_size();
+  int source_y_size = source.get_y_size();
+
+  if (filter == F_unspecified || filter == F_point ||
+      (dest_x_size == source_x_size && dest_y_size == source_y_size)) {
+    // Point sampling is the best we can do for these; and when the size is
+    // unchanged, it is also an exact copy.
+    dest.quick_filter_from(source);
+    return;
+  }
+
+  if (dest_x_size == 0 || dest_y_size == 0 ||
+      source_x_size == 0 || source_y_size == 0) {
+    return;
+  }
+
+  Contributions cols, rows;
+  compute_contributions(cols, dest_x_size, source_x_size, filter);
+  compute_contributions(rows, dest_y_size, source_y_size, filter);
+
+  // The image is filtered in two passes: first horizontally, from each
+  // source row into a row of four floats per pixel, and then vertically,
+  // into dest.  The destination rows need overlapping, ascending ranges of
+  // source rows, so only a sliding window of the horizontally filtered rows
+  // is kept, in a ring buffer indexed by source row.
+  size_t window_rows = 1;
+  Contributions::const_iterator ci;
+  for (ci = rows.begin(); ci != rows.end(); ++ci) {
+    window_rows = max(window_rows, (*ci)._weights.size());
+  }
+
+  size_t row_floats = (size_t)dest_x_size * 4;
+  pvector<float> window(window_rows * row_floats);
+  pvector<float> row((size_t)source_x_size * 4);
+  pvector<float> sum(row_floats);
+
+  const xel *source_array = source.get_array();
+  const xelval *source_alpha_array = source.has_alpha() ? source.get_alpha_array() : nullptr;
+
+  xel *dest_array = dest.get_array();
+  xelval *dest_alpha_array = dest.has_alpha() ? dest.get_alpha_array() : nullptr;
+  xelval dest_maxval = dest.get_maxval();
+
+  nassertv(source_array != nullptr && dest_array != nullptr);
+
+  srgb = srgb || source.get_color_space() == CS_sRGB;
+
+  // If the alpha is not kept, the colors are averaged as they are, since
+  // weighting them by alpha would lose the colors of transparent pixels.
+  bool premultiply = (source_alpha_array != nullptr && dest_alpha_array != nullptr);
+
+  // Each possible source value is converted to a float in [0, 1] through a
+  // table, which also decodes the color values from sRGB.
+  xelval source_maxval = source.get_maxval();
+  pvector<float> color_table((size_t)source_maxval + 1);
+  pvector<float> alpha_table((size_t)source_maxval + 1);
+  for (size_t i = 0; i <= (size_t)source_maxval; ++i) {
+    float value = (float)i / (float)source_maxval;
+    alpha_table[i] = value;
+    color_table[i] = srgb ? decode_srgb(value) : value;
+  }
+
+  int next_row = 0;
+  for (int dy = 0; dy < dest_y_size; ++dy) {
+    const Contribution &contrib = rows[dy];
+    int end_row = contrib._start + (int)contrib._weights.size();
+    nassertv(end_row >= next_row);
+    next_row = max(next_row, contrib._start);
+
+    // Filter horizontally any source rows that have entered the window.
+    for (; next_row < end_row; ++next_row) {
+      const xel *sp = source_array + (size_t)next_row * source_x_size;
+      float *p = &row[0];
+      if (premultiply) {
+        const xelval *ap = source_alpha_array + (size_t)next_row * source_x_size;
+        for (int x = 0; x < source_x_size; ++x) {
+          float a = alpha_table[ap[x]];
+          p[0] = color_table[PPM_GETR(sp[x])] * a;
+          p[1] = color_table[PPM_GETG(sp[x])] * a;
+          p[2] = color_table[PPM_GETB(sp[x])] * a;
+          p[3] = a;
+          p += 4;
+        }
+      } else if (source_alpha_array != nullptr) {
+        const xelval *ap = source_alpha_array + (size_t)next_row * source_x_size;
+        for (int x = 0; x < source_x_size; ++x) {
+          p[0] = color_table[PPM_GETR(sp[x])];
+          p[1] = color_table[PPM_GETG(sp[x])];
+          p[2] = color_table[PPM_GETB(sp[x])];
+          p[3] = alpha_table[ap[x]];
+          p += 4;
+        }
+      } else {
+        for (int x = 0; x < source_x_size; ++x) {
+          p[0] = color_table[PPM_GETR(sp[x])];
+          p[1] = color_table[PPM_GETG(sp[x])];
+          p[2] = color_table[PPM_GETB(sp[x])];
+          p[3] = 1.0f;
+          p += 4;
+        }
+      }
+
+      float *out = &window[(size_t)(next_row % window_rows) * row_floats];
+      for (int dx = 0; dx < dest_x_size; ++dx) {
+        const Contribution &col = cols[dx];
+        const float *q = &row[(size_t)col._start * 4];
+        float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+        size_t num_weights = col._weights.size();
+        for (size_t k = 0; k < num_weights; ++k) {
+          float w = col._weights[k];
+          r += w * q[0];
+          g += w * q[1];
+          b += w * q[2];
+          a += w * q[3];
+          q += 4;
+        }
+        out[0] = r;
+        out[1] = g;
+        out[2] = b;
+        out[3] = a;
+        out += 4;
+      }
+    }
+
+    // The vertical pass sums whole rows at a time, which the compiler can
+    // vectorize.
+    std::fill(sum.begin(), sum.end(), 0.0f);
+    float *s = &sum[0];
+
+    size_t num_weights = contrib._weights.size();
+    for (size_t k = 0; k < num_weights; ++k) {
+      float w = contrib._weights[k];
+      const float *t = &window[((contrib._start + k) % window_rows) * row_floats];
+      for (size_t i = 0; i < row_floats; ++i) {
+        s[i] += w * t[i];
+      }
+    }
+
+    // Undo the alpha weighting and the sRGB decoding.  The Lanczos filter
+    // can ring outside of [0, 1], so the values are clamped first.
+    for (int dx = 0; dx < dest_x_size; ++dx) {
+      float *p = s + (size_t)dx * 4;
+      float a = min(max(p[3], 0.0f), 1.0f);
+      p[3] = a;
+      float inv_a = (premultiply && a > 0.0f) ? 1.0f / a : 1.0f;
+      for (int c = 0; c < 3; ++c) {
+        float value = min(max(p[c] * inv_a, 0.0f), 1.0f);
+        p[c] = srgb ? encode_srgb(value) : value;
+      }
+    }
+
+    xel *dp = dest_array + (size_t)dy * dest_x_size;
+    for (int dx = 0; dx < dest_x_size; ++dx) {
+      const float *p = s + (size_t)dx * 4;
+      PPM_ASSIGN(dp[dx],
+                 to_xelval(p[0], dest_maxval),
+                 to_xelval(p[1], dest_maxval),
+                 to_xelval(p[2], dest_maxval));
+    }
+    if (dest_alpha_array != nullptr) {
+      xelval *ap = dest_alpha_array + (size_t)dy * dest_x_size;
+      for (int dx = 0; dx < dest_x_size; ++dx) {
+        ap[dx] = to_xelval(s[(size_t)dx * 4 + 3], dest_maxval);
+      }
+    }
+  }
+}
+
+/**
+ * Returns the Filter corresponding to the indicated string, as it might
+ * appear in a .txa file, or F_unspecified if the string does not name a
+ * filter.
+ */
+TextureResampler::Filter TextureResampler::
+string_filter(const std::string &string) {
+  if (cmp_nocase(string, "point") == 0) {
+    return F_point;
+
+  } else if (cmp_nocase(string, "box") == 0) {
+    return F_box;
+
+  } else if (cmp_nocase(string, "lanczos") == 0) {
+    return F_lanczos;
+
+  } else {
+    return F_unspecified;
+  }
+}
+
+/**
+ * Computes, for each of the dest_size pixels along one axis of the
+ * destination image, the range of source pixels that contribute to it and
+ * their normalized weights.
+ */
+void TextureResampler::
+compute_contributions(Contributions &contribs, int dest_size, int source_size,
+                      Filter filter) {
+  contribs.clear();
+  contribs.resize(dest_size);
+
+  double scale = (double)source_size / (double)dest_size;
+
+  for (int i = 0; i < dest_size; ++i) {
+    Contribution &contrib = contribs[i];
+
+    if (filter == F_lanczos) {
+      // When shrinking, the filter is stretched to cover the footprint of
+      // the destination pixel.
+      double filter_scale = max(scale, 1.0);
+      double support = lanczos_lobes * filter_scale;
+      double center = (i + 0.5) * scale - 0.5;
+
+      int first = (int)ceil(center - support);
+      int last = (int)floor(center + support);
+      int lo = max(first, 0);
+      int hi = min(last, source_size - 1);
+
+      // Taps that fall off the edge of the image are folded onto the
+      // nearest edge pixel.
+      contrib._start = lo;
+      contrib._weights.assign(hi - lo + 1, 0.0f);
+      for (int k = first; k <= last; ++k) {
+        int sk = max(min(k, hi), lo);
+        contrib._weights[sk - lo] += lanczos_kernel((float)((k - center) / filter_scale));
+      }
+
+    } else {
+      // A box filter: weight each source pixel by how much of it falls
+      // within the destination pixel.
+      double lo = i * scale;
+      double hi = (i + 1) * scale;
+      int first = max((int)floor(lo), 0);
+      int last = min((int)ceil(hi), source_size) - 1;
+
+      contrib._start = first;
+      contrib._weights.assign(max(last - first + 1, 1), 0.0f);
+      for (int k = first; k <= last; ++k) {
+        double overlap = min(hi, (double)(k + 1)) - max(lo, (double)k);
+        contrib._weights[k - first] = (float)max(overlap, 0.0);
+      }
+    }
+
+    // Normalize the weights so that they sum to one.
+    float total = 0.0f;
+    pvector<float>::const_iterator wi;
+    for (wi = contrib._weights.begin(); wi != contrib._weights.end(); ++wi) {
+      total += (*wi);
+    }
+    if (total != 0.0f) {
+      pvector<float>::iterator wj;
+      for (wj = contrib._weights.begin(); wj != contrib._weights.end(); ++wj) {
+        (*wj) /= total;
+      }
+    } else {
+      contrib._weights.assign(1, 1.0f);
+    }
+  }
+}
+
+/**
+ *
+ */
+std::ostream &
+operator << (std::ostream &out, TextureResampler::Filter filter) {
+  switch (filter) {
+  case TextureResampler::F_unspecified:
+    return out << "unspecified";
+
+  case TextureResampler::F_point:
+    return out << "point";
+
+  case TextureResampler::F_box:
+    return out << "box";
+
+  case TextureResampler::F_lanczos:
+    return out << "lanczos";
+  }
+
+  return out << "**invalid filter(" << (int)filter << ")**";
+}
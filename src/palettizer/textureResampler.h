@@ -0,0 +1,64 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file textureResampler.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef TEXTURERESAMPLER_H
+#define TEXTURERESAMPLER_H
+
+#include "pandatoolbase.h"
+
+#include "pvector.h"
+
+class PNMImage;
+
+/**
+ * This scales a source texture image to the size it will have on a palette
+ * (or as a standalone copy), using the filter requested for the texture in
+ * the .txa file.
+ *
+ * The default, F_point, is PNMImage::quick_filter_from(), which is fast but
+ * aliases badly when shrinking.  F_box averages together all of the source
+ * pixels that each destination pixel covers, weighted by area, and F_lanczos
+ * applies a three-lobed Lanczos filter, which is sharper still.  Both filter
+ * in linear light, with the colors weighted by alpha.
+ */
+class TextureResampler {
+public:
+  enum Filter {
+    F_unspecified,
+    F_point,
+    F_box,
+    F_lanczos,
+  };
+
+  static void resample(PNMImage &dest, const PNMImage &source, Filter filter,
+                       bool srgb = false);
+
+  static Filter string_filter(const std::string &string);
+
+private:
+  // The source pixels, and their weights, that contribute to one pixel along
+  // one axis of the destination image.
+  class Contribution {
+  public:
+    int _start;
+    pvector<float> _weights;
+  };
+  typedef pvector<Contribution> Contributions;
+
+  static void compute_contributions(Contributions &contribs, int dest_size,
+                                    int source_size, Filter filter);
+};
+
+std::ostream &operator << (std::ostream &out, TextureResampler::Filter filter);
+
+#endif
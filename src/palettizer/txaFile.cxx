@@ -19,6 +19,9 @@
 
 #include "pnotify.h"
 #include "pnmFileTypeRegistry.h"
+#include "string_utils.h"
+
+#include <algorithm>
 
 using std::string;
 
@@ -118,6 +121,7 @@ read(std::istream &in, const string &filename) {
     return false;
   }
 
+  build_index();
   return true;
 }
 
@@ -126,12 +130,18 @@ read(std::istream &in, const string &filename) {
  * applies its specifications.  If a match is found, returns true; otherwise,
  * returns false.  Also returns false if all the matching lines for the egg
  * file include the keyword "cont".
+ *
+ * Only the lines that the index says might match are tested, in the order
+ * they appear in the file.
  */
 bool TxaFile::
 match_egg(EggFile *egg_file) const {
-  Lines::const_iterator li;
-  for (li = _lines.begin(); li != _lines.end(); ++li) {
-    if ((*li).match_egg(egg_file)) {
+  pvector<int> line_indices;
+  _egg_index.find_candidates(egg_file->get_name(), line_indices);
+
+  pvector<int>::const_iterator li;
+  for (li = line_indices.begin(); li != line_indices.end(); ++li) {
+    if (_lines[*li].match_egg(egg_file)) {
       return true;
     }
   }
@@ -144,12 +154,18 @@ match_egg(EggFile *egg_file) const {
  * applies its specifications.  If a match is found, returns true; otherwise,
  * returns false.  Also returns false if all the matching lines for the
  * texture include the keyword "cont".
+ *
+ * Only the lines that the index says might match are tested, in the order
+ * they appear in the file.
  */
 bool TxaFile::
 match_texture(TextureImage *texture) const {
-  Lines::const_iterator li;
-  for (li = _lines.begin(); li != _lines.end(); ++li) {
-    if ((*li).match_texture(texture)) {
+  pvector<int> line_indices;
+  _texture_index.find_candidates(texture->get_name(), line_indices);
+
+  pvector<int>::const_iterator li;
+  for (li = line_indices.begin(); li != line_indices.end(); ++li) {
+    if (_lines[*li].match_texture(texture)) {
       return true;
     }
   }
@@ -192,6 +208,30 @@ get_line_or_semicolon(std::istream &in, string &line) {
   return ch;
 }
 
+/**
+ * Rebuilds _egg_index and _texture_index from the patterns in _lines.
+ */
+void TxaFile::
+build_index() {
+  _egg_index = PatternIndex();
+  _texture_index = PatternIndex();
+
+  for (size_t i = 0; i < _lines.size(); ++i) {
+    const TxaLine &line = _lines[i];
+    TxaLine::Patterns::const_iterator pi;
+    for (pi = line.get_egg_patterns().begin();
+         pi != line.get_egg_patterns().end();
+         ++pi) {
+      _egg_index.add_pattern(*pi, (int)i);
+    }
+    for (pi = line.get_texture_patterns().begin();
+         pi != line.get_texture_patterns().end();
+         ++pi) {
+      _texture_index.add_pattern(*pi, (int)i);
+    }
+  }
+}
+
 /**
  * Handles the line in a .txa file that begins with the keyword ":group" and
  * indicates the relationships between one or more groups.
@@ -627,3 +667,88 @@ parse_textureswap_line(const vector_string &words) {
 
   return true;
 }
+
+/**
+ *
+ */
+TxaFile::PatternIndex::
+PatternIndex() {
+  _max_prefix_length = 0;
+  _max_suffix_length = 0;
+}
+
+/**
+ * Records that the indicated line contains the indicated pattern.
+ *
+ * The patterns in the .txa file are all case-insensitive, so the index is
+ * kept in lowercase.
+ */
+void TxaFile::PatternIndex::
+add_pattern(const GlobPattern &pattern, int line_index) {
+  string text = downcase(pattern.get_pattern());
+
+  size_t special = text.find_first_of("*?[\\");
+  if (special == string::npos) {
+    // A plain name can only match itself.
+    _exact[text].push_back(line_index);
+
+  } else if (special != 0) {
+    // Anything that matches must begin with the text before the first
+    // special character.
+    _prefix[text.substr(0, special)].push_back(line_index);
+    _max_prefix_length = std::max(_max_prefix_length, special);
+
+  } else if (text.find_first_of("[\\") == string::npos &&
+             text.find_last_of("*?") + 1 < text.length()) {
+    // A pattern like "*_shadow" must end with the text after the last
+    // wildcard.  We don't try this with character classes or escapes, whose
+    // closing characters are harder to pick out.
+    size_t last = text.find_last_of("*?") + 1;
+    _suffix[text.substr(last)].push_back(line_index);
+    _max_suffix_length = std::max(_max_suffix_length, text.length() - last);
+
+  } else {
+    _other.push_back(line_index);
+  }
+}
+
+/**
+ * Fills line_indices with the index of each line that has a pattern that
+ * might match the indicated name, in increasing order.  Every line that
+ * does match is included, but the lines must still be tested.
+ */
+void TxaFile::PatternIndex::
+find_candidates(const string &name, pvector<int> &line_indices) const {
+  line_indices = _other;
+
+  string key = downcase(name);
+  add_lines(_exact, key, line_indices);
+
+  size_t max_prefix = std::min(_max_prefix_length, key.length());
+  for (size_t len = 1; len <= max_prefix; ++len) {
+    add_lines(_prefix, key.substr(0, len), line_indices);
+  }
+
+  size_t max_suffix = std::min(_max_suffix_length, key.length());
+  for (size_t len = 1; len <= max_suffix; ++len) {
+    add_lines(_suffix, key.substr(key.length() - len), line_indices);
+  }
+
+  // A line with several patterns may have been found more than once.
+  std::sort(line_indices.begin(), line_indices.end());
+  line_indices.erase(std::unique(line_indices.begin(), line_indices.end()),
+                     line_indices.end());
+}
+
+/**
+ * Appends the lines recorded in the table under the indicated key, if any,
+ * to line_indices.
+ */
+void TxaFile::PatternIndex::
+add_lines(const Table &table, const string &key, LineIndices &line_indices) {
+  Table::const_iterator ti = table.find(key);
+  if (ti != table.end()) {
+    line_indices.insert(line_indices.end(), (*ti).second.begin(),
+                        (*ti).second.end());
+  }
+}
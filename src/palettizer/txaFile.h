@@ -22,6 +22,7 @@
 #include "vector_string.h"
 
 #include "pvector.h"
+#include "pmap.h"
 
 /**
  * This represents the .txa file (usually textures.txa) that contains the user
@@ -54,8 +55,41 @@ private:
   bool parse_cutout_line(const vector_string &words);
   bool parse_textureswap_line(const vector_string &words);
 
+  void build_index();
+
   typedef pvector<TxaLine> Lines;
   Lines _lines;
+
+  // This indexes the patterns of the above lines by their literal text, so
+  // that the lines that might match a given name can be found without
+  // testing each line in turn.
+  class PatternIndex {
+  public:
+    PatternIndex();
+    void add_pattern(const GlobPattern &pattern, int line_index);
+    void find_candidates(const std::string &name,
+                         pvector<int> &line_indices) const;
+
+  private:
+    typedef pvector<int> LineIndices;
+    typedef pmap<std::string, LineIndices> Table;
+    static void add_lines(const Table &table, const std::string &key,
+                          LineIndices &line_indices);
+
+    // Patterns without any special characters, keyed by the whole name.
+    Table _exact;
+    // Patterns that begin with literal text, keyed by that text.
+    Table _prefix;
+    size_t _max_prefix_length;
+    // Patterns that begin with a wildcard but end with literal text.
+    Table _suffix;
+    size_t _max_suffix_length;
+    // Everything else, which must be tested against every name.
+    LineIndices _other;
+  };
+
+  PatternIndex _egg_index;
+  PatternIndex _texture_index;
 };
 
 #endif
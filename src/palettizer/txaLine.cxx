@@ -42,6 +42,7 @@ TxaLine() {
   _alpha_mode = EggRenderMode::AM_unspecified;
   _wrap_u = EggTexture::WM_unspecified;
   _wrap_v = EggTexture::WM_unspecified;
+  _resize_filter = TextureResampler::F_unspecified;
   _quality_level = EggTexture::QL_unspecified;
   _got_margin = false;
   _margin = 0;
@@ -252,6 +253,18 @@ parse(const string &line) {
           return false;
         }
 
+      } else if (word.substr(0, 7) == "resize-") {
+        // Choose the filter used to scale the texture to its palettized
+        // size.
+        string filter_name = word.substr(7);
+        TextureResampler::Filter filter = TextureResampler::string_filter(filter_name);
+        if (filter != TextureResampler::F_unspecified) {
+          _resize_filter = filter;
+        } else {
+          nout << "Unknown resize filter: " << filter_name << "\n";
+          return false;
+        }
+
       } else if (word == "generic") {
         // Genericize the image format by replacing bitcount-specific formats
         // with their generic equivalents, e.g.  rgba8 becomes rgba.
@@ -474,6 +487,9 @@ match_texture(TextureImage *texture) const {
   if (_wrap_v != EggTexture::WM_unspecified) {
     request._wrap_v = _wrap_v;
   }
+  if (_resize_filter != TextureResampler::F_unspecified) {
+    request._resize_filter = _resize_filter;
+  }
 
   bool got_cont = false;
   Keywords::const_iterator ki;
@@ -527,6 +543,24 @@ match_texture(TextureImage *texture) const {
   return true;
 }
 
+/**
+ * Returns the list of patterns on this line that are tested against egg file
+ * names.
+ */
+const TxaLine::Patterns &TxaLine::
+get_egg_patterns() const {
+  return _egg_patterns;
+}
+
+/**
+ * Returns the list of patterns on this line that are tested against texture
+ * names.
+ */
+const TxaLine::Patterns &TxaLine::
+get_texture_patterns() const {
+  return _texture_patterns;
+}
+
 /**
  *
  */
@@ -566,6 +600,10 @@ output(std::ostream &out) const {
     out << " coverage " << _coverage_threshold;
   }
 
+  if (_resize_filter != TextureResampler::F_unspecified) {
+    out << " resize-" << _resize_filter;
+  }
+
   Keywords::const_iterator ki;
   for (ki = _keywords.begin(); ki != _keywords.end(); ++ki) {
     switch (*ki) {
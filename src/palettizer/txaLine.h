@@ -21,6 +21,7 @@
 #include "globPattern.h"
 #include "eggTexture.h"
 #include "eggRenderMode.h"
+#include "textureResampler.h"
 
 #include "pvector.h"
 
@@ -42,10 +43,13 @@ public:
   bool match_egg(EggFile *egg_file) const;
   bool match_texture(TextureImage *texture) const;
 
+  typedef pvector<GlobPattern> Patterns;
+  const Patterns &get_egg_patterns() const;
+  const Patterns &get_texture_patterns() const;
+
   void output(std::ostream &out) const;
 
 private:
-  typedef pvector<GlobPattern> Patterns;
   Patterns _texture_patterns;
   Patterns _egg_patterns;
 
@@ -67,6 +71,7 @@ private:
   bool _keep_format;
   EggRenderMode::AlphaMode _alpha_mode;
   EggTexture::WrapMode _wrap_u, _wrap_v;
+  TextureResampler::Filter _resize_filter;
   EggTexture::QualityLevel _quality_level;
 
   int _aniso_degree;
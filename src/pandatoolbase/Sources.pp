@@ -18,6 +18,7 @@
     animationConvert.cxx animationConvert.h \
     config_pandatoolbase.cxx config_pandatoolbase.h \
     distanceUnit.cxx distanceUnit.h \
+    fnvHash.I fnvHash.h \
     pandatoolbase.cxx pandatoolbase.h pandatoolsymbols.h \
     pathReplace.cxx pathReplace.I pathReplace.h \
     pathStore.cxx pathStore.h
@@ -26,6 +27,7 @@
     animationConvert.h \
     config_pandatoolbase.h \
     distanceUnit.h \
+    fnvHash.I fnvHash.h \
     pandatoolbase.h pandatoolsymbols.h \
     pathReplace.I pathReplace.h \
     pathStore.h
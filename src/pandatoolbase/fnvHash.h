@@ -0,0 +1,45 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file fnvHash.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef FNVHASH_H
+#define FNVHASH_H
+
+#include "pandatoolbase.h"
+
+/**
+ * Accumulates a 64-bit FNV-1a hash.  This is used by the tools to recognize
+ * inputs that have not changed since a previous run; it is fast, but it is
+ * not a cryptographic hash.
+ */
+class FnvHash {
+public:
+  INLINE FnvHash();
+
+  INLINE void add_byte(unsigned char value);
+  INLINE void add_data(const void *data, size_t length);
+  INLINE void add_word(uint64_t value);
+  INLINE void add_string(const std::string &str);
+
+  INLINE uint64_t get_hash() const;
+  INLINE uint64_t get_nonzero_hash() const;
+
+private:
+  uint64_t _hash;
+
+  static const uint64_t offset_basis = 14695981039346656037ULL;
+  static const uint64_t prime = 1099511628211ULL;
+};
+
+#include "fnvHash.I"
+
+#endif
@@ -17,8 +17,10 @@
     pStatListener.h \
     pStatMonitor.h pStatMonitor.I \
     pStatPianoRoll.h pStatPianoRoll.I \
-    pStatReader.h \
+    pStatReader.h pStatReader.I \
     pStatServer.h \
+    pStatSessionReader.h pStatSessionReader.I \
+    pStatSessionWriter.h pStatSessionWriter.I \
     pStatStripChart.h pStatStripChart.I \
     pStatThreadData.h pStatThreadData.I \
     pStatTimeline.h pStatTimeline.I \
@@ -35,6 +37,8 @@
     pStatPianoRoll.cxx \
     pStatReader.cxx \
     pStatServer.cxx \
+    pStatSessionReader.cxx \
+    pStatSessionWriter.cxx \
     pStatStripChart.cxx \
     pStatThreadData.cxx \
     pStatTimeline.cxx \
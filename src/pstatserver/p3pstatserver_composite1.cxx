@@ -6,6 +6,8 @@
 #include "pStatPianoRoll.cxx"
 #include "pStatReader.cxx"
 #include "pStatServer.cxx"
+#include "pStatSessionReader.cxx"
+#include "pStatSessionWriter.cxx"
 #include "pStatStripChart.cxx"
 #include "pStatThreadData.cxx"
 #include "pStatTimeline.cxx"
@@ -20,6 +20,7 @@
 using std::string;
 
 PStatCollectorDef PStatClientData::_null_collector(-1, "Unknown");
+BitArray PStatClientData::_null_levels;
 
 /**
  *
@@ -96,6 +97,15 @@ get_latest_time() const {
   return time;
 }
 
+/**
+ * Returns the number of frames sent by the client that were discarded without
+ * being recorded, because they arrived faster than they could be processed.
+ */
+int PStatClientData::
+get_num_dropped_frames() const {
+  return _num_dropped_frames;
+}
+
 /**
  * Returns the total number of collectors the Data knows about.
  */
@@ -208,6 +218,7 @@ set_collector_has_level(int index, int thread_index, bool flag) {
   }
 
   if (any_changed) {
+    ++_definitions_seq;
     _is_dirty = true;
   }
 
@@ -225,6 +236,17 @@ get_collector_has_level(int index, int thread_index) const {
           _collectors[index]._is_level.get_bit(thread_index));
 }
 
+/**
+ * Returns the set of threads for which the given collector has level data.
+ */
+const BitArray &PStatClientData::
+get_collector_levels(int index) const {
+  if (index < 0 || index >= (int)_collectors.size()) {
+    return _null_levels;
+  }
+  return _collectors[index]._is_level;
+}
+
 /**
  * Returns the total number of collectors that are toplevel collectors.  These
  * are the collectors that are the children of "Frame", which is collector 0.
@@ -332,6 +354,27 @@ get_child_distance(int parent, int child) const {
   }
 }
 
+/**
+ * Returns a sequence number that is incremented whenever a collector is
+ * defined or redefined, so that information derived from the collector
+ * hierarchy, such as get_child_distance(), can be cached.
+ */
+UpdateSeq PStatClientData::
+get_collectors_seq() const {
+  return _collectors_seq;
+}
+
+/**
+ * Returns a sequence number that is incremented whenever a collector or thread
+ * is defined, redefined or removed, or the set of threads for which a
+ * collector has level data changes.  This is the information that
+ * PStatSessionWriter writes ahead of the frames.
+ */
+UpdateSeq PStatClientData::
+get_definitions_seq() const {
+  return _definitions_seq;
+}
+
 /**
  * Adds a new collector definition to the dataset.  Presumably this is
  * information just arrived from the client.
@@ -350,6 +393,8 @@ add_collector(PStatCollectorDef *def) {
   }
 
   _collectors[def->_index]._def = def;
+  ++_collectors_seq;
+  ++_definitions_seq;
   update_toplevel_collectors();
 
   // If we already had the _is_level flag set, it should be immediately
@@ -383,12 +428,14 @@ define_thread(int thread_index, const string &name, bool mark_alive) {
     _threads[thread_index]._is_alive = true;
   }
 
-  if (!name.empty()) {
+  if (!name.empty() && _threads[thread_index]._name != name) {
     _threads[thread_index]._name = name;
+    ++_definitions_seq;
   }
 
   if (_threads[thread_index]._data.is_null()) {
     _threads[thread_index]._data = new PStatThreadData(this);
+    ++_definitions_seq;
   }
 
   _is_dirty = true;
@@ -414,6 +461,7 @@ remove_thread(int thread_index) {
     _threads[thread_index]._name.clear();
     _threads[thread_index]._data.clear();
     _threads[thread_index]._is_alive = false;
+    ++_definitions_seq;
   }
 }
 
@@ -433,6 +481,35 @@ record_new_frame(int thread_index, int frame_number,
   _is_dirty = true;
 }
 
+/**
+ * Records a frame of a session that is being read from a file, whose data
+ * will be read from the file when it is needed.  See
+ * PStatThreadData::record_paged_frame().
+ */
+void PStatClientData::
+record_paged_frame(int thread_index, int frame_number, double start,
+                   double end, PStatSessionReader *reader,
+                   std::streamoff offset) {
+  define_thread(thread_index);
+  nassertv(thread_index >= 0 && thread_index < (int)_threads.size());
+  _threads[thread_index]._data->record_paged_frame(frame_number, start, end,
+                                                   reader, offset);
+  _is_dirty = true;
+}
+
+/**
+ * Reads all of the frames recorded by record_paged_frame() that have not yet
+ * been read, so that the session file may be closed or overwritten.
+ */
+void PStatClientData::
+release_session_reader() {
+  for (Thread &thread : _threads) {
+    if (thread._data != nullptr) {
+      thread._data->release_reader();
+    }
+  }
+}
+
 /**
  * Writes the client data in the form of a JSON output that can be loaded into
  * Chrome's event tracer.
@@ -486,8 +563,7 @@ write_datagram(Datagram &dg) const {
   for (const Collector &collector : _collectors) {
     PStatCollectorDef *def = collector._def;
     if (def != nullptr && def->_index != -1) {
-      def->write_datagram(dg);
-      collector._is_level.write_datagram(nullptr, dg);
+      write_collector_datagram(dg, def->_index);
     }
   }
   dg.add_int16(-1);
@@ -510,10 +586,7 @@ write_datagram(Datagram &dg) const {
 void PStatClientData::
 read_datagram(DatagramIterator &scan) {
   while (scan.peek_int16() != -1) {
-    PStatCollectorDef *def = new PStatCollectorDef;
-    def->read_datagram(scan);
-    add_collector(def);
-    _collectors[def->_index]._is_level.read_datagram(scan, nullptr);
+    read_collector_datagram(scan);
   }
   scan.skip_bytes(2);
 
@@ -528,6 +601,32 @@ read_datagram(DatagramIterator &scan) {
   update_toplevel_collectors();
 }
 
+/**
+ * Writes the definition of the indicated collector, along with the set of
+ * threads for which it reports level data, to a datagram.
+ */
+void PStatClientData::
+write_collector_datagram(Datagram &dg, int index) const {
+  nassertv(has_collector(index));
+  const Collector &collector = _collectors[index];
+  collector._def->write_datagram(dg);
+  collector._is_level.write_datagram(nullptr, dg);
+}
+
+/**
+ * Reads a collector definition written by write_collector_datagram(), and
+ * adds it to the client data, replacing any previous definition of the same
+ * collector.
+ */
+void PStatClientData::
+read_collector_datagram(DatagramIterator &scan) {
+  PStatCollectorDef *def = new PStatCollectorDef;
+  def->read_datagram(scan);
+  add_collector(def);
+  _collectors[def->_index]._is_level.read_datagram(scan, nullptr);
+  ++_definitions_seq;
+}
+
 /**
  * Makes sure there is an entry in the array for a collector with the given
  * index number.
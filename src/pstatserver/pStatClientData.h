@@ -22,6 +22,7 @@
 #include "referenceCount.h"
 #include "pointerTo.h"
 #include "bitArray.h"
+#include "updateSeq.h"
 
 #include "pvector.h"
 #include "vector_int.h"
@@ -46,6 +47,7 @@ public:
   void close();
 
   double get_latest_time() const;
+  int get_num_dropped_frames() const;
 
   int get_num_collectors() const;
   bool has_collector(int index) const;
@@ -55,6 +57,7 @@ public:
   std::string get_collector_fullname(int index) const;
   bool set_collector_has_level(int index, int thread_index, bool flag);
   bool get_collector_has_level(int index, int thread_index) const;
+  const BitArray &get_collector_levels(int index) const;
 
   int get_num_toplevel_collectors() const;
   int get_toplevel_collector(int index) const;
@@ -67,6 +70,8 @@ public:
   bool is_thread_alive(int index) const;
 
   int get_child_distance(int parent, int child) const;
+  UpdateSeq get_collectors_seq() const;
+  UpdateSeq get_definitions_seq() const;
 
 
   void add_collector(PStatCollectorDef *def);
@@ -77,10 +82,16 @@ public:
 
   void record_new_frame(int thread_index, int frame_number,
                         PStatFrameData *frame_data);
+  void record_paged_frame(int thread_index, int frame_number,
+                          double start, double end,
+                          PStatSessionReader *reader, std::streamoff offset);
+  void release_session_reader();
 
   void write_json(std::ostream &out, int pid = 0) const;
   void write_datagram(Datagram &dg) const;
   void read_datagram(DatagramIterator &scan);
+  void write_collector_datagram(Datagram &dg, int index) const;
+  void read_collector_datagram(DatagramIterator &scan);
 
 private:
   void slot_collector(int collector_index);
@@ -90,6 +101,7 @@ private:
   bool _is_alive = false;
   mutable bool _is_dirty = false;
   PStatReader *_reader = nullptr;
+  int _num_dropped_frames = 0;
 
   class Collector {
   public:
@@ -99,6 +111,8 @@ private:
 
   typedef pvector<Collector> Collectors;
   Collectors _collectors;
+  UpdateSeq _collectors_seq;
+  UpdateSeq _definitions_seq;
 
   typedef vector_int ToplevelCollectors;
   ToplevelCollectors _toplevel_collectors;
@@ -113,6 +127,7 @@ private:
   Threads _threads;
 
   static PStatCollectorDef _null_collector;
+  static BitArray _null_levels;
   friend class PStatReader;
 };
 
@@ -21,10 +21,11 @@
 #include "pStatStripChart.h"
 #include "pStatFlameGraph.h"
 #include "pStatPianoRoll.h"
+#include "pStatSessionReader.h"
+#include "pStatSessionWriter.h"
 
 using std::string;
 
-static const string session_file_header("pstat\0\n\r", 8);
 static const string layout_file_header("pslyt\0\n\r", 8);
 
 static const Filename layout_filename = Filename::binary_filename(
@@ -43,6 +44,7 @@ static const Filename layout_filename = Filename::binary_filename(
 PStatMonitor::
 PStatMonitor(PStatServer *server) : _server(server) {
   _client_known = false;
+  _recorder = nullptr;
 }
 
 /**
@@ -50,6 +52,13 @@ PStatMonitor(PStatServer *server) : _server(server) {
  */
 PStatMonitor::
 ~PStatMonitor() {
+  // By now the derived class has been destructed, along with its graphs, so
+  // it is too late to write out the UI state.  A monitor that records must
+  // call stop_recording() from its own destructor or lost_connection().
+  nassertd(_recorder == nullptr) {
+    delete _recorder;
+    _recorder = nullptr;
+  }
   close();
 }
 
@@ -63,6 +72,11 @@ hello_from(const string &hostname, const string &progname, int pid) {
   _client_hostname = hostname;
   _client_progname = progname;
   _client_pid = pid;
+
+  if (_recorder != nullptr) {
+    _recorder->write_client(_client_known, _client_hostname, _client_progname,
+                            _client_pid);
+  }
   got_hello();
 }
 
@@ -99,59 +113,75 @@ set_client_data(PStatClientData *client_data) {
  */
 bool PStatMonitor::
 write(const Filename &fn) const {
-  DatagramOutputFile dof;
-  if (!dof.open(fn)) {
+  if (!_read_filename.empty() && !_client_data.is_null()) {
+    // The frames not yet read from the file we are about to overwrite must be
+    // read now, while they can still be.
+    Filename canon_fn = fn;
+    canon_fn.make_canonical();
+    Filename canon_read = _read_filename;
+    canon_read.make_canonical();
+    if (canon_fn == canon_read) {
+      _client_data->release_session_reader();
+    }
+  }
+
+  PStatSessionWriter writer;
+  if (!writer.open(fn)) {
     return false;
   }
-  if (!dof.write_header(session_file_header)) {
+
+  writer.write_client(_client_known, _client_hostname, _client_progname,
+                      _client_pid);
+  writer.write_frames(get_client_data(), true);
+
+  Datagram ui_data;
+  ui_data.set_stdfloat_double(false);
+  write_ui_datagram(ui_data);
+  writer.write_ui(ui_data);
+
+  if (!writer.is_open()) {
     return false;
   }
-  Datagram dg;
-  dg.set_stdfloat_double(false);
-  dg.add_uint16(1);
-  dg.add_uint16(1);
-  write_datagram(dg);
-  dof.put_datagram(dg);
-  dof.close();
+  writer.close();
   return true;
 }
 
 /**
- * Reads the data and the UI state from the given file.
+ * Reads the data and the UI state from the given file.  The frames of a
+ * version 2 session file are not read until they are needed, so the file is
+ * kept open for as long as the data is in use.
  */
 bool PStatMonitor::
 read(const Filename &fn) {
   close();
 
-  DatagramInputFile dif;
-  if (!dif.open(fn)) {
-    nout << "Failed to open " << fn << " for reading.\n";
+  PT(PStatSessionReader) reader = new PStatSessionReader;
+  if (!reader->open(fn)) {
     return false;
   }
-  string header;
-  if (!dif.read_header(header, 8) || header != session_file_header) {
-    nout << "Session file contains invalid header.\n";
-    return false;
-  }
-  Datagram dg;
-  dg.set_stdfloat_double(false);
 
-  if (!dif.get_datagram(dg)) {
-    nout << "Failed to read datagram from session file.\n";
-    return false;
-  }
+  int version = reader->get_major_version();
+  if (version == 1) {
+    // The entire session is stored in the next datagram.
+    Datagram dg;
+    if (!reader->read_chunk(dg)) {
+      nout << "Failed to read datagram from session file.\n";
+      return false;
+    }
+    DatagramIterator scan(dg);
+    read_datagram(scan);
+    reader->close();
+
+  } else if (version == PStatSessionWriter::major_version) {
+    // The session is stored in a series of chunks following this one.
+    if (!read_chunks(reader)) {
+      return false;
+    }
 
-  DatagramIterator scan(dg);
-  int version = scan.get_uint16();
-  if (version != 1) {
+  } else {
     nout << "Unsupported session file version " << version << ".\n";
     return false;
   }
-  // Room for a minor version number
-  scan.get_uint16();
-
-  read_datagram(scan);
-  dif.close();
 
   idle();
 
@@ -161,6 +191,76 @@ read(const Filename &fn) {
   return true;
 }
 
+/**
+ * Begins writing the session to the indicated file as it is received, so that
+ * it can be recorded for longer than the history retained in memory.  Frames
+ * already received are written immediately.  Returns true on success.
+ */
+bool PStatMonitor::
+start_recording(const Filename &fn) {
+  stop_recording();
+
+  _recorder = new PStatSessionWriter;
+  if (!_recorder->open(fn)) {
+    delete _recorder;
+    _recorder = nullptr;
+    return false;
+  }
+
+  _recorder->write_client(_client_known, _client_hostname, _client_progname,
+                          _client_pid);
+  if (!_client_data.is_null()) {
+    _recorder->write_frames(_client_data, true);
+  }
+  return true;
+}
+
+/**
+ * Finishes writing the file begun by start_recording(), including the frames
+ * still held back and the current state of the graphs.  This must be called
+ * while the graphs still exist, and so may not be left to the PStatMonitor
+ * destructor.
+ */
+void PStatMonitor::
+stop_recording() {
+  if (_recorder != nullptr) {
+    if (!_client_data.is_null()) {
+      _recorder->write_frames(_client_data, true);
+    }
+
+    Datagram ui_data;
+    ui_data.set_stdfloat_double(false);
+    write_ui_datagram(ui_data);
+    _recorder->write_ui(ui_data);
+
+    if (_recorder->get_num_late_frames() != 0) {
+      nout << _recorder->get_num_late_frames()
+           << " frames arrived out of order and were recorded separately.\n";
+    }
+    if (_recorder->get_num_lost_frames() != 0) {
+      nout << "Up to " << _recorder->get_num_lost_frames()
+           << " frames left the history before they could be recorded.\n";
+    }
+
+    delete _recorder;
+    _recorder = nullptr;
+  }
+}
+
+/**
+ * Writes out any frames that have been received since the last call to the
+ * file begun by start_recording(), given the frame that has just arrived.
+ * This is called by new_data(); a monitor that overrides new_data() without
+ * calling up to it should call this instead.
+ */
+void PStatMonitor::
+update_recording(int thread_index, int frame_number) {
+  if (_recorder != nullptr && !_client_data.is_null()) {
+    _recorder->write_late_frame(_client_data, thread_index, frame_number);
+    _recorder->write_frames(_client_data, false);
+  }
+}
+
 /**
  * Opens the default set of graphs.
  */
@@ -564,6 +664,8 @@ new_thread(int) {
  */
 void PStatMonitor::
 new_data(int thread_index, int frame_number) {
+  update_recording(thread_index, frame_number);
+
   const PStatClientData *client_data = get_client_data();
 
   // Don't bother to update the thread data until we know at least something
@@ -678,6 +780,15 @@ write_datagram(Datagram &dg) const {
 
   get_client_data()->write_datagram(dg);
 
+  write_ui_datagram(dg);
+}
+
+/**
+ * Writes the state of the open graphs, and the collector colors, to a
+ * datagram.
+ */
+void PStatMonitor::
+write_ui_datagram(Datagram &dg) const {
   dg.add_uint32((uint32_t)_colors.size());
   for (const auto &item : _colors) {
     dg.add_int32(item.first);
@@ -730,6 +841,96 @@ read_datagram(DatagramIterator &scan) {
   client_data->read_datagram(scan);
   set_client_data(client_data);
 
+  read_colors(scan);
+  finish_read();
+  read_graphs(scan);
+}
+
+/**
+ * A support function for read(), this reads the remainder of a version 2
+ * session file, following the version number, one chunk at a time.  Returns
+ * true on success, false if the file is truncated or corrupt.
+ */
+bool PStatMonitor::
+read_chunks(PStatSessionReader *reader) {
+  PStatClientData *client_data = new PStatClientData;
+  set_client_data(client_data);
+
+  PStatSessionReader::Index index;
+  if (!reader->read_index(index, client_data)) {
+    return false;
+  }
+
+  // The graphs can't be opened until all the data is in.
+  Datagram ui_data;
+  bool got_ui = false;
+
+  Datagram dg;
+  for (std::streamoff offset : index._definitions) {
+    if (!reader->read_chunk_at(offset, dg)) {
+      nout << "Failed to read datagram from session file.\n";
+      return false;
+    }
+
+    DatagramIterator scan(dg);
+    switch ((PStatSessionWriter::ChunkType)scan.get_uint8()) {
+    case PStatSessionWriter::CT_client:
+      _client_known = scan.get_bool();
+      _client_hostname = scan.get_string();
+      _client_progname = scan.get_string();
+      _client_pid = scan.get_int32();
+      break;
+
+    case PStatSessionWriter::CT_collector:
+      client_data->read_collector_datagram(scan);
+      break;
+
+    case PStatSessionWriter::CT_thread:
+      {
+        int thread_index = scan.get_int16();
+        std::string name = scan.get_string();
+        client_data->define_thread(thread_index, name, true);
+      }
+      break;
+
+    case PStatSessionWriter::CT_ui:
+      ui_data = Datagram(scan.get_remaining_bytes());
+      ui_data.set_stdfloat_double(false);
+      got_ui = true;
+      break;
+
+    default:
+      // An unknown chunk type, perhaps from a newer version; skip it.
+      break;
+    }
+  }
+
+  // Only the frame numbers and times are recorded now.  The frames themselves
+  // are read from the file as they are needed.
+  for (const PStatSessionReader::Page &page : index._pages) {
+    for (const PStatSessionReader::Frame &frame : page._frames) {
+      client_data->record_paged_frame(page._thread_index, frame._frame_number,
+                                      frame._start, frame._end,
+                                      reader, page._offset);
+    }
+  }
+
+  finish_read();
+
+  if (got_ui) {
+    DatagramIterator scan(ui_data);
+    read_colors(scan);
+    read_graphs(scan);
+  }
+  return true;
+}
+
+/**
+ * A support function for read(), this reads the collector colors written by
+ * write_ui_datagram().
+ */
+void PStatMonitor::
+read_colors(DatagramIterator &scan) {
   size_t num_colors = scan.get_uint32();
   for (size_t i = 0; i < num_colors; ++i) {
     int key = scan.get_int32();
@@ -738,6 +939,16 @@ read_datagram(DatagramIterator &scan) {
     color[1] = scan.get_float32();
     color[2] = scan.get_float32();
   }
+}
+
+/**
+ * A support function for read(), this notifies the monitor of the collectors
+ * and threads that have been read, and sets up the views to show the latest
+ * frame of each thread.
+ */
+void PStatMonitor::
+finish_read() {
+  const PStatClientData *client_data = _client_data;
 
   int num_collectors = client_data->get_num_collectors();
   for (int collector_index = 0; collector_index < num_collectors; ++collector_index) {
@@ -765,7 +976,14 @@ read_datagram(DatagramIterator &scan) {
       new_thread(thread_index);
     }
   }
+}
 
+/**
+ * A support function for read(), this reopens the graphs written by
+ * write_ui_datagram().
+ */
+void PStatMonitor::
+read_graphs(DatagramIterator &scan) {
   PStatGraph *graph;
 
   size_t num_timelines = scan.get_uint16();
@@ -28,6 +28,8 @@
 class PStatCollectorDef;
 class PStatGraph;
 class PStatServer;
+class PStatSessionReader;
+class PStatSessionWriter;
 
 /**
  * This is an abstract class that presents the interface to any number of
@@ -55,6 +57,11 @@ public:
   bool write(const Filename &fn) const;
   bool read(const Filename &fn);
 
+  bool start_recording(const Filename &fn);
+  void stop_recording();
+  void update_recording(int thread_index, int frame_number);
+  INLINE bool is_recording() const;
+
   void open_default_graphs();
   bool save_default_graphs() const;
 
@@ -109,6 +116,13 @@ public:
 
   void write_datagram(Datagram &dg) const;
   void read_datagram(DatagramIterator &scan);
+  void write_ui_datagram(Datagram &dg) const;
+
+private:
+  bool read_chunks(PStatSessionReader *reader);
+  void read_colors(DatagramIterator &scan);
+  void finish_read();
+  void read_graphs(DatagramIterator &scan);
 
 protected:
   PStatServer *_server;
@@ -121,6 +135,7 @@ private:
   std::string _client_progname;
   int _client_pid;
   Filename _read_filename;
+  PStatSessionWriter *_recorder;
 
   typedef pmap<int, PStatView> Views;
   Views _views;
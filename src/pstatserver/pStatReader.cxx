@@ -22,6 +22,7 @@
 #include "datagram.h"
 #include "datagramIterator.h"
 #include "connectionManager.h"
+#include "thread.h"
 
 /**
  *
@@ -29,7 +30,8 @@
 PStatReader::
 PStatReader(PStatServer *manager, PStatMonitor *monitor) :
 #ifdef HAVE_THREADS
-  ConnectionReader(manager, monitor->is_thread_safe() ? 1 : 0),
+  ConnectionReader(manager, (monitor->is_thread_safe() ||
+                             manager->get_threaded_ingest()) ? 1 : 0),
 #else  // HAVE_THREADS
   ConnectionReader(manager, 0),
 #endif  // HAVE_THREADS
@@ -40,6 +42,19 @@ PStatReader(PStatServer *manager, PStatMonitor *monitor) :
   set_tcp_header_size(4);
   _writer.set_tcp_header_size(4);
   _udp_port = 0;
+
+#ifdef HAVE_THREADS
+  // If the monitor can handle being called from the reader thread anyway,
+  // there is no need to hand the control messages over to the main thread.
+  _threaded_ingest = manager->get_threaded_ingest() && !monitor->is_thread_safe();
+#else
+  _threaded_ingest = false;
+#endif
+  _queue_head = 0;
+  _queue_tail = 0;
+  _got_hello = 0;
+  _num_dropped_frames = 0;
+
   _client_data = new PStatClientData(this);
   _monitor->set_client_data(_client_data);
 }
@@ -50,6 +65,15 @@ PStatReader(PStatServer *manager, PStatMonitor *monitor) :
 PStatReader::
 ~PStatReader() {
   _manager->release_udp_port(_udp_port);
+
+  // The reader thread has been stopped by now; free anything it left behind.
+  AtomicAdjust::Integer head = AtomicAdjust::get(_queue_head);
+  AtomicAdjust::Integer tail = AtomicAdjust::get(_queue_tail);
+  for (; head != tail; ++head) {
+    QueuedData &data = _queue[head & (queued_frame_records - 1)];
+    delete data._frame_data;
+    delete data._message;
+  }
 }
 
 /**
@@ -93,6 +117,7 @@ set_tcp_connection(Connection *tcp_connection) {
 void PStatReader::
 lost_connection() {
   _client_data->_is_alive = false;
+  _client_data->_num_dropped_frames = get_num_dropped_frames();
   _monitor->lost_connection();
   _manager->lost_connection(_monitor);
   _client_data.clear();
@@ -162,7 +187,29 @@ receive_datagram(const NetDatagram &datagram) {
   if (connection == _tcp_connection) {
     PStatClientControlMessage message;
     if (message.decode(datagram, _client_data)) {
-      handle_client_control_message(message);
+      if (_threaded_ingest) {
+        if (message._type == PStatClientControlMessage::T_hello) {
+          // We need to know the client version right away, in order to decode
+          // the frames that follow.
+          if (is_compatible_version(message._major_version, message._minor_version)) {
+            _client_data->set_version(message._major_version, message._minor_version);
+            AtomicAdjust::set(_got_hello, 1);
+          }
+        }
+
+        QueuedData data;
+        data._thread_index = 0;
+        data._frame_number = 0;
+        data._frame_data = nullptr;
+        data._message = new PStatClientControlMessage(message);
+
+        // Control messages can't be dropped; wait for room.
+        while (!enqueue(data)) {
+          Thread::sleep(0.001);
+        }
+      } else {
+        handle_client_control_message(message);
+      }
 
     } else if (message._type == PStatClientControlMessage::T_datagram) {
       handle_client_udp_data(datagram);
@@ -192,9 +239,7 @@ handle_client_control_message(const PStatClientControlMessage &message) {
       int server_major_version = get_current_pstat_major_version();
       int server_minor_version = get_current_pstat_minor_version();
 
-      if (message._major_version != server_major_version ||
-          (message._major_version == server_major_version &&
-           message._minor_version > server_minor_version)) {
+      if (!is_compatible_version(message._major_version, message._minor_version)) {
         _monitor->bad_version(message._client_hostname, message._client_progname,
                               message._client_pid,
                               message._major_version, message._minor_version,
@@ -264,7 +309,7 @@ handle_client_control_message(const PStatClientControlMessage &message) {
  */
 void PStatReader::
 handle_client_udp_data(const Datagram &datagram) {
-  if (!_monitor->is_client_known()) {
+  if (_threaded_ingest ? !AtomicAdjust::get(_got_hello) : !_monitor->is_client_known()) {
     // If we haven't heard a "hello" from the client yet, we don't know what
     // version data it will be sending us, so we can't decode the data.
     // Chances are good we can't display it sensibly yet anyway.  Ignore frame
@@ -280,17 +325,48 @@ handle_client_udp_data(const Datagram &datagram) {
     nassertv(initial_byte == 0);
   }
 
-  if (!_queued_frame_data.full()) {
-    FrameData data;
-    data._thread_index = source.get_uint16();
-    data._frame_number = source.get_uint32();
-    data._frame_data = new PStatFrameData;
-    data._frame_data->read_datagram(source, _client_data);
+  QueuedData data;
+  data._thread_index = source.get_uint16();
+  data._frame_number = source.get_uint32();
+  data._frame_data = new PStatFrameData;
+  data._frame_data->read_datagram(source, _client_data);
+  data._message = nullptr;
+
+  // Queue up the data till we're ready to handle it in a single-threaded
+  // way.
+  if (!enqueue(data)) {
+    delete data._frame_data;
+    AtomicAdjust::inc(_num_dropped_frames);
+  }
+}
 
-    // Queue up the data till we're ready to handle it in a single-threaded
-    // way.
-    _queued_frame_data.push_back(data);
+/**
+ * Adds the indicated data to the end of the queue, to be handled by the next
+ * call to dequeue_frame_data().  Returns false if the queue is full.  This may
+ * only be called from one thread at a time.
+ */
+bool PStatReader::
+enqueue(const QueuedData &data) {
+  AtomicAdjust::Integer tail = AtomicAdjust::get(_queue_tail);
+  if (tail - AtomicAdjust::get(_queue_head) >= queued_frame_records) {
+    return false;
   }
+
+  _queue[tail & (queued_frame_records - 1)] = data;
+
+  // Only now does the consumer get to see it.
+  AtomicAdjust::set(_queue_tail, tail + 1);
+  return true;
+}
+
+/**
+ * Returns true if a client reporting the indicated version of the PStats
+ * protocol may be served.
+ */
+bool PStatReader::
+is_compatible_version(int major_version, int minor_version) const {
+  return major_version == get_current_pstat_major_version() &&
+         minor_version <= get_current_pstat_minor_version();
 }
 
 /**
@@ -299,14 +375,29 @@ handle_client_udp_data(const Datagram &datagram) {
  */
 void PStatReader::
 dequeue_frame_data() {
-  if (_queued_frame_data.empty()) {
+  AtomicAdjust::Integer head = AtomicAdjust::get(_queue_head);
+  AtomicAdjust::Integer tail = AtomicAdjust::get(_queue_tail);
+  if (head == tail) {
     return;
   }
 
   do {
-    const FrameData &data = _queued_frame_data.front();
+    const QueuedData &data = _queue[head & (queued_frame_records - 1)];
     nassertv(_client_data != nullptr);
 
+    if (data._message != nullptr) {
+      handle_client_control_message(*data._message);
+      delete data._message;
+
+      // Free up the slot before handling anything else.
+      AtomicAdjust::set(_queue_head, ++head);
+      if (_client_data == nullptr) {
+        // The message closed the connection.
+        return;
+      }
+      continue;
+    }
+
     // Check to see if any new collectors have level data.
     int num_levels = data._frame_data->get_num_levels();
     for (int i = 0; i < num_levels; i++) {
@@ -323,9 +414,11 @@ dequeue_frame_data() {
                                    data._frame_data);
     _monitor->new_data(data._thread_index, data._frame_number);
 
-    _queued_frame_data.pop_front();
+    AtomicAdjust::set(_queue_head, ++head);
   }
-  while (!_queued_frame_data.empty());
+  while (head != tail);
+
+  _client_data->_num_dropped_frames = get_num_dropped_frames();
 
   // Clean up old threads.
   for (int thread_index = 0; thread_index < _client_data->get_num_threads(); ++thread_index) {
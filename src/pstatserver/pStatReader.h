@@ -22,7 +22,7 @@
 #include "connectionReader.h"
 #include "connectionWriter.h"
 #include "referenceCount.h"
-#include "circBuffer.h"
+#include "atomicAdjust.h"
 
 class PStatServer;
 class PStatMonitor;
@@ -30,8 +30,9 @@ class PStatClientControlMessage;
 class PStatFrameData;
 
 // This is the maximum number of frame records that will be queued up from
-// this particular client between processing loops.
-static const int queued_frame_records = 500;
+// this particular client between processing loops.  It must be a power of
+// two.
+static const int queued_frame_records = 4096;
 
 /**
  * This is the class that does all the work for handling communications from a
@@ -51,6 +52,9 @@ public:
 
   PStatMonitor *get_monitor();
 
+  INLINE bool is_threaded_ingest() const;
+  INLINE int get_num_dropped_frames() const;
+
 private:
   std::string get_hostname();
   void send_hello();
@@ -60,6 +64,7 @@ private:
   void handle_client_control_message(const PStatClientControlMessage &message);
   void handle_client_udp_data(const Datagram &datagram);
   void dequeue_frame_data();
+  bool is_compatible_version(int major_version, int minor_version) const;
 
 private:
   PStatServer *_manager;
@@ -74,14 +79,30 @@ private:
 
   std::string _hostname;
 
-  class FrameData {
+  // In threaded ingest mode, the control messages are also queued, so that
+  // they are handled in the order in which they arrived, and in the main
+  // thread; in this case _message is filled in instead of _frame_data.
+  class QueuedData {
   public:
     int _thread_index;
     int _frame_number;
     PStatFrameData *_frame_data;
+    PStatClientControlMessage *_message;
   };
-  typedef CircBuffer<FrameData, queued_frame_records> QueuedFrameData;
-  QueuedFrameData _queued_frame_data;
+  bool enqueue(const QueuedData &data);
+
+  // This is a ring buffer with a single producer, the thread that receives
+  // the datagrams, and a single consumer, the thread that calls idle().  Each
+  // side only writes its own index, so no lock is needed.
+  QueuedData _queue[queued_frame_records];
+  AtomicAdjust::Integer _queue_head;
+  AtomicAdjust::Integer _queue_tail;
+
+  bool _threaded_ingest;
+  AtomicAdjust::Integer _got_hello;
+  AtomicAdjust::Integer _num_dropped_frames;
 };
 
+#include "pStatReader.I"
+
 #endif
@@ -13,6 +13,7 @@
 
 #include "pStatServer.h"
 #include "pStatReader.h"
+#include "pStatThreadData.h"
 #include "thread.h"
 #include "config_pstatclient.h"
 
@@ -23,6 +24,7 @@ PStatServer::
 PStatServer() {
   _listener = new PStatListener(this);
   _next_udp_port = 0;
+  _threaded_ingest = false;
 }
 
 /**
@@ -93,6 +95,9 @@ stop_listening() {
  */
 void PStatServer::
 poll() {
+  // No frame references are held between polls.
+  PStatThreadData::unpin_frames();
+
   // Delete all the readers that we couldn't delete before.
   while (!_lost_readers.empty()) {
     PStatReader *reader = _lost_readers.back();
@@ -141,6 +146,29 @@ main_loop(bool *interrupt_flag) {
   }
 }
 
+/**
+ * Specifies whether each client connection established from now on should
+ * receive and decode its frame data in a thread of its own, even though the
+ * monitor is not thread-safe.  The decoded frames are then handed to the
+ * monitor by poll(), in the main thread, along with the other messages from
+ * the client.  This keeps up with more clients, or with faster ones, before
+ * frames start being dropped.
+ *
+ * This has no effect if Panda was compiled without threading support.
+ */
+void PStatServer::
+set_threaded_ingest(bool flag) {
+  _threaded_ingest = flag;
+}
+
+/**
+ * Returns the flag set by set_threaded_ingest().
+ */
+bool PStatServer::
+get_threaded_ingest() const {
+  return _threaded_ingest;
+}
+
 /**
  * Adds the newly-created PStatReader to the list of currently active readers.
  */
@@ -44,6 +44,9 @@ public:
   void poll();
   void main_loop(bool *interrupt_flag = nullptr);
 
+  void set_threaded_ingest(bool flag);
+  bool get_threaded_ingest() const;
+
   virtual PStatMonitor *make_monitor(const NetAddress &address)=0;
   virtual void lost_connection(PStatMonitor *monitor) {}
 
@@ -84,6 +87,8 @@ private:
 
   typedef vector_stdfloat GuideBars;
   GuideBars _user_guide_bars;
+
+  bool _threaded_ingest;
 };
 
 #endif
@@ -0,0 +1,316 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatSessionReader.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "pStatSessionReader.h"
+#include "pStatSessionWriter.h"
+
+#include "pStatFrameData.h"
+#include "datagramIterator.h"
+#include "streamReader.h"
+#include "virtualFileSystem.h"
+#include "vector_uchar.h"
+
+using std::string;
+
+/**
+ *
+ */
+PStatSessionReader::
+PStatSessionReader() {
+  _in = nullptr;
+  _size = -1;
+  _first_offset = 0;
+  _next_offset = 0;
+  _major_version = 0;
+  _minor_version = 0;
+}
+
+/**
+ *
+ */
+PStatSessionReader::
+~PStatSessionReader() {
+  close();
+}
+
+/**
+ * Opens the indicated session file and reads its header and version number.
+ * Returns true on success, false on failure.
+ */
+bool PStatSessionReader::
+open(const Filename &filename) {
+  close();
+
+  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+  _in = vfs->open_read_file(filename, false);
+  if (_in == nullptr) {
+    nout << "Failed to open " << filename << " for reading.\n";
+    return false;
+  }
+
+  _in->seekg(0, std::ios::end);
+  _size = _in->tellg();
+  _in->clear();
+  _in->seekg(0, std::ios::beg);
+
+  const string &file_header = PStatSessionWriter::file_header;
+  string header(file_header.size(), '\0');
+  _in->read(&header[0], header.size());
+  if (_in->fail() || header != file_header) {
+    nout << "Session file contains invalid header.\n";
+    close();
+    return false;
+  }
+
+  Datagram dg;
+  if (!read_chunk_at(header.size(), dg)) {
+    nout << "Failed to read datagram from session file.\n";
+    close();
+    return false;
+  }
+
+  DatagramIterator scan(dg);
+  _major_version = scan.get_uint16();
+  _minor_version = scan.get_uint16();
+  _first_offset = _next_offset;
+  return true;
+}
+
+/**
+ * Closes the file.  Any frames that have not yet been read can no longer be.
+ */
+void PStatSessionReader::
+close() {
+  if (_in != nullptr) {
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    vfs->close_read_file(_in);
+    _in = nullptr;
+  }
+  _size = -1;
+}
+
+/**
+ * Reads the chunk following the last one read.  Returns true on success,
+ * false on error or at the end of the file.
+ */
+bool PStatSessionReader::
+read_chunk(Datagram &dg) {
+  return read_chunk_at(_next_offset, dg);
+}
+
+/**
+ * Reads the chunk at the indicated offset within the file.  Returns true on
+ * success, false on error.
+ */
+bool PStatSessionReader::
+read_chunk_at(std::streamoff offset, Datagram &dg) {
+  if (_in == nullptr) {
+    return false;
+  }
+
+  _in->clear();
+  _in->seekg(offset);
+
+  // This is the same framing that DatagramOutputFile writes.
+  StreamReader reader(_in, false);
+  std::streamoff header_size = 4;
+  uint64_t length = reader.get_uint32();
+  if (length == 0xffffffff) {
+    length = reader.get_uint64();
+    header_size += 8;
+  }
+  if (_in->fail() ||
+      (_size >= 0 && (uint64_t)(_size - offset - header_size) < length)) {
+    return false;
+  }
+
+  vector_uchar data(length);
+  if (length != 0 && reader.extract_bytes(&data[0], length) != length) {
+    return false;
+  }
+
+  dg = Datagram(std::move(data));
+  dg.set_stdfloat_double(false);
+  _next_offset = offset + header_size + (std::streamoff)length;
+  return true;
+}
+
+/**
+ * Fills in the index of the chunks in the file.  If the file was not closed
+ * properly, or was written before the index was added to the format, the
+ * index is rebuilt by reading through the whole file, which requires decoding
+ * the frames.  Returns true on success, false if the file is unreadable.
+ */
+bool PStatSessionReader::
+read_index(Index &index, PStatClientVersion *version) {
+  index._definitions.clear();
+  index._pages.clear();
+  if (_minor_version >= 1 && read_stored_index(index)) {
+    return true;
+  }
+
+  index._definitions.clear();
+  index._pages.clear();
+  return scan_index(index, version);
+}
+
+/**
+ * Reads the frames in the CT_frames chunk at the indicated offset into the
+ * array of num_frames frames beginning with first_frame.  Frames in the chunk
+ * that are outside that range are skipped.  Returns true on success, false on
+ * error.
+ */
+bool PStatSessionReader::
+read_frames_at(std::streamoff offset, PStatClientVersion *version,
+               int first_frame, int num_frames, PStatFrameData *frames) {
+  Datagram dg;
+  if (!read_chunk_at(offset, dg)) {
+    return false;
+  }
+
+  DatagramIterator scan(dg);
+  if (scan.get_uint8() != PStatSessionWriter::CT_frames) {
+    return false;
+  }
+  // Skip the thread index, and the frame numbers and times covered.
+  scan.skip_bytes(2 + 4 + 4 + 8 + 8);
+
+  PStatFrameData skipped;
+  uint32_t count = scan.get_uint32();
+  for (uint32_t i = 0; i < count; ++i) {
+    int rel_frame = scan.get_int32() - first_frame;
+    PStatFrameData &frame_data =
+      (rel_frame >= 0 && rel_frame < num_frames) ? frames[rel_frame] : skipped;
+    frame_data.clear();
+    frame_data.read_datagram(scan, version);
+  }
+  return true;
+}
+
+/**
+ * Reads the index written at the end of the file by PStatSessionWriter.
+ * Returns false if there is none.
+ */
+bool PStatSessionReader::
+read_stored_index(Index &index) {
+  const std::streamoff end_chunk_size = PStatSessionWriter::end_chunk_size;
+  if (_size < _first_offset + end_chunk_size) {
+    return false;
+  }
+
+  Datagram dg;
+  if (!read_chunk_at(_size - end_chunk_size, dg) ||
+      dg.get_length() != end_chunk_size - 4) {
+    return false;
+  }
+  DatagramIterator end_scan(dg);
+  if (end_scan.get_uint8() != PStatSessionWriter::CT_end) {
+    return false;
+  }
+  std::streamoff index_offset = (std::streamoff)end_scan.get_uint64();
+  if (index_offset < _first_offset || index_offset >= _size - end_chunk_size ||
+      !read_chunk_at(index_offset, dg)) {
+    return false;
+  }
+
+  DatagramIterator scan(dg);
+  if (scan.get_uint8() != PStatSessionWriter::CT_index) {
+    return false;
+  }
+
+  // Check each count against the bytes remaining before trusting it.
+  uint32_t num_definitions = scan.get_uint32();
+  if (num_definitions > scan.get_remaining_size() / 8) {
+    return false;
+  }
+  index._definitions.reserve(num_definitions);
+  for (uint32_t i = 0; i < num_definitions; ++i) {
+    index._definitions.push_back((std::streamoff)scan.get_uint64());
+  }
+
+  uint32_t num_pages = scan.get_uint32();
+  if (num_pages > scan.get_remaining_size() / (2 + 8 + 4)) {
+    return false;
+  }
+  index._pages.resize(num_pages);
+  for (Page &page : index._pages) {
+    page._thread_index = scan.get_int16();
+    page._offset = (std::streamoff)scan.get_uint64();
+    uint32_t count = scan.get_uint32();
+    if (count > scan.get_remaining_size() / (4 + 8 + 8)) {
+      return false;
+    }
+    page._frames.resize(count);
+    for (Frame &frame : page._frames) {
+      frame._frame_number = scan.get_int32();
+      frame._start = scan.get_float64();
+      frame._end = scan.get_float64();
+    }
+  }
+
+  return scan.get_remaining_size() == 0;
+}
+
+/**
+ * Builds the index by reading through every chunk in the file.  Returns false
+ * if the end of the session is not found.
+ */
+bool PStatSessionReader::
+scan_index(Index &index, PStatClientVersion *version) {
+  PStatFrameData frame_data;
+  Datagram dg;
+  std::streamoff offset = _first_offset;
+  while (true) {
+    if (!read_chunk_at(offset, dg)) {
+      nout << "Session file is truncated.\n";
+      return false;
+    }
+
+    DatagramIterator scan(dg);
+    switch ((PStatSessionWriter::ChunkType)scan.get_uint8()) {
+    case PStatSessionWriter::CT_end:
+      return true;
+
+    case PStatSessionWriter::CT_index:
+      break;
+
+    case PStatSessionWriter::CT_frames:
+      {
+        index._pages.push_back(Page());
+        Page &page = index._pages.back();
+        page._thread_index = scan.get_int16();
+        page._offset = offset;
+        scan.skip_bytes(4 + 4 + 8 + 8);
+        uint32_t count = scan.get_uint32();
+        for (uint32_t i = 0; i < count; ++i) {
+          Frame frame;
+          frame._frame_number = scan.get_int32();
+          frame_data.clear();
+          frame_data.read_datagram(scan, version);
+          frame._start = frame_data.get_start();
+          frame._end = frame_data.get_end();
+          page._frames.push_back(frame);
+        }
+      }
+      break;
+
+    default:
+      // The client, collector and thread definitions and the UI state, as
+      // well as any chunk types added by a later version, are read in order.
+      index._definitions.push_back(offset);
+      break;
+    }
+
+    offset = _next_offset;
+  }
+}
@@ -0,0 +1,95 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatSessionReader.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef PSTATSESSIONREADER_H
+#define PSTATSESSIONREADER_H
+
+#include "pandatoolbase.h"
+
+#include "referenceCount.h"
+#include "datagram.h"
+#include "filename.h"
+#include "pvector.h"
+
+class PStatClientVersion;
+class PStatFrameData;
+
+/**
+ * Reads a PStats session file written by PStatSessionWriter.  The file is
+ * held open after the session has been loaded, so that the frame data need
+ * not all be read up front: PStatThreadData reads each chunk of frames from
+ * the file at the offset recorded in the index, the first time one of its
+ * frames is needed.
+ */
+class PStatSessionReader : public ReferenceCount {
+public:
+  PStatSessionReader();
+  ~PStatSessionReader();
+
+  bool open(const Filename &filename);
+  void close();
+
+  INLINE int get_major_version() const;
+  INLINE int get_minor_version() const;
+
+  bool read_chunk(Datagram &dg);
+  bool read_chunk_at(std::streamoff offset, Datagram &dg);
+
+  // The frame numbers and times of one frame in a CT_frames chunk.
+  class Frame {
+  public:
+    int _frame_number;
+    double _start;
+    double _end;
+  };
+
+  // A CT_frames chunk, and the frames in it.
+  class Page {
+  public:
+    int _thread_index;
+    std::streamoff _offset;
+    pvector<Frame> _frames;
+  };
+
+  // The index of a session file: the offsets of the chunks other than the
+  // frames, in the order they were written, and the chunks of frames.
+  class Index {
+  public:
+    pvector<std::streamoff> _definitions;
+    pvector<Page> _pages;
+  };
+
+  bool read_index(Index &index, PStatClientVersion *version);
+  bool read_frames_at(std::streamoff offset, PStatClientVersion *version,
+                      int first_frame, int num_frames, PStatFrameData *frames);
+
+private:
+  bool read_stored_index(Index &index);
+  bool scan_index(Index &index, PStatClientVersion *version);
+
+  std::istream *_in;
+  std::streamoff _size;
+
+  // The offset of the first chunk after the version number.
+  std::streamoff _first_offset;
+
+  // The offset of the chunk following the last one read.
+  std::streamoff _next_offset;
+
+  int _major_version;
+  int _minor_version;
+};
+
+#include "pStatSessionReader.I"
+
+#endif
@@ -0,0 +1,377 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatSessionWriter.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "pStatSessionWriter.h"
+#include "pStatClientData.h"
+
+#include "pStatFrameData.h"
+
+#include <algorithm>
+#include <limits.h>
+
+using std::string;
+
+const string PStatSessionWriter::file_header("pstat\0\n\r", 8);
+
+/**
+ *
+ */
+PStatSessionWriter::
+PStatSessionWriter() {
+  _is_open = false;
+  _file_pos = 0;
+  _num_pages = 0;
+  _num_late_frames = 0;
+  _num_lost_frames = 0;
+}
+
+/**
+ *
+ */
+PStatSessionWriter::
+~PStatSessionWriter() {
+  close();
+}
+
+/**
+ * Creates the indicated session file and writes its header.  Returns true on
+ * success, false on failure.
+ */
+bool PStatSessionWriter::
+open(const Filename &filename) {
+  close();
+
+  _definitions_seq = UpdateSeq::initial();
+  _collectors_written.clear();
+  _levels_written.clear();
+  _threads_written.clear();
+  _thread_names_written.clear();
+  _next_frame.clear();
+  _num_late_frames = 0;
+  _num_lost_frames = 0;
+  _definition_offsets.clear();
+  _page_index.clear();
+  _num_pages = 0;
+
+  if (!_dof.open(filename)) {
+    nout << "Failed to open " << filename << " for writing.\n";
+    return false;
+  }
+  if (!_dof.write_header(file_header)) {
+    _dof.close();
+    return false;
+  }
+
+  Datagram dg;
+  dg.set_stdfloat_double(false);
+  dg.add_uint16(major_version);
+  dg.add_uint16(minor_version);
+  if (!_dof.put_datagram(dg)) {
+    _dof.close();
+    return false;
+  }
+
+  _file_pos = file_header.size() + 4 + dg.get_length();
+  _is_open = true;
+  return true;
+}
+
+/**
+ * Writes the index and the end-of-session marker and closes the file.  It is
+ * not necessary to call this explicitly; the destructor will do it.
+ */
+void PStatSessionWriter::
+close() {
+  if (_is_open) {
+    Datagram index;
+    index.add_uint8(CT_index);
+    index.add_uint32(_definition_offsets.size());
+    for (uint64_t offset : _definition_offsets) {
+      index.add_uint64(offset);
+    }
+    index.add_uint32(_num_pages);
+    index.append_data(_page_index.get_data(), _page_index.get_length());
+    uint64_t index_offset = put_chunk(index);
+
+    // The offset of the index is always found in the last eight bytes of the
+    // file.
+    Datagram dg;
+    dg.add_uint8(CT_end);
+    dg.add_uint64(index_offset);
+    put_chunk(dg);
+    _dof.close();
+    _is_open = false;
+  }
+  _definition_offsets.clear();
+  _page_index.clear();
+  _num_pages = 0;
+}
+
+/**
+ * Writes the information about the client the session was recorded from.
+ */
+void PStatSessionWriter::
+write_client(bool known, const string &hostname, const string &progname,
+             int pid) {
+  Datagram dg;
+  dg.add_uint8(CT_client);
+  dg.add_bool(known);
+  dg.add_string(hostname);
+  dg.add_string(progname);
+  dg.add_int32(pid);
+  _definition_offsets.push_back(put_chunk(dg));
+}
+
+/**
+ * Writes the definitions of any collectors and threads that are new, or that
+ * have changed, since the last call.  This returns immediately if the client
+ * data reports no change to its definitions.
+ */
+void PStatSessionWriter::
+write_definitions(const PStatClientData *client_data) {
+  UpdateSeq seq = client_data->get_definitions_seq();
+  if (seq == _definitions_seq) {
+    return;
+  }
+  _definitions_seq = seq;
+
+  int num_threads = client_data->get_num_threads();
+  int num_collectors = client_data->get_num_collectors();
+  if ((int)_collectors_written.size() < num_collectors) {
+    _collectors_written.resize(num_collectors, false);
+    _levels_written.resize(num_collectors);
+  }
+
+  for (int collector_index = 0; collector_index < num_collectors; ++collector_index) {
+    if (!client_data->has_collector(collector_index)) {
+      continue;
+    }
+
+    // A collector needs to be written again if it has started reporting level
+    // data for another thread.
+    const BitArray &levels = client_data->get_collector_levels(collector_index);
+    if (!_collectors_written[collector_index] ||
+        levels != _levels_written[collector_index]) {
+      Datagram dg;
+      dg.set_stdfloat_double(false);
+      dg.add_uint8(CT_collector);
+      client_data->write_collector_datagram(dg, collector_index);
+      _definition_offsets.push_back(put_chunk(dg));
+
+      _collectors_written[collector_index] = true;
+      _levels_written[collector_index] = levels;
+    }
+  }
+
+  if ((int)_threads_written.size() < num_threads) {
+    _threads_written.resize(num_threads, false);
+    _thread_names_written.resize(num_threads);
+  }
+
+  for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+    if (!client_data->has_thread(thread_index)) {
+      continue;
+    }
+    string name = client_data->get_thread_name(thread_index);
+    if (!_threads_written[thread_index] ||
+        name != _thread_names_written[thread_index]) {
+      Datagram dg;
+      dg.add_uint8(CT_thread);
+      dg.add_int16(thread_index);
+      dg.add_string(name);
+      _definition_offsets.push_back(put_chunk(dg));
+
+      _threads_written[thread_index] = true;
+      _thread_names_written[thread_index] = name;
+    }
+  }
+}
+
+/**
+ * Writes out the frames of each thread that have not yet been written, in
+ * chunks of up to frames_per_chunk frames.  If flush_all is false, only full
+ * chunks are written, and the most recent reorder_frames frames are held
+ * back; otherwise, everything is written.
+ *
+ * Any new collector or thread definitions are written first.  Frames that
+ * arrive after later frames of the same thread have already been written are
+ * not written by this method; see write_late_frame().
+ */
+void PStatSessionWriter::
+write_frames(const PStatClientData *client_data, bool flush_all) {
+  if (!_is_open) {
+    return;
+  }
+  write_definitions(client_data);
+
+  int num_threads = client_data->get_num_threads();
+  if ((int)_next_frame.size() < num_threads) {
+    _next_frame.resize(num_threads, INT_MIN);
+  }
+
+  for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+    if (!client_data->has_thread(thread_index)) {
+      continue;
+    }
+    const PStatThreadData *thread_data = client_data->get_thread_data(thread_index);
+    if (thread_data == nullptr || thread_data->is_empty()) {
+      continue;
+    }
+
+    // Frames that have already been pruned from the history are gone.
+    int next = _next_frame[thread_index];
+    int oldest = thread_data->get_oldest_frame_number();
+    if (next < oldest) {
+      if (next != INT_MIN) {
+        _num_lost_frames += oldest - next;
+      }
+      next = oldest;
+    }
+    int last = thread_data->get_latest_frame_number();
+    if (!flush_all) {
+      last -= reorder_frames;
+    }
+
+    while (next <= last) {
+      // Chunks end on a multiple of frames_per_chunk.
+      int chunk_end = next | (frames_per_chunk - 1);
+      int end = std::min(chunk_end, last);
+      if (!flush_all && end != chunk_end) {
+        // Wait until we have a full chunk.
+        break;
+      }
+      write_frame_chunk(thread_index, thread_data, next, end);
+      next = end + 1;
+    }
+
+    _next_frame[thread_index] = next;
+  }
+}
+
+/**
+ * Should be called when the indicated frame has just been received.  If later
+ * frames of the same thread have already been written by write_frames(), the
+ * frame is written now, in a chunk by itself, and true is returned.  Otherwise
+ * this does nothing, and the frame will be written by a later call to
+ * write_frames().
+ */
+bool PStatSessionWriter::
+write_late_frame(const PStatClientData *client_data, int thread_index,
+                 int frame_number) {
+  if (!_is_open || thread_index < 0 ||
+      thread_index >= (int)_next_frame.size() ||
+      frame_number >= _next_frame[thread_index]) {
+    return false;
+  }
+
+  const PStatThreadData *thread_data = client_data->get_thread_data(thread_index);
+  if (thread_data == nullptr || !thread_data->has_frame(frame_number)) {
+    return false;
+  }
+
+  write_definitions(client_data);
+  write_frame_chunk(thread_index, thread_data, frame_number, frame_number);
+  ++_num_late_frames;
+  return true;
+}
+
+/**
+ * Writes the state of the user interface: the open graphs and the colors
+ * chosen for each collector.  The contents are up to the PStatMonitor.
+ */
+void PStatSessionWriter::
+write_ui(const Datagram &ui_data) {
+  Datagram dg;
+  dg.add_uint8(CT_ui);
+  dg.append_data(ui_data.get_data(), ui_data.get_length());
+  _definition_offsets.push_back(put_chunk(dg));
+}
+
+/**
+ * Writes a CT_frames chunk containing the frames of the indicated thread in
+ * the range first to last, inclusive, that are present in the thread data,
+ * and adds it to the index.  Nothing is written if there are none.
+ */
+void PStatSessionWriter::
+write_frame_chunk(int thread_index, const PStatThreadData *thread_data,
+                  int first, int last) {
+  // Each chunk is labeled with the range it covers, so that a reader may skip
+  // over the chunks it is not interested in without decoding them.
+  Datagram frames;
+  frames.set_stdfloat_double(false);
+  Datagram entries;
+  int count = 0;
+  double start_time = 0.0;
+  double end_time = 0.0;
+  for (int frame_number = first; frame_number <= last; ++frame_number) {
+    if (thread_data->has_frame(frame_number)) {
+      const PStatFrameData &frame_data = thread_data->get_frame(frame_number);
+      if (count == 0) {
+        start_time = frame_data.get_start();
+      }
+      end_time = frame_data.get_end();
+      frames.add_int32(frame_number);
+      frame_data.write_datagram(frames);
+
+      entries.add_int32(frame_number);
+      entries.add_float64(frame_data.get_start());
+      entries.add_float64(frame_data.get_end());
+      ++count;
+    }
+  }
+
+  if (count != 0) {
+    Datagram dg;
+    dg.add_uint8(CT_frames);
+    dg.add_int16(thread_index);
+    dg.add_int32(first);
+    dg.add_int32(last);
+    dg.add_float64(start_time);
+    dg.add_float64(end_time);
+    dg.add_uint32(count);
+    dg.append_data(frames.get_data(), frames.get_length());
+    uint64_t offset = put_chunk(dg);
+
+    _page_index.add_int16(thread_index);
+    _page_index.add_uint64(offset);
+    _page_index.add_uint32(count);
+    _page_index.append_data(entries.get_data(), entries.get_length());
+    ++_num_pages;
+  }
+}
+
+/**
+ * Writes the indicated chunk to the file, and returns the offset at which it
+ * was written.
+ */
+uint64_t PStatSessionWriter::
+put_chunk(Datagram &dg) {
+  uint64_t offset = _file_pos;
+  if (_is_open) {
+    if (!_dof.put_datagram(dg)) {
+      nout << "Error writing session file.\n";
+      _dof.close();
+      _is_open = false;
+    } else {
+      // Each datagram is preceded by its length, which takes another eight
+      // bytes if it does not fit in 32 bits.
+      size_t length = dg.get_length();
+      if (length >= 0xffffffff) {
+        _file_pos += 4 + 8 + length;
+      } else {
+        _file_pos += 4 + length;
+      }
+    }
+  }
+  return offset;
+}
@@ -0,0 +1,132 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatSessionWriter.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef PSTATSESSIONWRITER_H
+#define PSTATSESSIONWRITER_H
+
+#include "pandatoolbase.h"
+
+#include "datagramOutputFile.h"
+#include "bitArray.h"
+#include "filename.h"
+#include "updateSeq.h"
+#include "pvector.h"
+
+class PStatClientData;
+class PStatThreadData;
+
+/**
+ * Writes a PStats session file as a series of independent chunks, each one a
+ * separate datagram, rather than as a single datagram holding the entire
+ * session.  The frame data is broken up into blocks of at most
+ * frames_per_chunk frames of one thread, each labeled with the range of
+ * frames and times it covers, so the file can be appended to continuously
+ * while a session is being recorded, and read back (or skimmed) one chunk at
+ * a time.
+ *
+ * Collector and thread definitions are written the first time they are seen,
+ * and again whenever they change, ahead of any frames that refer to them.
+ *
+ * When the file is closed, an index is written giving the file offset of
+ * every other chunk, and the frame numbers and times in each block of frames,
+ * followed by an end marker holding the offset of the index.  This allows
+ * PStatSessionReader to load the frames of a long session only as they are
+ * needed.
+ */
+class PStatSessionWriter {
+public:
+  PStatSessionWriter();
+  ~PStatSessionWriter();
+
+  bool open(const Filename &filename);
+  void close();
+  INLINE bool is_open() const;
+
+  INLINE int get_num_late_frames() const;
+  INLINE int get_num_lost_frames() const;
+
+  void write_client(bool known, const std::string &hostname,
+                    const std::string &progname, int pid);
+  void write_definitions(const PStatClientData *client_data);
+  void write_frames(const PStatClientData *client_data, bool flush_all);
+  bool write_late_frame(const PStatClientData *client_data, int thread_index,
+                        int frame_number);
+  void write_ui(const Datagram &ui_data);
+
+  // The eight bytes at the start of every session file.
+  static const std::string file_header;
+
+  // The session file format version written by this class.  Version 1 files
+  // hold the entire session in one datagram.
+  static const int major_version = 2;
+  static const int minor_version = 1;
+
+  // Each chunk begins with one of these.
+  enum ChunkType {
+    CT_end = 0,
+    CT_client,
+    CT_collector,
+    CT_thread,
+    CT_frames,
+    CT_ui,
+    CT_index,
+  };
+
+  // The maximum number of frames written in one CT_frames chunk.  This is the
+  // same as the number of frames PStatThreadData keeps together, and chunks
+  // are aligned to multiples of it, so that PStatThreadData can page each one
+  // of its chunks in by reading a single chunk from the file.
+  static const int frames_per_chunk = 64;
+
+  // The size of the CT_end chunk that closes a file with an index.
+  static const int end_chunk_size = 4 + 1 + 8;
+
+  // While recording, the most recent frames of each thread are held back this
+  // long in case some earlier frames are still on their way.
+  static const int reorder_frames = 32;
+
+private:
+  void write_frame_chunk(int thread_index, const PStatThreadData *thread_data,
+                         int first, int last);
+  uint64_t put_chunk(Datagram &dg);
+
+  DatagramOutputFile _dof;
+  bool _is_open;
+
+  // The offset within the file of the next chunk to be written.
+  uint64_t _file_pos;
+
+  // The contents of the index, built up as the chunks are written.
+  pvector<uint64_t> _definition_offsets;
+  Datagram _page_index;
+  uint32_t _num_pages;
+
+  // The PStatClientData definitions sequence as of the last
+  // write_definitions().  Nothing needs to be written while it is unchanged.
+  UpdateSeq _definitions_seq;
+
+  pvector<bool> _collectors_written;
+  pvector<BitArray> _levels_written;
+  pvector<bool> _threads_written;
+  pvector<std::string> _thread_names_written;
+
+  // The next frame number to be written for each thread.
+  pvector<int> _next_frame;
+
+  int _num_late_frames;
+  int _num_lost_frames;
+};
+
+#include "pStatSessionWriter.I"
+
+#endif
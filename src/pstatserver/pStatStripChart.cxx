@@ -19,12 +19,20 @@
 #include "pStatCollectorDef.h"
 #include "string_utils.h"
 #include "config_pstatclient.h"
+#include "configVariableInt.h"
 
 #include <algorithm>
 
 using std::max;
 using std::min;
 
+static ConfigVariableInt pstats_strip_chart_cache_size
+("pstats-strip-chart-cache-size", 4096,
+ PRC_DESC("The maximum amount of memory, in kilobytes, that each strip chart "
+          "will use to remember the computed data for the frames it has "
+          "drawn.  Frames that are discarded will be recomputed if they are "
+          "needed again."));
+
 /**
  *
  */
@@ -42,6 +50,8 @@ PStatStripChart(PStatMonitor *monitor,
 
   _next_frame = 0;
   _first_data = true;
+  _data_first_frame = 0;
+  _data_size = 0;
   _cursor_pixel = 0;
 
   _time_width = 20.0;
@@ -105,13 +115,9 @@ update() {
       double oldest_time =
         thread_data->get_frame(latest).get_start() - _time_width;
 
-      Data::iterator di;
-      di = _data.begin();
-      while (di != _data.end() &&
-             thread_data->get_frame((*di).first).get_start() < oldest_time) {
-        dec_label_usage((*di).second);
-        _data.erase(di);
-        di = _data.begin();
+      while (!_data.empty() &&
+             thread_data->get_frame(_data_first_frame).get_start() < oldest_time) {
+        pop_front_data();
       }
     }
   }
@@ -141,7 +147,7 @@ set_collector_index(int collector_index) {
   if (_collector_index != collector_index) {
     _collector_index = collector_index;
     _title_unknown = true;
-    _data.clear();
+    clear_data();
     clear_label_usage();
     set_auto_vertical_scale();
     force_redraw();
@@ -582,16 +588,98 @@ scale_frame_data(FrameData &fdata, double factor) {
  */
 const PStatStripChart::FrameData &PStatStripChart::
 get_frame_data(int frame_number) const {
-  Data::const_iterator di;
-  di = _data.find(frame_number);
-  if (di != _data.end()) {
-    return (*di).second;
+  int index = frame_number - _data_first_frame;
+  if (index >= 0 && index < (int)_data.size() && _data[index]._computed) {
+    return _data[index]._fdata;
   }
 
+  fill_frame_data(frame_number, frame_number);
+  return _data[frame_number - _data_first_frame]._fdata;
+}
+
+/**
+ * Makes sure that the color data for all of the frames in the indicated range
+ * has been computed, so that get_frame_data() will find them in the cache.
+ * This may discard other frames from the cache to make room, but never any of
+ * the frames in the range unless the range itself is too large to fit.
+ */
+void PStatStripChart::
+fill_frame_data(int first_frame, int last_frame) const {
+  nassertv(first_frame <= last_frame);
+
+  size_t max_size = (size_t)max((int)pstats_strip_chart_cache_size, 1) * 1024;
+
+  // If the requested frames are far from the cached ones, the empty entries
+  // needed to bridge the gap would not fit in the cache; start over instead.
+  if (!_data.empty()) {
+    int data_last_frame = _data_first_frame + (int)_data.size() - 1;
+    int gap = 0;
+    if (first_frame > data_last_frame) {
+      gap = first_frame - data_last_frame;
+    } else if (last_frame < _data_first_frame) {
+      gap = _data_first_frame - last_frame;
+    }
+    if ((size_t)gap * sizeof(CachedFrame) > max_size) {
+      while (!_data.empty()) {
+        pop_back_data();
+      }
+    }
+  }
+
+  // Extend the range of the cache to include the requested frames.  Every
+  // entry counts toward the size of the cache, whether it has been computed
+  // or not.
+  if (_data.empty()) {
+    _data_first_frame = first_frame;
+  }
+  while (first_frame < _data_first_frame) {
+    _data.emplace_front();
+    _data_size += sizeof(CachedFrame);
+    --_data_first_frame;
+  }
+  while (_data_first_frame + (int)_data.size() <= last_frame) {
+    _data.emplace_back();
+    _data_size += sizeof(CachedFrame);
+  }
+
+  for (int frame_number = first_frame; frame_number <= last_frame; ++frame_number) {
+    CachedFrame &cached = _data[frame_number - _data_first_frame];
+    if (!cached._computed) {
+      compute_frame_data(frame_number, cached._fdata);
+      cached._computed = true;
+      _data_size += cached._fdata.size() * sizeof(ColorData);
+    }
+
+    // Make room by discarding the frames farthest from this one, but keep
+    // the frames we were asked for.  Note that discarding frames from either
+    // end of a deque does not move the other frames.
+    while (_data_size > max_size) {
+      int data_last_frame = _data_first_frame + (int)_data.size() - 1;
+      bool can_pop_front = (_data_first_frame < first_frame);
+      bool can_pop_back = (data_last_frame > last_frame);
+      if (can_pop_front &&
+          (!can_pop_back ||
+           frame_number - _data_first_frame >= data_last_frame - frame_number)) {
+        pop_front_data();
+      } else if (can_pop_back) {
+        pop_back_data();
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * Computes the color data for the indicated frame, by setting the view to
+ * that frame.
+ */
+void PStatStripChart::
+compute_frame_data(int frame_number, FrameData &fdata) const {
   const PStatThreadData *thread_data = _view.get_thread_data();
   _view.set_to_frame(thread_data->get_frame(frame_number));
 
-  FrameData &fdata = _data[frame_number];
+  fdata.clear();
 
   const PStatViewLevel *level = _view.get_level(_collector_index);
   int num_children = level->get_num_children();
@@ -619,8 +707,47 @@ get_frame_data(int frame_number) const {
   }
 
   ((PStatStripChart *)this)->inc_label_usage(fdata);
+}
 
-  return fdata;
+/**
+ * Discards the oldest frame from the cache of color data.
+ */
+void PStatStripChart::
+pop_front_data() const {
+  nassertv(!_data.empty());
+  CachedFrame &cached = _data.front();
+  if (cached._computed) {
+    ((PStatStripChart *)this)->dec_label_usage(cached._fdata);
+    _data_size -= cached._fdata.size() * sizeof(ColorData);
+  }
+  _data_size -= sizeof(CachedFrame);
+  _data.pop_front();
+  ++_data_first_frame;
+}
+
+/**
+ * Discards the newest frame from the cache of color data.
+ */
+void PStatStripChart::
+pop_back_data() const {
+  nassertv(!_data.empty());
+  CachedFrame &cached = _data.back();
+  if (cached._computed) {
+    ((PStatStripChart *)this)->dec_label_usage(cached._fdata);
+    _data_size -= cached._fdata.size() * sizeof(ColorData);
+  }
+  _data_size -= sizeof(CachedFrame);
+  _data.pop_back();
+}
+
+/**
+ * Discards all of the cached color data.  The caller should also clear the
+ * label usage.
+ */
+void PStatStripChart::
+clear_data() {
+  _data.clear();
+  _data_size = 0;
 }
 
 /**
@@ -1024,6 +1151,16 @@ draw_pixels(int first_pixel, int last_pixel) {
     double start_time = pixel_to_timestamp(first_pixel);
     int then_i = thread_data->get_frame_number_at_time(start_time - pstats_average_time);
     int now_i = thread_data->get_frame_number_at_time(start_time, then_i);
+
+    // Compute all of the frames we will be averaging in one go.  The last
+    // pixel may reach into the frame after the one at its timestamp.
+    int first_frame = max(then_i, thread_data->get_oldest_frame_number());
+    int last_frame = thread_data->get_frame_number_at_time(pixel_to_timestamp(last_pixel), now_i);
+    last_frame = min(last_frame + 1, thread_data->get_latest_frame_number());
+    if (first_frame <= last_frame) {
+      fill_frame_data(first_frame, last_frame);
+    }
+
     for (int x = first_pixel; x <= last_pixel; x++) {
       if (x == _cursor_pixel && !_scroll_mode) {
         draw_cursor(x);
@@ -1037,6 +1174,15 @@ draw_pixels(int first_pixel, int last_pixel) {
   } else {
     // When average mode is false, we are in frame mode; just show the actual
     // frame data.
+    if (!thread_data->is_empty()) {
+      int first_frame = thread_data->get_frame_number_at_time(pixel_to_timestamp(first_pixel));
+      int last_frame = thread_data->get_frame_number_at_time(pixel_to_timestamp(last_pixel), first_frame);
+      first_frame = max(first_frame, thread_data->get_oldest_frame_number());
+      if (first_frame <= last_frame) {
+        fill_frame_data(first_frame, last_frame);
+      }
+    }
+
     int frame_number = -1;
     int x = first_pixel;
     while (x <= last_pixel) {
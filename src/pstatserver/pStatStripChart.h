@@ -24,6 +24,7 @@
 #include "vector_int.h"
 
 #include "pmap.h"
+#include "pdeque.h"
 
 class PStatView;
 
@@ -87,7 +88,6 @@ protected:
     double _net_value;
   };
   typedef pvector<ColorData> FrameData;
-  typedef pmap<int, FrameData> Data;
 
   static void accumulate_frame_data(FrameData &fdata,
                                     const FrameData &additional, double weight);
@@ -121,6 +121,12 @@ private:
   void draw_frames(int first_frame, int last_frame);
   void draw_pixels(int first_pixel, int last_pixel);
 
+  void fill_frame_data(int first_frame, int last_frame) const;
+  void compute_frame_data(int frame_number, FrameData &fdata) const;
+  void pop_front_data() const;
+  void pop_back_data() const;
+  void clear_data();
+
   void clear_label_usage();
   void dec_label_usage(const FrameData &fdata);
   void inc_label_usage(const FrameData &fdata);
@@ -134,7 +140,19 @@ private:
   bool _scroll_mode;
   bool _average_mode;
 
+  // The color data for a contiguous range of frames beginning with
+  // _data_first_frame, each computed when it is first needed.  The total size
+  // is limited by pstats-strip-chart-cache-size; frames are discarded from
+  // whichever end is farthest from the frame being requested.
+  class CachedFrame {
+  public:
+    bool _computed = false;
+    FrameData _fdata;
+  };
+  typedef pdeque<CachedFrame> Data;
   mutable Data _data;
+  mutable int _data_first_frame;
+  mutable size_t _data_size;
 
   int _next_frame;
   bool _first_data;
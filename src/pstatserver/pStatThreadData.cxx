@@ -13,12 +13,24 @@
 
 #include "pStatThreadData.h"
 
+#include "pStatClientData.h"
 #include "pStatFrameData.h"
 #include "pStatCollectorDef.h"
 #include "config_pstatclient.h"
+#include "configVariableInt.h"
 
+#include <algorithm>
+
+static ConfigVariableInt pstats_resident_frames
+("pstats-resident-frames", 16384,
+ PRC_DESC("The maximum number of frames of each thread of a session file "
+          "that are kept in memory at once.  The frames of a session file "
+          "are read from the file as they are needed; once this many have "
+          "been read, the ones read longest ago are dropped, and will be "
+          "read again if they are needed again."));
 
 PStatFrameData PStatThreadData::_null_frame;
+unsigned int PStatThreadData::_pin_epoch = 1;
 
 /**
  *
@@ -27,7 +39,9 @@ PStatThreadData::
 PStatThreadData(const PStatClientData *client_data) :
   _client_data(client_data)
 {
+  _first_chunk = 0;
   _first_frame_number = 0;
+  _num_frames = 0;
   _history = pstats_history;
   _computed_elapsed_frames = false;
 }
@@ -37,6 +51,10 @@ PStatThreadData(const PStatClientData *client_data) :
  */
 PStatThreadData::
 ~PStatThreadData() {
+  clear_frames();
+  for (PStatFrameData *frames : _spare_frames) {
+    delete[] frames;
+  }
 }
 
 /**
@@ -44,8 +62,8 @@ PStatThreadData::
  */
 int PStatThreadData::
 get_latest_frame_number() const {
-  nassertr(!_frames.empty(), 0);
-  return _first_frame_number + _frames.size() - 1;
+  nassertr(_num_frames != 0, 0);
+  return _first_frame_number + _num_frames - 1;
 }
 
 /**
@@ -53,7 +71,7 @@ get_latest_frame_number() const {
  */
 int PStatThreadData::
 get_oldest_frame_number() const {
-  nassertr(!_frames.empty(), 0);
+  nassertr(_num_frames != 0, 0);
   return _first_frame_number;
 }
 
@@ -65,8 +83,8 @@ bool PStatThreadData::
 has_frame(int frame_number) const {
   int rel_frame = frame_number - _first_frame_number;
 
-  return (rel_frame >= 0 && rel_frame < (int)_frames.size() &&
-          _frames[rel_frame] != nullptr);
+  return (rel_frame >= 0 && rel_frame < _num_frames &&
+          has_frame_data(frame_number));
 }
 
 /**
@@ -77,28 +95,27 @@ has_frame(int frame_number) const {
 const PStatFrameData &PStatThreadData::
 get_frame(int frame_number) const {
   int rel_frame = frame_number - _first_frame_number;
-  int num_frames = _frames.size();
+  int num_frames = _num_frames;
   if (rel_frame >= num_frames) {
     rel_frame = num_frames - 1;
   }
 
-  while (rel_frame >= 0 && _frames[rel_frame] == nullptr) {
+  while (rel_frame >= 0 && !has_frame_data(_first_frame_number + rel_frame)) {
     rel_frame--;
   }
   if (rel_frame < 0) {
     // No frame data that old.  Return the oldest frame we've got.
     rel_frame = 0;
     while (rel_frame < num_frames &&
-           _frames[rel_frame] == nullptr) {
+           !has_frame_data(_first_frame_number + rel_frame)) {
       rel_frame++;
     }
   }
 
   if (rel_frame >= 0 && rel_frame < num_frames) {
-    PStatFrameData *frame = _frames[rel_frame];
-    nassertr(frame != nullptr, _null_frame);
-    nassertr(frame->get_start() >= 0.0, _null_frame);
-    return *frame;
+    const PStatFrameData &frame = get_frame_data(_first_frame_number + rel_frame);
+    nassertr(frame.get_start() >= 0.0, _null_frame);
+    return frame;
   }
 
   nassertr(_null_frame.get_start() >= 0.0, _null_frame);
@@ -111,8 +128,8 @@ get_frame(int frame_number) const {
  */
 double PStatThreadData::
 get_latest_time() const {
-  nassertr(!_frames.empty(), 0.0);
-  return _frames.back()->get_start();
+  nassertr(_num_frames != 0, 0.0);
+  return get_frame_start(_first_frame_number + _num_frames - 1);
 }
 
 /**
@@ -121,8 +138,8 @@ get_latest_time() const {
  */
 double PStatThreadData::
 get_oldest_time() const {
-  nassertr(!_frames.empty(), 0.0);
-  return _frames.front()->get_start();
+  nassertr(_num_frames != 0, 0.0);
+  return get_frame_start(_first_frame_number);
 }
 
 /**
@@ -140,39 +157,59 @@ get_frame_at_time(double time) const {
  *
  * If the hint is nonnegative, it represents a frame number that we believe
  * the correct answer to be near, which may speed the search for the frame.
+ * The search takes logarithmic time even if the hint is wrong.
  */
 int PStatThreadData::
 get_frame_number_at_time(double time, int hint) const {
-  hint -= _first_frame_number;
-  if (hint >= 0 && hint < (int)_frames.size()) {
-    if (_frames[hint] != nullptr &&
-        _frames[hint]->get_start() <= time) {
-      // The hint might be right.  Scan forward from there.
+  int end_frame = _first_frame_number + _num_frames;
+  if (hint >= _first_frame_number && hint < end_frame) {
+    if (has_frame_data(hint) && get_frame_start(hint) <= time) {
+      // The hint might be right.  Scan forward a short distance from there,
+      // until we find a frame that is later than the time.
       int i = hint + 1;
-      while (i < (int)_frames.size() &&
-             (_frames[i] == nullptr ||
-              _frames[i]->get_start() <= time)) {
-        if (_frames[i] != nullptr) {
+      int scan_end = std::min(end_frame, hint + chunk_size);
+      while (i < scan_end &&
+             (!has_frame_data(i) || get_frame_start(i) <= time)) {
+        if (has_frame_data(i)) {
           hint = i;
         }
         ++i;
       }
-      return _first_frame_number + hint;
+      if (i < scan_end || i == end_frame) {
+        return hint;
+      }
     }
   }
 
-  // The hint is totally wrong.  Start from the end and work backwards.
+  // Find the last chunk that contains a frame not later than the time.
+  // Since _min_start never decreases, everything after that chunk is later.
+  int lo = 0;
+  int hi = (int)_chunks.size();
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (_chunks[mid]->_min_start <= time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    // Every frame is later than the time.
+    return _first_frame_number - 1;
+  }
 
-  int i = _frames.size() - 1;
-  while (i >= 0) {
-    const PStatFrameData *frame = _frames[i];
-    if (frame != nullptr && frame->get_start() <= time) {
+  // Then scan backwards from the end of that chunk.  The frame will usually be
+  // within it, but if that chunk's frames have since been pruned or
+  // replaced, we may have to keep looking.
+  int i = std::min(end_frame, (_first_chunk + lo) << chunk_bits) - 1;
+  while (i >= _first_frame_number) {
+    if (has_frame_data(i) && get_frame_start(i) <= time) {
       break;
     }
     --i;
   }
 
-  return _first_frame_number + i;
+  return i;
 }
 
 /**
@@ -180,8 +217,8 @@ get_frame_number_at_time(double time, int hint) const {
  */
 const PStatFrameData &PStatThreadData::
 get_latest_frame() const {
-  nassertr(!_frames.empty(), _null_frame);
-  return *_frames.back();
+  nassertr(_num_frames != 0, _null_frame);
+  return get_frame_data(_first_frame_number + _num_frames - 1);
 }
 
 /**
@@ -213,8 +250,8 @@ get_frame_rate() const {
   }
 
   int num_frames = now_i - then_i + 1;
-  double now = _frames[now_i - _first_frame_number]->get_end();
-  double elapsed_time = (now - _frames[then_i - _first_frame_number]->get_start());
+  double now = get_frame_end(now_i);
+  double elapsed_time = (now - get_frame_start(then_i));
   return (double)num_frames / elapsed_time;
 }
 
@@ -247,16 +284,14 @@ get_history() const {
 bool PStatThreadData::
 prune_history(double time) {
   double oldest_allowable_time = time - _history;
-  while (!_frames.empty() &&
-         (_frames.front() == nullptr ||
-          _frames.front()->is_time_empty() ||
-          _frames.front()->get_start() < oldest_allowable_time)) {
-    delete _frames.front();
-    _frames.pop_front();
-    _first_frame_number++;
+  while (_num_frames != 0 &&
+         (!has_frame_data(_first_frame_number) ||
+          get_frame_data(_first_frame_number).is_time_empty() ||
+          get_frame_start(_first_frame_number) < oldest_allowable_time)) {
+    pop_front_frame();
   }
 
-  return _frames.empty();
+  return _num_frames == 0;
 }
 
 /**
@@ -264,8 +299,8 @@ prune_history(double time) {
  * function may cause old frame data to be discarded to make room, according
  * to the amount of time set up via set_history().
  *
- * The pointer will become owned by the PStatThreadData object and will be
- * freed on destruction.
+ * The pointer will become owned by the PStatThreadData object, which moves
+ * the data into its own storage and frees it immediately.
  */
 void PStatThreadData::
 record_new_frame(int frame_number, PStatFrameData *frame_data) {
@@ -273,36 +308,68 @@ record_new_frame(int frame_number, PStatFrameData *frame_data) {
   nassertv(!frame_data->is_empty());
 
   // First, remove all the old frames that fall outside of our history window.
-  // Then, add enough empty frame definitions to account for the latest frame
-  // number.  This might involve some skips, since we don't guarantee that we
-  // get all the frames in order or even at all.
-  if (prune_history(frame_data->get_start())) {
-    _first_frame_number = frame_number;
-    _frames.push_back(nullptr);
+  // Then, extend the range to account for the latest frame number.
+  prune_history(frame_data->get_start());
+  extend_range(frame_number);
+
+  int chunk_number = frame_number >> chunk_bits;
+  Chunk *chunk = get_chunk(frame_number);
+  int slot = frame_number & (chunk_size - 1);
+  uint64_t bit = (uint64_t)1 << slot;
+
+  if (chunk->_present & bit) {
+    nout << "Got repeated frame data for frame " << frame_number << "\n";
   }
-  else {
-    while (_first_frame_number + (int)_frames.size() <= frame_number) {
-      _frames.push_back(nullptr);
+
+  if (chunk->_frames == nullptr) {
+    if (!chunk->_pages.empty()) {
+      chunk->_pinned = _pin_epoch;
+      page_in(chunk_number);
+    } else {
+      chunk->_frames = alloc_frames();
     }
   }
 
-  int index = frame_number - _first_frame_number;
-
-  // It's possible to receive frames out of order.
-  while (index < 0) {
-    _frames.push_front(nullptr);
-    ++index;
-    --_first_frame_number;
-  }
+  // The frame's arrays are moved into the slot, not copied; whatever the slot
+  // held before goes away with the PStatFrameData object.
+  chunk->_start[slot] = frame_data->get_start();
+  chunk->_end[slot] = frame_data->get_end();
+  chunk->_frames[slot].swap(*frame_data);
+  chunk->_present |= bit;
+  chunk->_in_file &= ~bit;
+  update_min_start(chunk_number - _first_chunk, chunk->_start[slot]);
+  delete frame_data;
 
-  nassertv(index >= 0 && index < (int)_frames.size());
+  _computed_elapsed_frames = false;
+}
 
-  if (_frames[index] != nullptr) {
-    nout << "Got repeated frame data for frame " << frame_number << "\n";
-    delete _frames[index];
+/**
+ * Records a frame of a session that is being read from a file, without its
+ * data.  The data will be read from the CT_frames chunk at the indicated
+ * offset of the reader's file when it is first needed.
+ *
+ * Frames recorded this way are not subject to the history; the entire
+ * session is kept available.
+ */
+void PStatThreadData::
+record_paged_frame(int frame_number, double start, double end,
+                   PStatSessionReader *reader, std::streamoff offset) {
+  nassertv(_reader == nullptr || _reader == reader);
+  _reader = reader;
+  extend_range(frame_number);
+
+  int chunk_number = frame_number >> chunk_bits;
+  Chunk *chunk = get_chunk(frame_number);
+  int slot = frame_number & (chunk_size - 1);
+  chunk->_start[slot] = start;
+  chunk->_end[slot] = end;
+  chunk->_present |= (uint64_t)1 << slot;
+  chunk->_in_file |= (uint64_t)1 << slot;
+  if (chunk->_pages.empty() || chunk->_pages.back() != offset) {
+    chunk->_pages.push_back(offset);
   }
+  update_min_start(chunk_number - _first_chunk, start);
 
-  _frames[index] = frame_data;
   _computed_elapsed_frames = false;
 }
 
@@ -311,14 +378,12 @@ record_new_frame(int frame_number, PStatFrameData *frame_data) {
  */
 void PStatThreadData::
 write_datagram(Datagram &dg) const {
-  int frame_number = _first_frame_number;
-
-  for (PStatFrameData *frame_data : _frames) {
-    if (frame_data != nullptr) {
+  int end_frame = _first_frame_number + _num_frames;
+  for (int frame_number = _first_frame_number; frame_number < end_frame; ++frame_number) {
+    if (has_frame_data(frame_number)) {
       dg.add_int32(frame_number);
-      frame_data->write_datagram(dg);
+      get_frame_data(frame_number).write_datagram(dg);
     }
-    ++frame_number;
   }
   dg.add_int32(-1);
 }
@@ -344,32 +409,29 @@ read_datagram(DatagramIterator &scan, PStatClientVersion *version) {
  */
 void PStatThreadData::
 compute_elapsed_frames() const {
-  if (_frames.empty()) {
+  if (_num_frames == 0) {
     // No frames in the data at all.
     _got_elapsed_frames = false;
   }
   else {
-    _now_i = _frames.size() - 1;
-    while (_now_i > 0 && _frames[_now_i] == nullptr) {
+    _now_i = _first_frame_number + _num_frames - 1;
+    while (_now_i > _first_frame_number && !has_frame_data(_now_i)) {
       _now_i--;
     }
-    if (_now_i < 0) {
+    if (!has_frame_data(_now_i)) {
       // No frames have any real data.
       _got_elapsed_frames = false;
     }
     else {
-      nassertv(_frames[_now_i] != nullptr);
-
-      double now = _frames[_now_i]->get_end();
+      double now = get_frame_end(_now_i);
       double then = now - pstats_average_time;
 
       int old_i = _now_i;
       _then_i = _now_i;
 
-      while (old_i >= 0) {
-        const PStatFrameData *frame = _frames[old_i];
-        if (frame != nullptr) {
-          if (frame->get_start() > then) {
+      while (old_i >= _first_frame_number) {
+        if (has_frame_data(old_i)) {
+          if (get_frame_start(old_i) > then) {
             _then_i = old_i;
           } else {
             break;
@@ -378,14 +440,238 @@ compute_elapsed_frames() const {
         old_i--;
       }
 
-      nassertv(_then_i >= 0);
-      nassertv(_frames[_then_i] != nullptr);
+      nassertv(has_frame_data(_then_i));
       _got_elapsed_frames = true;
-
-      _now_i += _first_frame_number;
-      _then_i += _first_frame_number;
     }
   }
 
   _computed_elapsed_frames = true;
 }
+
+/**
+ * Extends the range of stored frames to include the indicated frame number,
+ * adding chunks as needed.  This might involve some skips, since we don't
+ * guarantee that we get all the frames in order or even at all.
+ */
+void PStatThreadData::
+extend_range(int frame_number) {
+  int chunk_number = frame_number >> chunk_bits;
+  if (_num_frames == 0) {
+    clear_frames();
+    _first_frame_number = frame_number;
+    _first_chunk = chunk_number;
+    _num_frames = 1;
+    _chunks.push_back(new Chunk);
+  }
+  else if (frame_number >= _first_frame_number + _num_frames) {
+    _num_frames = frame_number - _first_frame_number + 1;
+    while (_first_chunk + (int)_chunks.size() <= chunk_number) {
+      _chunks.push_back(new Chunk);
+    }
+  }
+  else if (frame_number < _first_frame_number) {
+    // It's possible to receive frames out of order.
+    _num_frames += _first_frame_number - frame_number;
+    _first_frame_number = frame_number;
+    while (_first_chunk > chunk_number) {
+      Chunk *chunk = new Chunk;
+      chunk->_min_start = _chunks.front()->_min_start;
+      _chunks.push_front(chunk);
+      --_first_chunk;
+    }
+  }
+}
+
+/**
+ * Reads the frames of the indicated chunk from the session file, and then
+ * drops other chunks if this leaves more than pstats-resident-frames frames
+ * in memory.
+ */
+void PStatThreadData::
+page_in(int chunk_number) const {
+  read_chunk(_chunks[chunk_number - _first_chunk], chunk_number);
+
+  _resident.push_back(chunk_number);
+  page_out();
+}
+
+/**
+ * Drops the frames of the chunks that were paged in longest ago, until no
+ * more than pstats-resident-frames frames are in memory.  A chunk is kept if
+ * one of its frames has been asked for since the last call to unpin_frames(),
+ * since the caller may still hold a reference to it, or if it holds a frame
+ * that is not in the session file.
+ */
+void PStatThreadData::
+page_out() const {
+  int max_resident = std::max((int)pstats_resident_frames / (int)chunk_size, 2);
+  pdeque<int>::iterator ri = _resident.begin();
+  while ((int)_resident.size() > max_resident && ri != _resident.end()) {
+    int index = (*ri) - _first_chunk;
+    if (index < 0 || index >= (int)_chunks.size() ||
+        _chunks[index]->_frames == nullptr) {
+      // This chunk has since been pruned.
+      ri = _resident.erase(ri);
+      continue;
+    }
+
+    Chunk *chunk = _chunks[index];
+    if (chunk->_pinned == _pin_epoch ||
+        (chunk->_present & ~chunk->_in_file) != 0) {
+      ++ri;
+      continue;
+    }
+
+    free_frames(chunk->_frames);
+    chunk->_frames = nullptr;
+    ri = _resident.erase(ri);
+  }
+}
+
+/**
+ * Allocates the frames of the indicated chunk, and reads them from the
+ * session file.
+ */
+void PStatThreadData::
+read_chunk(const Chunk *chunk, int chunk_number) const {
+  nassertv(chunk->_frames == nullptr);
+  chunk->_frames = alloc_frames();
+
+  nassertv(_reader != nullptr);
+  PStatClientVersion *version = (PStatClientData *)_client_data;
+  int first_frame = chunk_number << chunk_bits;
+  for (std::streamoff offset : chunk->_pages) {
+    if (!_reader->read_frames_at(offset, version, first_frame, chunk_size,
+                                 chunk->_frames)) {
+      nout << "Failed to read frames " << first_frame << " through "
+           << first_frame + chunk_size - 1 << " from session file.\n";
+    }
+  }
+}
+
+/**
+ * Returns an array of chunk_size empty frames, reusing one that was freed by
+ * free_frames() if there is one.
+ */
+PStatFrameData *PStatThreadData::
+alloc_frames() const {
+  if (_spare_frames.empty()) {
+    return new PStatFrameData[chunk_size];
+  }
+  PStatFrameData *frames = _spare_frames.back();
+  _spare_frames.pop_back();
+  return frames;
+}
+
+/**
+ * Gives back an array of frames allocated by alloc_frames().  A few arrays
+ * are cleared and kept for reuse; clearing a frame keeps the capacity of its
+ * event arrays, so that reading another frame into it need not allocate.
+ */
+void PStatThreadData::
+free_frames(PStatFrameData *frames) const {
+  if (frames == nullptr) {
+    return;
+  }
+  if (_spare_frames.size() >= max_spare_frames) {
+    delete[] frames;
+    return;
+  }
+  for (int i = 0; i < chunk_size; ++i) {
+    frames[i].clear();
+  }
+  _spare_frames.push_back(frames);
+}
+
+/**
+ * Reads all of the frames that have not yet been read from the session file,
+ * and lets go of the file.  The frames are all held in memory from then on.
+ */
+void PStatThreadData::
+release_reader() {
+  if (_reader == nullptr) {
+    return;
+  }
+
+  for (size_t i = 0; i < _chunks.size(); ++i) {
+    Chunk *chunk = _chunks[i];
+    if (chunk->_frames == nullptr && !chunk->_pages.empty()) {
+      read_chunk(chunk, _first_chunk + (int)i);
+    }
+    chunk->_pages.clear();
+  }
+  _resident.clear();
+  _reader.clear();
+}
+
+/**
+ * Declares that the references returned by get_frame() and the like are no
+ * longer held by anyone, so that the frames of session files may be dropped
+ * from memory again.  This should be called where no such reference can be
+ * outstanding, for instance between polls of the event loop; it is called by
+ * PStatServer::poll().
+ */
+void PStatThreadData::
+unpin_frames() {
+  ++_pin_epoch;
+}
+
+/**
+ * Discards the oldest frame in the range, freeing its chunk if it was the last
+ * frame in it.
+ */
+void PStatThreadData::
+pop_front_frame() {
+  nassertv(_num_frames != 0);
+  Chunk *chunk = get_chunk(_first_frame_number);
+  int slot = _first_frame_number & (chunk_size - 1);
+  uint64_t bit = (uint64_t)1 << slot;
+  if (chunk->_frames != nullptr && (chunk->_present & bit)) {
+    chunk->_frames[slot].clear();
+  }
+
+  // Even if the chunk is not in memory, the frame must not be read back in.
+  chunk->_present &= ~bit;
+  chunk->_in_file &= ~bit;
+
+  ++_first_frame_number;
+  --_num_frames;
+
+  if (_num_frames == 0) {
+    clear_frames();
+  }
+  else if ((_first_frame_number >> chunk_bits) != _first_chunk) {
+    Chunk *front = _chunks.front();
+    free_frames(front->_frames);
+    front->_frames = nullptr;
+    delete front;
+    _chunks.pop_front();
+    ++_first_chunk;
+  }
+}
+
+/**
+ * Lowers the _min_start of the indicated chunk, and of the chunks before it,
+ * to account for a new frame with the indicated start time.
+ */
+void PStatThreadData::
+update_min_start(int chunk_index, double start) {
+  // Frames usually arrive in order, so this rarely goes past the first chunk.
+  while (chunk_index >= 0 && _chunks[chunk_index]->_min_start > start) {
+    _chunks[chunk_index]->_min_start = start;
+    --chunk_index;
+  }
+}
+
+/**
+ * Frees all of the stored frames.
+ */
+void PStatThreadData::
+clear_frames() {
+  for (Chunk *chunk : _chunks) {
+    delete chunk;
+  }
+  _chunks.clear();
+  _resident.clear();
+  _num_frames = 0;
+}
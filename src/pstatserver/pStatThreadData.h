@@ -18,11 +18,16 @@
 #include "datagram.h"
 #include "datagramIterator.h"
 #include "referenceCount.h"
+#include "pStatFrameData.h"
+#include "pStatSessionReader.h"
+#include "pointerTo.h"
 
 #include "pdeque.h"
+#include "pvector.h"
+
+#include <limits>
 
 class PStatCollectorDef;
-class PStatFrameData;
 class PStatClientData;
 class PStatClientVersion;
 
@@ -32,6 +37,14 @@ class PStatClientVersion;
  * it automatically handles frames received out-of-order or skipped.  You can
  * ask for a particular frame by frame number or time and receive the data for
  * the nearest frame.
+ *
+ * The frames of a session loaded from a file are not held in memory all at
+ * once.  Only their numbers and times are recorded up front; the rest of each
+ * frame is read from the file by the PStatSessionReader when it is first
+ * asked for, and dropped again when too many other frames have been read
+ * since.  A frame that has been asked for is never dropped before the next
+ * call to unpin_frames(), so the references returned by get_frame() and the
+ * like remain valid until then.
  */
 class PStatThreadData : public ReferenceCount {
 public:
@@ -63,20 +76,102 @@ public:
   bool prune_history(double time);
 
   void record_new_frame(int frame_number, PStatFrameData *frame_data);
+  void record_paged_frame(int frame_number, double start, double end,
+                          PStatSessionReader *reader, std::streamoff offset);
+  void release_reader();
+
+  static void unpin_frames();
 
   void write_datagram(Datagram &dg) const;
   void read_datagram(DatagramIterator &scan, PStatClientVersion *version);
 
 private:
+  class Chunk;
+
   void compute_elapsed_frames() const;
 
+  INLINE bool has_frame_data(int frame_number) const;
+  INLINE double get_frame_start(int frame_number) const;
+  INLINE double get_frame_end(int frame_number) const;
+  INLINE const PStatFrameData &get_frame_data(int frame_number) const;
+
+  void extend_range(int frame_number);
+  void page_in(int chunk_number) const;
+  void page_out() const;
+  void read_chunk(const Chunk *chunk, int chunk_number) const;
+  PStatFrameData *alloc_frames() const;
+  void free_frames(PStatFrameData *frames) const;
+  void pop_front_frame();
+  void clear_frames();
+
   const PStatClientData *_client_data;
 
-  typedef pdeque<PStatFrameData *> Frames;
-  Frames _frames;
+  // Frames are stored in chunks of chunk_size consecutive frame numbers, by
+  // value, rather than allocated one at a time.  The start and end times of
+  // each frame are also kept in packed arrays, so that searches by time need
+  // not touch the frame data itself.
+  //
+  // The events of each frame remain in the arrays of its own PStatFrameData
+  // rather than in arrays shared by the whole chunk, since get_frame() and
+  // every view built on it hand out references to PStatFrameData objects,
+  // and that class is defined by the client library.  Instead, the frame
+  // arrays of dropped chunks are cleared and kept for reuse, which keeps
+  // the capacity of each frame's event arrays, so that paging a chunk in
+  // from the session file usually allocates nothing.
+  enum { chunk_bits = 6, chunk_size = 1 << chunk_bits, max_spare_frames = 2 };
+
+  class Chunk {
+  public:
+    INLINE Chunk();
+    INLINE ~Chunk();
+
+    // One bit for each frame that has been received, and one for each of
+    // those that can be read again from the session file.
+    uint64_t _present;
+    uint64_t _in_file;
+
+    // The value of _pin_epoch when a frame of this chunk was last asked for.
+    mutable unsigned int _pinned;
+
+    // The earliest start time of any frame in this chunk or in any later
+    // chunk.  This never decreases from one chunk to the next, so the chunk
+    // containing the frame at a particular time can be found by a binary
+    // search.
+    double _min_start;
+    double _start[chunk_size];
+    double _end[chunk_size];
+
+    // An array of chunk_size frames, allocated when the first frame is
+    // stored, or when the chunk is paged in from the session file.
+    mutable PStatFrameData *_frames;
+
+    // The offsets within the session file of the chunks holding these frames,
+    // if they were read from a file.
+    pvector<std::streamoff> _pages;
+  };
+
+  INLINE const Chunk *get_chunk(int frame_number) const;
+  INLINE Chunk *get_chunk(int frame_number);
+  void update_min_start(int chunk_index, double start);
+
+  typedef pdeque<Chunk *> Chunks;
+  Chunks _chunks;
+  int _first_chunk;
+
+  // The range of frame numbers covered, including any frames in between that
+  // were never received.
   int _first_frame_number;
+  int _num_frames;
   double _history;
 
+  // The file from which paged frames are read, and the chunk numbers of the
+  // chunks that have been paged in, in the order they were read.
+  PT(PStatSessionReader) _reader;
+  mutable pdeque<int> _resident;
+
+  // Frame arrays of dropped chunks, kept for reuse by alloc_frames().
+  mutable pvector<PStatFrameData *> _spare_frames;
+
   // Cached values, updated by compute_elapsed_frames().
   mutable bool _computed_elapsed_frames;
   mutable bool _got_elapsed_frames;
@@ -84,6 +179,9 @@ private:
   mutable int _now_i;
 
   static PStatFrameData _null_frame;
+
+  // Advanced by unpin_frames().
+  static unsigned int _pin_epoch;
 };
 
 #include "pStatThreadData.I"
@@ -148,6 +148,13 @@ new_data(int thread_index, int frame_number) {
         }
       }
 
+      if (!_frame_offsets.empty() &&
+          thread_data->get_oldest_frame_number() > _frame_offsets.front().first) {
+        // The thread data no longer goes back to the first correction, so
+        // there is little left to gain by keeping the corrections apart.
+        apply_frame_offsets();
+      }
+
       if (update_bars(thread_index, frame_number)) {
         // The number of rows was changed.
         // Change the offset of all subsequent ThreadRows.
@@ -200,6 +207,11 @@ update_bars(int thread_index, int frame_number) {
   double frame_start = frame_data.get_start() + _clock_skew;
   double prev = frame_start;
 
+  // The bars of this frame are stored relative to this.  It doesn't change
+  // while we process this frame, since a correction only affects the frames
+  // after the one it was detected in.
+  double offset = get_frame_offset(frame_number);
+
   // There may still be open collectors from the previous frame.  Rebuild the
   // stack based on that so we can close them properly.
   for (size_t i = 0; i < thread_row._rows.size(); ++i) {
@@ -214,7 +226,7 @@ update_bars(int thread_index, int frame_number) {
           if (i >= stack.size()) {
             stack.resize(i + 1, std::make_pair(-1, 0.0));
           }
-          stack[i] = std::make_pair(bar._collector_index, bar._start);
+          stack[i] = std::make_pair(bar._collector_index, get_bar_start(bar));
 
           // Remove this bar for now, we'll recreate it when we close it.
           row.erase(row.begin() + (row.size() - j - 1));
@@ -247,16 +259,7 @@ update_bars(int thread_index, int frame_number) {
            << thread_index << "\n";
 
       // Move all bars after this frame to the right by this amount.
-      for (ThreadRow &thread_row : _threads) {
-        for (Row &row : thread_row._rows) {
-          for (ColorBar &bar : row) {
-            if (bar._frame_number > frame_number) {
-              bar._start += delta;
-              bar._end += delta;
-            }
-          }
-        }
-      }
+      add_frame_offset(frame_number, delta);
     }
     prev = time;
 
@@ -282,7 +285,8 @@ update_bars(int thread_index, int frame_number) {
       double start_time = stack.back().second;
       stack.pop_back();
       thread_row._rows[stack.size()].push_back({
-        start_time, time, collector_index, thread_index, frame_number, false, false});
+        start_time - offset, time - offset, collector_index, thread_index,
+        frame_number, false, false});
 
       // Pop off stack levels for prematurely ended collectors (see below).
       while (!stack.empty() && stack.back().first < 0) {
@@ -299,7 +303,8 @@ update_bars(int thread_index, int frame_number) {
 
         if (item.first == collector_index) {
           thread_row._rows[stack.size() - 1 - i].push_back({
-            item.second, time, collector_index, thread_index, frame_number, false, false});
+            item.second - offset, time - offset, collector_index, thread_index,
+            frame_number, false, false});
           item.first = -1;
           break;
         }
@@ -332,7 +337,10 @@ update_bars(int thread_index, int frame_number) {
 
               // Insert it into the row below while retaining sorting.
               Row &row2 = thread_row._rows[j + 1];
-              row2.insert(std::upper_bound(row2.begin(), row2.end(), bar), bar);
+              row2.insert(std::upper_bound(row2.begin(), row2.end(), bar,
+                [this] (const ColorBar &a, const ColorBar &b) {
+                  return get_bar_end(a) < get_bar_end(b);
+                }), bar);
             }
             else if (bar._frame_number < frame_number) {
               break;
@@ -346,7 +354,7 @@ update_bars(int thread_index, int frame_number) {
           changed_num_rows = true;
         }
         thread_row._rows[1].push_back({
-          frame_start, time, collector_index, thread_index,
+          frame_start - offset, time - offset, collector_index, thread_index,
           frame_number, true, false});
       }
     }
@@ -358,7 +366,7 @@ update_bars(int thread_index, int frame_number) {
     if (collector_index >= 0) {
       double start_time = stack.back().second;
       thread_row._rows[stack.size() - 1].push_back({
-        start_time, frame_data.get_end() + _clock_skew,
+        start_time - offset, frame_data.get_end() + _clock_skew - offset,
         collector_index, thread_index, frame_number, false, true,
       });
     }
@@ -369,7 +377,10 @@ update_bars(int thread_index, int frame_number) {
     // Added a frame out of order.
     for (Row &row : thread_row._rows) {
       // Sort by end time.
-      std::sort(row.begin(), row.end());
+      std::sort(row.begin(), row.end(),
+        [this] (const ColorBar &a, const ColorBar &b) {
+          return get_bar_end(a) < get_bar_end(b);
+        });
 
       // Glue together open ends and beginnings that match up.
       size_t end = row.size() - 1;
@@ -381,7 +392,7 @@ update_bars(int thread_index, int frame_number) {
             left._open_end && right._open_begin) {
           // Erase the left one, to maintain the sorting by end time.
           right._open_begin = false;
-          right._start = left._start;
+          right._start = get_bar_start(left) - get_frame_offset(right._frame_number);
           row.erase(row.begin() + i);
           --end;
         } else {
@@ -561,16 +572,16 @@ normal_guide_bars() {
     const Row &row = _threads[0]._rows[0];
 
     // Look for the last Frame bar with end time lower than our start time.
-    Row::const_iterator it = std::lower_bound(row.begin(), row.end(), ColorBar {0.0, start_time});
+    Row::const_iterator it = find_bar_ending_after(row, start_time);
     while (it != row.end() && it->_collector_index != 0) {
       ++it;
     }
 
     int num_frames = 0;
 
-    while (it != row.end() && it->_start <= end_time) {
-      double frame_start = it->_start;
-      double frame_end = it->_end;
+    while (it != row.end() && get_bar_start(*it) <= end_time) {
+      double frame_start = get_bar_start(*it);
+      double frame_end = get_bar_end(*it);
       int frame_number = it->_frame_number;
 
       if (frame_start > start_time) {
@@ -617,9 +628,10 @@ normal_guide_bars() {
       }
 
       // If there's a gap between frames, add another line.
-      if (it->_start > frame_end && it->_frame_number > frame_number + 1) {
+      if (it != row.end() && get_bar_start(*it) > frame_end &&
+          it->_frame_number > frame_number + 1) {
         std::string label;
-        if (it->_start - frame_end >= interval) {
+        if (get_bar_start(*it) - frame_end >= interval) {
           label = "#" + format_string(frame_number + 1);
           if (it->_frame_number > frame_number + 2) {
             label += "-" + format_string(it->_frame_number - 1);
@@ -690,17 +702,17 @@ draw_row(int thread_index, int row_index, double start_time, double end_time) {
 
   // Find the first element whose end time is larger than our start time.
   // Then iterate until at least the end of the frame.
-  Row::iterator it = std::lower_bound(row.begin(), row.end(), ColorBar {0.0, start_time});
+  Row::const_iterator it = find_bar_ending_after(row, start_time);
   if (it == row.end()) {
     return;
   }
 
   int frame_number = it->_frame_number;
   do {
-    ColorBar &bar = *it;
+    const ColorBar &bar = *it;
 
-    int from_x = timestamp_to_pixel(bar._start);
-    int to_x = timestamp_to_pixel(bar._end);
+    int from_x = timestamp_to_pixel(get_bar_start(bar));
+    int to_x = timestamp_to_pixel(get_bar_end(bar));
 
     if (to_x >= 0 && to_x > from_x && from_x < get_xsize()) {
       if (bar._collector_index != 0) {
@@ -724,7 +736,7 @@ draw_row(int thread_index, int row_index, double start_time, double end_time) {
 
     ++it;
   }
-  while (it != row.end() && (it->_start <= end_time || it->_frame_number == frame_number));
+  while (it != row.end() && (get_bar_start(*it) <= end_time || it->_frame_number == frame_number));
 }
 
 /**
@@ -873,9 +885,12 @@ find_bar(int row, int x, ColorBar &bar) const {
     if (row_index < (int)thread_row._rows.size()) {
       // Find the first element whose end time is larger than the given time.
       const Row &bars = thread_row._rows[row_index];
-      Row::const_iterator it = std::lower_bound(bars.begin(), bars.end(), ColorBar {time, time});
-      if (it != bars.end() && it->_start <= time) {
+      Row::const_iterator it = find_bar_ending_after(bars, time);
+      if (it != bars.end() && get_bar_start(*it) <= time) {
+        // Return the actual times to the caller.
         bar = *it;
+        bar._start = get_bar_start(*it);
+        bar._end = get_bar_end(*it);
         return true;
       }
     }
@@ -883,3 +898,82 @@ find_bar(int row, int x, ColorBar &bar) const {
 
   return false;
 }
+
+/**
+ * Returns the total clock skew correction that applies to the bars of the
+ * indicated frame.
+ */
+double PStatTimeline::
+get_frame_offset(int frame_number) const {
+  if (_frame_offsets.empty() || frame_number <= _frame_offsets.front().first) {
+    // This is by far the most common case.
+    return 0.0;
+  }
+
+  // Find the last entry for a frame before this one.
+  FrameOffsets::const_iterator it =
+    std::lower_bound(_frame_offsets.begin(), _frame_offsets.end(), frame_number,
+      [] (const std::pair<int, double> &entry, int frame_number) {
+        return entry.first < frame_number;
+      });
+  --it;
+  return it->second;
+}
+
+/**
+ * Moves the bars of all frames after the indicated frame to the right by the
+ * indicated amount.
+ */
+void PStatTimeline::
+add_frame_offset(int frame_number, double delta) {
+  FrameOffsets::iterator it =
+    std::lower_bound(_frame_offsets.begin(), _frame_offsets.end(), frame_number,
+      [] (const std::pair<int, double> &entry, int frame_number) {
+        return entry.first < frame_number;
+      });
+
+  if (it == _frame_offsets.end() || it->first != frame_number) {
+    double prev = (it == _frame_offsets.begin()) ? 0.0 : (it - 1)->second;
+    it = _frame_offsets.insert(it, std::make_pair(frame_number, prev));
+  }
+
+  // The entries for any later frames include this correction too.
+  for (; it != _frame_offsets.end(); ++it) {
+    it->second += delta;
+  }
+}
+
+/**
+ * Folds the clock skew corrections into the bars themselves, and empties the
+ * list of corrections.  This does not change where any bar is drawn, nor
+ * where the bars of frames that are yet to arrive will be placed.
+ */
+void PStatTimeline::
+apply_frame_offsets() {
+  if (_frame_offsets.empty()) {
+    return;
+  }
+
+  for (ThreadRow &thread_row : _threads) {
+    for (Row &row : thread_row._rows) {
+      for (ColorBar &bar : row) {
+        double offset = get_frame_offset(bar._frame_number);
+        bar._start += offset;
+        bar._end += offset;
+      }
+    }
+  }
+  _frame_offsets.clear();
+}
+
+/**
+ * Returns the first bar in the row whose end time is not earlier than the
+ * indicated time, corrected for clock skew.
+ */
+PStatTimeline::Row::const_iterator PStatTimeline::
+find_bar_ending_after(const Row &row, double time) const {
+  return std::lower_bound(row.begin(), row.end(), time,
+    [this] (const ColorBar &bar, double time) {
+      return get_bar_end(bar) < time;
+    });
+}
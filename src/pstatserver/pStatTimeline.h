@@ -79,6 +79,10 @@ protected:
 
   bool animate(double time, double dt);
 
+  // The start and end times of a bar are stored relative to the clock skew
+  // correction of its frame (see get_frame_offset()), so that correcting for
+  // skew does not require rewriting all the bars.  Use get_bar_start() and
+  // get_bar_end() to get the actual times.
   class ColorBar {
   public:
     double _start, _end;
@@ -86,16 +90,19 @@ protected:
     int _thread_index;
     int _frame_number;
     bool _open_begin : 8, _open_end : 8;
-
-    bool operator < (const ColorBar &other) const {
-      return _end < other._end;
-    }
   };
   typedef pvector<ColorBar> Row;
   typedef pvector<Row> Rows;
 
   bool find_bar(int row, int x, ColorBar &bar) const;
 
+  INLINE double get_bar_start(const ColorBar &bar) const;
+  INLINE double get_bar_end(const ColorBar &bar) const;
+  double get_frame_offset(int frame_number) const;
+  void add_frame_offset(int frame_number, double delta);
+  void apply_frame_offsets();
+  Row::const_iterator find_bar_ending_after(const Row &row, double time) const;
+
   class ThreadRow {
   public:
     std::string _label;
@@ -110,6 +117,11 @@ protected:
   double _clock_skew = 0.0;
   int _app_collector_index = -1;
 
+  // Each entry is the total clock skew correction applied to the bars of all
+  // frames after the given frame number, sorted by frame number.
+  typedef pvector<std::pair<int, double> > FrameOffsets;
+  FrameOffsets _frame_offsets;
+
   enum KeyFlag {
     F_left = 1,
     F_right = 2,
@@ -17,97 +17,6 @@
 #include "pStatCollectorDef.h"
 
 #include <algorithm>
-#include <vector>
-
-/**
- * This class is used within this module only--in fact, within
- * PStatView::set_to_frame() only--to help collect event data out of the
- * PStatFrameData object and boil it down to a list of elapsed times.
- */
-class FrameSample {
-public:
-  void start(double time, FrameSample *started) {
-    // Keep track of nested start/stop pairs.  We only consider the outer one.
-    if (_started++ > 0) {
-      return;
-    }
-
-    nassertv(!_pushed);
-    _net_time -= time;
-    push_all(time, started);
-    nassertv(_next == nullptr && _prev == nullptr);
-    _prev = started->_prev;
-    _next = started;
-    _prev->_next = this;
-    started->_prev = this;
-  }
-
-  void stop(double time, FrameSample *started) {
-    nassertv(_started > 0);
-    if (--_started > 0) {
-      return;
-    }
-
-    nassertv(_next != nullptr && _prev != nullptr);
-
-    if (_pushed) {
-      _prev->_next = _next;
-      _next->_prev = _prev;
-      _next = _prev = nullptr;
-    } else {
-      _net_time += time;
-      _prev->_next = _next;
-      _next->_prev = _prev;
-      _next = _prev = nullptr;
-      pop_one(time, started);
-    }
-  }
-
-private:
-  void push(double time) {
-    if (!_pushed) {
-      _pushed = true;
-      if (_started > 0) {
-        _net_time += time;
-      }
-    }
-  }
-
-  void pop(double time) {
-    if (_pushed) {
-      _pushed = false;
-      if (_started > 0) {
-        _net_time -= time;
-      }
-    }
-  }
-
-  void push_all(double time, FrameSample *started) {
-    for (FrameSample *sample = started->_next;
-         sample != started; sample = sample->_next) {
-      sample->push(time);
-    }
-  }
-
-  void pop_one(double time, FrameSample *started) {
-    for (FrameSample *sample = started->_prev;
-         sample != started; sample = sample->_prev) {
-      if (sample->_pushed) {
-        sample->pop(time);
-        return;
-      }
-    }
-  }
-
-public:
-  FrameSample *_next = nullptr;
-  FrameSample *_prev = nullptr;
-  double _net_time = 0.0;
-  int _started = 0;
-  int _count = 0;
-  bool _pushed = false;
-  bool _is_new = false;
-};
 
 /**
  *
@@ -148,6 +57,8 @@ void PStatView::
 constrain(int collector, bool show_level) {
   _constraint = collector;
   _show_level = show_level;
+  _membership_known.clear();
+  _in_constraint.clear();
   clear_levels();
 }
 
@@ -167,6 +78,8 @@ void PStatView::
 set_thread_data(const PStatThreadData *thread_data) {
   _thread_data = thread_data;
   _client_data = thread_data->get_client_data();
+  _membership_known.clear();
+  _in_constraint.clear();
   clear_levels();
   _all_collectors_known = false;
 }
@@ -272,8 +185,15 @@ update_time_data(const PStatFrameData &frame_data) {
   int num_events = frame_data.get_num_events();
   int num_collectors = _client_data->get_num_collectors();
 
-  typedef std::vector<FrameSample> Samples;
-  Samples samples(num_collectors);
+  // The samples are kept from one call to the next, and only those touched by
+  // this frame's events are reset afterwards.  Note that growing the vector
+  // is only safe while no samples are linked into a started list.
+  if ((int)_samples.size() < num_collectors) {
+    _samples.resize(num_collectors);
+  }
+  nassertd(_touched.empty()) {
+    reset_samples();
+  }
 
   // Keep a linked list of started samples.
   FrameSample started;
@@ -282,7 +202,6 @@ update_time_data(const PStatFrameData &frame_data) {
 
   _all_collectors_known = true;
 
-  int new_collectors = 0;
   int i;
   for (i = 0; i < num_events; i++) {
     int collector_index = frame_data.get_time_collector(i);
@@ -292,40 +211,49 @@ update_time_data(const PStatFrameData &frame_data) {
       _all_collectors_known = false;
 
     } else {
-      nassertv(collector_index >= 0 && collector_index < num_collectors);
+      nassertd(collector_index >= 0 && collector_index < num_collectors) {
+        reset_samples();
+        return;
+      }
 
-      if (_client_data->get_child_distance(_constraint, collector_index) >= 0) {
+      if (is_in_constraint(collector_index)) {
         // Here's a data point we care about: anything at constraint level or
         // below.
+        FrameSample &sample = _samples[collector_index];
+        if (!sample._is_new) {
+          sample._is_new = true;
+          _touched.push_back(collector_index);
+        }
+
         if (is_start) {
-          samples[collector_index].start(frame_data.get_time(i), &started);
-          samples[collector_index]._count++;
+          sample.start(frame_data.get_time(i), &started);
+          sample._count++;
         } else {
           // A "stop" in the middle of a frame implies a "start" since time
           // 0 (that is, since the first data point in the frame).
-          if (samples[collector_index]._started == 0) {
-            samples[collector_index].start(frame_data.get_time(0), &started);
+          if (sample._started == 0) {
+            sample.start(frame_data.get_time(0), &started);
           }
-          samples[collector_index].stop(frame_data.get_time(i), &started);
-        }
-
-        if (!samples[collector_index]._is_new) {
-          samples[collector_index]._is_new = true;
-          ++new_collectors;
+          sample.stop(frame_data.get_time(i), &started);
         }
       }
     }
   }
 
-  // Make sure everything is stopped.
-  Samples::iterator si;
-  for (i = 0, si = samples.begin(); si != samples.end(); ++i, ++si) {
-    if ((*si)._started > 0) {
-      (*si).stop(frame_data.get_end(), &started);
+  // Make sure everything is stopped.  This must be done in collector order,
+  // since the order in which the samples are stopped affects the times.
+  std::sort(_touched.begin(), _touched.end());
+  for (int collector_index : _touched) {
+    FrameSample &sample = _samples[collector_index];
+    if (sample._started > 0) {
+      sample.stop(frame_data.get_end(), &started);
     }
   }
 
-  nassertv(started._next == &started && started._prev == &started);
+  nassertd(started._next == &started && started._prev == &started) {
+    reset_samples();
+    return;
+  }
 
   bool any_new_levels = false;
 
@@ -345,35 +273,58 @@ update_time_data(const PStatFrameData &frame_data) {
     }
 
     int collector_index = level->_collector;
-    if (samples[collector_index]._is_new) {
-      level->_value_alone = samples[collector_index]._net_time;
-      level->_count = samples[collector_index]._count;
-      samples[collector_index]._is_new = false;
-      --new_collectors;
+    if (collector_index < (int)_samples.size() &&
+        _samples[collector_index]._is_new) {
+      level->_value_alone = _samples[collector_index]._net_time;
+      level->_count = _samples[collector_index]._count;
+      _samples[collector_index]._is_new = false;
     }
 
     li = lnext;
   }
 
-  // Finally, any samples left over in the got_samples set are new collectors
-  // that we need to add to the Levels list.
-  if (new_collectors > 0) {
-    any_new_levels = true;
-
-    for (int collector_index = 0; collector_index < num_collectors; ++collector_index) {
-      if (samples[collector_index]._is_new) {
-        PStatViewLevel *level = get_level(collector_index);
-        level->_value_alone = samples[collector_index]._net_time;
-        level->_count = samples[collector_index]._count;
-      }
+  // Finally, any samples still marked new are new collectors that we need to
+  // add to the Levels list.  Either way, reset the samples for next time.
+  for (int collector_index : _touched) {
+    FrameSample &sample = _samples[collector_index];
+    if (sample._is_new) {
+      any_new_levels = true;
+      PStatViewLevel *level = get_level(collector_index);
+      level->_value_alone = sample._net_time;
+      level->_count = sample._count;
     }
+    sample = FrameSample();
   }
+  _touched.clear();
 
   if (any_new_levels) {
     _level_index++;
   }
 }
 
+/**
+ * Returns true if the indicated collector, which must be defined, is the
+ * constraint or one of its descendants.  The answer is cached until the
+ * constraint or the collector definitions change.
+ */
+bool PStatView::
+is_in_constraint(int collector_index) {
+  UpdateSeq seq = _client_data->get_collectors_seq();
+  if (_membership_seq != seq) {
+    _membership_known.clear();
+    _in_constraint.clear();
+    _membership_seq = seq;
+  }
+
+  if (!_membership_known.get_bit(collector_index)) {
+    _membership_known.set_bit(collector_index);
+    if (_client_data->get_child_distance(_constraint, collector_index) >= 0) {
+      _in_constraint.set_bit(collector_index);
+    }
+  }
+  return _in_constraint.get_bit(collector_index);
+}
+
 /**
  * The implementation of set_to_frame() for views that show level values.
  */
@@ -486,6 +437,19 @@ clear_levels() {
   _levels.clear();
 }
 
+/**
+ * Resets the samples touched by update_time_data(), unlinking any that are
+ * still started, so that the next call begins with a clean slate.  This is
+ * done on every path out of update_time_data().
+ */
+void PStatView::
+reset_samples() {
+  for (int collector_index : _touched) {
+    _samples[collector_index] = FrameSample();
+  }
+  _touched.clear();
+}
+
 /**
  * Resets the total value of the Level to zero, and also makes sure it is
  * parented to the right Level corresponding to its Collector's parent.  Since
@@ -21,6 +21,9 @@
 #include "pStatViewLevel.h"
 #include "pmap.h"
 #include "pointerTo.h"
+#include "bitArray.h"
+#include "updateSeq.h"
+#include "vector_int.h"
 
 /**
  * A View boils down the frame data to a linear list of times spent in a
@@ -56,7 +59,97 @@ public:
   INLINE int get_level_index() const;
 
 private:
+  // This class is used within PStatView::update_time_data() only, to help
+  // collect event data out of the PStatFrameData object and boil it down to a
+  // list of elapsed times.
+  class FrameSample {
+  public:
+    void start(double time, FrameSample *started) {
+      // Keep track of nested start/stop pairs.  We only consider the outer one.
+      if (_started++ > 0) {
+        return;
+      }
+
+      nassertv(!_pushed);
+      _net_time -= time;
+      push_all(time, started);
+      nassertv(_next == nullptr && _prev == nullptr);
+      _prev = started->_prev;
+      _next = started;
+      _prev->_next = this;
+      started->_prev = this;
+    }
+
+    void stop(double time, FrameSample *started) {
+      nassertv(_started > 0);
+      if (--_started > 0) {
+        return;
+      }
+
+      nassertv(_next != nullptr && _prev != nullptr);
+
+      if (_pushed) {
+        _prev->_next = _next;
+        _next->_prev = _prev;
+        _next = _prev = nullptr;
+      } else {
+        _net_time += time;
+        _prev->_next = _next;
+        _next->_prev = _prev;
+        _next = _prev = nullptr;
+        pop_one(time, started);
+      }
+    }
+
+  private:
+    void push(double time) {
+      if (!_pushed) {
+        _pushed = true;
+        if (_started > 0) {
+          _net_time += time;
+        }
+      }
+    }
+
+    void pop(double time) {
+      if (_pushed) {
+        _pushed = false;
+        if (_started > 0) {
+          _net_time -= time;
+        }
+      }
+    }
+
+    void push_all(double time, FrameSample *started) {
+      for (FrameSample *sample = started->_next;
+           sample != started; sample = sample->_next) {
+        sample->push(time);
+      }
+    }
+
+    void pop_one(double time, FrameSample *started) {
+      for (FrameSample *sample = started->_prev;
+           sample != started; sample = sample->_prev) {
+        if (sample->_pushed) {
+          sample->pop(time);
+          return;
+        }
+      }
+    }
+
+  public:
+    FrameSample *_next = nullptr;
+    FrameSample *_prev = nullptr;
+    double _net_time = 0.0;
+    int _started = 0;
+    int _count = 0;
+    bool _pushed = false;
+    bool _is_new = false;
+  };
+
   void update_time_data(const PStatFrameData &frame_data);
+  void reset_samples();
+  bool is_in_constraint(int collector_index);
   void update_level_data(const PStatFrameData &frame_data);
 
   void clear_levels();
@@ -71,6 +164,18 @@ private:
 
   int _level_index;
 
+  // Scratch space for update_time_data(), kept between calls.  Only the
+  // samples listed in _touched are in use.
+  typedef pvector<FrameSample> Samples;
+  Samples _samples;
+  vector_int _touched;
+
+  // Caches which collectors fall within the constraint.  Only the bits set in
+  // _membership_known are valid, and only as of _membership_seq.
+  BitArray _membership_known;
+  BitArray _in_constraint;
+  UpdateSeq _membership_seq;
+
   CPT(PStatClientData) _client_data;
   CPT(PStatThreadData) _thread_data;
 };
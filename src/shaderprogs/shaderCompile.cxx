@@ -25,6 +25,13 @@
 #include "load_prc_file.h"
 #include "threadManager.h"
 #include "config_shader.h"
+#include "pandaSystem.h"
+#include "configVariableManager.h"
+#include "configVariableCore.h"
+#include "configDeclaration.h"
+#include "fnvHash.h"
+
+#include <iomanip>
 
 static ShaderCompile *g_prog = nullptr;
 
@@ -40,8 +47,13 @@ ShaderCompile() :
   _num_threads = 1;
   _sho = nullptr;
   _verbose = false;
+  _num_variations = 0;
+  _first_variation = 0;
   _num_skipped = 0;
+  _num_compiled = 0;
   _curr_options = nullptr;
+  _lang = Shader::SL_none;
+  _got_cache_dirname = false;
 
   set_program_brief("compiles shader source files into Panda shader object (.sho) files");
   set_program_description(
@@ -78,6 +90,17 @@ ShaderCompile() :
      "variations in parallel.",
      &ShaderCompile::dispatch_int, nullptr, &_num_threads);
 
+  add_option
+    ("cache", "dirname", 0,
+     "Keep a cache of compiled shader objects in the indicated directory.  "
+     "Each shader object is keyed on the contents of the source file and of "
+     "every file it includes, the shader stage, the version and build of "
+     "Panda, and every config variable set in a prc file.  If a matching "
+     "shader object is found in the cache, it is written to the output file "
+     "instead of compiling the shader again.  A shader with an include that "
+     "cannot be found is always compiled.",
+     &ShaderCompile::dispatch_filename, &_got_cache_dirname, &_cache_dirname);
+
   add_option
     ("v", "", 0,
      "Enable verbose output.",
@@ -94,165 +117,395 @@ run() {
     shadermgr_cat->set_severity(NS_debug);
   }
 
-  Shader::ShaderLanguage lang = Shader::SL_none;
+  _lang = Shader::SL_none;
   if (_input_filename.get_extension() == "glsl") {
-    lang = Shader::SL_GLSL;
+    _lang = Shader::SL_GLSL;
   } else if (_input_filename.get_extension() == "hlsl") {
-    lang = Shader::SL_HLSL;
+    _lang = Shader::SL_HLSL;
   } else {
     nout << "Error: unsupported shader language " << _input_filename.get_extension() << "\n";
     return false;
   }
 
-  _sho = ShaderObject::read_source(lang, _stage, _input_filename);
-  if (_sho == nullptr) {
-    nout << "Error: failed to read shader object!\n";
+  uint64_t key = 0;
+  if (_got_cache_dirname) {
+    key = compute_cache_key();
+    if (key == 0) {
+      nout << "Warning: couldn't read " << _input_filename
+           << " or one of its includes; compiling without the cache.\n";
+    } else {
+      _sho = read_cached_object(key);
+    }
+  }
+
+  bool from_cache = (_sho != nullptr);
+  if (from_cache) {
+    nout << "Using cached " << get_cache_filename(key) << "\n";
+  } else if (!compile_all()) {
     return false;
   }
 
-  nout << "Compiling a " << _stage << " shader\n";
+  // Now write the .sho file.
+  BamFile bam;
+  if (!bam.open_write(_output_filename)) {
+    nout << "Error: couldn't open " << _output_filename.get_fullpath() << " for writing.\n";
+    return false;
+  }
+  if (!bam.write_object(_sho)) {
+    nout << "Error: couldn't write the shader object\n";
+    return false;
+  }
+  bam.close();
 
-  // Create all of our permutations up front, makes threading simpler.
-  size_t num_variations = _sho->get_total_combos();
-  _variations.resize(num_variations);
+  if (key != 0 && !from_cache) {
+    write_cached_object(key);
+  }
 
-  size_t n = _sho->get_num_combos();
-  if (n > 0 && num_variations > 1) {
-    // There are combos for this shader, so compile each possible variation of
-    // combo values.
+  return true;
+}
 
-    int *indices = new int[n];
-    memset(indices, 0, sizeof(int) * n);
+/**
+ * Reads the shader source and compiles each of its variations that is not
+ * skipped, storing them on the shader object.  Returns false if the source
+ * could not be read.
+ */
+bool ShaderCompile::
+compile_all() {
+  _sho = ShaderObject::read_source(_lang, _stage, _input_filename);
+  if (_sho == nullptr) {
+    nout << "Error: failed to read shader object!\n";
+    return false;
+  }
 
-    int index = 0;
+  nout << "Compiling a " << _stage << " shader\n";
 
-    // Build the combo values for each variation we will be compiling.
-    while (true) {
-      VariationData &vdata = _variations[index];
-      vdata.skip = false;
-      vdata.builder.reset(_sho);
+  // The variations are not enumerated up front.  Each index is decoded into
+  // its combo values as it is visited, and the skip commands are evaluated
+  // by whichever thread visits it, so nothing is stored per variation.
+  _num_variations = _sho->get_total_combos();
+  _num_skipped = 0;
+  _num_compiled = 0;
+
+  nout << "Compiling up to " << _num_variations << " combo variations for "
+       << _input_filename.get_basename() << "\n";
+
+  // Compile one variation on the main thread first, to initialize glslang
+  // and others without race conditions.  We take the last variation that is
+  // not skipped, so that the remaining ones all have lower indices.
+  ShaderObject::VariationBuilder builder;
+  _first_variation = _num_variations;
+  for (size_t i = _num_variations; i > 0; --i) {
+    if (setup_variation(builder, i - 1)) {
+      _first_variation = i - 1;
+      compile_variation(builder);
+      break;
+    }
+  }
 
-      for (size_t i = 0; i < n; i++) {
-        const ShaderObject::Combo *combo = &(_sho->get_combo(i));
-        vdata.builder.set_combo_value(i, combo->min_val + indices[i]);
+  if (_first_variation > 0 && _first_variation < _num_variations) {
+    int num_blocks = (int)((_first_variation + block_size - 1) / block_size);
+    if (_num_threads > 1) {
+      ThreadManager::_num_threads = _num_threads;
+      nout << ThreadManager::_num_threads << " threads\n";
+      ThreadManager::run_threads_on_individual("CompileVariations", num_blocks, false,
+                                              std::bind(&ShaderCompile::compile_block, this, std::placeholders::_1));
+    } else {
+      for (int i = 0; i < num_blocks; ++i) {
+        compile_block(i);
       }
+    }
+  }
 
-      // Evaluate the skip commands to see if we should skip this variation.
-      for (size_t i = 0; i < _sho->get_num_skip_commands(); i++) {
-        if (_sho->get_skip_command(i)->eval(vdata.builder) != 0) {
-          // The expression evaluated to true for this variation.  Skip it.
-          vdata.skip = true;
-          if (_verbose) {
-            nout << "Skipping variation " << index << " with defines:\n";
-            for (size_t i = 0; i < _sho->get_num_combos(); i++) {
-              const ShaderObject::Combo &combo = _sho->get_combo(i);
-              nout << "\t" << combo.name->get_name()  << "\t" << vdata.builder._combo_values[i] << "\n";
-            }
-          }
-          _num_skipped++;
-          break;
+  nout << "Compiled " << AtomicAdjust::get(_num_compiled) << " combo variations ("
+       << AtomicAdjust::get(_num_skipped) << " skipped)\n";
+  return true;
+}
+
+/**
+ * Sets up the builder with the combo values of the indicated variation, and
+ * evaluates the skip commands against it.  Returns true if the variation
+ * should be compiled, or false if it is skipped.
+ *
+ * The combo values are the digits of the index in a mixed radix, with the
+ * last combo varying fastest.
+ */
+bool ShaderCompile::
+setup_variation(ShaderObject::VariationBuilder &builder, size_t index) {
+  builder.reset(_sho);
+
+  size_t n = _sho->get_num_combos();
+  size_t remainder = index;
+  for (size_t i = n; i > 0; --i) {
+    const ShaderObject::Combo &combo = _sho->get_combo(i - 1);
+    size_t count = (size_t)(combo.max_val - combo.min_val) + 1;
+    builder.set_combo_value(i - 1, combo.min_val + (int)(remainder % count));
+    remainder /= count;
+  }
+  nassertr((size_t)builder.get_module_index() == index, false);
+
+  // Evaluate the skip commands to see if we should skip this variation.
+  for (size_t i = 0; i < _sho->get_num_skip_commands(); i++) {
+    if (_sho->get_skip_command(i)->eval(builder) != 0) {
+      // The expression evaluated to true for this variation.  Skip it.
+      if (_verbose) {
+        std::ostringstream strm;
+        strm << "Skipping variation " << index << " with defines:\n";
+        for (size_t ci = 0; ci < n; ci++) {
+          const ShaderObject::Combo &combo = _sho->get_combo(ci);
+          strm << "\t" << combo.name->get_name() << "\t" << builder._combo_values[ci] << "\n";
         }
+        nout << strm.str();
       }
+      AtomicAdjust::inc(_num_skipped);
+      return false;
+    }
+  }
 
-      int next = n - 1;
-      while ((next >= 0) &&
-            ((indices[next] + 1) >= (_sho->get_combo(next).max_val - _sho->get_combo(next).min_val) + 1)) {
-        next--;
-      }
+  return true;
+}
 
-      if (next < 0) {
-        break;
-      }
+/**
+ * Visits the nth block of block_size consecutive variations below
+ * _first_variation, compiling each one that is not skipped.  This is the
+ * unit of work for the thread pool; the one builder is reused across the
+ * block.
+ */
+void ShaderCompile::
+compile_block(int n) {
+  size_t begin = (size_t)n * block_size;
+  size_t end = std::min(begin + block_size, _first_variation);
+
+  ShaderObject::VariationBuilder builder;
+  for (size_t index = begin; index < end; ++index) {
+    if (setup_variation(builder, index)) {
+      compile_variation(builder);
+    }
+  }
+}
 
-      indices[next]++;
+/**
+ * Compiles the variation that the builder has been set up for, and stores it
+ * on the shader object.
+ */
+void ShaderCompile::
+compile_variation(const ShaderObject::VariationBuilder &builder) {
+  size_t index = builder.get_module_index();
 
-      for (int i = next + 1; i < n; i++) {
-        indices[i] = 0;
-      }
+  if (_verbose) {
+    std::ostringstream strm;
+    strm << "Compiling variation " << index << " with defines:\n";
+    for (size_t i = 0; i < _sho->get_num_combos(); i++) {
+      const ShaderObject::Combo &combo = _sho->get_combo(i);
+      strm << "\t" << combo.name->get_name() << "\t" << builder._combo_values[i] << "\n";
+    }
+    nout << strm.str();
+  }
 
-      index++;
+  // Call get_module() to compile the variation and store it on the
+  // ShaderObject.
+  ShaderModule *mod = builder.get_module(true);
+  if (mod == nullptr) {
+    nout << "Failed to compile variation " << index << "!\n";
+    exit(1);
+  }
+  AtomicAdjust::inc(_num_compiled);
+}
+
+/**
+ * Returns the key under which the compiled shader object is stored in the
+ * cache, or 0 if the source or one of its includes cannot be read, in which
+ * case the shader is compiled without the cache.
+ *
+ * The key is a hash of the source file and every file it includes, and of
+ * everything else the compiled modules depend on: the input file name, the
+ * language and stage, the version and build of Panda, and the value of every
+ * config variable that has been set, which covers the compiler options read
+ * from prc files.  The build date and git commit are included because the
+ * version string does not change between development builds.  The combos and
+ * skip commands are declared in the source, so they are covered as well.
+ *
+ * This also hashes variables that have nothing to do with the compiler, so a
+ * change to an unrelated prc setting invalidates the cache.  That costs a
+ * recompile, but never reuses a stale shader object.
+ */
+uint64_t ShaderCompile::
+compute_cache_key() const {
+  FnvHash hash;
+  hash.add_string(PandaSystem::get_version_string());
+  hash.add_string(PandaSystem::get_git_commit());
+  hash.add_string(PandaSystem::get_build_date());
+  hash.add_string(_input_filename.get_fullpath());
+  hash.add_word((uint64_t)_lang);
+  hash.add_word((uint64_t)_stage);
+
+  // Sort the variables by name, since the order in which they are defined
+  // depends on the order in which the libraries were loaded.
+  pmap<std::string, std::string> values;
+  ConfigVariableManager *mgr = ConfigVariableManager::get_global_ptr();
+  int num_variables = mgr->get_num_variables();
+  for (int i = 0; i < num_variables; ++i) {
+    ConfigVariableCore *core = mgr->get_variable(i);
+    if (core->get_num_declarations() != 0) {
+      values[core->get_name()] = core->get_declaration(0)->get_string_value();
     }
+  }
+  for (const auto &item : values) {
+    hash.add_string(item.first);
+    hash.add_string(item.second);
+  }
+
+  pset<Filename> visited;
+  if (!hash_source(hash, _input_filename, visited)) {
+    return 0;
+  }
+  return hash.get_nonzero_hash();
+}
 
-    //
-    // Now for the real work.
-    //
+/**
+ * Folds the contents of the indicated source file into the running hash,
+ * followed by those of each file it includes, recursively.  Returns false if
+ * the file or any of its includes could not be read.
+ *
+ * The includes are found by a simple scan for #include lines, without regard
+ * to conditional compilation, so this may hash more files than the
+ * preprocessor would actually read, but never fewer.  This is much cheaper
+ * than preprocessing the source once for each variation, which the compiler
+ * would then do again.
+ */
+bool ShaderCompile::
+hash_source(FnvHash &hash, const Filename &filename, pset<Filename> &visited) {
+  if (!visited.insert(filename).second) {
+    return true;
+  }
 
-    ThreadManager::_num_threads = _num_threads;
+  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+  std::string source;
+  if (!vfs->read_file(filename, source, true)) {
+    return false;
+  }
+  hash.add_string(filename.get_fullpath());
+  hash.add_string(source);
+
+  size_t p = 0;
+  while (p < source.size()) {
+    size_t eol = source.find('\n', p);
+    if (eol == std::string::npos) {
+      eol = source.size();
+    }
 
-    _non_skipped_variations.reserve(_variations.size());
-    for (size_t i = 0; i < _variations.size(); ++i) {
-      if (!_variations[i].skip) {
-        _non_skipped_variations.push_back((int)i);
+    // Look for a line of the form: #include "name" or #include <name>
+    size_t q = source.find_first_not_of(" \t", p);
+    if (q < eol && source[q] == '#') {
+      q = source.find_first_not_of(" \t", q + 1);
+      if (q < eol && source.compare(q, 7, "include") == 0) {
+        q = source.find_first_not_of(" \t", q + 7);
+        if (q < eol && (source[q] == '"' || source[q] == '<')) {
+          char close = (source[q] == '"') ? '"' : '>';
+          size_t end = source.find(close, q + 1);
+          if (end < eol) {
+            Filename include = Filename::from_os_specific(source.substr(q + 1, end - q - 1));
+
+            // Quoted includes are looked for next to the including file
+            // first; both forms are then looked for along the model path, as
+            // the shader compiler does.
+            Filename local(filename.get_dirname(), include);
+            if (close == '"' && vfs->exists(local)) {
+              include = local;
+            } else if (!vfs->resolve_filename(include, get_model_path())) {
+              return false;
+            }
+            if (!hash_source(hash, include, visited)) {
+              return false;
+            }
+          }
+        }
       }
     }
-    size_t num_real_variations = _non_skipped_variations.size();
-
-    nout << "Compiling " << num_real_variations << " combo variations for "
-        << _input_filename.get_basename() << "\n";
-    nout << "(" << _num_skipped << " skipped)\n";
-    nout << ThreadManager::_num_threads << " threads\n";
+    p = eol + 1;
+  }
 
-    // Compile the first variation on the main thread to initialize glslang
-    // and others without race conditions.
-    compile_variation(num_real_variations - 1);
-    ThreadManager::run_threads_on_individual("CompileVariations", (int)num_real_variations - 1, false,
-                                            std::bind(&ShaderCompile::compile_variation, this, std::placeholders::_1));
+  return true;
+}
 
-  } else {
-    // In this case we have no combos, and only one possible variation for this shader.
-    // Compile the single variation.
+/**
+ * Returns the name of the file in the cache that holds the shader object with
+ * the indicated key.
+ */
+Filename ShaderCompile::
+get_cache_filename(uint64_t key) const {
+  std::ostringstream strm;
+  strm << _input_filename.get_basename_wo_extension() << "-"
+       << std::hex << std::setw(16) << std::setfill('0') << key << ".sho";
+  Filename filename(_cache_dirname, strm.str());
+  filename.set_binary();
+  return filename;
+}
 
-    _variations[0].skip = false;
-    _variations[0].builder.reset(_sho);
-    _non_skipped_variations.push_back(0);
-    compile_variation(0);
+/**
+ * Reads the shader object with the indicated key from the cache.  Returns
+ * nullptr if it is not in the cache or cannot be read.
+ */
+PT(ShaderObject) ShaderCompile::
+read_cached_object(uint64_t key) const {
+  Filename filename = get_cache_filename(key);
+  VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+  if (!vfs->exists(filename)) {
+    return nullptr;
   }
 
-  // Now write the .sho file.
   BamFile bam;
-  if (!bam.open_write(_output_filename)) {
-    nout << "Error: couldn't open " << _output_filename.get_fullpath() << " for writing.\n";
-    return false;
-  }
-  if (!bam.write_object(_sho)) {
-    nout << "Error: couldn't write the shader object\n";
-    return false;
+  if (!bam.open_read(filename)) {
+    return nullptr;
   }
+
+  // Hold a reference right away, so that the object is freed if it turns out
+  // not to be what we expected.
+  PT(TypedWritable) object = bam.read_object();
+  bool valid = (object != nullptr && bam.resolve() &&
+                object->is_of_type(ShaderObject::get_class_type()));
   bam.close();
 
-  return true;
+  if (!valid) {
+    nout << "Warning: " << filename << " is not a valid shader object; "
+         << "compiling anyway.\n";
+    return nullptr;
+  }
+  return DCAST(ShaderObject, object);
 }
 
 /**
- * Compiles a single variation of the shader.
+ * Writes the shader object to the cache under the indicated key.  It is
+ * written to a temporary name first and then renamed, so that another
+ * shadercompile process never sees a partial file.
  */
-void ShaderCompile::
-compile_variation(int n) {
-  assert(n >= 0 && n < (int)_non_skipped_variations.size());
-  int v_index = _non_skipped_variations[n];
-  assert(v_index >= 0 && v_index < (int)_variations.size());
-  const VariationData &vdata = _variations[v_index];
+bool ShaderCompile::
+write_cached_object(uint64_t key) const {
+  Filename filename = get_cache_filename(key);
+  filename.make_dir();
 
-  // It shouldn't be a skipped variation.
-  assert(!vdata.skip);
-  // Sanity check our index.
-  assert(vdata.builder.get_module_index() == v_index);
+  Filename temp = Filename::temporary(filename.get_dirname(),
+                                      filename.get_basename_wo_extension() + "-");
+  temp.set_binary();
 
-  if (_verbose) {
-    nout << "Compiling variation " << v_index << " with defines:\n";
-    for (size_t i = 0; i < _sho->get_num_combos(); i++) {
-      const ShaderObject::Combo &combo = _sho->get_combo(i);
-      nout << "\t" << combo.name->get_name() << "\t" << vdata.builder._combo_values[i] << "\n";
-    }
+  BamFile bam;
+  if (!bam.open_write(temp) || !bam.write_object(_sho)) {
+    bam.close();
+    temp.unlink();
+    nout << "Warning: couldn't write " << temp << "\n";
+    return false;
   }
+  bam.close();
 
-  // Call get_module() to compile the variation and store it on the
-  // ShaderObject.
-  ShaderModule *mod = vdata.builder.get_module(true);
-  if (mod == nullptr) {
-    nout << "Failed to compile variation " << n << "!\n";
-    exit(1);
+  if (!temp.rename_to(filename)) {
+    temp.unlink();
+    nout << "Warning: couldn't write " << filename << "\n";
+    return false;
   }
+
+  if (_verbose) {
+    nout << "Wrote " << filename << "\n";
+  }
+  return true;
 }
 
 /**
@@ -21,6 +21,9 @@
 #include "shaderCompiler.h"
 #include "shaderObject.h"
 #include "thread.h"
+#include "atomicAdjust.h"
+#include "fnvHash.h"
+#include "pset.h"
 
 /**
  * Program that compiles a raw shader source file into a shader object.  Each
@@ -33,21 +36,27 @@ public:
 
   bool run();
 
-  void compile_variation(int n);
-
 protected:
   virtual bool handle_args(Args &args);
 
 private:
   static bool dispatch_stage(const std::string &opt, const std::string &arg, void *var);
 
-  class VariationData {
-  public:
-    VariationData() = default;
+  uint64_t compute_cache_key() const;
+  static bool hash_source(FnvHash &hash, const Filename &filename,
+                          pset<Filename> &visited);
+  Filename get_cache_filename(uint64_t key) const;
+  PT(ShaderObject) read_cached_object(uint64_t key) const;
+  bool write_cached_object(uint64_t key) const;
+
+  bool compile_all();
+  bool setup_variation(ShaderObject::VariationBuilder &builder, size_t index);
+  void compile_block(int n);
+  void compile_variation(const ShaderObject::VariationBuilder &builder);
 
-    ShaderObject::VariationBuilder builder;
-    bool skip;
-  };
+  // The variations are visited in blocks of this many consecutive indices,
+  // each of which is one work item for the thread pool.
+  enum { block_size = 64 };
 
 public:
   ShaderCompiler::Options *_curr_options;
@@ -56,10 +65,17 @@ public:
   PT(ShaderObject) _sho;
   ShaderModule::Stage _stage;
   int _num_threads;
-  int _num_skipped;
   Filename _input_filename;
-  pvector<VariationData> _variations;
-  vector_int _non_skipped_variations;
+  Shader::ShaderLanguage _lang;
+  bool _got_cache_dirname;
+  Filename _cache_dirname;
+
+  size_t _num_variations;
+  // The variation compiled up front on the main thread, or _num_variations
+  // if every variation is skipped.
+  size_t _first_variation;
+  AtomicAdjust::Integer _num_skipped;
+  AtomicAdjust::Integer _num_compiled;
 };
 
 #endif // SHADERCOMPILE_H
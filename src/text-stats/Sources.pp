@@ -19,3 +19,22 @@
   #define INSTALL_HEADERS
 
 #end bin_target
+
+#begin bin_target
+  #define TARGET pstats-aggregate
+  #define LOCAL_LIBS \
+    progbase pstatserver
+  #define OTHER_LIBS \
+    pstatclient:c linmath:c putil:c pipeline:c event:c \
+    pnmimage:c mathutil:c \
+    downloader:c $[if $[HAVE_NET],net:c] $[if $[WANT_NATIVE_NET],nativenet:c] \
+    panda:m \
+     express:c pandaexpress:m \
+    interrogatedb dtoolutil:c dtoolbase:c prc  dtool:m
+
+  #define SOURCES \
+    pStatAggregate.cxx pStatAggregate.h
+
+  #define INSTALL_HEADERS
+
+#end bin_target
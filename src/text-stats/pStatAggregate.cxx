@@ -0,0 +1,515 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatAggregate.cxx
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#include "pStatAggregate.h"
+#include "pStatSessionWriter.h"
+#include "pStatCollectorDef.h"
+#include "pStatFrameData.h"
+#include "pStatViewLevel.h"
+#include "datagramInputFile.h"
+#include "datagramIterator.h"
+#include "string_utils.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>  // snprintf
+
+using std::string;
+
+/**
+ *
+ */
+PStatAggregate::
+PStatAggregate() {
+  set_program_brief("summarize recorded PStats sessions");
+  set_program_description
+    ("This program reads one or more PStats session files, such as those "
+     "recorded with text-stats -b or saved from the graphical PStats server, "
+     "and reports, for each thread, the distribution of the time spent in "
+     "each collector per frame: the minimum, mean, 50th, 95th and 99th "
+     "percentiles, and maximum.  Frames in which a collector was not active "
+     "count as zero time.  Level values, such as memory usage, are reported "
+     "the same way, over the frames in which they were reported.");
+
+  clear_runlines();
+  add_runline("[opts] session.pstats [session.pstats ... ]");
+
+  add_option
+    ("from", "seconds", 0,
+     "Ignore the frames that began earlier than this many seconds after the "
+     "first frame in the recording.",
+     &PStatAggregate::dispatch_double, &_got_from, &_from);
+
+  add_option
+    ("to", "seconds", 0,
+     "Ignore the frames that began later than this many seconds after the "
+     "first frame in the recording.",
+     &PStatAggregate::dispatch_double, &_got_to, &_to);
+
+  add_option
+    ("c", "name", 0,
+     "Report only the indicated collector.  The name may be either the "
+     "collector's own name or its full name, e.g. Draw:Flip.  This option may "
+     "be repeated.",
+     &PStatAggregate::dispatch_vector_string, nullptr, &_collector_names);
+
+  add_option
+    ("hist", "bins", 0,
+     "Also print a histogram of the values of each reported collector, with "
+     "the indicated number of bins between its minimum and maximum values.",
+     &PStatAggregate::dispatch_int, nullptr, &_histogram_bins);
+
+  _got_session_start = false;
+  _session_start = 0.0;
+  _got_from = false;
+  _from = 0.0;
+  _got_to = false;
+  _to = 0.0;
+  _histogram_bins = 0;
+}
+
+/**
+ *
+ */
+void PStatAggregate::
+run() {
+  bool okflag = true;
+
+  Filenames::const_iterator fi;
+  for (fi = _filenames.begin(); fi != _filenames.end(); ++fi) {
+    if (read_session(*fi)) {
+      report(*fi);
+    } else {
+      okflag = false;
+    }
+    clear();
+  }
+
+  if (!okflag) {
+    // Exit with an error if any of the files was unreadable.
+    exit(1);
+  }
+}
+
+/**
+ *
+ */
+bool PStatAggregate::
+handle_args(ProgramBase::Args &args) {
+  if (args.empty()) {
+    nout << "You must specify the session file(s) to read on the command line.\n";
+    return false;
+  }
+
+  ProgramBase::Args::const_iterator ai;
+  for (ai = args.begin(); ai != args.end(); ++ai) {
+    _filenames.push_back(Filename::from_os_specific(*ai));
+  }
+
+  return true;
+}
+
+/**
+ * Reads the indicated session file, collecting the values of all of the
+ * frames within the requested window.  Returns true on success, false on
+ * failure.
+ */
+bool PStatAggregate::
+read_session(const Filename &filename) {
+  // The window is measured from the earliest frame of any thread, which may
+  // not be in the first chunk, so the chunk headers are all scanned first.
+  {
+    DatagramInputFile dif;
+    if (!open_session(dif, filename)) {
+      return false;
+    }
+    find_session_start(dif);
+  }
+
+  DatagramInputFile dif;
+  if (!open_session(dif, filename)) {
+    return false;
+  }
+  Datagram dg;
+  dg.set_stdfloat_double(false);
+
+  _client_data = new PStatClientData;
+
+  bool got_end = false;
+  while (!got_end) {
+    if (!dif.get_datagram(dg)) {
+      // A recording that was interrupted may not have been finished, but the
+      // chunks that were written are still good.
+      nout << filename << " is truncated; reporting the frames read so far.\n";
+      break;
+    }
+
+    DatagramIterator scan(dg);
+    switch ((PStatSessionWriter::ChunkType)scan.get_uint8()) {
+    case PStatSessionWriter::CT_end:
+      got_end = true;
+      break;
+
+    case PStatSessionWriter::CT_collector:
+      _client_data->read_collector_datagram(scan);
+      break;
+
+    case PStatSessionWriter::CT_thread:
+      {
+        int thread_index = scan.get_int16();
+        string name = scan.get_string();
+        _client_data->define_thread(thread_index, name, true);
+      }
+      break;
+
+    case PStatSessionWriter::CT_frames:
+      read_frames(scan);
+      break;
+
+    default:
+      // The client information and the graph layout are of no interest here.
+      break;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Opens the indicated session file and reads its header, leaving the file
+ * positioned at the first chunk.  Returns true on success, false on failure.
+ */
+bool PStatAggregate::
+open_session(DatagramInputFile &dif, const Filename &filename) {
+  if (!dif.open(filename)) {
+    nout << "Failed to open " << filename << " for reading.\n";
+    return false;
+  }
+  string header;
+  if (!dif.read_header(header, 8) || header != PStatSessionWriter::file_header) {
+    nout << filename << " is not a PStats session file.\n";
+    return false;
+  }
+  Datagram dg;
+  dg.set_stdfloat_double(false);
+
+  if (!dif.get_datagram(dg)) {
+    nout << "Failed to read datagram from " << filename << ".\n";
+    return false;
+  }
+
+  DatagramIterator scan(dg);
+  int version = scan.get_uint16();
+  // Room for a minor version number
+  scan.get_uint16();
+
+  if (version == 1) {
+    nout << filename << " was saved by an older version of PStats, which "
+         << "stored the whole session in one block.  Open it and save it "
+         << "again to convert it.\n";
+    return false;
+
+  } else if (version != PStatSessionWriter::major_version) {
+    nout << "Unsupported session file version " << version << ".\n";
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Reads the remaining chunks of a session file opened by open_session(), and
+ * sets _session_start to the earliest start time of any of its CT_frames
+ * chunks.  Only the chunk headers are decoded.
+ */
+void PStatAggregate::
+find_session_start(DatagramInputFile &dif) {
+  _got_session_start = false;
+  _session_start = 0.0;
+
+  Datagram dg;
+  dg.set_stdfloat_double(false);
+  while (dif.get_datagram(dg)) {
+    DatagramIterator scan(dg);
+    PStatSessionWriter::ChunkType type =
+      (PStatSessionWriter::ChunkType)scan.get_uint8();
+    if (type == PStatSessionWriter::CT_end) {
+      break;
+
+    } else if (type == PStatSessionWriter::CT_frames) {
+      // Skip the thread index and the range of frame numbers.
+      scan.skip_bytes(2 + 4 + 4);
+      double start_time = scan.get_float64();
+      scan.get_float64();
+      uint32_t count = scan.get_uint32();
+      if (count != 0 && (!_got_session_start || start_time < _session_start)) {
+        _session_start = start_time;
+        _got_session_start = true;
+      }
+    }
+  }
+}
+
+/**
+ * Processes a CT_frames chunk.  A chunk that lies entirely outside the
+ * requested window is skipped without decoding its frames.
+ */
+void PStatAggregate::
+read_frames(DatagramIterator &scan) {
+  int thread_index = scan.get_int16();
+  // Skip the range of frame numbers covered by this chunk.
+  scan.skip_bytes(4 + 4);
+  double start_time = scan.get_float64();
+  double end_time = scan.get_float64();
+  uint32_t count = scan.get_uint32();
+
+  double from = _session_start + _from;
+  double to = _session_start + _to;
+  if ((_got_from && end_time < from) || (_got_to && start_time > to)) {
+    return;
+  }
+
+  PStatFrameData frame_data;
+  for (uint32_t i = 0; i < count; ++i) {
+    // The frame number is not needed.
+    scan.skip_bytes(4);
+    frame_data.read_datagram(scan, _client_data);
+
+    double frame_start = frame_data.get_start();
+    if ((!_got_from || frame_start >= from) &&
+        (!_got_to || frame_start <= to)) {
+      add_frame(thread_index, frame_data);
+    }
+  }
+}
+
+/**
+ * Adds the values from the indicated frame to the statistics for its thread.
+ */
+void PStatAggregate::
+add_frame(int thread_index, const PStatFrameData &frame_data) {
+  if (frame_data.is_empty()) {
+    return;
+  }
+
+  if (thread_index >= (int)_threads.size()) {
+    _threads.resize(thread_index + 1, nullptr);
+  }
+  ThreadStats *stats = _threads[thread_index];
+  if (stats == nullptr) {
+    stats = new ThreadStats;
+    stats->_thread_data = new PStatThreadData(_client_data);
+    stats->_view.set_thread_data(stats->_thread_data);
+    stats->_num_frames = 0;
+    stats->_start_time = frame_data.get_start();
+    stats->_end_time = frame_data.get_end();
+    _threads[thread_index] = stats;
+  }
+
+  ++stats->_num_frames;
+  stats->_start_time = std::min(stats->_start_time, frame_data.get_start());
+  stats->_end_time = std::max(stats->_end_time, frame_data.get_end());
+
+  if (!frame_data.is_time_empty()) {
+    // The view does the work of matching up the start and stop events and
+    // attributing the time to each collector and its parents.
+    PStatView &view = stats->_view;
+    view.set_to_frame(frame_data);
+
+    int num_collectors = _client_data->get_num_collectors();
+    for (int collector_index = 0; collector_index < num_collectors; ++collector_index) {
+      if (view.has_level(collector_index)) {
+        double value = view.get_level(collector_index)->get_net_value();
+        if (value > 0.0) {
+          stats->_times[collector_index].push_back(value * 1000.0);
+        }
+      }
+    }
+  }
+
+  int num_levels = frame_data.get_num_levels();
+  for (int i = 0; i < num_levels; ++i) {
+    stats->_levels[frame_data.get_level_collector(i)].push_back(frame_data.get_level(i));
+  }
+}
+
+/**
+ * Returns true if the indicated collector should be included in the report,
+ * according to the -c options.
+ */
+bool PStatAggregate::
+is_reported(int collector_index) const {
+  if (_collector_names.empty()) {
+    return true;
+  }
+  if (!_client_data->has_collector(collector_index)) {
+    return false;
+  }
+
+  string name = _client_data->get_collector_name(collector_index);
+  string fullname = _client_data->get_collector_fullname(collector_index);
+  vector_string::const_iterator ni;
+  for (ni = _collector_names.begin(); ni != _collector_names.end(); ++ni) {
+    if ((*ni) == name || (*ni) == fullname) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Writes the statistics collected from the indicated file.
+ */
+void PStatAggregate::
+report(const Filename &filename) {
+  nout << filename << ":\n";
+
+  bool any_frames = false;
+  for (size_t thread_index = 0; thread_index < _threads.size(); ++thread_index) {
+    ThreadStats *stats = _threads[thread_index];
+    if (stats == nullptr) {
+      continue;
+    }
+    any_frames = true;
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "\n%s: %d frames from %.3lf to %.3lf s\n",
+             _client_data->get_thread_name(thread_index).c_str(),
+             stats->_num_frames,
+             stats->_start_time - _session_start,
+             stats->_end_time - _session_start);
+    nout << line;
+
+    snprintf(line, sizeof(line), "  %-40s %8s %10s %10s %10s %10s %10s %10s\n",
+             "collector", "frames", "min", "mean", "p50", "p95", "p99", "max");
+    nout << line;
+
+    CollectorValues::iterator ci;
+    for (ci = stats->_times.begin(); ci != stats->_times.end(); ++ci) {
+      if (is_reported((*ci).first)) {
+        report_values((*ci).first, (*ci).second, stats->_num_frames, "ms");
+      }
+    }
+    for (ci = stats->_levels.begin(); ci != stats->_levels.end(); ++ci) {
+      if (is_reported((*ci).first)) {
+        string units;
+        if (_client_data->has_collector((*ci).first)) {
+          units = _client_data->get_collector_def((*ci).first)._level_units;
+        }
+        report_values((*ci).first, (*ci).second, (int)(*ci).second.size(), units);
+      }
+    }
+  }
+
+  if (!any_frames) {
+    nout << "  No frames in the requested range.\n";
+  }
+  nout << "\n";
+}
+
+/**
+ * Writes the statistics for one collector.  The values are the nonzero
+ * values out of num_frames frames; the remaining frames count as zero.  The
+ * values are sorted in place.
+ */
+void PStatAggregate::
+report_values(int collector_index, Values &values, int num_frames,
+              const string &units) {
+  std::sort(values.begin(), values.end());
+  int num_zeros = num_frames - (int)values.size();
+
+  double sum = 0.0;
+  for (double value : values) {
+    sum += value;
+  }
+
+  // This returns the value at the given fraction of the way through the
+  // frames, by the nearest-rank method.
+  auto percentile = [&] (double p) {
+    int rank = std::max((int)ceil(p * num_frames), 1);
+    return (rank <= num_zeros) ? 0.0 : values[rank - num_zeros - 1];
+  };
+
+  string name = _client_data->has_collector(collector_index)
+    ? _client_data->get_collector_fullname(collector_index)
+    : "collector " + format_string(collector_index);
+  if (!units.empty()) {
+    name += " (" + units + ")";
+  }
+
+  char line[256];
+  snprintf(line, sizeof(line),
+           "  %-40s %8d %10.3lf %10.3lf %10.3lf %10.3lf %10.3lf %10.3lf\n",
+           name.c_str(), (int)values.size(),
+           (num_zeros > 0) ? 0.0 : values.front(),
+           sum / num_frames,
+           percentile(0.50), percentile(0.95), percentile(0.99),
+           values.back());
+  nout << line;
+
+  if (_histogram_bins > 0) {
+    report_histogram(values, num_zeros);
+  }
+}
+
+/**
+ * Writes a histogram of the indicated sorted values, preceded by num_zeros
+ * zero values.
+ */
+void PStatAggregate::
+report_histogram(const Values &values, int num_zeros) {
+  double lo = (num_zeros > 0) ? 0.0 : values.front();
+  double hi = values.back();
+  int num_bins = (hi > lo) ? _histogram_bins : 1;
+  double bin_width = (hi - lo) / num_bins;
+
+  pvector<int> counts(num_bins, 0);
+  counts[0] = num_zeros;
+  for (double value : values) {
+    int bin = (bin_width > 0.0) ? (int)((value - lo) / bin_width) : 0;
+    ++counts[std::min(bin, num_bins - 1)];
+  }
+
+  static const int max_bar = 40;
+  int max_count = *std::max_element(counts.begin(), counts.end());
+
+  for (int bin = 0; bin < num_bins; ++bin) {
+    char line[256];
+    snprintf(line, sizeof(line), "      %10.3lf - %10.3lf %8d ",
+             lo + bin * bin_width, lo + (bin + 1) * bin_width, counts[bin]);
+    nout << line << string((size_t)counts[bin] * max_bar / max_count, '#') << "\n";
+  }
+}
+
+/**
+ * Discards the statistics collected from the previous file.
+ */
+void PStatAggregate::
+clear() {
+  for (ThreadStats *stats : _threads) {
+    delete stats;
+  }
+  _threads.clear();
+  _client_data.clear();
+  _got_session_start = false;
+  _session_start = 0.0;
+}
+
+
+int main(int argc, char *argv[]) {
+  PStatAggregate prog;
+  prog.parse_command_line(argc, argv);
+  prog.run();
+  return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * PANDA 3D SOFTWARE
+ * Copyright (c) Carnegie Mellon University.  All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license.  You should have received a copy of this license along
+ * with this source code in a file named "LICENSE."
+ *
+ * @file pStatAggregate.h
+ * @author brian
+ * @date 2026-10-17
+ */
+
+#ifndef PSTATAGGREGATE_H
+#define PSTATAGGREGATE_H
+
+#include "pandatoolbase.h"
+
+#include "programBase.h"
+#include "pStatClientData.h"
+#include "pStatThreadData.h"
+#include "pStatView.h"
+#include "filename.h"
+#include "pointerTo.h"
+#include "pvector.h"
+#include "pmap.h"
+#include "vector_string.h"
+
+class DatagramInputFile;
+class DatagramIterator;
+class PStatFrameData;
+
+/**
+ * Reads one or more PStats session files, such as those recorded by
+ * text-stats -b, and reports the distribution of the time spent in each
+ * collector per frame, and of each level value, over an optional window of
+ * time.  The frames are processed one chunk at a time as they are read, so
+ * the recording may be much longer than would fit in a PStats server's
+ * history.
+ */
+class PStatAggregate : public ProgramBase {
+public:
+  PStatAggregate();
+
+  void run();
+
+protected:
+  virtual bool handle_args(Args &args);
+
+private:
+  bool read_session(const Filename &filename);
+  bool open_session(DatagramInputFile &dif, const Filename &filename);
+  void find_session_start(DatagramInputFile &dif);
+  void read_frames(DatagramIterator &scan);
+  void add_frame(int thread_index, const PStatFrameData &frame_data);
+
+  bool is_reported(int collector_index) const;
+  void report(const Filename &filename);
+  void report_values(int collector_index, pvector<double> &values,
+                     int num_frames, const std::string &units);
+  void report_histogram(const pvector<double> &values, int num_zeros);
+  void clear();
+
+  typedef pvector<double> Values;
+  typedef pmap<int, Values> CollectorValues;
+
+  // The values collected for each thread.  The time values are in
+  // milliseconds, and are only recorded for the frames in which the collector
+  // was active; the other frames are counted as zero.
+  class ThreadStats {
+  public:
+    PT(PStatThreadData) _thread_data;
+    PStatView _view;
+    int _num_frames;
+    double _start_time;
+    double _end_time;
+    CollectorValues _times;
+    CollectorValues _levels;
+  };
+  typedef pvector<ThreadStats *> Threads;
+  Threads _threads;
+
+  PT(PStatClientData) _client_data;
+  bool _got_session_start;
+  double _session_start;
+
+  typedef pvector<Filename> Filenames;
+  Filenames _filenames;
+
+  bool _got_from;
+  double _from;
+  bool _got_to;
+  double _to;
+  int _histogram_bins;
+  vector_string _collector_names;
+};
+
+#endif
@@ -22,10 +22,20 @@
  *
  */
 TextMonitor::
-TextMonitor(TextStats *server, std::ostream *outStream, bool show_raw_data, bool json) : PStatMonitor(server) {
+TextMonitor(TextStats *server, std::ostream *outStream, bool show_raw_data, bool json,
+            const Filename &record_filename) : PStatMonitor(server) {
   _outStream = outStream;    //[PECI]
   _show_raw_data = show_raw_data;
   _json = json;
+  _record_filename = record_filename;
+}
+
+/**
+ *
+ */
+TextMonitor::
+~TextMonitor() {
+  stop_recording();
 }
 
 /**
@@ -53,6 +63,14 @@ void TextMonitor::
 got_hello() {
   nout << "Now connected to " << get_client_progname() << " on host "
        << get_client_hostname() << "\n";
+
+  if (!_record_filename.empty()) {
+    if (start_recording(_record_filename)) {
+      nout << "Recording to " << _record_filename << "\n";
+    } else {
+      nout << "Unable to record to " << _record_filename << "\n";
+    }
+  }
 }
 
 /**
@@ -83,7 +101,7 @@ got_bad_version(int client_major, int client_minor,
  */
 void TextMonitor::
 new_thread(int thread_index) {
-  if (_json) {
+  if (_json && _record_filename.empty()) {
     const PStatClientData *client_data = get_client_data();
 
     int pid = get_client_pid();
@@ -106,6 +124,13 @@ new_thread(int thread_index) {
  */
 void TextMonitor::
 new_data(int thread_index, int frame_number) {
+  if (!_record_filename.empty()) {
+    // When recording, the frames are written out in blocks as they come in,
+    // without being boiled down or printed.
+    update_recording(thread_index, frame_number);
+    return;
+  }
+
   PStatView &view = get_view(thread_index);
   const PStatThreadData *thread_data = view.get_thread_data();
 
@@ -191,6 +216,19 @@ new_data(int thread_index, int frame_number) {
 void TextMonitor::
 lost_connection() {
   nout << "Lost connection.\n";
+
+  if (is_recording()) {
+    stop_recording();
+    nout << "Wrote " << _record_filename << "\n";
+  }
+  get_server()->remove_monitor(this);
+
+  const PStatClientData *client_data = get_client_data();
+  if (client_data != nullptr && client_data->get_num_dropped_frames() != 0) {
+    nout << client_data->get_num_dropped_frames()
+         << " frames were dropped because they could not be processed "
+            "quickly enough.\n";
+  }
   ++_dummy_pid;
 }
 
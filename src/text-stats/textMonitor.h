@@ -16,6 +16,7 @@
 
 #include "pandatoolbase.h"
 #include "pStatMonitor.h"
+#include "filename.h"
 
 // [PECI]
 #include <iostream>
@@ -29,7 +30,9 @@ class TextStats;
  */
 class TextMonitor : public PStatMonitor {
 public:
-  TextMonitor(TextStats *server, std::ostream *outStream, bool show_raw_data, bool json = false);
+  TextMonitor(TextStats *server, std::ostream *outStream, bool show_raw_data, bool json = false,
+              const Filename &record_filename = Filename());
+  virtual ~TextMonitor();
   TextStats *get_server();
 
   virtual std::string get_monitor_name();
@@ -50,6 +53,10 @@ private:
   bool _show_raw_data;
   bool _json;
   int _dummy_pid = 0;
+
+  // If this is nonempty, the session is recorded to this file instead of
+  // being printed as it comes in.
+  Filename _record_filename;
 };
 
 #include "textMonitor.I"
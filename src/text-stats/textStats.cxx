@@ -16,7 +16,9 @@
 
 #include "pStatServer.h"
 #include "config_pstatclient.h"
+#include "string_utils.h"
 
+#include <algorithm>
 #include <signal.h>
 
 static bool user_interrupted = false;
@@ -55,6 +57,25 @@ TextStats() {
      "Output data in JSON format.",
      &TextStats::dispatch_none, &_json, nullptr);
 
+  add_option
+    ("t", "", 0,
+     "Receive and decode the frame data from each client in a separate "
+     "thread, so that more frames can be received before any have to be "
+     "dropped.  This is useful when recording data from many clients or "
+     "from very fast ones.",
+     &TextStats::dispatch_none, &_threaded_ingest, nullptr);
+
+  add_option
+    ("b", "filename", 0,
+     "Record each session to the indicated file, in the same format written "
+     "by the graphical PStats server, instead of printing the frames as they "
+     "come in.  The frames are written in compact binary blocks and are not "
+     "otherwise processed, so this can keep up with much higher data rates, "
+     "and for longer, than the text output.  If more than one client "
+     "connects, each session after the first is written to a numbered file.  "
+     "The recordings can later be summarized with pstats-aggregate.",
+     &TextStats::dispatch_filename, &_got_record_filename, &_record_filename);
+
   add_option
     ("o", "filename", 0,
      "Filename where to print. If not given then stderr is being used.",
@@ -70,8 +91,36 @@ TextStats() {
  */
 PStatMonitor *TextStats::
 make_monitor(const NetAddress &address) {
+  Filename record_filename;
+  if (_got_record_filename) {
+    record_filename = _record_filename;
+    if (_num_recordings != 0) {
+      record_filename.set_basename_wo_extension(
+        _record_filename.get_basename_wo_extension() + "-" +
+        format_string(_num_recordings + 1));
+    }
+    ++_num_recordings;
+  }
+
+  TextMonitor *monitor = new TextMonitor(this, _outFile, _show_raw_data, _json,
+                                         record_filename);
+  if (!record_filename.empty()) {
+    _monitors.push_back(monitor);
+  }
+  return monitor;
+}
 
-  return new TextMonitor(this, _outFile, _show_raw_data, _json);
+/**
+ * Called by a TextMonitor when its connection has been lost, and its
+ * recording, if any, has been finished.  The monitor need not be kept any
+ * longer.
+ */
+void TextStats::
+remove_monitor(TextMonitor *monitor) {
+  Monitors::iterator mi = std::find(_monitors.begin(), _monitors.end(), monitor);
+  if (mi != _monitors.end()) {
+    _monitors.erase(mi);
+  }
 }
 
 
@@ -84,6 +133,13 @@ run() {
   // clean up nicely if the user stops us.
   signal(SIGINT, &signal_handler);
 
+  if (_got_record_filename && (_json || _show_raw_data)) {
+    nout << "-j and -r are ignored when recording with -b.\n";
+    _json = false;
+    _show_raw_data = false;
+  }
+
+  set_threaded_ingest(_threaded_ingest);
   if (!listen(_port)) {
     nout << "Unable to open port.\n";
     exit(1);
@@ -104,6 +160,13 @@ run() {
   main_loop(&user_interrupted);
   nout << "Exiting.\n";
 
+  // Finish any recordings that are still in progress, so that the files are
+  // complete.
+  for (TextMonitor *monitor : _monitors) {
+    monitor->stop_recording();
+  }
+  _monitors.clear();
+
   if (_json) {
     // Remove the last comma.
     _outFile->seekp(-3, std::ios::cur);
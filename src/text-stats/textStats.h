@@ -18,10 +18,15 @@
 
 #include "programBase.h"
 #include "pStatServer.h"
+#include "filename.h"
+#include "pointerTo.h"
+#include "pvector.h"
 
 #include <iostream>
 #include <fstream>
 
+class TextMonitor;
+
 /**
  * A simple, scrolling-text stats server.  Guaranteed to compile on every
  * platform.
@@ -33,11 +38,22 @@ public:
   virtual PStatMonitor *make_monitor(const NetAddress &address);
 
   void run();
+  void remove_monitor(TextMonitor *monitor);
 
 private:
   int _port;
   bool _show_raw_data;
   bool _json = false;
+  bool _threaded_ingest = false;
+
+  bool _got_record_filename = false;
+  Filename _record_filename;
+  int _num_recordings = 0;
+
+  // The monitors that are currently recording, so that their files can be
+  // finished if we are interrupted.
+  typedef pvector<PT(TextMonitor)> Monitors;
+  Monitors _monitors;
 
   // [PECI]
   bool _got_outputFileName;